@@ -75,6 +75,8 @@
 
 #ifdef _WIN32
 #include "btstack_run_loop_windows.h"
+#elif defined(HAVE_EPOLL)
+#include "btstack_run_loop_linux.h"
 #else
 #include "btstack_run_loop_posix.h"
 #endif
@@ -2076,6 +2078,9 @@ int btstack_server_run(int tcp_flag){
 
 #ifdef _WIN32
     btstack_run_loop_init(btstack_run_loop_windows_get_instance());
+#elif defined(HAVE_EPOLL)
+    // epoll based run loop scales with number of client connections
+    btstack_run_loop_init(btstack_run_loop_linux_get_instance());
 #else
     btstack_run_loop_init(btstack_run_loop_posix_get_instance());
 #endif
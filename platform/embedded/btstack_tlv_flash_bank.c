@@ -73,6 +73,10 @@
 //
 // With ENABLE_TLV_FLASH_WRITE_ONCE, tags are never marked as deleted. Instead, an emtpy tag will be written instead.
 //     Also, lookup and migrate requires to always search until the end of the valid bank
+//
+// With ENABLE_TLV_FLASH_BANK_INDEX, tag, offset, and len of the latest entry for up to TLV_FLASH_BANK_INDEX_SIZE tags
+//     are kept in RAM. The index is built during init and migrate, and updated on store and delete. If there are
+//     more tags than fit into the index, lookup of non-indexed tags falls back to scanning the bank
 
 #if defined (ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD) && defined (ENABLE_TLV_FLASH_WRITE_ONCE)
 #error "Please define either ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD or ENABLE_TLV_FLASH_WRITE_ONCE"
@@ -204,6 +208,63 @@ static void tlv_iterator_fetch_next(btstack_tlv_flash_bank_t * self, tlv_iterato
 	btstack_tlv_flash_bank_iterator_fetch_tag_len(self, it);
 }
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+
+// tag index
+
+static btstack_tlv_flash_bank_index_entry_t * btstack_tlv_flash_bank_index_find(btstack_tlv_flash_bank_t * self, uint32_t tag){
+    uint16_t i;
+    for (i = 0; i < self->index_num_entries; i++){
+        if (self->index[i].tag == tag){
+            return &self->index[i];
+        }
+    }
+    return NULL;
+}
+
+static void btstack_tlv_flash_bank_index_reset(btstack_tlv_flash_bank_t * self){
+    self->index_num_entries = 0;
+    self->index_complete = true;
+}
+
+static void btstack_tlv_flash_bank_index_update(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset, uint32_t len){
+    btstack_tlv_flash_bank_index_entry_t * entry = btstack_tlv_flash_bank_index_find(self, tag);
+    if (entry == NULL){
+        if (self->index_num_entries >= TLV_FLASH_BANK_INDEX_SIZE){
+            log_info("index full, tag '%x' not indexed", (unsigned int) tag);
+            self->index_complete = false;
+            return;
+        }
+        entry = &self->index[self->index_num_entries++];
+        entry->tag = tag;
+    }
+    entry->offset = offset;
+    entry->len    = len;
+}
+
+#ifndef ENABLE_TLV_FLASH_WRITE_ONCE
+static void btstack_tlv_flash_bank_index_remove(btstack_tlv_flash_bank_t * self, btstack_tlv_flash_bank_index_entry_t * entry){
+    // replace with last entry
+    self->index_num_entries--;
+    *entry = self->index[self->index_num_entries];
+}
+#endif
+
+static void btstack_tlv_flash_bank_index_build(btstack_tlv_flash_bank_t * self){
+    btstack_tlv_flash_bank_index_reset(self);
+    tlv_iterator_t it;
+    btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
+    while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
+        // skip deleted entries
+        if (it.tag){
+            btstack_tlv_flash_bank_index_update(self, it.tag, it.offset, it.len);
+        }
+        tlv_iterator_fetch_next(self, &it);
+    }
+    log_info("index: %u tags, complete %u", self->index_num_entries, self->index_complete);
+}
+#endif
+
 //
 
 // check both banks for headers and pick the one with the higher epoch % 4
@@ -265,6 +326,27 @@ static void btstack_tlv_flash_bank_erase_bank(btstack_tlv_flash_bank_t * self, i
 	}
 }
 
+#ifdef ENABLE_TLV_FLASH_WRITE_ONCE
+// search until end for newer entry of same tag
+static bool btstack_tlv_flash_bank_newer_entry_exists(btstack_tlv_flash_bank_t * self, const tlv_iterator_t * it){
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+    const btstack_tlv_flash_bank_index_entry_t * entry = btstack_tlv_flash_bank_index_find(self, it->tag);
+    if (entry != NULL){
+        return entry->offset != it->offset;
+    }
+#endif
+    tlv_iterator_t it2;
+    memcpy(&it2, it, sizeof(tlv_iterator_t));
+    while (btstack_tlv_flash_bank_iterator_has_next(self, &it2)){
+        if ((it2.offset != it->offset) && (it2.tag == it->tag)){
+            return true;
+        }
+        tlv_iterator_fetch_next(self, &it2);
+    }
+    return false;
+}
+#endif
+
 static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
 
 	int next_bank = 1 - self->current_bank;
@@ -284,19 +366,9 @@ static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
             bool tag_valid = true;
 
 #ifdef ENABLE_TLV_FLASH_WRITE_ONCE
-            // search until end for newer entry of same tag
-            tlv_iterator_t it2;
-            memcpy(&it2, &it, sizeof(tlv_iterator_t));
-            while (btstack_tlv_flash_bank_iterator_has_next(self, &it2)){
-                if ((it2.offset != it.offset) && (it2.tag == it.tag)){
-                    tag_valid = false;
-                    break;
-                }
-                tlv_iterator_fetch_next(self, &it2);
-            }
-            if (tag_valid == false){
-			    log_info("skip pos %u, tag '%x' as newer entry found at %u", (unsigned int) tag_index, (unsigned int) it.tag,
-                    (unsigned int) it2.offset);
+            if (btstack_tlv_flash_bank_newer_entry_exists(self, &it)){
+                tag_valid = false;
+                log_info("skip pos %u, tag '%x' as newer entry exists", (unsigned int) tag_index, (unsigned int) it.tag);
             }
 #endif
 
@@ -349,44 +421,90 @@ static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
 	btstack_tlv_flash_bank_write_header(self, next_bank, (epoch_buffer + 1) & 3);
 	self->current_bank = next_bank;
 	self->write_offset = next_write_pos;
+
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_build(self);
+#endif
 }
 
 #ifndef ENABLE_TLV_FLASH_WRITE_ONCE
+static void btstack_tlv_flash_bank_delete_entry(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset, uint32_t len){
+	log_info("Erase tag '%x' at position %u", (unsigned int) tag, (unsigned int) offset);
+
+	// mark entry as invalid
+	uint32_t zero_value = 0;
+#ifdef ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD
+	UNUSED(len);
+	// write delete field after entry header
+	btstack_tlv_flash_bank_write(self, self->current_bank, offset+self->entry_header_len, (uint8_t*) &zero_value, sizeof(zero_value));
+#else
+    uint32_t alignment = self->hal_flash_bank_impl->get_alignment(self->hal_flash_bank_context);
+    if (alignment <= 4){
+        // if alignment < 4, overwrite only tag with zero value
+        btstack_tlv_flash_bank_write(self, self->current_bank, offset, (uint8_t*) &zero_value, sizeof(zero_value));
+    } else {
+        // otherwise, overwrite complete entry. This results in a sequence of { tag: 0, len: 0 } entries
+        uint8_t zero_buffer[32];
+        memset(zero_buffer, 0, sizeof(zero_buffer));
+        uint32_t entry_offset = 0;
+        uint32_t entry_size = btstack_tlv_flash_bank_aligned_entry_size(self, len);
+        while (entry_offset < entry_size) {
+            uint32_t bytes_to_write = btstack_min(entry_size - entry_offset, sizeof(zero_buffer));
+            btstack_tlv_flash_bank_write(self, self->current_bank, offset + entry_offset, zero_buffer, bytes_to_write);
+            entry_offset += bytes_to_write;
+        }
+    }
+#endif
+}
+
 static void btstack_tlv_flash_bank_delete_tag_until_offset(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset){
 	tlv_iterator_t it;
 	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
 	while (btstack_tlv_flash_bank_iterator_has_next(self, &it) && it.offset < offset){
 		if (it.tag == tag){
-			log_info("Erase tag '%x' at position %u", (unsigned int) tag, (unsigned int) it.offset);
+			btstack_tlv_flash_bank_delete_entry(self, tag, it.offset, it.len);
+		}
+		tlv_iterator_fetch_next(self, &it);
+	}
+}
 
-			// mark entry as invalid
-			uint32_t zero_value = 0;
-#ifdef ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD
-			// write delete field after entry header
-			btstack_tlv_flash_bank_write(self, self->current_bank, it.offset+self->entry_header_len, (uint8_t*) &zero_value, sizeof(zero_value));
-#else
-            uint32_t alignment = self->hal_flash_bank_impl->get_alignment(self->hal_flash_bank_context);
-            if (alignment <= 4){
-                // if alignment < 4, overwrite only tag with zero value
-                btstack_tlv_flash_bank_write(self, self->current_bank, it.offset, (uint8_t*) &zero_value, sizeof(zero_value));
-            } else {
-                // otherwise, overwrite complete entry. This results in a sequence of { tag: 0, len: 0 } entries
-                uint8_t zero_buffer[32];
-                memset(zero_buffer, 0, sizeof(zero_buffer));
-                uint32_t entry_offset = 0;
-                uint32_t entry_size = btstack_tlv_flash_bank_aligned_entry_size(self, it.len);
-                while (entry_offset < entry_size) {
-                    uint32_t bytes_to_write = btstack_min(entry_size - entry_offset, sizeof(zero_buffer));
-                    btstack_tlv_flash_bank_write(self, self->current_bank, it.offset + entry_offset, zero_buffer, bytes_to_write);
-                    entry_offset += bytes_to_write;
-                }
-            }
+// delete all entries for tag before offset, uses index if available
+static void btstack_tlv_flash_bank_delete_tag_entries(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset){
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_entry_t * entry = btstack_tlv_flash_bank_index_find(self, tag);
+	if (entry != NULL){
+		// older entries have been deleted when the indexed one was stored
+		btstack_tlv_flash_bank_delete_entry(self, tag, entry->offset, entry->len);
+		btstack_tlv_flash_bank_index_remove(self, entry);
+		return;
+	}
+	if (self->index_complete){
+		return;
+	}
+#endif
+	btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, offset);
+}
+#endif
+
+// find latest entry for tag by scanning the current bank
+// @returns offset of entry or 0 if not found
+static uint32_t btstack_tlv_flash_bank_find_tag(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t * tag_len){
+	uint32_t tag_index = 0;
+	tlv_iterator_t it;
+	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
+	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
+		if (it.tag == tag){
+			log_info("Found tag '%x' at position %u", (unsigned int) tag, (unsigned int) it.offset);
+			tag_index = it.offset;
+			*tag_len  = it.len;
+#ifndef ENABLE_TLV_FLASH_WRITE_ONCE
+			break;
 #endif
 		}
 		tlv_iterator_fetch_next(self, &it);
 	}
+	return tag_index;
 }
-#endif
 
 /**
  * Get Value for Tag
@@ -401,19 +519,17 @@ static int btstack_tlv_flash_bank_get_tag(void * context, uint32_t tag, uint8_t
 
 	uint32_t tag_index = 0;
 	uint32_t tag_len   = 0;
-	tlv_iterator_t it;
-	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
-	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
-		if (it.tag == tag){
-			log_info("Found tag '%x' at position %u", (unsigned int) tag, (unsigned int) it.offset);
-			tag_index = it.offset;
-			tag_len   = it.len;
-#ifndef ENABLE_TLV_FLASH_WRITE_ONCE
-			break;
-#endif
-		}
-		tlv_iterator_fetch_next(self, &it);
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	const btstack_tlv_flash_bank_index_entry_t * entry = btstack_tlv_flash_bank_index_find(self, tag);
+	if (entry != NULL){
+		tag_index = entry->offset;
+		tag_len   = entry->len;
+	} else if (self->index_complete == false){
+		tag_index = btstack_tlv_flash_bank_find_tag(self, tag, &tag_len);
 	}
+#else
+	tag_index = btstack_tlv_flash_bank_find_tag(self, tag, &tag_len);
+#endif
 	if (tag_index == 0) return 0;
 	if (!buffer) return tag_len;
 	int copy_size = btstack_min(buffer_size, tag_len);
@@ -488,7 +604,11 @@ static int btstack_tlv_flash_bank_store_tag(void * context, uint32_t tag, const
 
 #ifndef ENABLE_TLV_FLASH_WRITE_ONCE
 	// overwrite old entries (if exists)
-	btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
+	btstack_tlv_flash_bank_delete_tag_entries(self, tag, self->write_offset);
+#endif
+
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_update(self, tag, self->write_offset, data_size);
 #endif
 
 	// done
@@ -506,7 +626,7 @@ static void btstack_tlv_flash_bank_delete_tag(void * context, uint32_t tag){
     btstack_tlv_flash_bank_store_tag(context, tag, NULL, 0);
 #else
     btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) context;
-	btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
+	btstack_tlv_flash_bank_delete_tag_entries(self, tag, self->write_offset);
 #endif
 }
 
@@ -543,6 +663,10 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
     self->entry_header_len = BTSTACK_TLV_ENTRY_HEADER_LEN;
 #endif
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_reset(self);
+#endif
+
 	// try to find current bank
 	self->current_bank = btstack_tlv_flash_bank_get_latest_bank(self);
 	log_info("found bank %d", self->current_bank);
@@ -559,6 +683,12 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 #ifndef ENABLE_TLV_FLASH_WRITE_ONCE
 			last_tag = it.tag;
 			last_offset = it.offset;
+#endif
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+			// skip deleted entries
+			if (it.tag){
+				btstack_tlv_flash_bank_index_update(self, it.tag, it.offset, it.len);
+			}
 #endif
 			tlv_iterator_fetch_next(self, &it);
 		}
@@ -593,6 +723,9 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 		self->current_bank = 0;
 		btstack_tlv_flash_bank_write_header(self, self->current_bank, 0);	// epoch = 0;
         self->write_offset = btstack_tlv_flash_bank_align_size (self, BTSTACK_TLV_BANK_HEADER_LEN);
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+		btstack_tlv_flash_bank_index_reset(self);
+#endif
 	}
 
 	log_info("write offset %" PRIx32, self->write_offset);
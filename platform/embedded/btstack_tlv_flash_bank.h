@@ -40,6 +40,8 @@
 #define BTSTACK_TLV_FLASH_BANK_H
 
 #include <stdint.h>
+#include "btstack_config.h"
+#include "btstack_bool.h"
 #include "btstack_tlv.h"
 #include "hal_flash_bank.h"
 
@@ -47,6 +49,19 @@
 extern "C" {
 #endif
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+#ifndef TLV_FLASH_BANK_INDEX_SIZE
+#define TLV_FLASH_BANK_INDEX_SIZE 16
+#endif
+
+// latest entry for tag in current bank
+typedef struct {
+    uint32_t tag;
+    uint32_t offset;
+    uint32_t len;
+} btstack_tlv_flash_bank_index_entry_t;
+#endif
+
 typedef struct {
 	const    hal_flash_bank_t * hal_flash_bank_impl;
 	void *   hal_flash_bank_context;
@@ -54,6 +69,12 @@ typedef struct {
 	int8_t   current_bank;
     uint16_t  delete_tag_len;
     uint16_t  entry_header_len;
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+    // index is complete if it contains all tags of the current bank
+    btstack_tlv_flash_bank_index_entry_t index[TLV_FLASH_BANK_INDEX_SIZE];
+    uint16_t index_num_entries;
+    bool     index_complete;
+#endif
 } btstack_tlv_flash_bank_t;
 
 /**
@@ -73,6 +73,7 @@
 #include "hci.h"
 #include "hci_transport.h"
 #include "hci_transport_usb.h"
+#include "hci_transport_h2_libusb.h"
 
 #define DEBUG
 
@@ -88,6 +89,7 @@
 #define HAVE_USB_VENDOR_ID_AND_PRODUCT_ID
 #endif
 
+// default number of transfers, IN transfers can be configured with hci_transport_usb_set_*_in_transfers
 #define ACL_IN_BUFFER_COUNT    3
 #define EVENT_IN_BUFFER_COUNT  3
 #define EVENT_OUT_BUFFER_COUNT 4
@@ -323,6 +325,7 @@ void usb_transfer_list_free( usb_transfer_list_t *list ) {
 }
 
 static usb_transfer_list_t *default_transfer_list = NULL;
+static usb_transfer_list_t *acl_in_transfer_list = NULL;
 
 // For (ab)use as a linked list of received packets
 static list_head_t handle_packet_list = LIST_HEAD_INIT(handle_packet_list);
@@ -388,6 +391,76 @@ static uint16_t usb_product_id;
 // transport interface state
 static int usb_transport_open;
 
+// number and size of IN transfers kept in flight
+static uint8_t  usb_acl_in_transfers   = ACL_IN_BUFFER_COUNT;
+static uint16_t usb_acl_in_transfer_size = HCI_ACL_BUFFER_SIZE;
+static uint8_t  usb_event_in_transfers = EVENT_IN_BUFFER_COUNT;
+#ifdef ENABLE_SCO_OVER_HCI
+static uint8_t  usb_sco_in_transfers   = SCO_IN_BUFFER_COUNT;
+#endif
+
+// per endpoint counters
+static hci_transport_usb_endpoint_counters_t usb_endpoint_counters[HCI_TRANSPORT_USB_ENDPOINT_NUM];
+
+static hci_transport_usb_endpoint_counters_t * usb_endpoint_counters_for_address(int endpoint_address){
+    if (endpoint_address == 0)             return &usb_endpoint_counters[HCI_TRANSPORT_USB_ENDPOINT_COMMAND_OUT];
+    if (endpoint_address == event_in_addr) return &usb_endpoint_counters[HCI_TRANSPORT_USB_ENDPOINT_EVENT_IN];
+    if (endpoint_address == acl_in_addr)   return &usb_endpoint_counters[HCI_TRANSPORT_USB_ENDPOINT_ACL_IN];
+    if (endpoint_address == acl_out_addr)  return &usb_endpoint_counters[HCI_TRANSPORT_USB_ENDPOINT_ACL_OUT];
+#ifdef ENABLE_SCO_OVER_HCI
+    if (endpoint_address == sco_in_addr)   return &usb_endpoint_counters[HCI_TRANSPORT_USB_ENDPOINT_SCO_IN];
+    if (endpoint_address == sco_out_addr)  return &usb_endpoint_counters[HCI_TRANSPORT_USB_ENDPOINT_SCO_OUT];
+#endif
+    return NULL;
+}
+
+static void usb_endpoint_counters_reset(void){
+    memset(usb_endpoint_counters, 0, sizeof(usb_endpoint_counters));
+    int i;
+    for (i = 0; i < HCI_TRANSPORT_USB_ENDPOINT_NUM; i++){
+        usb_endpoint_counters[i].min_in_flight = UINT16_MAX;
+    }
+}
+
+static int usb_submit_transfer(struct libusb_transfer *transfer){
+    int r = libusb_submit_transfer(transfer);
+    hci_transport_usb_endpoint_counters_t * counters = usb_endpoint_counters_for_address(transfer->endpoint);
+    if (counters != NULL){
+        if (r == 0){
+            counters->submitted++;
+            counters->in_flight++;
+        } else {
+            counters->errors++;
+        }
+    }
+    return r;
+}
+
+static void usb_endpoint_counters_update(struct libusb_transfer *transfer){
+    hci_transport_usb_endpoint_counters_t * counters = usb_endpoint_counters_for_address(transfer->endpoint);
+    if (counters == NULL) return;
+    if (counters->in_flight > 0){
+        counters->in_flight--;
+    }
+    switch (transfer->status){
+        case LIBUSB_TRANSFER_COMPLETED:
+            counters->completed++;
+            // transfers left at the controller, 0 indicates that IN endpoint was starved
+            if (counters->in_flight < counters->min_in_flight){
+                counters->min_in_flight = counters->in_flight;
+            }
+            break;
+        case LIBUSB_TRANSFER_STALL:
+            counters->stalls++;
+            break;
+        case LIBUSB_TRANSFER_CANCELLED:
+            break;
+        default:
+            counters->errors++;
+            break;
+    }
+}
+
 static void hci_transport_h2_libusb_emit_usb_info(void) {
     uint8_t event[7 + USB_MAX_PATH_LEN];
     uint16_t pos = 0;
@@ -421,7 +494,43 @@ void hci_transport_usb_set_path(int len, uint8_t * port_numbers){
     memcpy(usb_path, port_numbers, len);
 }
 
+void hci_transport_usb_set_acl_in_transfers(uint8_t num_transfers, uint16_t transfer_size){
+    if ((num_transfers == 0) || (transfer_size > HCI_ACL_BUFFER_SIZE) || ((transfer_size > 0) && (transfer_size < HCI_ACL_HEADER_SIZE))){
+        log_error("hci_transport_usb_set_acl_in_transfers: num transfers %u or transfer size %u invalid", num_transfers, transfer_size);
+        return;
+    }
+    usb_acl_in_transfers = num_transfers;
+    usb_acl_in_transfer_size = (transfer_size == 0) ? HCI_ACL_BUFFER_SIZE : transfer_size;
+}
+
+void hci_transport_usb_set_event_in_transfers(uint8_t num_transfers){
+    if (num_transfers == 0){
+        log_error("hci_transport_usb_set_event_in_transfers: num transfers invalid");
+        return;
+    }
+    usb_event_in_transfers = num_transfers;
+}
+
+void hci_transport_usb_set_sco_in_transfers(uint8_t num_transfers){
+#ifdef ENABLE_SCO_OVER_HCI
+    if (num_transfers == 0){
+        log_error("hci_transport_usb_set_sco_in_transfers: num transfers invalid");
+        return;
+    }
+    usb_sco_in_transfers = num_transfers;
+#else
+    UNUSED(num_transfers);
+#endif
+}
+
+void hci_transport_usb_get_endpoint_counters(hci_transport_usb_endpoint_t endpoint, hci_transport_usb_endpoint_counters_t * counters){
+    btstack_assert(endpoint < HCI_TRANSPORT_USB_ENDPOINT_NUM);
+    *counters = usb_endpoint_counters[endpoint];
+}
+
 LIBUSB_CALL static void async_callback(struct libusb_transfer *transfer) {
+    usb_endpoint_counters_update(transfer);
+
     if (libusb_state != LIB_USB_TRANSFERS_ALLOCATED) {
         log_info("shutdown, transfer %p", transfer);
         usb_transfer_list_free_entry( transfer );
@@ -439,7 +548,7 @@ LIBUSB_CALL static void async_callback(struct libusb_transfer *transfer) {
         if (r) {
             log_error("Error rclearing halt %d", r);
         }
-        r = libusb_submit_transfer(transfer);
+        r = usb_submit_transfer(transfer);
         if (r) {
             log_error("Error re-submitting transfer %d", r);
         }
@@ -449,13 +558,15 @@ LIBUSB_CALL static void async_callback(struct libusb_transfer *transfer) {
             usb_transfer_list_release( sco_transfer_list, transfer );
         } else
 #endif
-        {
+        if (transfer->endpoint == acl_in_addr) {
+            usb_transfer_list_release( acl_in_transfer_list, transfer );
+        } else {
             usb_transfer_list_release( default_transfer_list, transfer );
         }
     } else {
         log_info("async_callback. not data -> resubmit transfer, endpoint %x, status %x, length %u", transfer->endpoint, transfer->status, transfer->actual_length);
         // No usable data, just resubmit packet
-        r = libusb_submit_transfer(transfer);
+        r = usb_submit_transfer(transfer);
         if (r) {
             log_error("Error re-submitting transfer %d", r);
         }
@@ -488,7 +599,7 @@ static int usb_send_sco_packet(uint8_t *packet, int size){
     // log_info("usb_send_sco_packet: size %u, max size %u, iso packet size %u", size, NUM_ISO_PACKETS * iso_packet_size, iso_packet_size);
     libusb_fill_iso_transfer(transfer, handle, sco_out_addr, data, NUM_ISO_PACKETS * iso_packet_size, NUM_ISO_PACKETS, async_callback, user_data, 0);
     libusb_set_iso_packet_lengths(transfer, iso_packet_size);
-    r = libusb_submit_transfer(transfer);
+    r = usb_submit_transfer(transfer);
     if (r < 0) {
         log_error("Error submitting sco transfer, %d", r);
         return -1;
@@ -615,7 +726,7 @@ static void handle_completed_transfer(struct libusb_transfer *transfer){
 
     if (resubmit){
         // Re-submit transfer 
-        int r = libusb_submit_transfer(transfer);
+        int r = usb_submit_transfer(transfer);
         if (r) {
             log_error("Error re-submitting transfer %d", r);
         }
@@ -963,7 +1074,7 @@ static int usb_sco_start(void){
 
     // incoming
     int c;
-    for (c = 0 ; c < SCO_IN_BUFFER_COUNT ; c++) {
+    for (c = 0 ; c < usb_sco_in_transfers ; c++) {
 
         struct libusb_transfer *transfer = usb_transfer_list_acquire( sco_transfer_list );
         uint8_t *data = transfer->buffer;
@@ -973,7 +1084,7 @@ static int usb_sco_start(void){
         libusb_fill_iso_transfer(transfer, handle, sco_in_addr,
                 data, NUM_ISO_PACKETS * iso_packet_size, NUM_ISO_PACKETS, async_callback, user_data, 0);
         libusb_set_iso_packet_lengths(transfer, iso_packet_size);
-        r = libusb_submit_transfer(transfer);
+        r = usb_submit_transfer(transfer);
         if (r) {
             log_error("Error submitting isochronous in transfer %d", r);
             usb_close();
@@ -1158,14 +1269,22 @@ static int usb_open(void){
     // allocate transfer handlers
     int c;
 
+    usb_endpoint_counters_reset();
+
     default_transfer_list = usb_transfer_list_alloc(
-            EVENT_OUT_BUFFER_COUNT+EVENT_IN_BUFFER_COUNT+ACL_IN_BUFFER_COUNT,
+            EVENT_OUT_BUFFER_COUNT+usb_event_in_transfers,
             0,
             LIBUSB_CONTROL_SETUP_SIZE + HCI_INCOMING_PRE_BUFFER_SIZE + HCI_ACL_BUFFER_SIZE ); // biggest packet ever to expect
 
+    // ACL IN transfers are handed to HCI without copy, pre-buffer allows HCI/L2CAP to prepend data
+    acl_in_transfer_list = usb_transfer_list_alloc(
+            usb_acl_in_transfers,
+            0,
+            HCI_INCOMING_PRE_BUFFER_SIZE + usb_acl_in_transfer_size );
+
 #ifdef ENABLE_SCO_OVER_HCI
     sco_transfer_list = usb_transfer_list_alloc(
-            SCO_OUT_BUFFER_COUNT+SCO_IN_BUFFER_COUNT,
+            SCO_OUT_BUFFER_COUNT+usb_sco_in_transfers,
             NUM_ISO_PACKETS,
             SCO_PACKET_SIZE
             );
@@ -1175,14 +1294,14 @@ static int usb_open(void){
 
     libusb_state = LIB_USB_TRANSFERS_ALLOCATED;
 
-    for (c = 0 ; c < EVENT_IN_BUFFER_COUNT ; c++) {
+    for (c = 0 ; c < usb_event_in_transfers ; c++) {
         struct libusb_transfer *transfer = usb_transfer_list_acquire( default_transfer_list );
         uint8_t *data = transfer->buffer;
         void *user_data = transfer->user_data;
         // configure event_in handlers      
         libusb_fill_interrupt_transfer(transfer, handle, event_in_addr,
                 data, HCI_ACL_BUFFER_SIZE, async_callback, user_data, 0);
-        r = libusb_submit_transfer(transfer);
+        r = usb_submit_transfer(transfer);
         if (r) {
             log_error("Error submitting interrupt transfer %d", r);
             usb_close();
@@ -1190,15 +1309,15 @@ static int usb_open(void){
         }
     }
 
-    for (c = 0 ; c < ACL_IN_BUFFER_COUNT ; c++) {
-        struct libusb_transfer *transfer = usb_transfer_list_acquire( default_transfer_list );
+    for (c = 0 ; c < usb_acl_in_transfers ; c++) {
+        struct libusb_transfer *transfer = usb_transfer_list_acquire( acl_in_transfer_list );
         usb_transfer_list_entry_t *transfer_meta_data = (usb_transfer_list_entry_t*)transfer->user_data;
         uint8_t *data = transfer_meta_data->data;
         void *user_data = transfer->user_data;
         // configure acl_in handlers
         libusb_fill_bulk_transfer(transfer, handle, acl_in_addr,
-                data + HCI_INCOMING_PRE_BUFFER_SIZE, HCI_ACL_BUFFER_SIZE, async_callback, user_data, 0) ;
-        r = libusb_submit_transfer(transfer);
+                data + HCI_INCOMING_PRE_BUFFER_SIZE, usb_acl_in_transfer_size, async_callback, user_data, 0) ;
+        r = usb_submit_transfer(transfer);
         if (r) {
             log_error("Error submitting bulk in transfer %d", r);
             usb_close();
@@ -1290,11 +1409,13 @@ static int usb_close(void) {
         case LIB_USB_INTERFACE_CLAIMED:
             libusb_set_pollfd_notifiers( NULL, NULL, NULL, NULL );
             usb_transfer_list_cancel( default_transfer_list );
+            usb_transfer_list_cancel( acl_in_transfer_list );
 #ifdef ENABLE_SCO_OVER_HCI
             usb_transfer_list_cancel( sco_transfer_list );
 #endif
 
             int in_flight_transfers = usb_transfer_list_in_flight( default_transfer_list );
+            in_flight_transfers += usb_transfer_list_in_flight( acl_in_transfer_list );
 #ifdef ENABLE_SCO_OVER_HCI
             in_flight_transfers += usb_transfer_list_in_flight( sco_transfer_list );
 #endif
@@ -1303,12 +1424,14 @@ static int usb_close(void) {
                 libusb_handle_events_timeout(NULL, &tv);
 
                 in_flight_transfers = usb_transfer_list_in_flight( default_transfer_list );
+                in_flight_transfers += usb_transfer_list_in_flight( acl_in_transfer_list );
 #ifdef ENABLE_SCO_OVER_HCI
                 in_flight_transfers += usb_transfer_list_in_flight( sco_transfer_list );
 #endif
             }
 
             usb_transfer_list_free( default_transfer_list );
+            usb_transfer_list_free( acl_in_transfer_list );
 #ifdef ENABLE_SCO_OVER_HCI
             usb_transfer_list_free( sco_transfer_list );
             sco_enabled = 0;
@@ -1393,7 +1516,7 @@ static int usb_send_cmd_packet(uint8_t *packet, int size){
     libusb_fill_control_transfer(transfer, handle, data, async_callback, user_data, 0);
 
     // submit transfer
-    r = libusb_submit_transfer(transfer);
+    r = usb_submit_transfer(transfer);
 
     if (r < 0) {
         log_error("Error submitting cmd transfer %d", r);
@@ -1420,7 +1543,7 @@ static int usb_send_acl_packet(uint8_t *packet, int size){
     libusb_fill_bulk_transfer(transfer, handle, acl_out_addr, data, size,
         async_callback, transfer->user_data, 0);
 
-    r = libusb_submit_transfer(transfer);
+    r = usb_submit_transfer(transfer);
 
     if (r < 0) {
         log_error("Error submitting acl transfer, %d", r);
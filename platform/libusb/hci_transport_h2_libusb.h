@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+/*
+ *  hci_transport_h2_libusb.h
+ *
+ *  Configuration and statistics of the HCI Transport for USB based on libusb, see hci_transport_usb.h for the
+ *  common USB Transport API
+ */
+
+#ifndef HCI_TRANSPORT_H2_LIBUSB_H
+#define HCI_TRANSPORT_H2_LIBUSB_H
+
+#include <stdint.h>
+#include "hci_transport_usb.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+/* API_START */
+
+typedef enum {
+    HCI_TRANSPORT_USB_ENDPOINT_COMMAND_OUT = 0,
+    HCI_TRANSPORT_USB_ENDPOINT_EVENT_IN,
+    HCI_TRANSPORT_USB_ENDPOINT_ACL_OUT,
+    HCI_TRANSPORT_USB_ENDPOINT_ACL_IN,
+    HCI_TRANSPORT_USB_ENDPOINT_SCO_OUT,
+    HCI_TRANSPORT_USB_ENDPOINT_SCO_IN,
+    HCI_TRANSPORT_USB_ENDPOINT_NUM
+} hci_transport_usb_endpoint_t;
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t stalls;
+    uint32_t errors;
+    // transfers currently submitted
+    uint16_t in_flight;
+    // min number of transfers left submitted when a transfer completed, 0 indicates that IN endpoint was starved
+    uint16_t min_in_flight;
+} hci_transport_usb_endpoint_counters_t;
+
+/**
+ * @brief Set number of ACL IN bulk transfers kept in flight and their max size. Call before HCI power on.
+ * @param num_transfers, default 3
+ * @param transfer_size max ACL packet size incl. ACL header, 0 for HCI_ACL_BUFFER_SIZE
+ */
+void hci_transport_usb_set_acl_in_transfers(uint8_t num_transfers, uint16_t transfer_size);
+
+/**
+ * @brief Set number of HCI Event IN interrupt transfers kept in flight. Call before HCI power on.
+ * @param num_transfers, default 3
+ */
+void hci_transport_usb_set_event_in_transfers(uint8_t num_transfers);
+
+/**
+ * @brief Set number of SCO IN isochronous transfers kept in flight. Call before HCI power on.
+ * @param num_transfers, default 10
+ */
+void hci_transport_usb_set_sco_in_transfers(uint8_t num_transfers);
+
+/**
+ * @brief Get transfer counters for endpoint, counters are reset on HCI power on
+ * @param endpoint
+ * @param counters
+ */
+void hci_transport_usb_get_endpoint_counters(hci_transport_usb_endpoint_t endpoint, hci_transport_usb_endpoint_counters_t * counters);
+
+/* API_END */
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // HCI_TRANSPORT_H2_LIBUSB_H
@@ -0,0 +1,502 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "btstack_run_loop_linux.c"
+
+/*
+ *  btstack_run_loop_linux.c
+ *
+ *  Run loop for Linux based on epoll(), timerfd and eventfd
+ *
+ *  In contrast to the select() based POSIX run loop, file descriptors are registered with the kernel
+ *  when a data source is added or its callbacks are changed. Each wakeup then only reports the ready
+ *  data sources, so the cost does not depend on the number of registered data sources.
+ */
+
+#ifdef __linux__
+
+// enable epoll, timerfd and eventfd
+#define _GNU_SOURCE
+
+#include "btstack_run_loop_linux.h"
+
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "btstack_linked_list.h"
+#include "btstack_debug.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+// max number of ready file descriptors reported by a single epoll_wait call
+#ifndef BTSTACK_RUN_LOOP_LINUX_MAX_EVENTS
+#define BTSTACK_RUN_LOOP_LINUX_MAX_EVENTS 32
+#endif
+
+static int  btstack_run_loop_linux_epoll_fd = -1;
+
+static bool btstack_run_loop_linux_exit_requested;
+
+// registered data sources indexed by fd
+static btstack_data_source_t ** btstack_run_loop_linux_data_source_for_fd;
+static int                      btstack_run_loop_linux_data_source_for_fd_size;
+
+// ready events of current epoll_wait call, entries of removed data sources are cleared
+static struct epoll_event    btstack_run_loop_linux_events[BTSTACK_RUN_LOOP_LINUX_MAX_EVENTS];
+static int                   btstack_run_loop_linux_events_count;
+static int                   btstack_run_loop_linux_events_index;
+static btstack_data_source_t * btstack_run_loop_linux_current_ds;
+
+// timerfd for next timeout
+static int                   btstack_run_loop_linux_timer_fd = -1;
+static btstack_data_source_t btstack_run_loop_linux_timer_ds;
+static bool                  btstack_run_loop_linux_timer_armed;
+static uint64_t              btstack_run_loop_linux_timer_deadline_ms;
+
+// to trigger process callbacks other thread
+static pthread_mutex_t       btstack_run_loop_linux_callbacks_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int                   btstack_run_loop_linux_process_callbacks_fd = -1;
+static btstack_data_source_t btstack_run_loop_linux_process_callbacks_ds;
+
+// to trigger poll data sources from irq
+static int                   btstack_run_loop_linux_poll_data_sources_fd = -1;
+static btstack_data_source_t btstack_run_loop_linux_poll_data_sources_ds;
+
+// start time. tv_nsec = 0
+static struct timespec init_ts;
+
+static uint32_t btstack_run_loop_linux_events_for_flags(uint16_t flags){
+    uint32_t events = 0;
+    if ((flags & DATA_SOURCE_CALLBACK_READ) != 0){
+        events |= EPOLLIN;
+    }
+    if ((flags & DATA_SOURCE_CALLBACK_WRITE) != 0){
+        events |= EPOLLOUT;
+    }
+    return events;
+}
+
+static void btstack_run_loop_linux_epoll_ctl(int op, btstack_data_source_t * ds){
+    if (ds->source.fd < 0) return;
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = btstack_run_loop_linux_events_for_flags(ds->flags);
+    event.data.ptr = ds;
+    int res = epoll_ctl(btstack_run_loop_linux_epoll_fd, op, ds->source.fd, &event);
+    if (res < 0){
+        log_error("epoll_ctl(%u) for fd %u -> errno %u", op, ds->source.fd, errno);
+    }
+}
+
+static bool btstack_run_loop_linux_data_source_registered(btstack_data_source_t * ds){
+    int fd = ds->source.fd;
+    if ((fd < 0) || (fd >= btstack_run_loop_linux_data_source_for_fd_size)) return false;
+    return btstack_run_loop_linux_data_source_for_fd[fd] == ds;
+}
+
+static bool btstack_run_loop_linux_data_source_for_fd_reserve(int fd){
+    if (fd < btstack_run_loop_linux_data_source_for_fd_size) return true;
+    int new_size = (btstack_run_loop_linux_data_source_for_fd_size > 0) ? btstack_run_loop_linux_data_source_for_fd_size : 64;
+    while (new_size <= fd){
+        new_size *= 2;
+    }
+    btstack_data_source_t ** table = (btstack_data_source_t **) realloc(btstack_run_loop_linux_data_source_for_fd, new_size * sizeof(btstack_data_source_t *));
+    if (table == NULL) return false;
+    memset(&table[btstack_run_loop_linux_data_source_for_fd_size], 0, (new_size - btstack_run_loop_linux_data_source_for_fd_size) * sizeof(btstack_data_source_t *));
+    btstack_run_loop_linux_data_source_for_fd = table;
+    btstack_run_loop_linux_data_source_for_fd_size = new_size;
+    return true;
+}
+
+/**
+ * Add data_source to run_loop
+ */
+static void btstack_run_loop_linux_add_data_source(btstack_data_source_t *ds){
+    btstack_run_loop_base_add_data_source(ds);
+    int fd = ds->source.fd;
+    if (fd < 0) return;
+    if (btstack_run_loop_linux_data_source_for_fd_reserve(fd) == false){
+        log_error("no memory to register fd %u", fd);
+        return;
+    }
+    btstack_run_loop_linux_data_source_for_fd[fd] = ds;
+    // epoll reports hangup and errors even without requested events, only add fd if a callback is enabled
+    if (btstack_run_loop_linux_events_for_flags(ds->flags) == 0) return;
+    btstack_run_loop_linux_epoll_ctl(EPOLL_CTL_ADD, ds);
+}
+
+/**
+ * Remove data_source from run loop
+ */
+static bool btstack_run_loop_linux_remove_data_source(btstack_data_source_t *ds){
+    bool removed = btstack_run_loop_base_remove_data_source(ds);
+    if (removed == false) return false;
+
+    // fd might have been closed already, which also removes it from the epoll set
+    if (btstack_run_loop_linux_data_source_registered(ds)){
+        btstack_run_loop_linux_data_source_for_fd[ds->source.fd] = NULL;
+        if (btstack_run_loop_linux_events_for_flags(ds->flags) != 0){
+            (void) epoll_ctl(btstack_run_loop_linux_epoll_fd, EPOLL_CTL_DEL, ds->source.fd, NULL);
+        }
+    }
+
+    // drop pending events for this data source
+    if (btstack_run_loop_linux_current_ds == ds){
+        btstack_run_loop_linux_current_ds = NULL;
+    }
+    int i;
+    for (i = btstack_run_loop_linux_events_index; i < btstack_run_loop_linux_events_count; i++){
+        if (btstack_run_loop_linux_events[i].data.ptr == ds){
+            btstack_run_loop_linux_events[i].data.ptr = NULL;
+        }
+    }
+    return true;
+}
+
+static void btstack_run_loop_linux_update_data_source_callbacks(btstack_data_source_t * ds, uint16_t flags){
+    uint32_t old_events = btstack_run_loop_linux_events_for_flags(ds->flags);
+    ds->flags = flags;
+    if (btstack_run_loop_linux_events_for_flags(flags) == old_events) return;
+    // only registered data sources are known to epoll
+    if (btstack_run_loop_linux_data_source_registered(ds) == false) return;
+    // fd without enabled callbacks is not in epoll set, see btstack_run_loop_linux_add_data_source
+    if (old_events == 0){
+        btstack_run_loop_linux_epoll_ctl(EPOLL_CTL_ADD, ds);
+    } else if (btstack_run_loop_linux_events_for_flags(flags) == 0){
+        (void) epoll_ctl(btstack_run_loop_linux_epoll_fd, EPOLL_CTL_DEL, ds->source.fd, NULL);
+    } else {
+        btstack_run_loop_linux_epoll_ctl(EPOLL_CTL_MOD, ds);
+    }
+}
+
+static void btstack_run_loop_linux_enable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callback_types){
+    btstack_run_loop_linux_update_data_source_callbacks(ds, ds->flags | callback_types);
+}
+
+static void btstack_run_loop_linux_disable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callback_types){
+    btstack_run_loop_linux_update_data_source_callbacks(ds, ds->flags & ~callback_types);
+}
+
+/**
+ * @brief Returns the time in ms since start without overflow
+ */
+static uint64_t btstack_run_loop_linux_get_time_ms_64(void){
+    struct timespec now_ts;
+    clock_gettime(CLOCK_MONOTONIC, &now_ts);
+    uint64_t sec_val  = (uint64_t) (now_ts.tv_sec - init_ts.tv_sec);
+    uint64_t nsec_val = (uint64_t) now_ts.tv_nsec;
+    return (sec_val * 1000) + (nsec_val / 1000000);
+}
+
+/**
+ * @brief Queries the current time in ms since start
+ */
+static uint32_t btstack_run_loop_linux_get_time_ms(void){
+    return (uint32_t) btstack_run_loop_linux_get_time_ms_64();
+}
+
+static void btstack_run_loop_linux_set_timer(btstack_timer_source_t *a, uint32_t timeout_in_ms){
+    uint32_t time_ms = btstack_run_loop_linux_get_time_ms();
+    a->timeout = time_ms + timeout_in_ms;
+    log_debug("btstack_run_loop_linux_set_timer to %u ms (now %u, timeout %u)", a->timeout, time_ms, timeout_in_ms);
+}
+
+static void btstack_run_loop_linux_timer_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    uint64_t expirations;
+    ssize_t bytes_read = read(ds->source.fd, &expirations, sizeof(expirations));
+    UNUSED(bytes_read);
+    // one-shot timer expired, timers are processed at the end of the run loop iteration
+    btstack_run_loop_linux_timer_armed = false;
+}
+
+static void btstack_run_loop_linux_timer_fd_set(bool armed, uint64_t deadline_ms){
+    struct itimerspec timer_spec;
+    memset(&timer_spec, 0, sizeof(timer_spec));
+    if (armed){
+        timer_spec.it_value.tv_sec  = init_ts.tv_sec + (time_t) (deadline_ms / 1000);
+        timer_spec.it_value.tv_nsec = (long) (deadline_ms % 1000) * 1000000;
+    }
+    int res = timerfd_settime(btstack_run_loop_linux_timer_fd, TFD_TIMER_ABSTIME, &timer_spec, NULL);
+    if (res < 0){
+        log_error("timerfd_settime -> errno %u", errno);
+    }
+    btstack_run_loop_linux_timer_armed = armed;
+    btstack_run_loop_linux_timer_deadline_ms = deadline_ms;
+}
+
+// @return timeout for epoll_wait
+static int btstack_run_loop_linux_update_timer_fd(void){
+    uint64_t now_ms = btstack_run_loop_linux_get_time_ms_64();
+    int32_t delta_ms = btstack_run_loop_base_get_time_until_timeout((uint32_t) now_ms);
+    if (delta_ms == 0){
+        // timer already expired, don't block
+        return 0;
+    }
+    if (delta_ms < 0){
+        // no timer, avoid spurious wakeups
+        if (btstack_run_loop_linux_timer_armed){
+            btstack_run_loop_linux_timer_fd_set(false, 0);
+        }
+        return -1;
+    }
+    // only re-arm timerfd if next timeout has changed
+    uint64_t deadline_ms = now_ms + (uint32_t) delta_ms;
+    if ((btstack_run_loop_linux_timer_armed == false) || (btstack_run_loop_linux_timer_deadline_ms != deadline_ms)){
+        log_debug("btstack_run_loop_linux_execute next timeout in %u ms", delta_ms);
+        btstack_run_loop_linux_timer_fd_set(true, deadline_ms);
+    }
+    return -1;
+}
+
+static void btstack_run_loop_linux_process_events(void){
+    for (btstack_run_loop_linux_events_index = 0; btstack_run_loop_linux_events_index < btstack_run_loop_linux_events_count; btstack_run_loop_linux_events_index++){
+        struct epoll_event * event = &btstack_run_loop_linux_events[btstack_run_loop_linux_events_index];
+        btstack_data_source_t * ds = (btstack_data_source_t *) event->data.ptr;
+        // data source removed by previous callback
+        if (ds == NULL) continue;
+        btstack_run_loop_linux_current_ds = ds;
+        // report hangup and errors as ready to read/write, same as select()
+        if (((event->events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) && ((ds->flags & DATA_SOURCE_CALLBACK_READ) != 0)){
+            log_debug("btstack_run_loop_linux_execute: process read ds %p with fd %u\n", ds, ds->source.fd);
+            ds->process(ds, DATA_SOURCE_CALLBACK_READ);
+        }
+        // data source removed by read callback
+        if (btstack_run_loop_linux_current_ds == NULL) continue;
+        if (((event->events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) != 0) && ((ds->flags & DATA_SOURCE_CALLBACK_WRITE) != 0)){
+            log_debug("btstack_run_loop_linux_execute: process write ds %p with fd %u\n", ds, ds->source.fd);
+            ds->process(ds, DATA_SOURCE_CALLBACK_WRITE);
+        }
+    }
+    btstack_run_loop_linux_current_ds = NULL;
+    btstack_run_loop_linux_events_count = 0;
+    btstack_run_loop_linux_events_index = 0;
+}
+
+/**
+ * Execute run_loop
+ */
+static void btstack_run_loop_linux_execute(void) {
+    log_info("Linux run loop with epoll");
+
+    // clear exit flag
+    btstack_run_loop_linux_exit_requested = false;
+
+    while (btstack_run_loop_linux_exit_requested == false) {
+        // get next timeout
+        int timeout_ms = btstack_run_loop_linux_update_timer_fd();
+
+        // wait for ready FDs
+        int res = epoll_wait(btstack_run_loop_linux_epoll_fd, btstack_run_loop_linux_events, BTSTACK_RUN_LOOP_LINUX_MAX_EVENTS, timeout_ms);
+        if (res < 0){
+            if (errno != EINTR){
+                log_error("btstack_run_loop_linux_execute: epoll_wait -> errno %u", errno);
+            }
+        }
+        if (res > 0){
+            btstack_run_loop_linux_events_count = res;
+            btstack_run_loop_linux_process_events();
+        }
+
+        // process timers
+        btstack_run_loop_base_process_timers(btstack_run_loop_linux_get_time_ms());
+    }
+}
+
+static void btstack_run_loop_linux_trigger_exit(void){
+    btstack_run_loop_linux_exit_requested = true;
+}
+
+// trigger eventfd
+static void btstack_run_loop_linux_trigger_eventfd(int fd){
+    if (fd < 0) return;
+    const uint64_t value = 1;
+    ssize_t bytes_written = write(fd, &value, sizeof(value));
+    UNUSED(bytes_written);
+}
+
+static void btstack_run_loop_linux_read_eventfd(int fd){
+    uint64_t value;
+    ssize_t bytes_read = read(fd, &value, sizeof(value));
+    UNUSED(bytes_read);
+}
+
+// poll data sources from irq
+
+static void btstack_run_loop_linux_poll_data_sources_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    btstack_run_loop_linux_read_eventfd(ds->source.fd);
+    // poll data sources
+    btstack_run_loop_base_poll_data_sources();
+}
+
+static void btstack_run_loop_linux_poll_data_sources_from_irq(void){
+    // trigger run loop
+    btstack_run_loop_linux_trigger_eventfd(btstack_run_loop_linux_poll_data_sources_fd);
+}
+
+// execute on main thread from same or different thread
+
+static void btstack_run_loop_linux_process_callbacks_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    btstack_run_loop_linux_read_eventfd(ds->source.fd);
+    // execute callbacks - protect list with mutex
+    while (1){
+        pthread_mutex_lock(&btstack_run_loop_linux_callbacks_mutex);
+        btstack_context_callback_registration_t * callback_registration = (btstack_context_callback_registration_t *) btstack_linked_list_pop(&btstack_run_loop_base_callbacks);
+        pthread_mutex_unlock(&btstack_run_loop_linux_callbacks_mutex);
+        if (callback_registration == NULL){
+            break;
+        }
+        (*callback_registration->callback)(callback_registration->context);
+    }
+}
+
+static void btstack_run_loop_linux_execute_on_main_thread(btstack_context_callback_registration_t * callback_registration){
+    // protect list with mutex
+    pthread_mutex_lock(&btstack_run_loop_linux_callbacks_mutex);
+    btstack_run_loop_base_add_callback(callback_registration);
+    pthread_mutex_unlock(&btstack_run_loop_linux_callbacks_mutex);
+    // trigger run loop
+    btstack_run_loop_linux_trigger_eventfd(btstack_run_loop_linux_process_callbacks_fd);
+}
+
+//init
+
+static void btstack_run_loop_linux_close_fd(int * fd){
+    if (*fd >= 0){
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+static void btstack_run_loop_linux_register_internal_data_source(btstack_data_source_t * data_source, int fd,
+    void (*process)(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)){
+    data_source->source.fd = fd;
+    data_source->process = process;
+    data_source->flags = DATA_SOURCE_CALLBACK_READ;
+    btstack_run_loop_linux_add_data_source(data_source);
+}
+
+static void btstack_run_loop_linux_init(void){
+    btstack_run_loop_base_init();
+
+    clock_gettime(CLOCK_MONOTONIC, &init_ts);
+    init_ts.tv_nsec = 0;
+
+    // release fds from previous init
+    btstack_run_loop_linux_close_fd(&btstack_run_loop_linux_timer_fd);
+    btstack_run_loop_linux_close_fd(&btstack_run_loop_linux_process_callbacks_fd);
+    btstack_run_loop_linux_close_fd(&btstack_run_loop_linux_poll_data_sources_fd);
+    btstack_run_loop_linux_close_fd(&btstack_run_loop_linux_epoll_fd);
+
+    if (btstack_run_loop_linux_data_source_for_fd_size > 0){
+        memset(btstack_run_loop_linux_data_source_for_fd, 0, btstack_run_loop_linux_data_source_for_fd_size * sizeof(btstack_data_source_t *));
+    }
+    btstack_run_loop_linux_events_count = 0;
+    btstack_run_loop_linux_events_index = 0;
+    btstack_run_loop_linux_current_ds = NULL;
+    btstack_run_loop_linux_timer_armed = false;
+
+    btstack_run_loop_linux_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (btstack_run_loop_linux_epoll_fd < 0){
+        log_error("epoll_create1() failed, errno %u", errno);
+        return;
+    }
+
+    // setup timerfd for next timeout
+    btstack_run_loop_linux_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (btstack_run_loop_linux_timer_fd < 0){
+        log_error("timerfd_create() failed, errno %u", errno);
+    } else {
+        btstack_run_loop_linux_register_internal_data_source(&btstack_run_loop_linux_timer_ds, btstack_run_loop_linux_timer_fd,
+                                                             &btstack_run_loop_linux_timer_handler);
+    }
+
+    // setup eventfd to trigger process callbacks
+    btstack_run_loop_linux_process_callbacks_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (btstack_run_loop_linux_process_callbacks_fd < 0){
+        log_error("eventfd() failed, errno %u", errno);
+    } else {
+        btstack_run_loop_linux_register_internal_data_source(&btstack_run_loop_linux_process_callbacks_ds, btstack_run_loop_linux_process_callbacks_fd,
+                                                             &btstack_run_loop_linux_process_callbacks_handler);
+    }
+
+    // setup eventfd to poll data sources
+    btstack_run_loop_linux_poll_data_sources_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (btstack_run_loop_linux_poll_data_sources_fd < 0){
+        log_error("eventfd() failed, errno %u", errno);
+    } else {
+        btstack_run_loop_linux_register_internal_data_source(&btstack_run_loop_linux_poll_data_sources_ds, btstack_run_loop_linux_poll_data_sources_fd,
+                                                             &btstack_run_loop_linux_poll_data_sources_handler);
+    }
+}
+
+static const btstack_run_loop_t btstack_run_loop_linux = {
+    &btstack_run_loop_linux_init,
+    &btstack_run_loop_linux_add_data_source,
+    &btstack_run_loop_linux_remove_data_source,
+    &btstack_run_loop_linux_enable_data_source_callbacks,
+    &btstack_run_loop_linux_disable_data_source_callbacks,
+    &btstack_run_loop_linux_set_timer,
+    &btstack_run_loop_base_add_timer,
+    &btstack_run_loop_base_remove_timer,
+    &btstack_run_loop_linux_execute,
+    &btstack_run_loop_base_dump_timer,
+    &btstack_run_loop_linux_get_time_ms,
+    &btstack_run_loop_linux_poll_data_sources_from_irq,
+    &btstack_run_loop_linux_execute_on_main_thread,
+    &btstack_run_loop_linux_trigger_exit,
+};
+
+/**
+ * Provide btstack_run_loop_linux instance
+ */
+const btstack_run_loop_t * btstack_run_loop_linux_get_instance(void){
+    return &btstack_run_loop_linux;
+}
+
+#endif // __linux__
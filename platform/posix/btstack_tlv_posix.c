@@ -31,6 +31,9 @@
 
 #define BTSTACK_FILE__ "btstack_tlv_posix.c"
 
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
 #include "btstack_tlv.h"
 #include "btstack_tlv_posix.h"
 #include "btstack_debug.h"
@@ -40,6 +43,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 
 // Header:
@@ -57,25 +61,121 @@
 
 #define MAX_TLV_VALUE_SIZE 2048
 
+// initial number of hash buckets, power of two
+#define BTSTACK_TLV_POSIX_MIN_BUCKETS 64
+
+// compact log file if it contains at least this many overwritten or deleted records...
+#ifndef BTSTACK_TLV_POSIX_COMPACTION_MIN_DEAD_RECORDS
+#define BTSTACK_TLV_POSIX_COMPACTION_MIN_DEAD_RECORDS 64
+#endif
+
+// ... and they make up at least this percentage of all records
+#ifndef BTSTACK_TLV_POSIX_COMPACTION_DEAD_PERCENT
+#define BTSTACK_TLV_POSIX_COMPACTION_DEAD_PERCENT 50
+#endif
+
 static const char * btstack_tlv_header_magic = "BTstack";
 
 #define DUMMY_SIZE 4
 typedef struct tlv_entry {
-	void   * next;
+	struct tlv_entry * next;
 	uint32_t tag;
 	uint32_t len;
+	// write coalescing: value not written to file yet
+	bool     dirty;
+	// write coalescing: tag deleted, delete record not written to file yet
+	bool     deleted;
 	uint8_t  value[DUMMY_SIZE];	// dummy size
 } tlv_entry_t;
 
 // testing support
 static bool btstack_tlv_posix_read_only = false;
 
-static void btstack_tlv_posix_append_tag(btstack_tlv_posix_t * self, uint32_t tag, const uint8_t * data, uint32_t data_size){
+static void btstack_tlv_posix_maybe_compact(btstack_tlv_posix_t * self);
 
-	if (!self->file) return;
+static uint32_t btstack_tlv_posix_bucket_for_tag(uint32_t num_buckets, uint32_t tag){
+	// Fibonacci hashing spreads sequential tags, e.g. link keys with index in lower bits
+	uint32_t hash = tag * 2654435761u;
+	return (hash ^ (hash >> 16)) & (num_buckets - 1u);
+}
 
-	log_info("append tag %04x, len %u", tag, data_size);
+static tlv_entry_t ** btstack_tlv_posix_buckets(btstack_tlv_posix_t * self){
+	return (tlv_entry_t **) self->buckets;
+}
+
+static void btstack_tlv_posix_insert_entry(btstack_tlv_posix_t * self, tlv_entry_t * entry){
+	tlv_entry_t ** buckets = btstack_tlv_posix_buckets(self);
+	uint32_t bucket = btstack_tlv_posix_bucket_for_tag(self->num_buckets, entry->tag);
+	entry->next = buckets[bucket];
+	buckets[bucket] = entry;
+	if (entry->deleted == false){
+		self->num_entries++;
+	}
+}
+
+static void btstack_tlv_posix_grow_buckets(btstack_tlv_posix_t * self){
+	uint32_t num_buckets = (self->num_buckets == 0u) ? BTSTACK_TLV_POSIX_MIN_BUCKETS : (self->num_buckets * 2u);
+	tlv_entry_t ** buckets = (tlv_entry_t **) calloc(num_buckets, sizeof(tlv_entry_t *));
+	if (buckets == NULL) return;
+	tlv_entry_t ** old_buckets = btstack_tlv_posix_buckets(self);
+	uint32_t old_num_buckets = self->num_buckets;
+	self->buckets = (void **) buckets;
+	self->num_buckets = num_buckets;
+	self->num_entries = 0;
+	uint32_t i;
+	for (i = 0; i < old_num_buckets; i++){
+		tlv_entry_t * entry = old_buckets[i];
+		while (entry != NULL){
+			tlv_entry_t * next = entry->next;
+			btstack_tlv_posix_insert_entry(self, entry);
+			entry = next;
+		}
+	}
+	free(old_buckets);
+}
+
+// find entry incl. pending delete entries
+static tlv_entry_t * btstack_tlv_posix_find_entry(btstack_tlv_posix_t * self, uint32_t tag){
+	if (self->num_buckets == 0u) return NULL;
+	tlv_entry_t * entry = btstack_tlv_posix_buckets(self)[btstack_tlv_posix_bucket_for_tag(self->num_buckets, tag)];
+	while (entry != NULL){
+		if (entry->tag == tag) return entry;
+		entry = entry->next;
+	}
+	return NULL;
+}
+
+static void btstack_tlv_posix_remove_entry(btstack_tlv_posix_t * self, tlv_entry_t * entry){
+	tlv_entry_t ** it = &btstack_tlv_posix_buckets(self)[btstack_tlv_posix_bucket_for_tag(self->num_buckets, entry->tag)];
+	while (*it != NULL){
+		if (*it == entry){
+			*it = entry->next;
+			if (entry->deleted == false){
+				self->num_entries--;
+			}
+			free(entry);
+			return;
+		}
+		it = &(*it)->next;
+	}
+}
+
+static tlv_entry_t * btstack_tlv_posix_create_entry(btstack_tlv_posix_t * self, uint32_t tag, uint32_t len){
+	// keep load factor <= 1
+	if (self->num_entries >= self->num_buckets){
+		btstack_tlv_posix_grow_buckets(self);
+	}
+	if (self->num_buckets == 0u) return NULL;
+	uint32_t entry_size = sizeof(tlv_entry_t) - DUMMY_SIZE + len;
+	tlv_entry_t * new_entry = (tlv_entry_t *) malloc(entry_size);
+	if (!new_entry) return NULL;
+	memset(new_entry, 0, entry_size);
+	new_entry->tag = tag;
+	new_entry->len = len;
+	return new_entry;
+}
 
+static void btstack_tlv_posix_write_tag(btstack_tlv_posix_t * self, uint32_t tag, const uint8_t * data, uint32_t data_size){
 	uint8_t header[8];
 	big_endian_store_32(header, 0, tag);
 	big_endian_store_32(header, 4, data_size);
@@ -85,18 +185,99 @@ static void btstack_tlv_posix_append_tag(btstack_tlv_posix_t * self, uint32_t ta
 		size_t written_value = fwrite(data, 1, data_size, self->file);
 		if (written_value != data_size) return;
 	}
+	self->num_records++;
+}
+
+static void btstack_tlv_posix_append_tag(btstack_tlv_posix_t * self, uint32_t tag, const uint8_t * data, uint32_t data_size){
+
+	if (!self->file) return;
+
+	log_info("append tag %04x, len %u", tag, data_size);
+
+	btstack_tlv_posix_write_tag(self, tag, data, data_size);
 	fflush(self->file);
+
+	btstack_tlv_posix_maybe_compact(self);
 }
 
-static tlv_entry_t * btstack_tlv_posix_find_entry(btstack_tlv_posix_t * self, uint32_t tag){
-	btstack_linked_list_iterator_t it;
-	btstack_linked_list_iterator_init(&it, &self->entry_list);
-	while (btstack_linked_list_iterator_has_next(&it)){
-		tlv_entry_t * entry = (tlv_entry_t*) btstack_linked_list_iterator_next(&it);
-		if (entry->tag != tag) continue;
-		return entry;
+// write all entries and drop pending deletes, used for sync and compaction
+static void btstack_tlv_posix_write_entries(btstack_tlv_posix_t * self, bool only_dirty){
+	tlv_entry_t ** buckets = btstack_tlv_posix_buckets(self);
+	uint32_t i;
+	for (i = 0; i < self->num_buckets; i++){
+		tlv_entry_t * entry = buckets[i];
+		while (entry != NULL){
+			tlv_entry_t * next = entry->next;
+			if (entry->deleted){
+				if (only_dirty && (self->file != NULL)){
+					btstack_tlv_posix_write_tag(self, entry->tag, NULL, 0);
+				}
+				btstack_tlv_posix_remove_entry(self, entry);
+			} else {
+				if (((only_dirty == false) || entry->dirty) && (self->file != NULL)){
+					btstack_tlv_posix_write_tag(self, entry->tag, &entry->value[0], entry->len);
+				}
+				entry->dirty = false;
+			}
+			entry = next;
+		}
 	}
-	return NULL;
+	self->dirty = false;
+}
+
+static void btstack_tlv_posix_write_header(btstack_tlv_posix_t * self){
+	uint8_t header[BTSTACK_TLV_HEADER_LEN];
+	memset(header, 0, sizeof(header));
+	strcpy((char *)header, btstack_tlv_header_magic);
+	fwrite(header, 1, sizeof(header), self->file);
+}
+
+// rewrite file with live entries only. new file is written next to the old one and then renamed
+static void btstack_tlv_posix_compact(btstack_tlv_posix_t * self){
+	size_t path_len = strlen(self->db_path);
+	char * temp_path = (char *) malloc(path_len + 5);
+	if (temp_path == NULL) return;
+	memcpy(temp_path, self->db_path, path_len);
+	memcpy(&temp_path[path_len], ".tmp", 5);
+
+	FILE * old_file = self->file;
+	uint32_t old_num_records = self->num_records;
+	self->file = fopen(temp_path, "w+");
+	if (self->file == NULL){
+		log_error("compaction: failed to create %s", temp_path);
+		self->file = old_file;
+		free(temp_path);
+		return;
+	}
+	self->num_records = 0;
+	btstack_tlv_posix_write_header(self);
+	btstack_tlv_posix_write_entries(self, false);
+	bool ok = (fflush(self->file) == 0) && (fsync(fileno(self->file)) == 0);
+	if (ok){
+		ok = rename(temp_path, self->db_path) == 0;
+	}
+	if (ok){
+		log_info("compaction: %u -> %u records", old_num_records, self->num_records);
+		fclose(old_file);
+	} else {
+		log_error("compaction: failed to replace %s", self->db_path);
+		fclose(self->file);
+		unlink(temp_path);
+		self->file = old_file;
+		self->num_records = old_num_records;
+	}
+	free(temp_path);
+}
+
+static void btstack_tlv_posix_maybe_compact(btstack_tlv_posix_t * self){
+	if (self->file == NULL) return;
+	if (self->dirty) return;
+	// num_records only counts successful writes, after a write error it can be less than num_entries
+	if (self->num_records <= self->num_entries) return;
+	uint32_t dead_records = self->num_records - self->num_entries;
+	if (dead_records < BTSTACK_TLV_POSIX_COMPACTION_MIN_DEAD_RECORDS) return;
+	if ((dead_records * 100u) < (self->num_records * BTSTACK_TLV_POSIX_COMPACTION_DEAD_PERCENT)) return;
+	btstack_tlv_posix_compact(self);
 }
 
 /**
@@ -105,16 +286,21 @@ static tlv_entry_t * btstack_tlv_posix_find_entry(btstack_tlv_posix_t * self, ui
  */
 static void btstack_tlv_posix_delete_tag(void * context, uint32_t tag){
 	btstack_tlv_posix_t * self = (btstack_tlv_posix_t *) context;
-	btstack_linked_list_iterator_t it;
-	btstack_linked_list_iterator_init(&it, &self->entry_list);
-	while (btstack_linked_list_iterator_has_next(&it)){
-		tlv_entry_t * entry = (tlv_entry_t*) btstack_linked_list_iterator_next(&it);
-		if (entry->tag != tag) continue;
-		btstack_linked_list_iterator_remove(&it);
-		free(entry);
-		btstack_tlv_posix_append_tag(self, tag, NULL, 0);
-		return;
+	tlv_entry_t * entry = btstack_tlv_posix_find_entry(self, tag);
+	if (entry == NULL) return;
+	if (entry->deleted) return;
+	btstack_tlv_posix_remove_entry(self, entry);
+	if (self->write_coalescing){
+		// remember delete until sync
+		tlv_entry_t * delete_entry = btstack_tlv_posix_create_entry(self, tag, 0);
+		if (delete_entry != NULL){
+			delete_entry->deleted = true;
+			btstack_tlv_posix_insert_entry(self, delete_entry);
+			self->dirty = true;
+			return;
+		}
 	}
+	btstack_tlv_posix_append_tag(self, tag, NULL, 0);
 }
 
 /**
@@ -129,6 +315,7 @@ static int btstack_tlv_posix_get_tag(void * context, uint32_t tag, uint8_t * buf
 	tlv_entry_t * entry = btstack_tlv_posix_find_entry(self, tag);
 	// not found
 	if (!entry) return 0;
+	if (entry->deleted) return 0;
 	// return len if buffer = NULL
 	if (!buffer) return entry->len;
 	// otherwise copy data into buffer
@@ -152,24 +339,24 @@ static int btstack_tlv_posix_store_tag(void * context, uint32_t tag, const uint8
 	// remove old entry
 	tlv_entry_t * old_entry = btstack_tlv_posix_find_entry(self, tag);
 	if (old_entry){
-		btstack_linked_list_remove(&self->entry_list, (btstack_linked_item_t *) old_entry);
-		free(old_entry);
+		btstack_tlv_posix_remove_entry(self, old_entry);
 	}
 
 	// create new entry
-	uint32_t entry_size = sizeof(tlv_entry_t) - DUMMY_SIZE + data_size;
-	tlv_entry_t * new_entry = (tlv_entry_t *) malloc(entry_size);
+	tlv_entry_t * new_entry = btstack_tlv_posix_create_entry(self, tag, data_size);
 	if (!new_entry) return 0;
-	memset(new_entry, 0, entry_size);
-	new_entry->tag = tag;
-	new_entry->len = data_size;
 	memcpy(&new_entry->value[0], data, data_size);
 
-	// append new entry
-	btstack_linked_list_add(&self->entry_list, (btstack_linked_item_t *) new_entry);
+	// add new entry
+	btstack_tlv_posix_insert_entry(self, new_entry);
 
-	// write new tag
-	btstack_tlv_posix_append_tag(self, tag, data, data_size);
+	// write new tag or mark for sync
+	if (self->write_coalescing){
+		new_entry->dirty = true;
+		self->dirty = true;
+	} else {
+		btstack_tlv_posix_append_tag(self, tag, data, data_size);
+	}
 
 	return 0;
 }
@@ -208,26 +395,27 @@ static int btstack_tlv_posix_read_db(btstack_tlv_posix_t * self){
                     // create new entry for regular tag
                     tlv_entry_t * new_entry = NULL;
                     if (len > 0) {
-                        new_entry = (tlv_entry_t *) malloc(sizeof(tlv_entry_t) - DUMMY_SIZE + len);
+                        new_entry = btstack_tlv_posix_create_entry(self, tag, len);
                         if (!new_entry) return 0;
-                        new_entry->tag = tag;
-                        new_entry->len = len;
 
                         // read
                         size_t value_read = fread(&new_entry->value[0], 1, len, self->file);
-                        if (value_read != len) break;
+                        if (value_read != len) {
+                            free(new_entry);
+                            break;
+                        }
                     }
+                    self->num_records++;
 
                     // remove old entry
                     tlv_entry_t * old_entry = btstack_tlv_posix_find_entry(self, tag);
                     if (old_entry){
-                        btstack_linked_list_remove(&self->entry_list, (btstack_linked_item_t *) old_entry);
-                        free(old_entry);
+                        btstack_tlv_posix_remove_entry(self, old_entry);
                     }
 
-                    // append new entry
+                    // add new entry
                     if (new_entry){
-	                    btstack_linked_list_add(&self->entry_list, (btstack_linked_item_t *) new_entry);
+                        btstack_tlv_posix_insert_entry(self, new_entry);
                     }
 		    	}
 	    	}
@@ -246,23 +434,21 @@ static int btstack_tlv_posix_read_db(btstack_tlv_posix_t * self){
         return 0;
     }
 
-    if (!self->file){
+    if (self->file){
+        // drop overwritten and deleted records if needed
+        btstack_tlv_posix_maybe_compact(self);
+    } else {
     	// create truncate file
 	    self->file = fopen(self->db_path,"w+");
         if (!self->file) {
             log_error("failed to create file");
             return -1;
         }
-	    memset(header, 0, sizeof(header));
-	    strcpy((char *)header, btstack_tlv_header_magic);
-	    fwrite(header, 1, sizeof(header), self->file);
+	    btstack_tlv_posix_write_header(self);
 	    // write out all valid entries (if any)
-		btstack_linked_list_iterator_t it;
-		btstack_linked_list_iterator_init(&it, &self->entry_list);
-		while (btstack_linked_list_iterator_has_next(&it)){
-			tlv_entry_t * entry = (tlv_entry_t*) btstack_linked_list_iterator_next(&it);
-			btstack_tlv_posix_append_tag(self, entry->tag, &entry->value[0], entry->len);
-		}
+	    self->num_records = 0;
+	    btstack_tlv_posix_write_entries(self, false);
+	    fflush(self->file);
     }
 	return 0;
 }
@@ -291,18 +477,46 @@ void btstack_tlv_posix_set_read_only(void){
     btstack_tlv_posix_read_only = true;
 }
 
+void btstack_tlv_posix_set_write_coalescing(btstack_tlv_posix_t * self, bool enabled){
+    self->write_coalescing = enabled;
+    if (enabled == false){
+        btstack_tlv_posix_sync(self);
+    }
+}
+
+void btstack_tlv_posix_sync(btstack_tlv_posix_t * self){
+    if (self->dirty == false) return;
+    btstack_tlv_posix_write_entries(self, true);
+    if (self->file == NULL) return;
+    fflush(self->file);
+    btstack_tlv_posix_maybe_compact(self);
+}
+
 /**
  * Free TLV entries
  * @param self
  */
 void btstack_tlv_posix_deinit(btstack_tlv_posix_t * self){
+    // write pending changes
+    btstack_tlv_posix_sync(self);
     // free all entries
-    btstack_linked_list_iterator_t it;
-    btstack_linked_list_iterator_init(&it, &self->entry_list);
-    while (btstack_linked_list_iterator_has_next(&it)){
-        tlv_entry_t * entry = (tlv_entry_t*) btstack_linked_list_iterator_next(&it);
-		btstack_linked_list_iterator_remove(&it);
-		free(entry);
+    tlv_entry_t ** buckets = btstack_tlv_posix_buckets(self);
+    uint32_t i;
+    for (i = 0; i < self->num_buckets; i++){
+        tlv_entry_t * entry = buckets[i];
+        while (entry != NULL){
+            tlv_entry_t * next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    free(buckets);
+    self->buckets = NULL;
+    self->num_buckets = 0;
+    self->num_entries = 0;
+    // close file
+    if (self->file != NULL){
+        fclose(self->file);
+        self->file = NULL;
     }
-    btstack_tlv_posix_read_only = true;
 }
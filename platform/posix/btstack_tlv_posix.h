@@ -41,6 +41,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include "btstack_bool.h"
 #include "btstack_tlv.h"
 #include "btstack_linked_list.h"
 
@@ -49,9 +50,16 @@ extern "C" {
 #endif
 
 typedef struct {
-	btstack_linked_list_t entry_list;
+	// hash table of entries
+	void ** buckets;
+	uint32_t num_buckets;
+	uint32_t num_entries;
+	// number of records in file, incl. overwritten and deleted ones
+	uint32_t num_records;
 	const char * db_path;
 	FILE * file;
+	bool write_coalescing;
+	bool dirty;
 } btstack_tlv_posix_t;
 
 /**
@@ -68,7 +76,22 @@ const btstack_tlv_t * btstack_tlv_posix_init_instance(btstack_tlv_posix_t * cont
 void btstack_tlv_posix_set_read_only(void);
 
 /**
- * Free TLV entries
+ * Buffer stores and deletes in memory until btstack_tlv_posix_sync is called
+ * @note by default, each store and delete is written to the file immediately
+ * @param self
+ * @param enabled
+ */
+void btstack_tlv_posix_set_write_coalescing(btstack_tlv_posix_t * self, bool enabled);
+
+/**
+ * Write buffered stores and deletes to file. Log file is compacted if it contains
+ * mostly overwritten and deleted records
+ * @param self
+ */
+void btstack_tlv_posix_sync(btstack_tlv_posix_t * self);
+
+/**
+ * Write buffered changes, free TLV entries and close file
  * @param self
  */
 void btstack_tlv_posix_deinit(btstack_tlv_posix_t * self);
@@ -47,6 +47,7 @@
 #include "btstack_uart.h"
 #include "btstack_run_loop.h"
 #include "btstack_debug.h"
+#include "btstack_util.h"
 
 #include <termios.h>  /* POSIX terminal control definitions */
 #include <fcntl.h>    /* File control definitions */
@@ -77,6 +78,16 @@ static const uint8_t * btstack_uart_block_write_bytes_data;
 static uint16_t  btstack_uart_block_read_bytes_len;
 static uint8_t * btstack_uart_block_read_bytes_data;
 
+// read-ahead buffer: read as many bytes as available with a single read() call and serve
+// following block reads (e.g. H4 packet type, header, payload of several packets) from it
+#ifndef BTSTACK_UART_POSIX_RECEIVE_BUFFER_SIZE
+#define BTSTACK_UART_POSIX_RECEIVE_BUFFER_SIZE 1024
+#endif
+static uint8_t   btstack_uart_block_receive_buffer[BTSTACK_UART_POSIX_RECEIVE_BUFFER_SIZE];
+static uint16_t  btstack_uart_block_receive_pos;
+static uint16_t  btstack_uart_block_receive_len;
+static bool      btstack_uart_block_receive_active;
+
 // callbacks
 static void (*block_sent)(void);
 static void (*block_received)(void);
@@ -127,17 +138,64 @@ static void btstack_uart_block_posix_process_write(btstack_data_source_t *ds) {
     }
 }
 
+// serve pending block read from read-ahead buffer, loops as block_received usually requests the next block right away
+static void btstack_uart_block_posix_process_buffer(void){
+    // avoid recursion if receive_block is called from block_received
+    if (btstack_uart_block_receive_active) return;
+    btstack_uart_block_receive_active = true;
+
+    while ((btstack_uart_block_read_bytes_len > 0) && (btstack_uart_block_receive_pos < btstack_uart_block_receive_len)){
+        uint16_t bytes_to_copy = btstack_min(btstack_uart_block_read_bytes_len, btstack_uart_block_receive_len - btstack_uart_block_receive_pos);
+        memcpy(btstack_uart_block_read_bytes_data, &btstack_uart_block_receive_buffer[btstack_uart_block_receive_pos], bytes_to_copy);
+        btstack_uart_block_receive_pos      += bytes_to_copy;
+        btstack_uart_block_read_bytes_data  += bytes_to_copy;
+        btstack_uart_block_read_bytes_len   -= bytes_to_copy;
+
+        if (btstack_uart_block_read_bytes_len > 0) break;
+
+        // block complete. note: block_received might close the UART
+        if (block_received){
+            block_received();
+        }
+    }
+
+    // reset buffer if fully processed
+    if (btstack_uart_block_receive_pos == btstack_uart_block_receive_len){
+        btstack_uart_block_receive_pos = 0;
+        btstack_uart_block_receive_len = 0;
+    }
+
+    btstack_uart_block_receive_active = false;
+}
+
+static void btstack_uart_block_posix_update_read_callback(void){
+    if (transport_data_source.source.fd < 0) return;
+    if (btstack_uart_block_read_bytes_len > 0){
+        btstack_run_loop_enable_data_source_callbacks(&transport_data_source, DATA_SOURCE_CALLBACK_READ);
+    } else {
+        btstack_run_loop_disable_data_source_callbacks(&transport_data_source, DATA_SOURCE_CALLBACK_READ);
+    }
+}
+
 static void btstack_uart_block_posix_process_read(btstack_data_source_t *ds) {
 
     if (btstack_uart_block_read_bytes_len == 0) {
         log_info("called but no read pending");
         btstack_run_loop_disable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
+        return;
     }
 
     uint32_t start = btstack_run_loop_get_time_ms();
-    
-    // read up to bytes_to_read data in
-    ssize_t bytes_read = read(ds->source.fd, btstack_uart_block_read_bytes_data, btstack_uart_block_read_bytes_len);
+
+    // large blocks are read directly, otherwise read as much as available into read-ahead buffer
+    // read-ahead buffer is empty as a block read is pending
+    bool read_direct = btstack_uart_block_read_bytes_len >= BTSTACK_UART_POSIX_RECEIVE_BUFFER_SIZE;
+    ssize_t bytes_read;
+    if (read_direct){
+        bytes_read = read(ds->source.fd, btstack_uart_block_read_bytes_data, btstack_uart_block_read_bytes_len);
+    } else {
+        bytes_read = read(ds->source.fd, btstack_uart_block_receive_buffer, BTSTACK_UART_POSIX_RECEIVE_BUFFER_SIZE);
+    }
     // log_info("read need %u bytes, got %d", btstack_uart_block_read_bytes_len, (int) bytes_read);
     uint32_t end = btstack_run_loop_get_time_ms();
     if (end - start > 10){
@@ -152,15 +210,23 @@ static void btstack_uart_block_posix_process_read(btstack_data_source_t *ds) {
         return;
     }
 
-    btstack_uart_block_read_bytes_len   -= bytes_read;
-    btstack_uart_block_read_bytes_data  += bytes_read;
-    if (btstack_uart_block_read_bytes_len > 0) return;
-    
-    btstack_run_loop_disable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
+    if (read_direct){
+        btstack_uart_block_read_bytes_len   -= bytes_read;
+        btstack_uart_block_read_bytes_data  += bytes_read;
+        if (btstack_uart_block_read_bytes_len > 0) return;
+
+        btstack_run_loop_disable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
 
-    if (block_received){
-        block_received();
+        if (block_received){
+            block_received();
+        }
+        return;
     }
+
+    btstack_uart_block_receive_pos = 0;
+    btstack_uart_block_receive_len = (uint16_t) bytes_read;
+    btstack_uart_block_posix_process_buffer();
+    btstack_uart_block_posix_update_read_callback();
 }
 
 static int btstack_uart_posix_set_baudrate(uint32_t baudrate){
@@ -344,6 +410,10 @@ static int btstack_uart_posix_open(void){
 
     // store fd in data source
     transport_data_source.source.fd = fd;
+
+    // drop bytes from earlier session
+    btstack_uart_block_receive_pos = 0;
+    btstack_uart_block_receive_len = 0;
     
     // also set baudrate
     if (btstack_uart_posix_set_baudrate(baudrate) < 0){
@@ -370,6 +440,11 @@ static int btstack_uart_posix_close_new(void){
     // then close device 
     close(transport_data_source.source.fd);
     transport_data_source.source.fd = -1;
+
+    // drop pending reads and buffered bytes
+    btstack_uart_block_read_bytes_len = 0;
+    btstack_uart_block_receive_pos = 0;
+    btstack_uart_block_receive_len = 0;
     return 0;
 }
 
@@ -398,7 +473,13 @@ static void btstack_uart_posix_receive_block(uint8_t *buffer, uint16_t len){
     // setup async read
     btstack_uart_block_read_bytes_data = buffer;
     btstack_uart_block_read_bytes_len = len;
-    btstack_run_loop_enable_data_source_callbacks(&transport_data_source, DATA_SOURCE_CALLBACK_READ);
+
+    // called from block_received while processing read-ahead buffer, will be handled there
+    if (btstack_uart_block_receive_active) return;
+
+    // serve from read-ahead buffer first
+    btstack_uart_block_posix_process_buffer();
+    btstack_uart_block_posix_update_read_callback();
 }
 
 #ifdef ENABLE_H5
@@ -46,6 +46,9 @@
  *  - Apple's PacketLogger
  *  - stdout hexdump
  *
+ *  With ENABLE_HCI_DUMP_POSIX_FS_ASYNC, hci_dump_posix_fs_open_async() stores timestamped records in a
+ *  single-producer/single-consumer ring buffer, which is written to the file by a background thread.
+ *
  */
 
 #include "btstack_config.h"
@@ -69,16 +72,140 @@
 
 #include <time.h>
 #include <stdio.h>        // printf
+#include <string.h>       // memcpy
 #include <fcntl.h>        // open
 #include <unistd.h>       // write
 #include <errno.h>        // errno
 
+#ifdef ENABLE_HCI_DUMP_POSIX_FS_ASYNC
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>       // malloc
+
+// max time records stay in the ring buffer before the writer thread stores them
+#ifndef HCI_DUMP_POSIX_FS_ASYNC_FLUSH_INTERVAL_MS
+#define HCI_DUMP_POSIX_FS_ASYNC_FLUSH_INTERVAL_MS 100
+#endif
+#endif
+
 static int  dump_file = -1;
 static int  dump_format;
 static char log_message_buffer[256];
 
+#ifdef ENABLE_HCI_DUMP_POSIX_FS_ASYNC
+// ring buffer with one free byte to tell full from empty
+// - async_write_pos is only modified by the Bluetooth thread
+// - async_read_pos  is only modified by the writer thread
+static bool      async_active;
+static uint8_t * async_buffer;
+static uint32_t  async_buffer_size;
+static _Atomic uint32_t async_write_pos;
+static _Atomic uint32_t async_read_pos;
+static _Atomic bool     async_stop;
+static _Atomic bool     async_reset_requested;
+static _Atomic uint32_t async_reset_pos;
+static uint32_t  async_dropped_packets;
+static pthread_t       async_thread;
+static pthread_mutex_t async_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  async_cond  = PTHREAD_COND_INITIALIZER;
+
+static uint32_t hci_dump_posix_fs_async_used(uint32_t write_pos, uint32_t read_pos){
+    return (write_pos >= read_pos) ? (write_pos - read_pos) : (async_buffer_size - read_pos + write_pos);
+}
+
+static uint32_t hci_dump_posix_fs_async_copy(uint32_t pos, const uint8_t * data, uint32_t len){
+    uint32_t bytes_till_end = async_buffer_size - pos;
+    if (len < bytes_till_end){
+        memcpy(&async_buffer[pos], data, len);
+        return pos + len;
+    }
+    memcpy(&async_buffer[pos], data, bytes_till_end);
+    memcpy(async_buffer, &data[bytes_till_end], len - bytes_till_end);
+    return len - bytes_till_end;
+}
+
+static void hci_dump_posix_fs_async_store(const uint8_t * header, uint16_t header_len, const uint8_t * packet, uint16_t len){
+    uint32_t write_pos = atomic_load_explicit(&async_write_pos, memory_order_relaxed);
+    uint32_t read_pos  = atomic_load_explicit(&async_read_pos,  memory_order_acquire);
+    uint32_t used = hci_dump_posix_fs_async_used(write_pos, read_pos);
+    uint32_t record_len = header_len + len;
+    if ((used + record_len) >= async_buffer_size){
+        async_dropped_packets++;
+        return;
+    }
+    write_pos = hci_dump_posix_fs_async_copy(write_pos, header, header_len);
+    write_pos = hci_dump_posix_fs_async_copy(write_pos, packet, len);
+    atomic_store_explicit(&async_write_pos, write_pos, memory_order_release);
+
+    // wake up writer thread when buffer becomes half full. signal without mutex might get lost,
+    // in this case, the writer thread wakes up after the flush interval
+    uint32_t threshold = async_buffer_size / 2;
+    if ((used < threshold) && ((used + record_len) >= threshold)){
+        pthread_cond_signal(&async_cond);
+    }
+}
+
+// writer thread: store all records from ring buffer
+static void hci_dump_posix_fs_async_drain(void){
+    uint32_t read_pos  = atomic_load_explicit(&async_read_pos,  memory_order_relaxed);
+
+    // get write position before checking for reset: if no reset was requested yet, all records up to
+    // write position were stored before a later reset
+    uint32_t write_pos = atomic_load_explicit(&async_write_pos, memory_order_acquire);
+    if (atomic_exchange_explicit(&async_reset_requested, false, memory_order_acquire)){
+        // drop records before reset
+        read_pos  = atomic_load_explicit(&async_reset_pos, memory_order_relaxed);
+        atomic_store_explicit(&async_read_pos, read_pos, memory_order_release);
+        write_pos = atomic_load_explicit(&async_write_pos, memory_order_acquire);
+        (void) lseek(dump_file, 0, SEEK_SET);
+        int err = ftruncate(dump_file, 0);
+        UNUSED(err);
+    }
+
+    while (read_pos != write_pos){
+        uint32_t chunk_len = (write_pos > read_pos) ? (write_pos - read_pos) : (async_buffer_size - read_pos);
+        ssize_t bytes_written = write(dump_file, &async_buffer[read_pos], chunk_len);
+        UNUSED(bytes_written);
+        read_pos += chunk_len;
+        if (read_pos == async_buffer_size){
+            read_pos = 0;
+        }
+        atomic_store_explicit(&async_read_pos, read_pos, memory_order_release);
+    }
+}
+
+static void * hci_dump_posix_fs_async_thread(void * context){
+    UNUSED(context);
+    while (true){
+        bool stop = atomic_load(&async_stop);
+        hci_dump_posix_fs_async_drain();
+        if (stop) break;
+
+        struct timespec timeout;
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_nsec += HCI_DUMP_POSIX_FS_ASYNC_FLUSH_INTERVAL_MS * 1000000L;
+        timeout.tv_sec  += timeout.tv_nsec / 1000000000L;
+        timeout.tv_nsec  = timeout.tv_nsec % 1000000000L;
+        pthread_mutex_lock(&async_mutex);
+        if (atomic_load(&async_stop) == false){
+            (void) pthread_cond_timedwait(&async_cond, &async_mutex, &timeout);
+        }
+        pthread_mutex_unlock(&async_mutex);
+    }
+    return NULL;
+}
+#endif
+
 static void hci_dump_posix_fs_reset(void){
     btstack_assert(dump_file >= 0);
+#ifdef ENABLE_HCI_DUMP_POSIX_FS_ASYNC
+    if (async_active){
+        // writer thread truncates file and drops records stored so far
+        atomic_store_explicit(&async_reset_pos, atomic_load_explicit(&async_write_pos, memory_order_relaxed), memory_order_relaxed);
+        atomic_store_explicit(&async_reset_requested, true, memory_order_release);
+        return;
+    }
+#endif
     (void) lseek(dump_file, 0, SEEK_SET);
     int err = ftruncate(dump_file, 0);
     UNUSED(err);
@@ -121,6 +248,10 @@ static void hci_dump_posix_fs_log_packet(uint8_t packet_type, uint8_t in, uint8_
     uint32_t tv_sec = 0;
     uint32_t tv_us  = 0;
     uint64_t ts_usec;
+    uint32_t cumulative_drops = 0;
+#ifdef ENABLE_HCI_DUMP_POSIX_FS_ASYNC
+    cumulative_drops = async_dropped_packets;
+#endif
 
     // get time
     struct timeval curr_time;
@@ -149,7 +280,7 @@ static void hci_dump_posix_fs_log_packet(uint8_t packet_type, uint8_t in, uint8_
             if (packet_type == LOG_MESSAGE_PACKET) return;
             ts_usec = 0xdcddb30f2f8000LLU + 1000000LLU * curr_time.tv_sec + curr_time.tv_usec;
             // append packet type to pcap header
-            hci_dump_setup_header_btsnoop(header.header_btsnoop, ts_usec >> 32, ts_usec & 0xFFFFFFFF, 0, packet_type, in, len+1);
+            hci_dump_setup_header_btsnoop(header.header_btsnoop, ts_usec >> 32, ts_usec & 0xFFFFFFFF, cumulative_drops, packet_type, in, len+1);
             header.header_btsnoop[HCI_DUMP_HEADER_SIZE_BTSNOOP] = packet_type;
             header_len = HCI_DUMP_HEADER_SIZE_BTSNOOP + 1;
             break;
@@ -158,6 +289,15 @@ static void hci_dump_posix_fs_log_packet(uint8_t packet_type, uint8_t in, uint8_
             return;
     }
 
+#ifdef ENABLE_HCI_DUMP_POSIX_FS_ASYNC
+    if (async_active){
+        hci_dump_posix_fs_async_store((const uint8_t *) &header, header_len, packet, len);
+        return;
+    }
+#else
+    UNUSED(cumulative_drops);
+#endif
+
     ssize_t bytes_written;
     bytes_written = write(dump_file, &header, header_len);
     UNUSED(bytes_written);
@@ -204,7 +344,60 @@ int hci_dump_posix_fs_open(const char *filename, hci_dump_format_t format){
     return 0;
 }
 
+#ifdef ENABLE_HCI_DUMP_POSIX_FS_ASYNC
+// returns system errno
+int hci_dump_posix_fs_open_async(const char *filename, hci_dump_format_t format, uint32_t buffer_size){
+    btstack_assert(async_active == false);
+    btstack_assert(buffer_size > 0);
+
+    async_buffer = (uint8_t *) malloc(buffer_size);
+    if (async_buffer == NULL){
+        return ENOMEM;
+    }
+    int err = hci_dump_posix_fs_open(filename, format);
+    if (err != 0){
+        free(async_buffer);
+        async_buffer = NULL;
+        return err;
+    }
+
+    async_buffer_size = buffer_size;
+    async_dropped_packets = 0;
+    atomic_store(&async_write_pos, 0);
+    atomic_store(&async_read_pos, 0);
+    atomic_store(&async_stop, false);
+    atomic_store(&async_reset_requested, false);
+    err = pthread_create(&async_thread, NULL, &hci_dump_posix_fs_async_thread, NULL);
+    if (err != 0){
+        free(async_buffer);
+        async_buffer = NULL;
+        close(dump_file);
+        dump_file = -1;
+        return err;
+    }
+    async_active = true;
+    return 0;
+}
+
+uint32_t hci_dump_posix_fs_get_dropped_packets(void){
+    return async_dropped_packets;
+}
+#endif
+
 void hci_dump_posix_fs_close(void){
+#ifdef ENABLE_HCI_DUMP_POSIX_FS_ASYNC
+    if (async_active){
+        // writer thread stores all pending records before it exits
+        pthread_mutex_lock(&async_mutex);
+        atomic_store(&async_stop, true);
+        pthread_cond_signal(&async_cond);
+        pthread_mutex_unlock(&async_mutex);
+        pthread_join(async_thread, NULL);
+        async_active = false;
+        free(async_buffer);
+        async_buffer = NULL;
+    }
+#endif
     close(dump_file);
     dump_file = -1;
 }
@@ -65,7 +65,24 @@ const hci_dump_t * hci_dump_posix_fs_get_instance(void);
 int hci_dump_posix_fs_open(const char *filename, hci_dump_format_t format);
 
 /*
- * @brief Close Log file
+ * @brief Open Log file and store packets from a background thread. Requires ENABLE_HCI_DUMP_POSIX_FS_ASYNC
+ * @note Packets are timestamped and copied into a ring buffer of buffer_size bytes. If the ring buffer is full,
+ *       packets are dropped and, for BTSnoop, the number of dropped packets is stored in the cumulative drops field
+ * @param filename or path
+ * @param format
+ * @param buffer_size of ring buffer in bytes
+ * @returns 0 if ok, errno otherwise
+ */
+int hci_dump_posix_fs_open_async(const char *filename, hci_dump_format_t format, uint32_t buffer_size);
+
+/*
+ * @brief Get number of packets dropped due to full ring buffer since hci_dump_posix_fs_open_async
+ * @return dropped packets
+ */
+uint32_t hci_dump_posix_fs_get_dropped_packets(void);
+
+/*
+ * @brief Close Log file, pending packets are stored first
  */
 void hci_dump_posix_fs_close(void);
 
@@ -0,0 +1,555 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "hci_dump_posix_rolling.c"
+
+/*
+ *  hci_dump_posix_rolling.c
+ *
+ *  Dump HCI trace into a set of files with limited size:
+ *
+ *  - current file is rotated before it grows beyond max_file_size
+ *  - rotated files are renamed to path.1 .. path.(num_files - 1), oldest file is deleted
+ *  - rotated files can be compressed with gzip (HAVE_ZLIB) by a background thread, a file stays
+ *    uncompressed as path.N if compression fails
+ *  - packets of the last history_duration_ms can be kept in memory and stored on demand
+ *
+ */
+
+#include "btstack_config.h"
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#ifdef __FreeBSD__
+// FreeBSD does not set __BSD_VISIBLE or __XSI_VISIBLE if _POSIX_C_SOURCE is defined
+#define __BSD_VISIBLE 1
+#define __XSI_VISIBLE 1
+#endif
+
+#include "hci_dump_posix_rolling.h"
+
+#include "btstack_debug.h"
+#include "btstack_util.h"
+
+#include <sys/time.h>     // for timestamps
+#include <sys/stat.h>     // file modes
+
+#include <stdio.h>        // printf, rename
+#include <stdlib.h>       // malloc
+#include <string.h>       // memcpy
+#include <fcntl.h>        // open
+#include <unistd.h>       // write
+#include <errno.h>        // errno
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#include <pthread.h>
+#endif
+
+#define HCI_DUMP_POSIX_ROLLING_MAX_PATH_LEN  256
+#define HCI_DUMP_POSIX_ROLLING_MAX_HEADER_LEN (HCI_DUMP_HEADER_SIZE_BTSNOOP + 1)
+
+// history entry: timestamp in ms (4), record len (4), record
+#define HCI_DUMP_POSIX_ROLLING_HISTORY_ENTRY_HEADER_LEN 8
+
+static hci_dump_posix_rolling_config_t rolling_config;
+static int      dump_file = -1;
+static uint32_t dump_file_size;
+static char     log_message_buffer[256];
+static char     path_buffer[HCI_DUMP_POSIX_ROLLING_MAX_PATH_LEN];
+
+#ifdef HAVE_ZLIB
+// compression thread, state protected by compress_mutex:
+// - rotated files path.1 .. path.compress_pending are waiting for compression
+// - file currently compressed is at path.compress_active_index, 0 if it was dropped meanwhile
+static bool            compress_thread_running;
+static bool            compress_stop;
+static uint16_t        compress_pending;
+static uint16_t        compress_active_index;
+static int             compress_error;
+static pthread_t       compress_thread;
+static pthread_mutex_t compress_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  compress_cond  = PTHREAD_COND_INITIALIZER;
+#endif
+
+static uint8_t * history_buffer;
+static uint32_t  history_buffer_size;
+static uint32_t  history_head;
+static uint32_t  history_tail;
+static uint32_t  history_used;
+
+static const uint8_t btsnoop_file_header[] = {
+    // Identification Pattern: "btsnoop\0"
+    0x62, 0x74, 0x73, 0x6E, 0x6F, 0x6F, 0x70, 0x00,
+    // Version: 1
+    0x00, 0x00, 0x00, 0x01,
+    // Datalink Type: 1002 - H4
+    0x00, 0x00, 0x03, 0xEA,
+};
+
+static const char * hci_dump_posix_rolling_file_name(char * buffer, uint16_t index, bool compressed){
+    if (index == 0){
+        return rolling_config.path;
+    }
+    (void) snprintf(buffer, HCI_DUMP_POSIX_ROLLING_MAX_PATH_LEN, "%s.%u%s", rolling_config.path, index, compressed ? ".gz" : "");
+    return buffer;
+}
+
+static int hci_dump_posix_rolling_open_file(const char * path, int mode_flag){
+    int oflags = O_WRONLY | O_CREAT | mode_flag;
+#ifdef _WIN32
+    oflags |= O_BINARY;
+#endif
+    return open(path, oflags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH );
+}
+
+static uint32_t hci_dump_posix_rolling_write_file_header(int fd){
+    if (rolling_config.format != HCI_DUMP_BTSNOOP) return 0;
+    ssize_t bytes_written = write(fd, btsnoop_file_header, sizeof(btsnoop_file_header));
+    UNUSED(bytes_written);
+    return sizeof(btsnoop_file_header);
+}
+
+static int hci_dump_posix_rolling_open_current(void){
+    dump_file = hci_dump_posix_rolling_open_file(rolling_config.path, O_TRUNC);
+    if (dump_file < 0){
+        log_error("failed to open file %s, errno = %d", rolling_config.path, errno);
+        return errno;
+    }
+    dump_file_size = hci_dump_posix_rolling_write_file_header(dump_file);
+    return 0;
+}
+
+#ifdef HAVE_ZLIB
+// compress open file into temp file, so final .gz file is either complete or missing
+static int hci_dump_posix_rolling_compress(int fd, const char * temp_path){
+    gzFile gz_file = gzopen(temp_path, "wb1");
+    if (gz_file == NULL){
+        return EIO;
+    }
+    uint8_t buffer[4096];
+    int err = 0;
+    while (true){
+        ssize_t bytes_read = read(fd, buffer, sizeof(buffer));
+        if (bytes_read < 0){
+            err = errno;
+            break;
+        }
+        if (bytes_read == 0) break;
+        if (gzwrite(gz_file, buffer, (unsigned int) bytes_read) != (int) bytes_read){
+            err = EIO;
+            break;
+        }
+    }
+    if ((gzclose(gz_file) != Z_OK) && (err == 0)){
+        err = EIO;
+    }
+    return err;
+}
+
+static void * hci_dump_posix_rolling_compress_thread(void * context){
+    UNUSED(context);
+    char path[HCI_DUMP_POSIX_ROLLING_MAX_PATH_LEN];
+    char temp_path[HCI_DUMP_POSIX_ROLLING_MAX_PATH_LEN + 8];
+    (void) snprintf(temp_path, sizeof(temp_path), "%s.gz.tmp", rolling_config.path);
+
+    pthread_mutex_lock(&compress_mutex);
+    while (true){
+        if (compress_pending == 0){
+            // pending files are compressed before the thread stops
+            if (compress_stop) break;
+            pthread_cond_wait(&compress_cond, &compress_mutex);
+            continue;
+        }
+
+        // compress oldest pending file, so remaining ones stay at path.1 .. path.compress_pending
+        compress_active_index = compress_pending--;
+        int fd = open(hci_dump_posix_rolling_file_name(path, compress_active_index, false), O_RDONLY);
+        pthread_mutex_unlock(&compress_mutex);
+
+        int err = (fd < 0) ? errno : hci_dump_posix_rolling_compress(fd, temp_path);
+        if (fd >= 0){
+            close(fd);
+        }
+
+        // file might have been shifted or dropped by rotation meanwhile
+        pthread_mutex_lock(&compress_mutex);
+        if ((err == 0) && (compress_active_index > 0)){
+            char compressed_path[HCI_DUMP_POSIX_ROLLING_MAX_PATH_LEN];
+            if (rename(temp_path, hci_dump_posix_rolling_file_name(compressed_path, compress_active_index, true)) == 0){
+                (void) unlink(hci_dump_posix_rolling_file_name(path, compress_active_index, false));
+            } else {
+                err = errno;
+            }
+        }
+        if (err != 0){
+            // keep uncompressed file, error is logged on Bluetooth thread during next rotation
+            compress_error = err;
+        }
+        if ((err != 0) || (compress_active_index == 0)){
+            (void) unlink(temp_path);
+        }
+        compress_active_index = 0;
+    }
+    pthread_mutex_unlock(&compress_mutex);
+    return NULL;
+}
+
+static int hci_dump_posix_rolling_compress_start(void){
+    compress_stop = false;
+    compress_pending = 0;
+    compress_active_index = 0;
+    compress_error = 0;
+    int err = pthread_create(&compress_thread, NULL, &hci_dump_posix_rolling_compress_thread, NULL);
+    if (err != 0){
+        return err;
+    }
+    compress_thread_running = true;
+    return 0;
+}
+
+static void hci_dump_posix_rolling_compress_stop(void){
+    if (compress_thread_running == false) return;
+    pthread_mutex_lock(&compress_mutex);
+    compress_stop = true;
+    pthread_cond_signal(&compress_cond);
+    pthread_mutex_unlock(&compress_mutex);
+    pthread_join(compress_thread, NULL);
+    compress_thread_running = false;
+}
+#endif
+
+// shift rotated files up by one, compressed or not, and drop oldest one
+static void hci_dump_posix_rolling_shift_files(void){
+    char older_path[HCI_DUMP_POSIX_ROLLING_MAX_PATH_LEN];
+    uint16_t oldest_index = rolling_config.num_files - 1;
+    (void) unlink(hci_dump_posix_rolling_file_name(path_buffer, oldest_index, false));
+    (void) unlink(hci_dump_posix_rolling_file_name(path_buffer, oldest_index, true));
+    uint16_t index;
+    for (index = oldest_index; index > 1; index--){
+        (void) rename(hci_dump_posix_rolling_file_name(path_buffer, index - 1, false),
+                      hci_dump_posix_rolling_file_name(older_path,  index,     false));
+        if (rolling_config.compress){
+            (void) rename(hci_dump_posix_rolling_file_name(path_buffer, index - 1, true),
+                          hci_dump_posix_rolling_file_name(older_path,  index,     true));
+        }
+    }
+}
+
+int hci_dump_posix_rolling_rotate(void){
+    if (dump_file < 0) return EBADF;
+    close(dump_file);
+    dump_file = -1;
+
+    if (rolling_config.num_files > 1){
+#ifdef HAVE_ZLIB
+        pthread_mutex_lock(&compress_mutex);
+#endif
+        hci_dump_posix_rolling_shift_files();
+        int err = 0;
+        if (rename(rolling_config.path, hci_dump_posix_rolling_file_name(path_buffer, 1, false)) != 0){
+            err = errno;
+        }
+#ifdef HAVE_ZLIB
+        if (compress_active_index > 0){
+            compress_active_index++;
+            if (compress_active_index >= rolling_config.num_files){
+                compress_active_index = 0;
+            }
+        }
+        compress_pending = btstack_min(compress_pending, rolling_config.num_files - 2);
+        int compress_err = compress_error;
+        compress_error = 0;
+        if (rolling_config.compress && (err == 0)){
+            compress_pending++;
+            pthread_cond_signal(&compress_cond);
+        }
+        pthread_mutex_unlock(&compress_mutex);
+        if (compress_err != 0){
+            log_error("failed to compress rotated file, errno = %d", compress_err);
+        }
+#endif
+        if (err != 0){
+            // keep current file instead of truncating it
+            log_error("failed to rotate file %s, errno = %d", rolling_config.path, err);
+            dump_file = hci_dump_posix_rolling_open_file(rolling_config.path, O_APPEND);
+            if (dump_file < 0){
+                return errno;
+            }
+            // retry after another max_file_size bytes
+            dump_file_size = 0;
+            return err;
+        }
+    }
+    return hci_dump_posix_rolling_open_current();
+}
+
+static void hci_dump_posix_rolling_reset(void){
+    (void) hci_dump_posix_rolling_rotate();
+}
+
+// history ring buffer
+static void hci_dump_posix_rolling_history_write(const uint8_t * data, uint32_t len){
+    uint32_t bytes_till_end = history_buffer_size - history_tail;
+    if (len < bytes_till_end){
+        memcpy(&history_buffer[history_tail], data, len);
+        history_tail += len;
+    } else {
+        memcpy(&history_buffer[history_tail], data, bytes_till_end);
+        memcpy(history_buffer, &data[bytes_till_end], len - bytes_till_end);
+        history_tail = len - bytes_till_end;
+    }
+    history_used += len;
+}
+
+static void hci_dump_posix_rolling_history_read(uint32_t pos, uint8_t * data, uint32_t len){
+    uint32_t bytes_till_end = history_buffer_size - pos;
+    if (len <= bytes_till_end){
+        memcpy(data, &history_buffer[pos], len);
+    } else {
+        memcpy(data, &history_buffer[pos], bytes_till_end);
+        memcpy(&data[bytes_till_end], history_buffer, len - bytes_till_end);
+    }
+}
+
+static uint32_t hci_dump_posix_rolling_history_next(uint32_t pos, uint32_t * timestamp_ms, uint32_t * record_len){
+    uint8_t entry_header[HCI_DUMP_POSIX_ROLLING_HISTORY_ENTRY_HEADER_LEN];
+    hci_dump_posix_rolling_history_read(pos, entry_header, sizeof(entry_header));
+    *timestamp_ms = little_endian_read_32(entry_header, 0);
+    *record_len   = little_endian_read_32(entry_header, 4);
+    return (pos + HCI_DUMP_POSIX_ROLLING_HISTORY_ENTRY_HEADER_LEN) % history_buffer_size;
+}
+
+static void hci_dump_posix_rolling_history_drop_oldest(void){
+    uint32_t timestamp_ms;
+    uint32_t record_len;
+    uint32_t record_pos = hci_dump_posix_rolling_history_next(history_head, &timestamp_ms, &record_len);
+    history_head  = (record_pos + record_len) % history_buffer_size;
+    history_used -= HCI_DUMP_POSIX_ROLLING_HISTORY_ENTRY_HEADER_LEN + record_len;
+}
+
+static void hci_dump_posix_rolling_history_store(uint32_t timestamp_ms, const uint8_t * header, uint16_t header_len, const uint8_t * packet, uint16_t len){
+    if (history_buffer == NULL) return;
+
+    // drop packets outside of history duration
+    while (history_used > 0){
+        uint32_t oldest_timestamp_ms;
+        uint32_t record_len;
+        (void) hci_dump_posix_rolling_history_next(history_head, &oldest_timestamp_ms, &record_len);
+        if ((uint32_t)(timestamp_ms - oldest_timestamp_ms) <= rolling_config.history_duration_ms) break;
+        hci_dump_posix_rolling_history_drop_oldest();
+    }
+
+    uint32_t entry_len = HCI_DUMP_POSIX_ROLLING_HISTORY_ENTRY_HEADER_LEN + header_len + len;
+    if (entry_len > history_buffer_size) return;
+
+    // make room
+    while ((history_buffer_size - history_used) < entry_len){
+        hci_dump_posix_rolling_history_drop_oldest();
+    }
+
+    uint8_t entry_header[HCI_DUMP_POSIX_ROLLING_HISTORY_ENTRY_HEADER_LEN];
+    little_endian_store_32(entry_header, 0, timestamp_ms);
+    little_endian_store_32(entry_header, 4, header_len + len);
+    hci_dump_posix_rolling_history_write(entry_header, sizeof(entry_header));
+    hci_dump_posix_rolling_history_write(header, header_len);
+    hci_dump_posix_rolling_history_write(packet, len);
+}
+
+static void hci_dump_posix_rolling_log_packet(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t len) {
+    if (dump_file < 0) return;
+
+    uint8_t header[HCI_DUMP_POSIX_ROLLING_MAX_HEADER_LEN];
+
+    // get time
+    struct timeval curr_time;
+    gettimeofday(&curr_time, NULL);
+    uint32_t tv_sec = curr_time.tv_sec;
+    uint32_t tv_us  = curr_time.tv_usec;
+    uint64_t ts_usec;
+
+    uint16_t header_len = 0;
+    switch (rolling_config.format){
+        case HCI_DUMP_BLUEZ:
+            // ISO packets not supported
+            if (packet_type == HCI_ISO_DATA_PACKET) return;
+            hci_dump_setup_header_bluez(header, tv_sec, tv_us, packet_type, in, len);
+            header_len = HCI_DUMP_HEADER_SIZE_BLUEZ;
+            break;
+        case HCI_DUMP_PACKETLOGGER:
+            hci_dump_setup_header_packetlogger(header, tv_sec, tv_us, packet_type, in, len);
+            header_len = HCI_DUMP_HEADER_SIZE_PACKETLOGGER;
+            break;
+        case HCI_DUMP_BTSNOOP:
+            // log messages not supported
+            if (packet_type == LOG_MESSAGE_PACKET) return;
+            ts_usec = 0xdcddb30f2f8000LLU + 1000000LLU * curr_time.tv_sec + curr_time.tv_usec;
+            // append packet type to pcap header
+            hci_dump_setup_header_btsnoop(header, ts_usec >> 32, ts_usec & 0xFFFFFFFF, 0, packet_type, in, len+1);
+            header[HCI_DUMP_HEADER_SIZE_BTSNOOP] = packet_type;
+            header_len = HCI_DUMP_HEADER_SIZE_BTSNOOP + 1;
+            break;
+        default:
+            btstack_unreachable();
+            return;
+    }
+
+    uint32_t timestamp_ms = (tv_sec * 1000u) + (tv_us / 1000u);
+    hci_dump_posix_rolling_history_store(timestamp_ms, header, header_len, packet, len);
+
+    // rotate if file would get too large, but store at least one packet per file
+    uint32_t record_len = header_len + len;
+    uint32_t file_header_len = (rolling_config.format == HCI_DUMP_BTSNOOP) ? sizeof(btsnoop_file_header) : 0;
+    if (((dump_file_size + record_len) > rolling_config.max_file_size) && (dump_file_size > file_header_len)){
+        (void) hci_dump_posix_rolling_rotate();
+        if (dump_file < 0) return;
+    }
+
+    ssize_t bytes_written;
+    bytes_written = write(dump_file, header, header_len);
+    UNUSED(bytes_written);
+    bytes_written = write(dump_file, packet, len);
+    UNUSED(bytes_written);
+    dump_file_size += record_len;
+}
+
+static void hci_dump_posix_rolling_log_message(int log_level, const char * format, va_list argptr){
+    UNUSED(log_level);
+    if (dump_file < 0) return;
+    int full_string_len = vsnprintf(log_message_buffer, sizeof(log_message_buffer), format, argptr);
+    int len = btstack_min(sizeof(log_message_buffer), full_string_len);
+    hci_dump_posix_rolling_log_packet(LOG_MESSAGE_PACKET, 0, (uint8_t*) log_message_buffer, len);
+}
+
+int hci_dump_posix_rolling_save_history(const char * path){
+    if (history_buffer == NULL) return ENOMEM;
+    int fd = hci_dump_posix_rolling_open_file(path, O_TRUNC);
+    if (fd < 0){
+        return errno;
+    }
+    (void) hci_dump_posix_rolling_write_file_header(fd);
+
+    uint8_t chunk[512];
+    uint32_t pos = history_head;
+    uint32_t remaining = history_used;
+    while (remaining > 0){
+        uint32_t timestamp_ms;
+        uint32_t record_len;
+        pos = hci_dump_posix_rolling_history_next(pos, &timestamp_ms, &record_len);
+        remaining -= HCI_DUMP_POSIX_ROLLING_HISTORY_ENTRY_HEADER_LEN + record_len;
+        while (record_len > 0){
+            uint32_t chunk_len = btstack_min(record_len, sizeof(chunk));
+            hci_dump_posix_rolling_history_read(pos, chunk, chunk_len);
+            ssize_t bytes_written = write(fd, chunk, chunk_len);
+            UNUSED(bytes_written);
+            pos = (pos + chunk_len) % history_buffer_size;
+            record_len -= chunk_len;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+// returns system errno
+int hci_dump_posix_rolling_open(const hci_dump_posix_rolling_config_t * config){
+    btstack_assert(config->format == HCI_DUMP_BLUEZ || config->format == HCI_DUMP_PACKETLOGGER || config->format == HCI_DUMP_BTSNOOP);
+    btstack_assert(config->num_files > 0);
+    btstack_assert(dump_file < 0);
+
+#ifndef HAVE_ZLIB
+    if (config->compress){
+        log_error("compression requires HAVE_ZLIB");
+        return ENOTSUP;
+    }
+#endif
+
+    rolling_config = *config;
+
+    if ((config->history_duration_ms > 0) && (config->history_buffer_size > 0)){
+        history_buffer = (uint8_t *) malloc(config->history_buffer_size);
+        if (history_buffer == NULL){
+            return ENOMEM;
+        }
+        history_buffer_size = config->history_buffer_size;
+        history_head = 0;
+        history_tail = 0;
+        history_used = 0;
+    }
+
+    int err = 0;
+#ifdef HAVE_ZLIB
+    if (config->compress && (config->num_files > 1)){
+        err = hci_dump_posix_rolling_compress_start();
+    }
+#endif
+    if (err == 0){
+        err = hci_dump_posix_rolling_open_current();
+    }
+    if (err != 0){
+        free(history_buffer);
+        history_buffer = NULL;
+#ifdef HAVE_ZLIB
+        hci_dump_posix_rolling_compress_stop();
+#endif
+    }
+    return err;
+}
+
+void hci_dump_posix_rolling_close(void){
+    if (dump_file >= 0){
+        close(dump_file);
+        dump_file = -1;
+    }
+#ifdef HAVE_ZLIB
+    hci_dump_posix_rolling_compress_stop();
+#endif
+    free(history_buffer);
+    history_buffer = NULL;
+}
+
+const hci_dump_t * hci_dump_posix_rolling_get_instance(void){
+    static const hci_dump_t hci_dump_instance = {
+        // void (*reset)(void);
+        &hci_dump_posix_rolling_reset,
+        // void (*log_packet)(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t len);
+        &hci_dump_posix_rolling_log_packet,
+        // void (*log_message)(int log_level, const char * format, va_list argptr);
+        &hci_dump_posix_rolling_log_message,
+    };
+    return &hci_dump_instance;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+/*
+ *  Dump HCI trace into a set of size-limited files that are rotated, with optional
+ *  compression of rotated files and an in-memory history of the most recent packets
+ */
+
+#ifndef HCI_DUMP_POSIX_ROLLING_H
+#define HCI_DUMP_POSIX_ROLLING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hci_dump.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    // path of current file, older files get suffix .1 .. .(num_files - 1)
+    const char *      path;
+    hci_dump_format_t format;
+    // file is rotated before it would grow larger than max_file_size
+    uint32_t          max_file_size;
+    // number of files incl. current one, at least 1
+    uint16_t          num_files;
+    // compress rotated files with gzip in a background thread, suffix .gz is appended. requires HAVE_ZLIB and pthreads
+    bool              compress;
+    // keep packets of the last history_duration_ms in a memory buffer of history_buffer_size bytes, 0 to disable
+    uint32_t          history_duration_ms;
+    uint32_t          history_buffer_size;
+} hci_dump_posix_rolling_config_t;
+
+/* API_START */
+
+/**
+ * @brief Get HCI Dump POSIX Rolling Instance
+ * @return hci_dump_impl
+ */
+const hci_dump_t * hci_dump_posix_rolling_get_instance(void);
+
+/**
+ * @brief Open current log file and start rolling capture
+ * @note config is copied, path needs to stay valid until hci_dump_posix_rolling_close
+ * @param config
+ * @returns 0 if ok, errno otherwise
+ */
+int hci_dump_posix_rolling_open(const hci_dump_posix_rolling_config_t * config);
+
+/**
+ * @brief Close current file and start a new one
+ * @returns 0 if ok, errno otherwise
+ */
+int hci_dump_posix_rolling_rotate(void);
+
+/**
+ * @brief Store packets from in-memory history into a separate file, e.g. after an incident
+ * @note History is not cleared
+ * @param path
+ * @returns 0 if ok, errno otherwise
+ */
+int hci_dump_posix_rolling_save_history(const char * path);
+
+/**
+ * @brief Close current log file and release history buffer
+ */
+void hci_dump_posix_rolling_close(void);
+
+/* API_END */
+
+#if defined __cplusplus
+}
+#endif
+#endif // HCI_DUMP_POSIX_ROLLING_H
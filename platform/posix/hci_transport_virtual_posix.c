@@ -0,0 +1,1089 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "hci_transport_virtual_posix.c"
+
+/*
+ *  hci_transport_virtual_posix.c
+ *
+ *  HCI Transport with a minimal simulated Controller:
+ *
+ *  - commands are answered from the run loop, unknown commands get a Command Complete with success
+ *  - LE advertising, scanning and connections, Classic connections to the peer virtual Controller
+ *  - outgoing ACL packets are queued and forwarded to the peer with link_rate_bps,
+ *    Number Of Completed Packets is emitted once a packet was forwarded
+ *  - messages to the peer are sent over a SOCK_SEQPACKET socket, each with a one byte message type
+ *
+ */
+
+#include "btstack_config.h"
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#ifdef __FreeBSD__
+// FreeBSD does not set __BSD_VISIBLE or __XSI_VISIBLE if _POSIX_C_SOURCE is defined
+#define __BSD_VISIBLE 1
+#define __XSI_VISIBLE 1
+#endif
+
+#include "hci_transport_virtual_posix.h"
+
+#include "bluetooth_company_id.h"
+#include "btstack_debug.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define VIRTUAL_CONTROLLER_MAX_CONNECTIONS  4
+#define VIRTUAL_CONTROLLER_MAX_ACL_PACKETS 32
+#define VIRTUAL_CONTROLLER_NUM_EVENTS      16
+#define VIRTUAL_CONTROLLER_EVENT_SIZE      (2 + 255)
+#define VIRTUAL_CONTROLLER_NUM_MESSAGES     8
+#define VIRTUAL_CONTROLLER_MESSAGE_SIZE    64
+#define VIRTUAL_CONTROLLER_LOCAL_NAME      "BTstack Virtual Controller"
+
+// max number of messages read from link per data source callback
+#define VIRTUAL_CONTROLLER_MAX_READS_PER_CALLBACK 16
+
+typedef enum {
+    // enabled(1), connectable(1), advertising event type(1), address(6), data len(1), data
+    VIRTUAL_LINK_MESSAGE_ADVERTISING = 1,
+    // initiator handle(2), initiator address(6), conn interval(2), conn latency(2), supervision timeout(2)
+    VIRTUAL_LINK_MESSAGE_LE_CONNECT,
+    // status(1), initiator handle(2), responder handle(2), responder address(6)
+    VIRTUAL_LINK_MESSAGE_LE_CONNECT_COMPLETE,
+    // initiator handle(2), initiator address(6), class of device(3)
+    VIRTUAL_LINK_MESSAGE_CONNECT,
+    // status(1), initiator handle(2), responder handle(2)
+    VIRTUAL_LINK_MESSAGE_CONNECT_COMPLETE,
+    // handle of receiver(2), reason(1)
+    VIRTUAL_LINK_MESSAGE_DISCONNECT,
+    // HCI ACL packet with handle of receiver
+    VIRTUAL_LINK_MESSAGE_ACL,
+} virtual_link_message_type_t;
+
+typedef enum {
+    VIRTUAL_CONNECTION_FREE = 0,
+    // outgoing, wait for peer
+    VIRTUAL_CONNECTION_W4_CONNECT_COMPLETE,
+    // incoming Classic, wait for Accept Connection Request
+    VIRTUAL_CONNECTION_W4_ACCEPT,
+    VIRTUAL_CONNECTION_OPEN,
+} virtual_connection_state_t;
+
+typedef struct {
+    virtual_connection_state_t state;
+    bool             le;
+    hci_con_handle_t handle;
+    hci_con_handle_t remote_handle;
+    bd_addr_t        address;
+    uint16_t         conn_interval;
+    uint16_t         conn_latency;
+    uint16_t         supervision_timeout;
+    // forwarded packets not reported in Number Of Completed Packets yet
+    uint16_t         num_completed_packets;
+} virtual_connection_t;
+
+static const hci_transport_virtual_posix_config_t * virtual_config;
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+static btstack_data_source_t virtual_link_data_source;
+static btstack_timer_source_t virtual_controller_timer;
+static bool                   virtual_controller_timer_active;
+
+// controller state
+static virtual_connection_t virtual_connections[VIRTUAL_CONTROLLER_MAX_CONNECTIONS];
+static hci_con_handle_t     virtual_next_con_handle;
+static uint8_t              virtual_scan_enable;
+static uint8_t              virtual_class_of_device[3];
+static bool                 virtual_le_scan_enabled;
+static bool                 virtual_le_advertising_enabled;
+static uint8_t              virtual_le_advertising_type;
+static uint8_t              virtual_le_advertising_data_len;
+static uint8_t              virtual_le_advertising_data[31];
+
+// peer advertising as received from link
+static bool      virtual_peer_advertising;
+static bool      virtual_peer_advertising_connectable;
+static uint8_t   virtual_peer_advertising_type;
+static bd_addr_t virtual_peer_address;
+static uint8_t   virtual_peer_advertising_data_len;
+static uint8_t   virtual_peer_advertising_data[31];
+
+// events to host, delivered from run loop
+static uint8_t  virtual_event_queue[VIRTUAL_CONTROLLER_NUM_EVENTS][VIRTUAL_CONTROLLER_EVENT_SIZE];
+static uint16_t virtual_event_queue_len[VIRTUAL_CONTROLLER_NUM_EVENTS];
+static uint16_t virtual_event_queue_head;
+static uint16_t virtual_event_queue_count;
+static uint8_t  virtual_event_buffer[VIRTUAL_CONTROLLER_EVENT_SIZE];
+
+// control messages to peer, sent before queued ACL packets
+static uint8_t  virtual_message_queue[VIRTUAL_CONTROLLER_NUM_MESSAGES][VIRTUAL_CONTROLLER_MESSAGE_SIZE];
+static uint16_t virtual_message_queue_len[VIRTUAL_CONTROLLER_NUM_MESSAGES];
+static uint16_t virtual_message_queue_head;
+static uint16_t virtual_message_queue_count;
+
+// outgoing ACL packets, forwarded with link rate
+static uint8_t  virtual_acl_queue[VIRTUAL_CONTROLLER_MAX_ACL_PACKETS][1 + HCI_ACL_HEADER_SIZE + HCI_ACL_PAYLOAD_SIZE];
+static uint16_t virtual_acl_queue_len[VIRTUAL_CONTROLLER_MAX_ACL_PACKETS];
+static uint16_t virtual_acl_queue_head;
+static uint16_t virtual_acl_queue_count;
+static uint32_t virtual_link_budget_time_ms;
+static uint32_t virtual_link_budget_bits;
+
+// incoming packets with pre-buffer, message type is read into byte before packet
+static uint8_t  virtual_rx_buffer[1 + HCI_INCOMING_PRE_BUFFER_SIZE + HCI_INCOMING_PACKET_BUFFER_SIZE];
+static uint8_t  virtual_rx_message_type;
+
+// LE Supported (Controller)
+static const uint8_t virtual_controller_features[8] = { 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00 };
+
+static void virtual_controller_timer_start(uint32_t timeout_ms);
+
+// connections
+
+static virtual_connection_t * virtual_connection_for_handle(hci_con_handle_t handle){
+    uint16_t i;
+    for (i = 0; i < VIRTUAL_CONTROLLER_MAX_CONNECTIONS; i++){
+        if (virtual_connections[i].state == VIRTUAL_CONNECTION_FREE) continue;
+        if (virtual_connections[i].handle == handle) return &virtual_connections[i];
+    }
+    return NULL;
+}
+
+static virtual_connection_t * virtual_connection_for_state(virtual_connection_state_t state, bool le){
+    uint16_t i;
+    for (i = 0; i < VIRTUAL_CONTROLLER_MAX_CONNECTIONS; i++){
+        if (virtual_connections[i].state != state) continue;
+        if (virtual_connections[i].le == le) return &virtual_connections[i];
+    }
+    return NULL;
+}
+
+static virtual_connection_t * virtual_connection_create(bool le, const bd_addr_t address){
+    uint16_t i;
+    for (i = 0; i < VIRTUAL_CONTROLLER_MAX_CONNECTIONS; i++){
+        virtual_connection_t * connection = &virtual_connections[i];
+        if (connection->state != VIRTUAL_CONNECTION_FREE) continue;
+        memset(connection, 0, sizeof(virtual_connection_t));
+        connection->le = le;
+        connection->handle = virtual_next_con_handle;
+        bd_addr_copy(connection->address, address);
+        virtual_next_con_handle++;
+        if (virtual_next_con_handle > 0x0effu){
+            virtual_next_con_handle = 0x0001;
+        }
+        return connection;
+    }
+    return NULL;
+}
+
+static void virtual_connection_free(virtual_connection_t * connection){
+    // drop queued packets, Number Of Completed Packets is not reported after disconnect
+    uint16_t count = virtual_acl_queue_count;
+    uint16_t i;
+    for (i = 0; i < count; i++){
+        uint16_t index = virtual_acl_queue_head;
+        virtual_acl_queue_head = (virtual_acl_queue_head + 1u) % VIRTUAL_CONTROLLER_MAX_ACL_PACKETS;
+        virtual_acl_queue_count--;
+        hci_con_handle_t handle = little_endian_read_16(virtual_acl_queue[index], 1) & 0x0fffu;
+        if (handle == connection->handle) continue;
+        uint16_t tail = (virtual_acl_queue_head + virtual_acl_queue_count) % VIRTUAL_CONTROLLER_MAX_ACL_PACKETS;
+        if (tail != index){
+            (void) memcpy(virtual_acl_queue[tail], virtual_acl_queue[index], virtual_acl_queue_len[index]);
+            virtual_acl_queue_len[tail] = virtual_acl_queue_len[index];
+        }
+        virtual_acl_queue_count++;
+    }
+    connection->state = VIRTUAL_CONNECTION_FREE;
+}
+
+// events to host
+
+static uint8_t * virtual_event_alloc(uint8_t event_code, uint8_t params_len){
+    if (virtual_event_queue_count == VIRTUAL_CONTROLLER_NUM_EVENTS){
+        log_error("virtual controller: event queue full, drop event 0x%02x", event_code);
+        return NULL;
+    }
+    uint16_t index = (virtual_event_queue_head + virtual_event_queue_count) % VIRTUAL_CONTROLLER_NUM_EVENTS;
+    virtual_event_queue_count++;
+    virtual_event_queue_len[index] = 2u + params_len;
+    uint8_t * event = virtual_event_queue[index];
+    memset(event, 0, VIRTUAL_CONTROLLER_EVENT_SIZE);
+    event[0] = event_code;
+    event[1] = params_len;
+    virtual_controller_timer_start(0);
+    return event;
+}
+
+static void virtual_event_emit_command_complete(uint16_t opcode, const uint8_t * return_params, uint8_t return_params_len){
+    uint8_t * event = virtual_event_alloc(HCI_EVENT_COMMAND_COMPLETE, 3u + return_params_len);
+    if (event == NULL) return;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    (void) memcpy(&event[5], return_params, return_params_len);
+}
+
+static void virtual_event_emit_command_complete_status(uint16_t opcode, uint8_t status){
+    virtual_event_emit_command_complete(opcode, &status, 1);
+}
+
+static void virtual_event_emit_command_status(uint16_t opcode, uint8_t status){
+    uint8_t * event = virtual_event_alloc(HCI_EVENT_COMMAND_STATUS, 4);
+    if (event == NULL) return;
+    event[2] = status;
+    event[3] = 1;
+    little_endian_store_16(event, 4, opcode);
+}
+
+static void virtual_event_emit_disconnection_complete(hci_con_handle_t handle, uint8_t reason){
+    uint8_t * event = virtual_event_alloc(HCI_EVENT_DISCONNECTION_COMPLETE, 4);
+    if (event == NULL) return;
+    event[2] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(event, 3, handle);
+    event[5] = reason;
+}
+
+static void virtual_event_emit_connection_complete(uint8_t status, const virtual_connection_t * connection){
+    uint8_t * event = virtual_event_alloc(HCI_EVENT_CONNECTION_COMPLETE, 11);
+    if (event == NULL) return;
+    event[2] = status;
+    little_endian_store_16(event, 3, connection->handle);
+    reverse_bd_addr(connection->address, &event[5]);
+    event[11] = 0x01;   // ACL
+    event[12] = 0x00;   // encryption disabled
+}
+
+static void virtual_event_emit_le_connection_complete(uint8_t status, const virtual_connection_t * connection, uint8_t role){
+    uint8_t * event = virtual_event_alloc(HCI_EVENT_LE_META, 19);
+    if (event == NULL) return;
+    event[2] = HCI_SUBEVENT_LE_CONNECTION_COMPLETE;
+    event[3] = status;
+    little_endian_store_16(event, 4, connection->handle);
+    event[6] = role;
+    event[7] = BD_ADDR_TYPE_LE_PUBLIC;
+    reverse_bd_addr(connection->address, &event[8]);
+    little_endian_store_16(event, 14, connection->conn_interval);
+    little_endian_store_16(event, 16, connection->conn_latency);
+    little_endian_store_16(event, 18, connection->supervision_timeout);
+    event[20] = 0;      // clock accuracy
+}
+
+static void virtual_event_emit_advertising_report(void){
+    uint8_t * event = virtual_event_alloc(HCI_EVENT_LE_META, 12u + virtual_peer_advertising_data_len);
+    if (event == NULL) return;
+    event[2] = HCI_SUBEVENT_LE_ADVERTISING_REPORT;
+    event[3] = 1;
+    event[4] = virtual_peer_advertising_type;
+    event[5] = BD_ADDR_TYPE_LE_PUBLIC;
+    reverse_bd_addr(virtual_peer_address, &event[6]);
+    event[12] = virtual_peer_advertising_data_len;
+    (void) memcpy(&event[13], virtual_peer_advertising_data, virtual_peer_advertising_data_len);
+    event[13u + virtual_peer_advertising_data_len] = (uint8_t) -40;
+}
+
+static void virtual_event_emit_number_of_completed_packets(void){
+    uint8_t num_handles = 0;
+    uint16_t i;
+    for (i = 0; i < VIRTUAL_CONTROLLER_MAX_CONNECTIONS; i++){
+        if (virtual_connections[i].num_completed_packets > 0u){
+            num_handles++;
+        }
+    }
+    if (num_handles == 0u) return;
+    uint8_t * event = virtual_event_alloc(HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 1u + (4u * num_handles));
+    if (event == NULL) return;
+    event[2] = num_handles;
+    uint16_t pos = 3;
+    for (i = 0; i < VIRTUAL_CONTROLLER_MAX_CONNECTIONS; i++){
+        virtual_connection_t * connection = &virtual_connections[i];
+        if (connection->num_completed_packets == 0u) continue;
+        little_endian_store_16(event, pos, connection->handle);
+        little_endian_store_16(event, pos + 2u, connection->num_completed_packets);
+        connection->num_completed_packets = 0;
+        pos += 4u;
+    }
+}
+
+static void virtual_event_deliver_all(void){
+    while (virtual_event_queue_count > 0u){
+        // copy event, as host may trigger new events while handling it
+        uint16_t index = virtual_event_queue_head;
+        uint16_t len = virtual_event_queue_len[index];
+        (void) memcpy(virtual_event_buffer, virtual_event_queue[index], len);
+        virtual_event_queue_head = (virtual_event_queue_head + 1u) % VIRTUAL_CONTROLLER_NUM_EVENTS;
+        virtual_event_queue_count--;
+        packet_handler(HCI_EVENT_PACKET, virtual_event_buffer, len);
+    }
+}
+
+// messages to peer
+
+static bool virtual_link_available(void){
+    return (virtual_config != NULL) && (virtual_config->link_fd >= 0);
+}
+
+static uint8_t * virtual_link_message_alloc(virtual_link_message_type_t type, uint16_t len){
+    if (virtual_link_available() == false) return NULL;
+    if ((virtual_message_queue_count == VIRTUAL_CONTROLLER_NUM_MESSAGES) || ((1u + len) > VIRTUAL_CONTROLLER_MESSAGE_SIZE)){
+        log_error("virtual controller: cannot queue message type %u", type);
+        return NULL;
+    }
+    uint16_t index = (virtual_message_queue_head + virtual_message_queue_count) % VIRTUAL_CONTROLLER_NUM_MESSAGES;
+    virtual_message_queue_count++;
+    virtual_message_queue_len[index] = 1u + len;
+    uint8_t * message = virtual_message_queue[index];
+    message[0] = (uint8_t) type;
+    virtual_controller_timer_start(0);
+    return &message[1];
+}
+
+static void virtual_link_send_advertising(void){
+    uint8_t * message = virtual_link_message_alloc(VIRTUAL_LINK_MESSAGE_ADVERTISING, 10u + virtual_le_advertising_data_len);
+    if (message == NULL) return;
+    // ADV_IND and ADV_DIRECT_IND are connectable
+    bool connectable = (virtual_le_advertising_type == 0x00u) || (virtual_le_advertising_type == 0x01u) || (virtual_le_advertising_type == 0x04u);
+    message[0] = virtual_le_advertising_enabled ? 1u : 0u;
+    message[1] = connectable ? 1u : 0u;
+    message[2] = virtual_le_advertising_type;
+    bd_addr_copy(&message[3], virtual_config->bd_addr);
+    message[9] = virtual_le_advertising_data_len;
+    (void) memcpy(&message[10], virtual_le_advertising_data, virtual_le_advertising_data_len);
+}
+
+static void virtual_link_send_le_connect(const virtual_connection_t * connection){
+    uint8_t * message = virtual_link_message_alloc(VIRTUAL_LINK_MESSAGE_LE_CONNECT, 14);
+    if (message == NULL) return;
+    little_endian_store_16(message, 0, connection->handle);
+    bd_addr_copy(&message[2], virtual_config->bd_addr);
+    little_endian_store_16(message,  8, connection->conn_interval);
+    little_endian_store_16(message, 10, connection->conn_latency);
+    little_endian_store_16(message, 12, connection->supervision_timeout);
+}
+
+static void virtual_link_send_disconnect(hci_con_handle_t remote_handle, uint8_t reason){
+    uint8_t * message = virtual_link_message_alloc(VIRTUAL_LINK_MESSAGE_DISCONNECT, 3);
+    if (message == NULL) return;
+    little_endian_store_16(message, 0, remote_handle);
+    message[2] = reason;
+}
+
+static void virtual_link_send_connect_complete(uint8_t status, hci_con_handle_t initiator_handle, hci_con_handle_t responder_handle){
+    uint8_t * message = virtual_link_message_alloc(VIRTUAL_LINK_MESSAGE_CONNECT_COMPLETE, 5);
+    if (message == NULL) return;
+    message[0] = status;
+    little_endian_store_16(message, 1, initiator_handle);
+    little_endian_store_16(message, 3, responder_handle);
+}
+
+// returns false if link is busy
+static bool virtual_link_write(const uint8_t * message, uint16_t len){
+    ssize_t res = send(virtual_config->link_fd, message, len, 0);
+    if (res == (ssize_t) len) return true;
+    if ((res < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) return false;
+    // peer is gone, drop message
+    log_error("virtual controller: link write failed, res %d, errno %d", (int) res, errno);
+    return true;
+}
+
+static void virtual_link_send_messages(void){
+    while (virtual_message_queue_count > 0u){
+        uint16_t index = virtual_message_queue_head;
+        if (virtual_link_write(virtual_message_queue[index], virtual_message_queue_len[index]) == false) return;
+        virtual_message_queue_head = (virtual_message_queue_head + 1u) % VIRTUAL_CONTROLLER_NUM_MESSAGES;
+        virtual_message_queue_count--;
+    }
+}
+
+// forward queued ACL packets as long as link rate allows
+static void virtual_link_send_acl_packets(void){
+    if (virtual_config->link_rate_bps > 0u){
+        uint32_t now = btstack_run_loop_get_time_ms();
+        uint32_t elapsed_ms = now - virtual_link_budget_time_ms;
+        virtual_link_budget_time_ms = now;
+        // allow bursts of up to 10 ms
+        uint64_t max_budget_bits = ((uint64_t) virtual_config->link_rate_bps / 100u) + (8u * (HCI_ACL_HEADER_SIZE + HCI_ACL_PAYLOAD_SIZE));
+        uint64_t budget_bits = (uint64_t) virtual_link_budget_bits + (((uint64_t) elapsed_ms * virtual_config->link_rate_bps) / 1000u);
+        virtual_link_budget_bits = (uint32_t) btstack_min(budget_bits, max_budget_bits);
+    }
+    while (virtual_acl_queue_count > 0u){
+        uint16_t index = virtual_acl_queue_head;
+        uint8_t * message = virtual_acl_queue[index];
+        uint16_t len = virtual_acl_queue_len[index];
+        uint32_t bits = 8u * (len - 1u);
+        if ((virtual_config->link_rate_bps > 0u) && (bits > virtual_link_budget_bits)) return;
+        hci_con_handle_t handle = little_endian_read_16(message, 1) & 0x0fffu;
+        virtual_connection_t * connection = virtual_connection_for_handle(handle);
+        if (connection != NULL){
+            // use handle of peer, first non-flushable fragment is reported as first automatically flushable fragment
+            uint16_t flags = little_endian_read_16(message, 1) & 0xf000u;
+            if ((flags & 0x3000u) == 0u){
+                flags |= 0x2000u;
+            }
+            little_endian_store_16(message, 1, flags | connection->remote_handle);
+            if (virtual_link_write(message, len) == false) return;
+            connection->num_completed_packets++;
+        }
+        if (virtual_config->link_rate_bps > 0u){
+            virtual_link_budget_bits -= bits;
+        }
+        virtual_acl_queue_head = (virtual_acl_queue_head + 1u) % VIRTUAL_CONTROLLER_MAX_ACL_PACKETS;
+        virtual_acl_queue_count--;
+    }
+}
+
+// timer: deliver events and forward packets
+
+static void virtual_controller_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    virtual_controller_timer_active = false;
+
+    virtual_event_deliver_all();
+
+    if (virtual_link_available()){
+        virtual_link_send_messages();
+        virtual_link_send_acl_packets();
+    }
+
+    virtual_event_emit_number_of_completed_packets();
+    virtual_event_deliver_all();
+
+    // retry if link rate or socket buffer doesn't allow to send everything
+    if ((virtual_message_queue_count > 0u) || (virtual_acl_queue_count > 0u)){
+        virtual_controller_timer_start(1);
+    }
+}
+
+static void virtual_controller_timer_start(uint32_t timeout_ms){
+    if (virtual_controller_timer_active){
+        if (timeout_ms > 0u) return;
+        btstack_run_loop_remove_timer(&virtual_controller_timer);
+    }
+    virtual_controller_timer_active = true;
+    btstack_run_loop_set_timer_handler(&virtual_controller_timer, &virtual_controller_timer_handler);
+    btstack_run_loop_set_timer(&virtual_controller_timer, timeout_ms);
+    btstack_run_loop_add_timer(&virtual_controller_timer);
+}
+
+// commands from host
+
+static void virtual_controller_reset(void){
+    memset(virtual_connections, 0, sizeof(virtual_connections));
+    virtual_next_con_handle = 0x0001;
+    virtual_scan_enable = 0;
+    virtual_le_scan_enabled = false;
+    virtual_le_advertising_enabled = false;
+    virtual_le_advertising_type = 0;
+    virtual_le_advertising_data_len = 0;
+    virtual_acl_queue_head = 0;
+    virtual_acl_queue_count = 0;
+    virtual_link_budget_bits = 0;
+    virtual_link_budget_time_ms = btstack_run_loop_get_time_ms();
+}
+
+static void virtual_controller_handle_le_create_connection(const uint8_t * packet){
+    bd_addr_t address;
+    reverse_bd_addr(&packet[9], address);
+    virtual_connection_t * connection = virtual_connection_create(true, address);
+    if (connection == NULL){
+        virtual_event_emit_command_status(HCI_OPCODE_HCI_LE_CREATE_CONNECTION, ERROR_CODE_CONNECTION_LIMIT_EXCEEDED);
+        return;
+    }
+    virtual_event_emit_command_status(HCI_OPCODE_HCI_LE_CREATE_CONNECTION, ERROR_CODE_SUCCESS);
+    connection->state = VIRTUAL_CONNECTION_W4_CONNECT_COMPLETE;
+    connection->conn_interval = little_endian_read_16(packet, 18);
+    connection->conn_latency = little_endian_read_16(packet, 20);
+    connection->supervision_timeout = little_endian_read_16(packet, 22);
+    // peer accepts if advertising, otherwise retried when peer starts advertising
+    if (virtual_peer_advertising && virtual_peer_advertising_connectable){
+        virtual_link_send_le_connect(connection);
+    }
+}
+
+static void virtual_controller_handle_le_create_connection_cancel(uint16_t opcode){
+    virtual_connection_t * connection = virtual_connection_for_state(VIRTUAL_CONNECTION_W4_CONNECT_COMPLETE, true);
+    if (connection == NULL){
+        virtual_event_emit_command_complete_status(opcode, ERROR_CODE_COMMAND_DISALLOWED);
+        return;
+    }
+    virtual_event_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+    virtual_event_emit_le_connection_complete(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, connection, HCI_ROLE_MASTER);
+    virtual_connection_free(connection);
+}
+
+static void virtual_controller_handle_create_connection(const uint8_t * packet){
+    bd_addr_t address;
+    reverse_bd_addr(&packet[3], address);
+    virtual_connection_t * connection = virtual_connection_create(false, address);
+    if (connection == NULL){
+        virtual_event_emit_command_status(HCI_OPCODE_HCI_CREATE_CONNECTION, ERROR_CODE_CONNECTION_LIMIT_EXCEEDED);
+        return;
+    }
+    uint8_t * message = virtual_link_message_alloc(VIRTUAL_LINK_MESSAGE_CONNECT, 11);
+    if (message == NULL){
+        connection->state = VIRTUAL_CONNECTION_FREE;
+        virtual_event_emit_command_status(HCI_OPCODE_HCI_CREATE_CONNECTION, ERROR_CODE_SUCCESS);
+        virtual_event_emit_connection_complete(ERROR_CODE_PAGE_TIMEOUT, connection);
+        return;
+    }
+    virtual_event_emit_command_status(HCI_OPCODE_HCI_CREATE_CONNECTION, ERROR_CODE_SUCCESS);
+    connection->state = VIRTUAL_CONNECTION_W4_CONNECT_COMPLETE;
+    little_endian_store_16(message, 0, connection->handle);
+    bd_addr_copy(&message[2], virtual_config->bd_addr);
+    (void) memcpy(&message[8], virtual_class_of_device, 3);
+}
+
+static void virtual_controller_handle_accept_connection_request(uint16_t opcode, const uint8_t * packet, bool accept){
+    bd_addr_t address;
+    reverse_bd_addr(&packet[3], address);
+    virtual_connection_t * connection = virtual_connection_for_state(VIRTUAL_CONNECTION_W4_ACCEPT, false);
+    if ((connection == NULL) || (bd_addr_cmp(connection->address, address) != 0)){
+        virtual_event_emit_command_status(opcode, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
+        return;
+    }
+    virtual_event_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+    if (accept){
+        connection->state = VIRTUAL_CONNECTION_OPEN;
+        virtual_event_emit_connection_complete(ERROR_CODE_SUCCESS, connection);
+        virtual_link_send_connect_complete(ERROR_CODE_SUCCESS, connection->remote_handle, connection->handle);
+    } else {
+        uint8_t reason = packet[9];
+        virtual_event_emit_connection_complete(reason, connection);
+        virtual_link_send_connect_complete(reason, connection->remote_handle, HCI_CON_HANDLE_INVALID);
+        virtual_connection_free(connection);
+    }
+}
+
+static void virtual_controller_handle_disconnect(const uint8_t * packet){
+    hci_con_handle_t handle = little_endian_read_16(packet, 3) & 0x0fffu;
+    virtual_connection_t * connection = virtual_connection_for_handle(handle);
+    if ((connection == NULL) || (connection->state != VIRTUAL_CONNECTION_OPEN)){
+        virtual_event_emit_command_status(HCI_OPCODE_HCI_DISCONNECT, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
+        return;
+    }
+    virtual_event_emit_command_status(HCI_OPCODE_HCI_DISCONNECT, ERROR_CODE_SUCCESS);
+    virtual_link_send_disconnect(connection->remote_handle, packet[5]);
+    virtual_event_emit_disconnection_complete(handle, ERROR_CODE_CONNECTION_TERMINATED_BY_LOCAL_HOST);
+    virtual_connection_free(connection);
+}
+
+// handle commands that refer to an existing connection and are completed by an event
+static void virtual_controller_handle_connection_command(uint16_t opcode, const uint8_t * packet){
+    hci_con_handle_t handle = little_endian_read_16(packet, 3) & 0x0fffu;
+    virtual_connection_t * connection = virtual_connection_for_handle(handle);
+    if ((connection == NULL) || (connection->state != VIRTUAL_CONNECTION_OPEN)){
+        virtual_event_emit_command_status(opcode, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
+        return;
+    }
+    virtual_event_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+    uint8_t * event;
+    switch (opcode){
+        case HCI_OPCODE_HCI_READ_REMOTE_SUPPORTED_FEATURES_COMMAND:
+            event = virtual_event_alloc(HCI_EVENT_READ_REMOTE_SUPPORTED_FEATURES_COMPLETE, 11);
+            if (event == NULL) break;
+            little_endian_store_16(event, 3, handle);
+            (void) memcpy(&event[5], virtual_controller_features, 8);
+            break;
+        case HCI_OPCODE_HCI_READ_REMOTE_EXTENDED_FEATURES_COMMAND:
+            event = virtual_event_alloc(HCI_EVENT_READ_REMOTE_EXTENDED_FEATURES_COMPLETE, 13);
+            if (event == NULL) break;
+            little_endian_store_16(event, 3, handle);
+            event[5] = packet[5];
+            event[6] = 0;
+            if (packet[5] == 0u){
+                (void) memcpy(&event[7], virtual_controller_features, 8);
+            }
+            break;
+        case HCI_OPCODE_HCI_READ_REMOTE_VERSION_INFORMATION:
+            event = virtual_event_alloc(HCI_EVENT_READ_REMOTE_VERSION_INFORMATION_COMPLETE, 8);
+            if (event == NULL) break;
+            little_endian_store_16(event, 3, handle);
+            event[5] = 0x09;
+            little_endian_store_16(event, 6, BLUETOOTH_COMPANY_ID_BLUEKITCHEN_GMBH);
+            little_endian_store_16(event, 8, 0x0001);
+            break;
+        case HCI_OPCODE_HCI_LE_READ_REMOTE_USED_FEATURES:
+            event = virtual_event_alloc(HCI_EVENT_LE_META, 12);
+            if (event == NULL) break;
+            event[2] = HCI_SUBEVENT_LE_READ_REMOTE_FEATURES_COMPLETE;
+            little_endian_store_16(event, 4, handle);
+            break;
+        case HCI_OPCODE_HCI_LE_CONNECTION_UPDATE:
+            connection->conn_interval = little_endian_read_16(packet, 7);
+            connection->conn_latency = little_endian_read_16(packet, 9);
+            connection->supervision_timeout = little_endian_read_16(packet, 11);
+            event = virtual_event_alloc(HCI_EVENT_LE_META, 10);
+            if (event == NULL) break;
+            event[2] = HCI_SUBEVENT_LE_CONNECTION_UPDATE_COMPLETE;
+            little_endian_store_16(event, 4, handle);
+            little_endian_store_16(event, 6, connection->conn_interval);
+            little_endian_store_16(event, 8, connection->conn_latency);
+            little_endian_store_16(event, 10, connection->supervision_timeout);
+            break;
+        default:
+            btstack_unreachable();
+            break;
+    }
+}
+
+static void virtual_controller_handle_command(const uint8_t * packet, uint16_t size){
+    if (size < 3u) return;
+    uint16_t opcode = little_endian_read_16(packet, 0);
+    uint8_t return_params[249];
+    uint8_t * event;
+    memset(return_params, 0, sizeof(return_params));
+    switch (opcode){
+        case HCI_OPCODE_HCI_RESET:
+            virtual_controller_reset();
+            virtual_event_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_VERSION_INFORMATION:
+            return_params[1] = 0x09;
+            little_endian_store_16(return_params, 2, 0x0001);
+            return_params[4] = 0x09;
+            little_endian_store_16(return_params, 5, BLUETOOTH_COMPANY_ID_BLUEKITCHEN_GMBH);
+            little_endian_store_16(return_params, 7, 0x0001);
+            virtual_event_emit_command_complete(opcode, return_params, 9);
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_NAME:
+            (void) memcpy(&return_params[1], VIRTUAL_CONTROLLER_LOCAL_NAME, strlen(VIRTUAL_CONTROLLER_LOCAL_NAME));
+            virtual_event_emit_command_complete(opcode, return_params, 249);
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_COMMANDS:
+            // Read Buffer Size, Write LE Host Supported, LE Read Remote Features
+            return_params[1 + 14] = 1u << 7;
+            return_params[1 + 24] = 1u << 6;
+            return_params[1 + 27] = 1u << 5;
+            virtual_event_emit_command_complete(opcode, return_params, 65);
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_FEATURES:
+            (void) memcpy(&return_params[1], virtual_controller_features, 8);
+            virtual_event_emit_command_complete(opcode, return_params, 9);
+            break;
+        case HCI_OPCODE_HCI_READ_BD_ADDR:
+            reverse_bd_addr(virtual_config->bd_addr, &return_params[1]);
+            virtual_event_emit_command_complete(opcode, return_params, 7);
+            break;
+        case HCI_OPCODE_HCI_READ_BUFFER_SIZE:
+            little_endian_store_16(return_params, 1, virtual_config->acl_data_packet_length);
+            little_endian_store_16(return_params, 4, virtual_config->total_num_acl_data_packets);
+            virtual_event_emit_command_complete(opcode, return_params, 8);
+            break;
+        case HCI_OPCODE_HCI_LE_READ_BUFFER_SIZE:
+            little_endian_store_16(return_params, 1, virtual_config->le_acl_data_packet_length);
+            return_params[3] = virtual_config->total_num_le_acl_data_packets;
+            virtual_event_emit_command_complete(opcode, return_params, 4);
+            break;
+        case HCI_OPCODE_HCI_LE_RAND:
+            {
+                uint16_t i;
+                for (i = 1; i <= 8u; i++){
+                    return_params[i] = (uint8_t) rand();
+                }
+            }
+            virtual_event_emit_command_complete(opcode, return_params, 9);
+            break;
+        case HCI_OPCODE_HCI_WRITE_SCAN_ENABLE:
+            virtual_scan_enable = packet[3];
+            virtual_event_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            break;
+        case HCI_OPCODE_HCI_WRITE_CLASS_OF_DEVICE:
+            (void) memcpy(virtual_class_of_device, &packet[3], 3);
+            virtual_event_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            break;
+        case HCI_OPCODE_HCI_LE_SET_ADVERTISING_PARAMETERS:
+            virtual_le_advertising_type = packet[3 + 4];
+            virtual_event_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            break;
+        case HCI_OPCODE_HCI_LE_SET_ADVERTISING_DATA:
+            virtual_le_advertising_data_len = btstack_min(packet[3], sizeof(virtual_le_advertising_data));
+            (void) memcpy(virtual_le_advertising_data, &packet[4], virtual_le_advertising_data_len);
+            if (virtual_le_advertising_enabled){
+                virtual_link_send_advertising();
+            }
+            virtual_event_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            break;
+        case HCI_OPCODE_HCI_LE_SET_ADVERTISE_ENABLE:
+            virtual_le_advertising_enabled = packet[3] != 0u;
+            virtual_link_send_advertising();
+            virtual_event_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            break;
+        case HCI_OPCODE_HCI_LE_SET_SCAN_ENABLE:
+            virtual_le_scan_enabled = packet[3] != 0u;
+            virtual_event_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            if (virtual_le_scan_enabled && virtual_peer_advertising){
+                virtual_event_emit_advertising_report();
+            }
+            break;
+        case HCI_OPCODE_HCI_LE_CREATE_CONNECTION:
+            virtual_controller_handle_le_create_connection(packet);
+            break;
+        case HCI_OPCODE_HCI_LE_CREATE_CONNECTION_CANCEL:
+            virtual_controller_handle_le_create_connection_cancel(opcode);
+            break;
+        case HCI_OPCODE_HCI_CREATE_CONNECTION:
+            virtual_controller_handle_create_connection(packet);
+            break;
+        case HCI_OPCODE_HCI_ACCEPT_CONNECTION_REQUEST:
+            virtual_controller_handle_accept_connection_request(opcode, packet, true);
+            break;
+        case HCI_OPCODE_HCI_REJECT_CONNECTION_REQUEST:
+            virtual_controller_handle_accept_connection_request(opcode, packet, false);
+            break;
+        case HCI_OPCODE_HCI_DISCONNECT:
+            virtual_controller_handle_disconnect(packet);
+            break;
+        case HCI_OPCODE_HCI_READ_REMOTE_SUPPORTED_FEATURES_COMMAND:
+        case HCI_OPCODE_HCI_READ_REMOTE_EXTENDED_FEATURES_COMMAND:
+        case HCI_OPCODE_HCI_READ_REMOTE_VERSION_INFORMATION:
+        case HCI_OPCODE_HCI_LE_READ_REMOTE_USED_FEATURES:
+        case HCI_OPCODE_HCI_LE_CONNECTION_UPDATE:
+            virtual_controller_handle_connection_command(opcode, packet);
+            break;
+        case HCI_OPCODE_HCI_REMOTE_NAME_REQUEST:
+            virtual_event_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+            event = virtual_event_alloc(HCI_EVENT_REMOTE_NAME_REQUEST_COMPLETE, 255);
+            if (event == NULL) break;
+            (void) memcpy(&event[3], &packet[3], 6);
+            (void) memcpy(&event[9], VIRTUAL_CONTROLLER_LOCAL_NAME, strlen(VIRTUAL_CONTROLLER_LOCAL_NAME));
+            break;
+        case HCI_OPCODE_HCI_INQUIRY:
+            virtual_event_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+            event = virtual_event_alloc(HCI_EVENT_INQUIRY_COMPLETE, 1);
+            break;
+        case HCI_OPCODE_HCI_AUTHENTICATION_REQUESTED:
+        case HCI_OPCODE_HCI_SET_CONNECTION_ENCRYPTION:
+        case HCI_OPCODE_HCI_CHANGE_CONNECTION_PACKET_TYPE:
+        case HCI_OPCODE_HCI_READ_CLOCK_OFFSET:
+        case HCI_OPCODE_HCI_SETUP_SYNCHRONOUS_CONNECTION:
+        case HCI_OPCODE_HCI_ENHANCED_SETUP_SYNCHRONOUS_CONNECTION:
+        case HCI_OPCODE_HCI_SNIFF_MODE:
+        case HCI_OPCODE_HCI_EXIT_SNIFF_MODE:
+        case HCI_OPCODE_HCI_SWITCH_ROLE_COMMAND:
+        case HCI_OPCODE_HCI_LE_START_ENCRYPTION:
+        case HCI_OPCODE_HCI_LE_SET_PHY:
+        case HCI_OPCODE_HCI_LE_EXTENDED_CREATE_CONNECTION:
+            // not simulated, commands completed by an event fail
+            virtual_event_emit_command_status(opcode, ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE);
+            break;
+        default:
+            // configuration commands succeed
+            virtual_event_emit_command_complete(opcode, return_params, 8);
+            break;
+    }
+}
+
+static void virtual_controller_handle_acl_packet(const uint8_t * packet, uint16_t size){
+    if (size < HCI_ACL_HEADER_SIZE) return;
+    if (size > (HCI_ACL_HEADER_SIZE + HCI_ACL_PAYLOAD_SIZE)){
+        log_error("virtual controller: ACL packet too large, %u bytes", size);
+        return;
+    }
+    if (virtual_acl_queue_count == VIRTUAL_CONTROLLER_MAX_ACL_PACKETS){
+        log_error("virtual controller: ACL queue full, host ignored buffer count");
+        return;
+    }
+    uint16_t index = (virtual_acl_queue_head + virtual_acl_queue_count) % VIRTUAL_CONTROLLER_MAX_ACL_PACKETS;
+    virtual_acl_queue_count++;
+    virtual_acl_queue[index][0] = (uint8_t) VIRTUAL_LINK_MESSAGE_ACL;
+    (void) memcpy(&virtual_acl_queue[index][1], packet, size);
+    virtual_acl_queue_len[index] = 1u + size;
+    virtual_controller_timer_start(0);
+}
+
+// messages from peer
+
+static void virtual_link_handle_advertising(const uint8_t * message, uint16_t size){
+    if (size < 10u) return;
+    virtual_peer_advertising = message[0] != 0u;
+    virtual_peer_advertising_connectable = message[1] != 0u;
+    virtual_peer_advertising_type = message[2];
+    bd_addr_copy(virtual_peer_address, &message[3]);
+    virtual_peer_advertising_data_len = btstack_min(message[9], btstack_min(size - 10u, sizeof(virtual_peer_advertising_data)));
+    (void) memcpy(virtual_peer_advertising_data, &message[10], virtual_peer_advertising_data_len);
+    if (virtual_peer_advertising == false) return;
+    if (virtual_le_scan_enabled){
+        virtual_event_emit_advertising_report();
+    }
+    // pending LE Create Connection
+    virtual_connection_t * connection = virtual_connection_for_state(VIRTUAL_CONNECTION_W4_CONNECT_COMPLETE, true);
+    if ((connection != NULL) && virtual_peer_advertising_connectable){
+        virtual_link_send_le_connect(connection);
+    }
+}
+
+static void virtual_link_handle_le_connect(const uint8_t * message, uint16_t size){
+    if (size < 14u) return;
+    // ignore if not connectable, initiator retries when advertising gets enabled
+    if (virtual_le_advertising_enabled == false) return;
+    bool connectable = (virtual_le_advertising_type == 0x00u) || (virtual_le_advertising_type == 0x01u) || (virtual_le_advertising_type == 0x04u);
+    if (connectable == false) return;
+    bd_addr_t address;
+    bd_addr_copy(address, &message[2]);
+    virtual_connection_t * connection = virtual_connection_create(true, address);
+    uint8_t * reply = virtual_link_message_alloc(VIRTUAL_LINK_MESSAGE_LE_CONNECT_COMPLETE, 11);
+    if (reply == NULL){
+        if (connection != NULL){
+            connection->state = VIRTUAL_CONNECTION_FREE;
+        }
+        return;
+    }
+    little_endian_store_16(reply, 1, little_endian_read_16(message, 0));
+    bd_addr_copy(&reply[5], virtual_config->bd_addr);
+    if (connection == NULL){
+        reply[0] = ERROR_CODE_CONNECTION_LIMIT_EXCEEDED;
+        little_endian_store_16(reply, 3, HCI_CON_HANDLE_INVALID);
+        return;
+    }
+    reply[0] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(reply, 3, connection->handle);
+    connection->state = VIRTUAL_CONNECTION_OPEN;
+    connection->remote_handle = little_endian_read_16(message, 0);
+    connection->conn_interval = little_endian_read_16(message, 8);
+    connection->conn_latency = little_endian_read_16(message, 10);
+    connection->supervision_timeout = little_endian_read_16(message, 12);
+    // advertising stops on connection
+    virtual_le_advertising_enabled = false;
+    virtual_link_send_advertising();
+    virtual_event_emit_le_connection_complete(ERROR_CODE_SUCCESS, connection, HCI_ROLE_SLAVE);
+}
+
+static void virtual_link_handle_le_connect_complete(const uint8_t * message, uint16_t size){
+    if (size < 11u) return;
+    virtual_connection_t * connection = virtual_connection_for_handle(little_endian_read_16(message, 1));
+    if ((connection == NULL) || (connection->state != VIRTUAL_CONNECTION_W4_CONNECT_COMPLETE)) return;
+    uint8_t status = message[0];
+    bd_addr_copy(connection->address, &message[5]);
+    virtual_event_emit_le_connection_complete(status, connection, HCI_ROLE_MASTER);
+    if (status != ERROR_CODE_SUCCESS){
+        virtual_connection_free(connection);
+        return;
+    }
+    connection->state = VIRTUAL_CONNECTION_OPEN;
+    connection->remote_handle = little_endian_read_16(message, 3);
+}
+
+static void virtual_link_handle_connect(const uint8_t * message, uint16_t size){
+    if (size < 11u) return;
+    hci_con_handle_t initiator_handle = little_endian_read_16(message, 0);
+    // page scan disabled
+    if ((virtual_scan_enable & 0x02u) == 0u){
+        virtual_link_send_connect_complete(ERROR_CODE_PAGE_TIMEOUT, initiator_handle, HCI_CON_HANDLE_INVALID);
+        return;
+    }
+    bd_addr_t address;
+    bd_addr_copy(address, &message[2]);
+    virtual_connection_t * connection = virtual_connection_create(false, address);
+    if (connection == NULL){
+        virtual_link_send_connect_complete(ERROR_CODE_CONNECTION_LIMIT_EXCEEDED, initiator_handle, HCI_CON_HANDLE_INVALID);
+        return;
+    }
+    connection->state = VIRTUAL_CONNECTION_W4_ACCEPT;
+    connection->remote_handle = initiator_handle;
+    uint8_t * event = virtual_event_alloc(HCI_EVENT_CONNECTION_REQUEST, 10);
+    if (event == NULL) return;
+    reverse_bd_addr(address, &event[2]);
+    (void) memcpy(&event[8], &message[8], 3);
+    event[11] = 0x01;   // ACL
+}
+
+static void virtual_link_handle_connect_complete(const uint8_t * message, uint16_t size){
+    if (size < 5u) return;
+    virtual_connection_t * connection = virtual_connection_for_handle(little_endian_read_16(message, 1));
+    if ((connection == NULL) || (connection->state != VIRTUAL_CONNECTION_W4_CONNECT_COMPLETE)) return;
+    uint8_t status = message[0];
+    virtual_event_emit_connection_complete(status, connection);
+    if (status != ERROR_CODE_SUCCESS){
+        virtual_connection_free(connection);
+        return;
+    }
+    connection->state = VIRTUAL_CONNECTION_OPEN;
+    connection->remote_handle = little_endian_read_16(message, 3);
+}
+
+static void virtual_link_handle_disconnect(const uint8_t * message, uint16_t size){
+    if (size < 3u) return;
+    hci_con_handle_t handle = little_endian_read_16(message, 0);
+    virtual_connection_t * connection = virtual_connection_for_handle(handle);
+    if (connection == NULL) return;
+    virtual_event_emit_disconnection_complete(handle, message[2]);
+    virtual_connection_free(connection);
+}
+
+static void virtual_link_handle_acl(uint8_t * packet, uint16_t size){
+    if (size < HCI_ACL_HEADER_SIZE) return;
+    hci_con_handle_t handle = little_endian_read_16(packet, 0) & 0x0fffu;
+    virtual_connection_t * connection = virtual_connection_for_handle(handle);
+    if ((connection == NULL) || (connection->state != VIRTUAL_CONNECTION_OPEN)) return;
+    // events like Connection Complete have to be delivered first
+    virtual_event_deliver_all();
+    packet_handler(HCI_ACL_DATA_PACKET, packet, size);
+}
+
+static void virtual_link_process(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    uint8_t * packet = &virtual_rx_buffer[1 + HCI_INCOMING_PRE_BUFFER_SIZE];
+    uint16_t i;
+    for (i = 0; i < VIRTUAL_CONTROLLER_MAX_READS_PER_CALLBACK; i++){
+        ssize_t res = recv(ds->source.fd, &virtual_rx_buffer[HCI_INCOMING_PRE_BUFFER_SIZE], 1 + HCI_INCOMING_PACKET_BUFFER_SIZE, 0);
+        if (res < 0){
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) break;
+            log_error("virtual controller: link read failed, errno %d", errno);
+            btstack_run_loop_disable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
+            break;
+        }
+        if (res == 0){
+            log_info("virtual controller: link closed by peer");
+            btstack_run_loop_disable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
+            break;
+        }
+        virtual_rx_message_type = virtual_rx_buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
+        uint16_t size = (uint16_t) (res - 1);
+        switch ((virtual_link_message_type_t) virtual_rx_message_type){
+            case VIRTUAL_LINK_MESSAGE_ADVERTISING:
+                virtual_link_handle_advertising(packet, size);
+                break;
+            case VIRTUAL_LINK_MESSAGE_LE_CONNECT:
+                virtual_link_handle_le_connect(packet, size);
+                break;
+            case VIRTUAL_LINK_MESSAGE_LE_CONNECT_COMPLETE:
+                virtual_link_handle_le_connect_complete(packet, size);
+                break;
+            case VIRTUAL_LINK_MESSAGE_CONNECT:
+                virtual_link_handle_connect(packet, size);
+                break;
+            case VIRTUAL_LINK_MESSAGE_CONNECT_COMPLETE:
+                virtual_link_handle_connect_complete(packet, size);
+                break;
+            case VIRTUAL_LINK_MESSAGE_DISCONNECT:
+                virtual_link_handle_disconnect(packet, size);
+                break;
+            case VIRTUAL_LINK_MESSAGE_ACL:
+                virtual_link_handle_acl(packet, size);
+                break;
+            default:
+                log_error("virtual controller: unknown message type %u", virtual_rx_message_type);
+                break;
+        }
+    }
+    virtual_event_deliver_all();
+}
+
+// HCI Transport API
+
+static void hci_transport_virtual_posix_init(const void * transport_config){
+    virtual_config = (const hci_transport_virtual_posix_config_t *) transport_config;
+    btstack_assert(virtual_config != NULL);
+    if ((virtual_config->total_num_acl_data_packets + virtual_config->total_num_le_acl_data_packets) > VIRTUAL_CONTROLLER_MAX_ACL_PACKETS){
+        log_error("virtual controller: more than %u ACL buffers configured", VIRTUAL_CONTROLLER_MAX_ACL_PACKETS);
+    }
+}
+
+static int hci_transport_virtual_posix_open(void){
+    virtual_controller_reset();
+    virtual_peer_advertising = false;
+    virtual_event_queue_count = 0;
+    virtual_message_queue_count = 0;
+    if (virtual_link_available()){
+        int flags = fcntl(virtual_config->link_fd, F_GETFL, 0);
+        if (fcntl(virtual_config->link_fd, F_SETFL, flags | O_NONBLOCK) < 0){
+            log_error("virtual controller: cannot set link to non-blocking");
+            return -1;
+        }
+        btstack_run_loop_set_data_source_fd(&virtual_link_data_source, virtual_config->link_fd);
+        btstack_run_loop_set_data_source_handler(&virtual_link_data_source, &virtual_link_process);
+        btstack_run_loop_enable_data_source_callbacks(&virtual_link_data_source, DATA_SOURCE_CALLBACK_READ);
+        btstack_run_loop_add_data_source(&virtual_link_data_source);
+    }
+    return 0;
+}
+
+static int hci_transport_virtual_posix_close(void){
+    if (virtual_link_available()){
+        btstack_run_loop_remove_data_source(&virtual_link_data_source);
+    }
+    if (virtual_controller_timer_active){
+        btstack_run_loop_remove_timer(&virtual_controller_timer);
+        virtual_controller_timer_active = false;
+    }
+    return 0;
+}
+
+static void hci_transport_virtual_posix_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static int hci_transport_virtual_posix_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    switch (packet_type){
+        case HCI_COMMAND_DATA_PACKET:
+            virtual_controller_handle_command(packet, (uint16_t) size);
+            break;
+        case HCI_ACL_DATA_PACKET:
+            virtual_controller_handle_acl_packet(packet, (uint16_t) size);
+            break;
+        default:
+            log_info("virtual controller: packet type 0x%02x not supported", packet_type);
+            break;
+    }
+    return 0;
+}
+
+static const hci_transport_t hci_transport_virtual_posix = {
+    /* const char * name; */                                        "VIRTUAL",
+    /* void   (*init) (const void *transport_config); */            &hci_transport_virtual_posix_init,
+    /* int    (*open)(void); */                                     &hci_transport_virtual_posix_open,
+    /* int    (*close)(void); */                                    &hci_transport_virtual_posix_close,
+    /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_virtual_posix_register_packet_handler,
+    /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+    /* int    (*send_packet)(...); */                               &hci_transport_virtual_posix_send_packet,
+    /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+    /* void   (*reset_link)(void); */                               NULL,
+    /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+const hci_transport_t * hci_transport_virtual_posix_instance(void){
+    return &hci_transport_virtual_posix;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+/*
+ *  HCI Transport with a minimal simulated Controller, e.g. for benchmarks without Bluetooth hardware
+ *
+ *  Two virtual Controllers are linked by a connected SOCK_SEQPACKET socket, e.g. from socketpair(),
+ *  and support LE advertising/scanning, LE and Classic ACL connections between each other, and
+ *  ACL data transfer limited by the configured buffers and link rate.
+ */
+
+#ifndef HCI_TRANSPORT_VIRTUAL_POSIX_H
+#define HCI_TRANSPORT_VIRTUAL_POSIX_H
+
+#include <stdint.h>
+#include "bluetooth.h"
+#include "hci_transport.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    // public address returned by Read BD_ADDR
+    bd_addr_t bd_addr;
+    // Classic ACL buffers returned by Read Buffer Size
+    uint16_t  acl_data_packet_length;
+    uint16_t  total_num_acl_data_packets;
+    // LE ACL buffers returned by LE Read Buffer Size
+    uint16_t  le_acl_data_packet_length;
+    uint8_t   total_num_le_acl_data_packets;
+    // ACL data sent to peer Controller per second in bits, 0 = no limit
+    uint32_t  link_rate_bps;
+    // connected SOCK_SEQPACKET socket to peer virtual Controller, or -1
+    int       link_fd;
+} hci_transport_virtual_posix_config_t;
+
+/**
+ * @brief Get HCI Transport with virtual Controller, pass hci_transport_virtual_posix_config_t to hci_init
+ * @return hci_transport
+ */
+const hci_transport_t * hci_transport_virtual_posix_instance(void);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // HCI_TRANSPORT_VIRTUAL_POSIX_H
@@ -45,6 +45,12 @@
 #include "btstack_debug.h"
 #include "btstack_util.h"
 
+#ifdef ENABLE_ATT_DB_INDEX
+#ifndef ATT_DB_INDEX_SIZE
+#define ATT_DB_INDEX_SIZE 256
+#endif
+#endif
+
 // check for ENABLE_ATT_DELAYED_READ_RESPONSE -> ENABLE_ATT_DELAYED_RESPONSE,
 #ifdef ENABLE_ATT_DELAYED_READ_RESPONSE
     #error "ENABLE_ATT_DELAYED_READ_RESPONSE was replaced by ENABLE_ATT_DELAYED_RESPONSE. Please update btstack_config.h"
@@ -107,6 +113,17 @@ static uint16_t att_prepare_write_error_handle = 0x0000;
 static uint16_t att_persistent_ccc_handle;
 static uint16_t att_persistent_ccc_uuid16;
 
+#ifdef ENABLE_ATT_DB_INDEX
+// offsets of attributes in db order. attributes added after att_set_db, e.g. by att_db_util,
+// are indexed on first lookup of an unknown handle
+static uint16_t att_db_index_offsets[ATT_DB_INDEX_SIZE];
+static uint16_t att_db_index_count;
+// offset of first attribute not in index
+static uint16_t att_db_index_end;
+// handles in db are strictly increasing, required for binary search
+static bool     att_db_index_sorted;
+#endif
+
 static void att_iterator_init(att_iterator_t *it){
     it->att_ptr = att_database;
 }
@@ -174,10 +191,109 @@ static bool att_iterator_match_uuid(att_iterator_t *it, uint8_t *uuid, uint16_t
 }
 
 
+#ifdef ENABLE_ATT_DB_INDEX
+
+static void att_db_index_reset(void){
+    att_db_index_count = 0;
+    att_db_index_end = 0;
+    att_db_index_sorted = true;
+}
+
+static uint16_t att_db_index_handle_for_entry(uint16_t index){
+    return little_endian_read_16(att_database, att_db_index_offsets[index] + 4u);
+}
+
+static void att_db_index_fetch(att_iterator_t *it, uint16_t offset){
+    it->att_ptr = &att_database[offset];
+    att_iterator_fetch_next(it);
+}
+
+// add attributes after att_db_index_end to index until handle was found, db end was reached, or index is full
+static bool att_db_index_extend(att_iterator_t *it, uint16_t handle){
+    if (att_database == NULL){
+        return false;
+    }
+    while (att_db_index_count < (uint16_t) ATT_DB_INDEX_SIZE){
+        uint16_t offset = att_db_index_end;
+        uint16_t size = little_endian_read_16(att_database, offset);
+        if (size == 0u){
+            return false;
+        }
+        // offset of next entry must fit into index
+        if (((uint32_t) offset + size) > 0xffffu){
+            break;
+        }
+        uint16_t entry_handle = little_endian_read_16(att_database, offset + 4u);
+        if ((att_db_index_count > 0u) && (entry_handle <= att_db_index_handle_for_entry(att_db_index_count - 1u))){
+            att_db_index_sorted = false;
+        }
+        att_db_index_offsets[att_db_index_count++] = offset;
+        att_db_index_end = offset + size;
+        if (entry_handle == handle){
+            att_db_index_fetch(it, offset);
+            return true;
+        }
+    }
+    // index full, search remaining attributes
+    it->att_ptr = &att_database[att_db_index_end];
+    while (att_iterator_has_next(it)){
+        att_iterator_fetch_next(it);
+        if (it->handle == handle){
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool att_db_index_find_handle(att_iterator_t *it, uint16_t handle){
+    if (att_db_index_count > 0u){
+        if (att_db_index_sorted){
+            // handles are usually consecutive, try direct hit first
+            uint16_t first_handle = att_db_index_handle_for_entry(0);
+            if (handle >= first_handle){
+                uint16_t index = handle - first_handle;
+                if ((index < att_db_index_count) && (att_db_index_handle_for_entry(index) == handle)){
+                    att_db_index_fetch(it, att_db_index_offsets[index]);
+                    return true;
+                }
+            }
+            // binary search
+            uint16_t low  = 0;
+            uint16_t high = att_db_index_count;
+            while (low < high){
+                uint16_t mid = low + ((high - low) / 2u);
+                uint16_t mid_handle = att_db_index_handle_for_entry(mid);
+                if (mid_handle == handle){
+                    att_db_index_fetch(it, att_db_index_offsets[mid]);
+                    return true;
+                }
+                if (mid_handle < handle){
+                    low = mid + 1u;
+                } else {
+                    high = mid;
+                }
+            }
+        } else {
+            uint16_t index;
+            for (index = 0; index < att_db_index_count; index++){
+                if (att_db_index_handle_for_entry(index) == handle){
+                    att_db_index_fetch(it, att_db_index_offsets[index]);
+                    return true;
+                }
+            }
+        }
+    }
+    return att_db_index_extend(it, handle);
+}
+#endif
+
 static bool att_find_handle(att_iterator_t *it, uint16_t handle){
     if (handle == 0u){
         return false;
     }
+#ifdef ENABLE_ATT_DB_INDEX
+    return att_db_index_find_handle(it, handle);
+#else
     att_iterator_init(it);
     while (att_iterator_has_next(it)){
         att_iterator_fetch_next(it);
@@ -186,6 +302,7 @@ static bool att_find_handle(att_iterator_t *it, uint16_t handle){
         }
     }
     return false;
+#endif
 }
 
 // experimental client API
@@ -250,6 +367,11 @@ void att_set_db(uint8_t const * db){
     log_info("att_set_db %p", db);
     // ignore db version
     att_database = &db[1];
+#ifdef ENABLE_ATT_DB_INDEX
+    att_db_index_reset();
+    att_iterator_t it;
+    (void) att_db_index_extend(&it, 0);
+#endif
 }
 
 void att_set_read_callback(att_read_callback_t callback){
@@ -77,6 +77,13 @@
 #define NVN_NUM_GATT_SERVER_CCC 20
 #endif
 
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+// max number of values packed into a single Multiple Handle Value Notification
+#ifndef ATT_SERVER_MULTIPLE_NOTIFICATION_MAX_VALUES
+#define ATT_SERVER_MULTIPLE_NOTIFICATION_MAX_VALUES 16
+#endif
+#endif
+
 #define ATT_SERVICE_FLAGS_DELAYED_RESPONSE (1u<<0u)
 
 static void att_run_for_context(att_server_t * att_server, att_connection_t * att_connection);
@@ -116,6 +123,12 @@ static hci_con_handle_t att_server_last_can_send_now = HCI_CON_HANDLE_INVALID;
 
 static uint8_t att_server_flags;
 
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+static bool att_server_notification_coalescing;
+static bool att_server_notification_flush_scheduled;
+static btstack_context_callback_registration_t att_server_notification_flush_registration;
+#endif
+
 #ifdef ENABLE_GATT_OVER_EATT
 static att_server_eatt_bearer_t * att_server_eatt_bearer_for_con_handle(hci_con_handle_t con_handle);
 static btstack_linked_list_t att_server_eatt_bearer_pool;
@@ -327,6 +340,14 @@ static void att_server_event_packet_handler (uint8_t packet_type, uint16_t chann
                             att_server->ir_le_device_db_index = sm_le_device_index(con_handle);
                             att_server->ir_lookup_active = false;
                             att_server->pairing_active = false;
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+                            att_server->multiple_notifications_supported = false;
+                            att_server->notification_queue_len = 0;
+                            att_server->notifications_queued = 0;
+                            att_server->notifications_rejected = 0;
+                            att_server->notification_pdus_sent = 0;
+                            att_server->notification_pdus_saved = 0;
+#endif
                             // notify all - new
                             att_emit_connected_event(att_server, att_connection);
                             break;
@@ -1025,6 +1046,17 @@ static void att_server_dispatch_packet_handler(uint8_t packet_type, uint16_t cha
 
 // ---------------------
 // persistent CCC writes
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+static void att_server_track_client_supported_features(att_server_t * att_server, uint16_t attribute_handle, const uint8_t * value, uint16_t value_len){
+    if (value_len == 0u) return;
+    if (att_uuid_for_handle(attribute_handle) != GATT_CLIENT_SUPPORTED_FEATURES) return;
+    // client cannot clear bits once set
+    if ((value[0] & GATT_CLIENT_SUPPORTED_FEATURES_MULTIPLE_HANDLE_VALUE_NOTIFICATIONS) != 0u){
+        att_server->multiple_notifications_supported = true;
+    }
+}
+#endif
+
 static uint32_t att_server_persistent_ccc_tag_for_index(uint8_t index){
     return (((uint8_t)'B') << 24u) | (((uint8_t)'T') << 16u) | (((uint8_t)'C') << 8u) | index;
 }
@@ -1170,6 +1202,9 @@ static void att_server_persistent_ccc_restore(att_server_t * att_server, att_con
         uint16_t attribute_handle = entry.att_handle;
         uint8_t  value[2];
         little_endian_store_16(value, 0, entry.value);
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+        att_server_track_client_supported_features(att_server, attribute_handle, value, sizeof(value));
+#endif
         att_write_callback_t callback = att_server_write_callback_for_handle(attribute_handle);
         if (!callback) continue;
         log_info("CCC Index %u: Set Attribute handle 0x%04x to value 0x%04x", index, attribute_handle, entry.value );
@@ -1268,6 +1303,13 @@ static int att_server_write_callback(hci_con_handle_t con_handle, uint16_t attri
         att_server_persistent_ccc_write(con_handle, attribute_handle, little_endian_read_16(buffer, 0));
     }
 
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+    hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
+    if ((hci_connection != NULL) && (offset == 0u)){
+        att_server_track_client_supported_features(&hci_connection->att_server, attribute_handle, buffer, buffer_size);
+    }
+#endif
+
     att_write_callback_t callback = att_server_write_callback_for_handle(attribute_handle);
     if (!callback) return 0;
     return (*callback)(con_handle, attribute_handle, transaction_mode, offset, buffer, buffer_size);
@@ -1412,11 +1454,148 @@ static uint8_t att_server_prepare_server_message(hci_con_handle_t con_handle, at
     return ERROR_CODE_SUCCESS;
 }
 
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+// send queued notifications, packed into a Multiple Handle Value Notification if supported by client
+static void att_server_notification_queue_send(void * context){
+    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) context;
+    hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
+    if (hci_connection == NULL) return;
+    att_server_t * att_server = &hci_connection->att_server;
+    att_connection_t * att_connection = &hci_connection->att_connection;
+    if (att_server->notification_queue_len == 0u) return;
+
+    uint16_t attribute_handles[ATT_SERVER_MULTIPLE_NOTIFICATION_MAX_VALUES];
+    const uint8_t * values_data[ATT_SERVER_MULTIPLE_NOTIFICATION_MAX_VALUES];
+    uint16_t values_len[ATT_SERVER_MULTIPLE_NOTIFICATION_MAX_VALUES];
+    uint8_t num_values = 0;
+    uint16_t queue_offset = 0;
+
+    // collect values that fit into a single PDU, same limit as att_prepare_handle_value_multiple_notification
+    if (att_server->multiple_notifications_supported){
+        uint16_t pdu_len = 1;
+        while ((queue_offset < att_server->notification_queue_len) && (num_values < ATT_SERVER_MULTIPLE_NOTIFICATION_MAX_VALUES)){
+            uint16_t value_len = little_endian_read_16(att_server->notification_queue, queue_offset + 2u);
+            if ((pdu_len + 4u + value_len) > (att_connection->mtu - 3u)) break;
+            attribute_handles[num_values] = little_endian_read_16(att_server->notification_queue, queue_offset);
+            values_data[num_values] = &att_server->notification_queue[queue_offset + 4u];
+            values_len[num_values] = value_len;
+            num_values++;
+            pdu_len += 4u + value_len;
+            queue_offset += 4u + value_len;
+        }
+    }
+
+    l2cap_reserve_packet_buffer();
+    uint8_t * packet_buffer = l2cap_get_outgoing_buffer();
+    uint16_t size;
+    if (num_values > 1u){
+        size = att_prepare_handle_value_multiple_notification(att_connection, num_values, attribute_handles, values_data, values_len, packet_buffer);
+        att_server->notification_pdus_saved += num_values - 1u;
+    } else {
+        uint16_t attribute_handle = little_endian_read_16(att_server->notification_queue, 0);
+        uint16_t value_len = little_endian_read_16(att_server->notification_queue, 2);
+        size = att_prepare_handle_value_notification(att_connection, attribute_handle, &att_server->notification_queue[4], value_len, packet_buffer);
+        queue_offset = 4u + value_len;
+    }
+    att_server->notification_pdus_sent++;
+    (void) att_server_send_prepared(att_server, att_connection, packet_buffer, size);
+
+    // drop sent notifications
+    att_server->notification_queue_len -= queue_offset;
+    (void) memmove(att_server->notification_queue, &att_server->notification_queue[queue_offset], att_server->notification_queue_len);
+
+    // send remaining notifications back-to-back if possible
+    if (att_server->notification_queue_len > 0u){
+        (void) att_server_request_to_send_notification(&att_server->notification_queue_request, con_handle);
+    }
+}
+
+// request to send for all connections with queued notifications
+static void att_server_notification_queue_flush(void * context){
+    UNUSED(context);
+    att_server_notification_flush_scheduled = false;
+    btstack_linked_list_iterator_t it;
+    hci_connections_get_iterator(&it);
+    while(btstack_linked_list_iterator_has_next(&it)){
+        hci_connection_t * hci_connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
+        att_server_t * att_server = &hci_connection->att_server;
+        if (att_server->notification_queue_len == 0u) continue;
+        att_server->notification_queue_request.callback = &att_server_notification_queue_send;
+        att_server->notification_queue_request.context = (void *) (uintptr_t) hci_connection->con_handle;
+        (void) att_server_request_to_send_notification(&att_server->notification_queue_request, hci_connection->con_handle);
+    }
+}
+
+// @return true if notification was queued or rejected, false if it should be sent directly
+static bool att_server_notification_queue_add(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value,
+                                              uint16_t value_len, uint8_t * out_status){
+#ifdef ENABLE_GATT_OVER_EATT
+    // notifications over enhanced bearer are sent directly
+    if (att_server_eatt_bearer_for_con_handle(con_handle) != NULL) return false;
+#endif
+    hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
+    if (hci_connection == NULL){
+        *out_status = ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+        return true;
+    }
+    att_server_t * att_server = &hci_connection->att_server;
+    att_connection_t * att_connection = &hci_connection->att_connection;
+
+    // value is truncated to ATT_MTU-3 as for regular notifications
+    value_len = btstack_min(value_len, att_connection->mtu - 3u);
+    uint16_t entry_len = 4u + value_len;
+    if ((att_server->notification_queue_len + entry_len) > ATT_SERVER_NOTIFICATION_QUEUE_SIZE){
+        att_server->notifications_rejected++;
+        *out_status = BTSTACK_ACL_BUFFERS_FULL;
+        return true;
+    }
+
+    uint8_t * entry = &att_server->notification_queue[att_server->notification_queue_len];
+    little_endian_store_16(entry, 0, attribute_handle);
+    little_endian_store_16(entry, 2, value_len);
+    (void) memcpy(&entry[4], value, value_len);
+    att_server->notification_queue_len += entry_len;
+    att_server->notifications_queued++;
+
+    // collect all notifications from current run loop iteration
+    if (att_server_notification_flush_scheduled == false){
+        att_server_notification_flush_scheduled = true;
+        att_server_notification_flush_registration.callback = &att_server_notification_queue_flush;
+        btstack_run_loop_execute_on_main_thread(&att_server_notification_flush_registration);
+    }
+
+    *out_status = ERROR_CODE_SUCCESS;
+    return true;
+}
+
+void att_server_enable_notification_coalescing(bool enabled){
+    att_server_notification_coalescing = enabled;
+}
+
+uint8_t att_server_get_notification_counters(hci_con_handle_t con_handle, att_server_notification_counters_t * counters){
+    hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
+    if (hci_connection == NULL) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    const att_server_t * att_server = &hci_connection->att_server;
+    counters->notifications_queued   = att_server->notifications_queued;
+    counters->notifications_rejected = att_server->notifications_rejected;
+    counters->pdus_sent              = att_server->notification_pdus_sent;
+    counters->pdus_saved             = att_server->notification_pdus_saved;
+    return ERROR_CODE_SUCCESS;
+}
+#endif
+
 uint8_t att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value, uint16_t value_len){
     att_server_t * att_server = NULL;
     att_connection_t * att_connection = NULL;
     uint8_t * packet_buffer = NULL;
 
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+    uint8_t queue_status;
+    if (att_server_notification_coalescing && att_server_notification_queue_add(con_handle, attribute_handle, value, value_len, &queue_status)){
+        return queue_status;
+    }
+#endif
+
     uint8_t status = att_server_prepare_server_message(con_handle, &att_server, &att_connection, &packet_buffer);
     if (status != ERROR_CODE_SUCCESS){
         return status;
@@ -1496,6 +1675,10 @@ void att_server_deinit(void){
     att_client_packet_handler = NULL;
     service_handlers = NULL;
     att_server_flags = 0;
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+    att_server_notification_coalescing = false;
+    att_server_notification_flush_scheduled = false;
+#endif
 }
 
 #ifdef ENABLE_GATT_OVER_EATT
@@ -165,6 +165,37 @@ uint8_t att_server_multiple_notify(hci_con_handle_t con_handle, uint8_t num_attr
  */
 uint8_t att_server_indicate(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value, uint16_t value_len);
 
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+typedef struct {
+    // notifications accepted by att_server_notify
+    uint32_t notifications_queued;
+    // notifications rejected with BTSTACK_ACL_BUFFERS_FULL as queue was full
+    uint32_t notifications_rejected;
+    // Handle Value Notification and Multiple Handle Value Notification PDUs sent
+    uint32_t pdus_sent;
+    // PDUs saved by packing notifications into Multiple Handle Value Notifications
+    uint32_t pdus_saved;
+} att_server_notification_counters_t;
+
+/**
+ * @brief Enable notification coalescing. If enabled, att_server_notify queues notifications per connection
+ * and returns BTSTACK_ACL_BUFFERS_FULL only if the queue is full. Queued notifications are sent on the next
+ * run loop iteration as ATT Multiple Handle Value Notifications if the client has set the corresponding bit in
+ * its Client Supported Features, and as back-to-back Handle Value Notifications otherwise.
+ * @note not used for Enhanced ATT bearers
+ * @param enabled
+ */
+void att_server_enable_notification_coalescing(bool enabled);
+
+/**
+ * @brief Get notification coalescing counters for connection
+ * @param con_handle
+ * @param counters
+ * @return ERROR_CODE_SUCCESS if ok, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER if handle unknown
+ */
+uint8_t att_server_get_notification_counters(hci_con_handle_t con_handle, att_server_notification_counters_t * counters);
+#endif
+
 #ifdef ENABLE_ATT_DELAYED_RESPONSE
 /**
  * @brief response ready - called after returning ATT_READ__RESPONSE_PENDING in an att_read_callback or
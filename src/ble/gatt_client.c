@@ -53,6 +53,7 @@
 #include "btstack_event.h"
 #include "btstack_memory.h"
 #include "btstack_run_loop.h"
+#include "btstack_tlv.h"
 #include "btstack_util.h"
 #include "hci.h"
 #include "hci_dump.h"
@@ -70,6 +71,90 @@
 // L2CAP Test Spec p35 defines a minimum of 100 ms, but PTS might indicate an error if we sent after 100 ms
 #define GATT_CLIENT_COLLISION_BACKOFF_MS 150
 
+#ifdef ENABLE_GATT_CLIENT_CACHE
+
+// number of LE connections with a GATT Client Cache at the same time
+#ifndef MAX_NR_GATT_CLIENT_CACHES
+#define MAX_NR_GATT_CLIENT_CACHES 1
+#endif
+
+// max number of services, characteristics and descriptors per remote GATT Server
+#ifndef GATT_CLIENT_CACHE_MAX_ENTRIES
+#define GATT_CLIENT_CACHE_MAX_ENTRIES 64
+#endif
+
+// entries are stored in groups to keep TLV values small, e.g. for Flash Bank TLV
+#ifndef GATT_CLIENT_CACHE_ENTRIES_PER_TAG
+#define GATT_CLIENT_CACHE_ENTRIES_PER_TAG 6
+#endif
+
+#define GATT_CLIENT_CACHE_NUM_ENTRY_TAGS ((GATT_CLIENT_CACHE_MAX_ENTRIES + GATT_CLIENT_CACHE_ENTRIES_PER_TAG - 1) / GATT_CLIENT_CACHE_ENTRIES_PER_TAG)
+#if GATT_CLIENT_CACHE_NUM_ENTRY_TAGS > 255
+#error "GATT_CLIENT_CACHE_MAX_ENTRIES / GATT_CLIENT_CACHE_ENTRIES_PER_TAG too large"
+#endif
+
+typedef enum {
+    GATT_CLIENT_CACHE_IDLE,
+    GATT_CLIENT_CACHE_BUILDING,
+    GATT_CLIENT_CACHE_W4_DATABASE_HASH,
+    GATT_CLIENT_CACHE_ACTIVE,
+    GATT_CLIENT_CACHE_DISABLED,
+} gatt_client_cache_state_t;
+
+typedef enum {
+    GATT_CLIENT_CACHE_ENTRY_SERVICE = 1,
+    GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC,
+    GATT_CLIENT_CACHE_ENTRY_DESCRIPTOR,
+} gatt_client_cache_entry_type_t;
+
+// header: all primary services have been discovered
+#define GATT_CLIENT_CACHE_FLAG_SERVICES_COMPLETE 0x01u
+// entry: all characteristics of a service or all descriptors of a characteristic have been discovered
+#define GATT_CLIENT_CACHE_FLAG_COMPLETE          0x01u
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  flags;
+    uint16_t properties;
+    uint16_t start_handle;  // service start, characteristic declaration, or descriptor handle
+    uint16_t value_handle;
+    uint16_t end_handle;
+    uint8_t  uuid128[16];
+} gatt_client_cache_entry_t;
+
+// stored in TLV tag part 0, followed by entries in parts 1..GATT_CLIENT_CACHE_NUM_ENTRY_TAGS
+typedef struct {
+    uint8_t   database_hash[16];
+    uint8_t   identity_addr_type;
+    bd_addr_t identity_addr;
+    uint8_t   flags;
+    uint16_t  num_entries;
+} gatt_client_cache_header_t;
+
+typedef struct {
+    gatt_client_cache_header_t header;
+    gatt_client_cache_entry_t  entries[GATT_CLIENT_CACHE_MAX_ENTRIES];
+} gatt_client_cache_storage_t;
+
+typedef struct {
+    hci_con_handle_t          con_handle;
+    gatt_client_cache_state_t state;
+    int                       le_device_index;
+    bool                      dirty;
+    // entries were recorded before Database Hash was read
+    bool                      building;
+    uint16_t                  database_hash_value_handle;
+    gatt_client_cache_storage_t storage;
+} gatt_client_cache_t;
+
+static gatt_client_cache_t gatt_client_caches[MAX_NR_GATT_CLIENT_CACHES];
+
+static void gatt_client_cache_provide_for_handle(hci_con_handle_t con_handle);
+static void gatt_client_cache_emit_query_results(gatt_client_t * gatt_client);
+static void gatt_client_emit_events(void * context);
+static void gatt_client_handle_transaction_complete(gatt_client_t *gatt_client, uint8_t att_status);
+#endif
+
 static btstack_linked_list_t gatt_client_connections;
 static btstack_linked_list_t gatt_client_value_listeners;
 static btstack_linked_list_t gatt_client_service_value_listeners;
@@ -130,6 +215,13 @@ void gatt_client_init(void){
 #ifdef ENABLE_GATT_OVER_EATT
     gatt_client_eatt_enabled = true;
 #endif
+
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    uint8_t i;
+    for (i = 0; i < MAX_NR_GATT_CLIENT_CACHES; i++){
+        gatt_client_caches[i].con_handle = HCI_CON_HANDLE_INVALID;
+    }
+#endif
 }
 
 void gatt_client_set_required_security_level(gap_security_level_t level){
@@ -229,6 +321,9 @@ static uint8_t gatt_client_provide_context_for_handle(hci_con_handle_t con_handl
     gatt_client->eatt_state = GATT_CLIENT_EATT_IDLE;
 #endif
     btstack_linked_list_add(&gatt_client_connections, (btstack_linked_item_t*)gatt_client);
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    gatt_client_cache_provide_for_handle(con_handle);
+#endif
 
     // get unenhanced att bearer state
     if (hci_connection->att_connection.mtu_exchanged){
@@ -1015,10 +1110,541 @@ static void emit_gatt_mtu_exchanged_result_event(gatt_client_t * gatt_client, ui
     emit_event_new(gatt_client->callback, packet, sizeof(packet));
 }
 
+#ifdef ENABLE_GATT_CLIENT_CACHE
+// part 0: header, part 1..: entries
+static uint32_t gatt_client_cache_tag_for_index(int le_device_index, uint8_t part){
+    static const char tag_0 = 'G';
+    static const char tag_1 = 'C';
+    return (tag_0 << 24u) | (tag_1 << 16u) | (part << 8u) | (uint8_t) le_device_index;
+}
+
+static gatt_client_cache_t * gatt_client_cache_for_handle(hci_con_handle_t con_handle){
+    uint8_t i;
+    for (i = 0; i < MAX_NR_GATT_CLIENT_CACHES; i++){
+        if (gatt_client_caches[i].con_handle == con_handle){
+            return &gatt_client_caches[i];
+        }
+    }
+    return NULL;
+}
+
+static void gatt_client_cache_provide_for_handle(hci_con_handle_t con_handle){
+    if (gatt_client_cache_for_handle(con_handle) != NULL) return;
+    gatt_client_cache_t * cache = gatt_client_cache_for_handle(HCI_CON_HANDLE_INVALID);
+    if (cache == NULL) {
+        log_info("GATT Client Cache: no free slot for handle 0x%04x, increase MAX_NR_GATT_CLIENT_CACHES", con_handle);
+        return;
+    }
+    (void)memset(cache, 0, sizeof(gatt_client_cache_t));
+    cache->con_handle = con_handle;
+    cache->state = GATT_CLIENT_CACHE_IDLE;
+    cache->le_device_index = -1;
+}
+
+static void gatt_client_cache_clear(gatt_client_cache_t * cache){
+    cache->storage.header.flags = 0;
+    cache->storage.header.num_entries = 0;
+    cache->dirty = false;
+}
+
+static uint8_t gatt_client_cache_num_entry_tags(uint16_t num_entries){
+    return (uint8_t) ((num_entries + GATT_CLIENT_CACHE_ENTRIES_PER_TAG - 1u) / GATT_CLIENT_CACHE_ENTRIES_PER_TAG);
+}
+
+static void gatt_client_cache_delete_tags(const btstack_tlv_t * tlv_impl, void * tlv_context, int le_device_index, uint8_t first_part){
+    uint8_t part;
+    for (part = first_part; part <= GATT_CLIENT_CACHE_NUM_ENTRY_TAGS; part++){
+        tlv_impl->delete_tag(tlv_context, gatt_client_cache_tag_for_index(le_device_index, part));
+    }
+}
+
+static void gatt_client_cache_delete(gatt_client_cache_t * cache){
+    if (cache->le_device_index < 0) return;
+    const btstack_tlv_t * tlv_impl = NULL;
+    void * tlv_context;
+    btstack_tlv_get_instance(&tlv_impl, &tlv_context);
+    if (tlv_impl == NULL) return;
+    gatt_client_cache_delete_tags(tlv_impl, tlv_context, cache->le_device_index, 0);
+}
+
+// header is only stored after all entries
+static bool gatt_client_cache_stored(int le_device_index){
+    const btstack_tlv_t * tlv_impl = NULL;
+    void * tlv_context;
+    btstack_tlv_get_instance(&tlv_impl, &tlv_context);
+    if (tlv_impl == NULL) return false;
+    gatt_client_cache_header_t header;
+    int size = tlv_impl->get_tag(tlv_context, gatt_client_cache_tag_for_index(le_device_index, 0), (uint8_t *) &header, sizeof(header));
+    return size == (int) sizeof(header);
+}
+
+static void gatt_client_cache_store(gatt_client_cache_t * cache){
+    if (cache->dirty == false) return;
+    cache->dirty = false;
+    if (cache->state != GATT_CLIENT_CACHE_ACTIVE) return;
+    if (cache->le_device_index < 0) return;
+    const btstack_tlv_t * tlv_impl = NULL;
+    void * tlv_context;
+    btstack_tlv_get_instance(&tlv_impl, &tlv_context);
+    if (tlv_impl == NULL) return;
+
+    // drop header first, so a partially written cache is never used
+    int le_device_index = cache->le_device_index;
+    tlv_impl->delete_tag(tlv_context, gatt_client_cache_tag_for_index(le_device_index, 0));
+
+    uint16_t num_entries = cache->storage.header.num_entries;
+    uint8_t num_parts = gatt_client_cache_num_entry_tags(num_entries);
+    uint8_t part;
+    int result = 0;
+    for (part = 1; part <= num_parts; part++){
+        uint16_t first_entry = (part - 1u) * GATT_CLIENT_CACHE_ENTRIES_PER_TAG;
+        uint16_t part_entries = btstack_min(GATT_CLIENT_CACHE_ENTRIES_PER_TAG, num_entries - first_entry);
+        result = tlv_impl->store_tag(tlv_context, gatt_client_cache_tag_for_index(le_device_index, part),
+                                     (const uint8_t *) &cache->storage.entries[first_entry],
+                                     part_entries * sizeof(gatt_client_cache_entry_t));
+        if (result != 0) break;
+    }
+    gatt_client_cache_delete_tags(tlv_impl, tlv_context, le_device_index, num_parts + 1u);
+
+    if (result == 0){
+        int addr_type;
+        le_device_db_info(le_device_index, &addr_type, cache->storage.header.identity_addr, NULL);
+        cache->storage.header.identity_addr_type = (uint8_t) addr_type;
+        result = tlv_impl->store_tag(tlv_context, gatt_client_cache_tag_for_index(le_device_index, 0),
+                                     (const uint8_t *) &cache->storage.header, sizeof(gatt_client_cache_header_t));
+    }
+    log_info("GATT Client Cache: store %u entries for le device %d, result %d", num_entries, le_device_index, result);
+}
+
+static void gatt_client_cache_free_for_handle(hci_con_handle_t con_handle){
+    gatt_client_cache_t * cache = gatt_client_cache_for_handle(con_handle);
+    if (cache == NULL) return;
+    gatt_client_cache_store(cache);
+    cache->con_handle = HCI_CON_HANDLE_INVALID;
+}
+
+// cache collected before bonding can be stored now
+static void gatt_client_cache_update_bonding(hci_con_handle_t con_handle){
+    gatt_client_cache_t * cache = gatt_client_cache_for_handle(con_handle);
+    if (cache == NULL) return;
+    cache->le_device_index = sm_le_device_index(con_handle);
+    if ((cache->state == GATT_CLIENT_CACHE_ACTIVE) && (cache->storage.header.num_entries > 0u)){
+        cache->dirty = true;
+    }
+}
+
+// Database Hash of remote is known, restore stored cache for bonded device if it matches
+static void gatt_client_cache_validate(gatt_client_cache_t * cache, const uint8_t * database_hash){
+    uint8_t hash[16];
+    (void)memcpy(hash, database_hash, 16);
+
+    gatt_client_cache_clear(cache);
+    (void)memcpy(cache->storage.header.database_hash, hash, 16);
+    cache->state = GATT_CLIENT_CACHE_ACTIVE;
+    cache->le_device_index = sm_le_device_index(cache->con_handle);
+    if (cache->le_device_index < 0) return;
+
+    const btstack_tlv_t * tlv_impl = NULL;
+    void * tlv_context;
+    btstack_tlv_get_instance(&tlv_impl, &tlv_context);
+    if (tlv_impl == NULL) return;
+
+    int size = tlv_impl->get_tag(tlv_context, gatt_client_cache_tag_for_index(cache->le_device_index, 0),
+                                 (uint8_t *) &cache->storage.header, sizeof(gatt_client_cache_header_t));
+
+    // stored for same identity, with same database hash
+    int addr_type;
+    bd_addr_t addr;
+    le_device_db_info(cache->le_device_index, &addr_type, addr, NULL);
+    bool valid = (size == (int) sizeof(gatt_client_cache_header_t))
+            && (cache->storage.header.num_entries <= GATT_CLIENT_CACHE_MAX_ENTRIES)
+            && (cache->storage.header.identity_addr_type == (uint8_t) addr_type)
+            && (memcmp(cache->storage.header.identity_addr, addr, 6) == 0)
+            && (memcmp(cache->storage.header.database_hash, hash, 16) == 0);
+
+    // and all entries are present
+    uint16_t num_entries = cache->storage.header.num_entries;
+    uint8_t num_parts = gatt_client_cache_num_entry_tags(num_entries);
+    uint8_t part;
+    for (part = 1; valid && (part <= num_parts); part++){
+        uint16_t first_entry = (part - 1u) * GATT_CLIENT_CACHE_ENTRIES_PER_TAG;
+        uint16_t part_entries = btstack_min(GATT_CLIENT_CACHE_ENTRIES_PER_TAG, num_entries - first_entry);
+        uint32_t part_size = part_entries * sizeof(gatt_client_cache_entry_t);
+        size = tlv_impl->get_tag(tlv_context, gatt_client_cache_tag_for_index(cache->le_device_index, part),
+                                 (uint8_t *) &cache->storage.entries[first_entry], part_size);
+        valid = (size == (int) part_size);
+    }
+
+    if (valid){
+        log_info("GATT Client Cache: restored %u entries for le device %d", num_entries, cache->le_device_index);
+        return;
+    }
+
+    log_info("GATT Client Cache: stored cache for le device %d outdated", cache->le_device_index);
+    gatt_client_cache_clear(cache);
+    (void)memcpy(cache->storage.header.database_hash, hash, 16);
+    gatt_client_cache_delete_tags(tlv_impl, tlv_context, cache->le_device_index, 0);
+}
+
+// Database Hash read after discovery results of bonded device without stored cache have been recorded
+static void gatt_client_cache_complete_building(gatt_client_cache_t * cache, const uint8_t * database_hash){
+    (void)memcpy(cache->storage.header.database_hash, database_hash, 16);
+    cache->building = false;
+    cache->state = GATT_CLIENT_CACHE_ACTIVE;
+}
+
+// remote database has changed: drop cache and read Database Hash again before next query
+static void gatt_client_cache_invalidate(gatt_client_cache_t * cache){
+    if ((cache->state != GATT_CLIENT_CACHE_ACTIVE) && (cache->state != GATT_CLIENT_CACHE_BUILDING)) return;
+    log_info("GATT Client Cache: invalidate cache for handle 0x%04x", cache->con_handle);
+    gatt_client_cache_delete(cache);
+    gatt_client_cache_clear(cache);
+    cache->state = GATT_CLIENT_CACHE_IDLE;
+}
+
+// service containing handle range
+static gatt_client_cache_entry_t * gatt_client_cache_find_service(gatt_client_cache_t * cache, uint16_t start_handle, uint16_t end_handle){
+    uint16_t i;
+    for (i = 0; i < cache->storage.header.num_entries; i++){
+        gatt_client_cache_entry_t * entry = &cache->storage.entries[i];
+        if (entry->type != GATT_CLIENT_CACHE_ENTRY_SERVICE) continue;
+        if (entry->start_handle > start_handle) continue;
+        if (entry->end_handle < end_handle) continue;
+        return entry;
+    }
+    return NULL;
+}
+
+// characteristic with descriptors in handle range
+static gatt_client_cache_entry_t * gatt_client_cache_find_characteristic(gatt_client_cache_t * cache, uint16_t start_handle, uint16_t end_handle){
+    uint16_t i;
+    for (i = 0; i < cache->storage.header.num_entries; i++){
+        gatt_client_cache_entry_t * entry = &cache->storage.entries[i];
+        if (entry->type != GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC) continue;
+        if ((entry->value_handle + 1u) != start_handle) continue;
+        if (entry->end_handle != end_handle) continue;
+        return entry;
+    }
+    return NULL;
+}
+
+// remove characteristics and descriptors in handle range, keeps order of remaining entries
+static void gatt_client_cache_remove_entries(gatt_client_cache_t * cache, uint16_t start_handle, uint16_t end_handle){
+    uint16_t i;
+    uint16_t num_entries = 0;
+    for (i = 0; i < cache->storage.header.num_entries; i++){
+        const gatt_client_cache_entry_t * entry = &cache->storage.entries[i];
+        if ((entry->type != GATT_CLIENT_CACHE_ENTRY_SERVICE) && (entry->start_handle >= start_handle) && (entry->start_handle <= end_handle)) continue;
+        if (i != num_entries){
+            cache->storage.entries[num_entries] = *entry;
+        }
+        num_entries++;
+    }
+    cache->storage.header.num_entries = num_entries;
+}
+
+// returns true if query is answered from cache
+static bool gatt_client_cache_prepare_query(gatt_client_t * gatt_client){
+    gatt_client_cache_t * cache = gatt_client_cache_for_handle(gatt_client->con_handle);
+    btstack_assert(cache != NULL);
+
+    gatt_client_cache_entry_t * entry = NULL;
+    bool complete;
+    switch (gatt_client->state){
+        case P_W2_SEND_SERVICE_QUERY:
+            if (gatt_client->uuid16 != GATT_PRIMARY_SERVICE_UUID) return false;
+            complete = (cache->storage.header.flags & GATT_CLIENT_CACHE_FLAG_SERVICES_COMPLETE) != 0u;
+            break;
+        case P_W2_SEND_SERVICE_WITH_UUID_QUERY:
+            complete = (cache->storage.header.flags & GATT_CLIENT_CACHE_FLAG_SERVICES_COMPLETE) != 0u;
+            break;
+        case P_W2_SEND_ALL_CHARACTERISTICS_OF_SERVICE_QUERY:
+        case P_W2_SEND_CHARACTERISTIC_WITH_UUID_QUERY:
+            entry = gatt_client_cache_find_service(cache, gatt_client->start_group_handle, gatt_client->end_group_handle);
+            complete = (entry != NULL) && ((entry->flags & GATT_CLIENT_CACHE_FLAG_COMPLETE) != 0u);
+            break;
+        case P_W2_SEND_ALL_CHARACTERISTIC_DESCRIPTORS_QUERY:
+            entry = gatt_client_cache_find_characteristic(cache, gatt_client->start_group_handle, gatt_client->end_group_handle);
+            complete = (entry != NULL) && ((entry->flags & GATT_CLIENT_CACHE_FLAG_COMPLETE) != 0u);
+            break;
+        default:
+            return false;
+    }
+
+    gatt_client->cache_query_active = true;
+    gatt_client->cache_query_state  = gatt_client->state;
+    gatt_client->cache_start_handle = gatt_client->start_group_handle;
+
+    // answer from main thread to avoid emitting events from API call
+    if (complete){
+        log_info("GATT Client Cache: answer query for range 0x%04x-0x%04x", gatt_client->start_group_handle, gatt_client->end_group_handle);
+        gatt_client->state = P_W2_EMIT_CACHED_QUERY_RESULTS;
+        gatt_client_deferred_event_emit.callback = gatt_client_emit_events;
+        btstack_run_loop_execute_on_main_thread(&gatt_client_deferred_event_emit);
+        return true;
+    }
+
+    // record results of complete discovery, drop partial results of an earlier attempt
+    switch (gatt_client->state){
+        case P_W2_SEND_SERVICE_QUERY:
+            gatt_client_cache_clear(cache);
+            gatt_client->cache_recording = true;
+            break;
+        case P_W2_SEND_ALL_CHARACTERISTICS_OF_SERVICE_QUERY:
+            if (entry == NULL) break;
+            if ((entry->start_handle != gatt_client->start_group_handle) || (entry->end_handle != gatt_client->end_group_handle)) break;
+            gatt_client_cache_remove_entries(cache, gatt_client->start_group_handle, gatt_client->end_group_handle);
+            gatt_client->cache_recording = true;
+            break;
+        case P_W2_SEND_ALL_CHARACTERISTIC_DESCRIPTORS_QUERY:
+            if (entry == NULL) break;
+            gatt_client_cache_remove_entries(cache, gatt_client->start_group_handle, gatt_client->end_group_handle);
+            gatt_client->cache_recording = true;
+            break;
+        default:
+            break;
+    }
+    return false;
+}
+
+// bonded device with stored cache: read Database Hash before first discovery query, then answer queries from cache
+// bonded device without stored cache: record results, read Database Hash before next discovery query
+// returns true if regular request must not be sent, request_sent is set if Database Hash read was sent
+static bool gatt_client_cache_handle_query(gatt_client_t * gatt_client, bool * request_sent){
+    *request_sent = false;
+    if (gatt_client->bearer_type != ATT_BEARER_UNENHANCED_LE) return false;
+    if (gatt_client->cache_query_active) return false;
+    switch (gatt_client->state){
+        case P_W2_SEND_SERVICE_QUERY:
+        case P_W2_SEND_SERVICE_WITH_UUID_QUERY:
+        case P_W2_SEND_ALL_CHARACTERISTICS_OF_SERVICE_QUERY:
+        case P_W2_SEND_CHARACTERISTIC_WITH_UUID_QUERY:
+        case P_W2_SEND_ALL_CHARACTERISTIC_DESCRIPTORS_QUERY:
+            break;
+        default:
+            return false;
+    }
+
+    gatt_client_cache_t * cache = gatt_client_cache_for_handle(gatt_client->con_handle);
+    if (cache == NULL) return false;
+    switch (cache->state){
+        case GATT_CLIENT_CACHE_IDLE:
+            // unbonded devices cannot use a cache on reconnect
+            cache->le_device_index = sm_le_device_index(gatt_client->con_handle);
+            if (cache->le_device_index < 0) return false;
+            if (gatt_client_cache_stored(cache->le_device_index) == false){
+                gatt_client_cache_clear(cache);
+                cache->building = true;
+                cache->state = GATT_CLIENT_CACHE_BUILDING;
+                return gatt_client_cache_prepare_query(gatt_client);
+            }
+            cache->building = false;
+            cache->state = GATT_CLIENT_CACHE_W4_DATABASE_HASH;
+            att_read_by_type_or_group_request_for_uuid16(gatt_client, ATT_READ_BY_TYPE_REQUEST,
+                                                         ORG_BLUETOOTH_CHARACTERISTIC_DATABASE_HASH, 0x0001, 0xffff);
+            *request_sent = true;
+            return true;
+        case GATT_CLIENT_CACHE_BUILDING:
+            if (cache->storage.header.num_entries == 0u){
+                return gatt_client_cache_prepare_query(gatt_client);
+            }
+            cache->state = GATT_CLIENT_CACHE_W4_DATABASE_HASH;
+            att_read_by_type_or_group_request_for_uuid16(gatt_client, ATT_READ_BY_TYPE_REQUEST,
+                                                         ORG_BLUETOOTH_CHARACTERISTIC_DATABASE_HASH, 0x0001, 0xffff);
+            *request_sent = true;
+            return true;
+        case GATT_CLIENT_CACHE_W4_DATABASE_HASH:
+            return true;
+        case GATT_CLIENT_CACHE_ACTIVE:
+            return gatt_client_cache_prepare_query(gatt_client);
+        default:
+            return false;
+    }
+}
+
+static void gatt_client_cache_add_entry(gatt_client_t * gatt_client, gatt_client_cache_entry_type_t type, uint16_t start_handle,
+                                        uint16_t value_handle, uint16_t end_handle, uint16_t properties, const uint8_t * uuid128){
+    if (gatt_client->cache_recording == false) return;
+
+    gatt_client_cache_t * cache = gatt_client_cache_for_handle(gatt_client->con_handle);
+    if ((cache == NULL) || ((cache->state != GATT_CLIENT_CACHE_ACTIVE) && (cache->state != GATT_CLIENT_CACHE_BUILDING))){
+        gatt_client->cache_recording = false;
+        return;
+    }
+    if (cache->storage.header.num_entries >= GATT_CLIENT_CACHE_MAX_ENTRIES){
+        log_info("GATT Client Cache: full, increase GATT_CLIENT_CACHE_MAX_ENTRIES");
+        gatt_client->cache_recording = false;
+        return;
+    }
+    gatt_client_cache_entry_t * entry = &cache->storage.entries[cache->storage.header.num_entries++];
+    entry->type = (uint8_t) type;
+    entry->flags = 0;
+    entry->properties = properties;
+    entry->start_handle = start_handle;
+    entry->value_handle = value_handle;
+    entry->end_handle = end_handle;
+    (void)memcpy(entry->uuid128, uuid128, 16);
+}
+
+static void gatt_client_cache_query_complete(gatt_client_t * gatt_client, uint8_t att_status){
+    gatt_client_cache_t * cache = gatt_client_cache_for_handle(gatt_client->con_handle);
+    bool recording = gatt_client->cache_recording;
+    gatt_client->cache_query_active = false;
+    gatt_client->cache_recording = false;
+    if (cache == NULL) return;
+
+    // query failed while Database Hash was requested, e.g. timeout
+    if ((cache->state == GATT_CLIENT_CACHE_W4_DATABASE_HASH) && (gatt_client->bearer_type == ATT_BEARER_UNENHANCED_LE)){
+        cache->state = GATT_CLIENT_CACHE_DISABLED;
+        return;
+    }
+
+    if (recording == false) return;
+    if (att_status != ATT_ERROR_SUCCESS) return;
+    if ((cache->state != GATT_CLIENT_CACHE_ACTIVE) && (cache->state != GATT_CLIENT_CACHE_BUILDING)) return;
+
+    gatt_client_cache_entry_t * entry;
+    switch (gatt_client->cache_query_state){
+        case P_W2_SEND_SERVICE_QUERY:
+            cache->storage.header.flags |= GATT_CLIENT_CACHE_FLAG_SERVICES_COMPLETE;
+            break;
+        case P_W2_SEND_ALL_CHARACTERISTICS_OF_SERVICE_QUERY:
+            entry = gatt_client_cache_find_service(cache, gatt_client->cache_start_handle, gatt_client->end_group_handle);
+            if (entry == NULL) return;
+            entry->flags |= GATT_CLIENT_CACHE_FLAG_COMPLETE;
+            break;
+        case P_W2_SEND_ALL_CHARACTERISTIC_DESCRIPTORS_QUERY:
+            entry = gatt_client_cache_find_characteristic(cache, gatt_client->cache_start_handle, gatt_client->end_group_handle);
+            if (entry == NULL) return;
+            entry->flags |= GATT_CLIENT_CACHE_FLAG_COMPLETE;
+            break;
+        default:
+            return;
+    }
+    cache->dirty = true;
+}
+
+static void gatt_client_cache_emit_query_results(gatt_client_t * gatt_client){
+    gatt_client_cache_t * cache = gatt_client_cache_for_handle(gatt_client->con_handle);
+    if ((cache == NULL) || (cache->state != GATT_CLIENT_CACHE_ACTIVE)){
+        // cache was invalidated in the meantime, send query to remote
+        gatt_client->state = gatt_client->cache_query_state;
+        gatt_client->cache_query_active = false;
+        att_dispatch_client_request_can_send_now_event(gatt_client->con_handle);
+        return;
+    }
+
+    uint16_t i;
+    for (i = 0; i < cache->storage.header.num_entries; i++){
+        const gatt_client_cache_entry_t * entry = &cache->storage.entries[i];
+        switch (gatt_client->cache_query_state){
+            case P_W2_SEND_SERVICE_QUERY:
+                if (entry->type != GATT_CLIENT_CACHE_ENTRY_SERVICE) break;
+                emit_gatt_service_query_result_event(gatt_client, entry->start_handle, entry->end_handle, entry->uuid128);
+                break;
+            case P_W2_SEND_SERVICE_WITH_UUID_QUERY:
+                if (entry->type != GATT_CLIENT_CACHE_ENTRY_SERVICE) break;
+                if (memcmp(entry->uuid128, gatt_client->uuid128, 16) != 0) break;
+                emit_gatt_service_query_result_event(gatt_client, entry->start_handle, entry->end_handle, entry->uuid128);
+                break;
+            case P_W2_SEND_ALL_CHARACTERISTICS_OF_SERVICE_QUERY:
+            case P_W2_SEND_CHARACTERISTIC_WITH_UUID_QUERY:
+                if (entry->type != GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC) break;
+                if (entry->start_handle < gatt_client->start_group_handle) break;
+                if (entry->start_handle > gatt_client->end_group_handle) break;
+                if (gatt_client->filter_with_uuid && (memcmp(entry->uuid128, gatt_client->uuid128, 16) != 0)) break;
+                emit_gatt_characteristic_query_result_event(gatt_client, entry->start_handle, entry->value_handle,
+                                                            (uint16_t) btstack_min(entry->end_handle, gatt_client->end_group_handle),
+                                                            entry->properties, entry->uuid128);
+                break;
+            case P_W2_SEND_ALL_CHARACTERISTIC_DESCRIPTORS_QUERY:
+                if (entry->type != GATT_CLIENT_CACHE_ENTRY_DESCRIPTOR) break;
+                if (entry->start_handle < gatt_client->start_group_handle) break;
+                if (entry->start_handle > gatt_client->end_group_handle) break;
+                emit_gatt_all_characteristic_descriptors_result_event(gatt_client, entry->start_handle, entry->uuid128);
+                break;
+            default:
+                btstack_unreachable();
+                break;
+        }
+    }
+    gatt_client_handle_transaction_complete(gatt_client, ATT_ERROR_SUCCESS);
+}
+
+// returns true if packet was response to Database Hash read
+static bool gatt_client_cache_handle_att_response(gatt_client_t * gatt_client, const uint8_t * packet, uint16_t size){
+    gatt_client_cache_t * cache = gatt_client_cache_for_handle(gatt_client->con_handle);
+    if (cache == NULL) return false;
+
+    // server reports that we are change-unaware, error is reported to application
+    if ((packet[0] == ATT_ERROR_RESPONSE) && (size >= 5u) && (packet[4] == ATT_ERROR_DATABASE_OUT_OF_SYNC)){
+        gatt_client_cache_invalidate(cache);
+        return false;
+    }
+
+    if (cache->state != GATT_CLIENT_CACHE_W4_DATABASE_HASH) return false;
+    if (gatt_client->bearer_type != ATT_BEARER_UNENHANCED_LE) return false;
+
+    switch (packet[0]){
+        case ATT_READ_BY_TYPE_RESPONSE:
+            // handle + 16 byte Database Hash
+            if ((size >= 20u) && (packet[1] == 18u)){
+                cache->database_hash_value_handle = little_endian_read_16(packet, 2);
+                if (cache->building){
+                    gatt_client_cache_complete_building(cache, &packet[4]);
+                } else {
+                    gatt_client_cache_validate(cache, &packet[4]);
+                }
+            } else {
+                gatt_client_cache_clear(cache);
+                cache->state = GATT_CLIENT_CACHE_DISABLED;
+            }
+            return true;
+        case ATT_ERROR_RESPONSE:
+            if ((size < 2u) || (packet[1] != ATT_READ_BY_TYPE_REQUEST)) return false;
+            log_info("GATT Client Cache: no Database Hash, cache disabled");
+            gatt_client_cache_clear(cache);
+            cache->state = GATT_CLIENT_CACHE_DISABLED;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void gatt_client_cache_handle_indication(gatt_client_t * gatt_client, uint16_t value_handle, const uint8_t * value, uint16_t value_len){
+    gatt_client_cache_t * cache = gatt_client_cache_for_handle(gatt_client->con_handle);
+    if ((cache == NULL) || (cache->state != GATT_CLIENT_CACHE_ACTIVE)) return;
+
+    if (value_handle == cache->database_hash_value_handle){
+        if ((value_len == 16u) && (memcmp(value, cache->storage.header.database_hash, 16) == 0)) return;
+        gatt_client_cache_invalidate(cache);
+        return;
+    }
+
+    bool service_changed = value_handle == gatt_client->gatt_service_changed_value_handle;
+    uint16_t i;
+    for (i = 0; i < cache->storage.header.num_entries; i++){
+        const gatt_client_cache_entry_t * entry = &cache->storage.entries[i];
+        if (entry->type != GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC) continue;
+        if (entry->value_handle != value_handle) continue;
+        if (uuid_has_bluetooth_prefix(entry->uuid128) == false) continue;
+        if (big_endian_read_32(entry->uuid128, 0) != ORG_BLUETOOTH_CHARACTERISTIC_GATT_SERVICE_CHANGED) continue;
+        service_changed = true;
+        break;
+    }
+    if (service_changed){
+        gatt_client_cache_invalidate(cache);
+    }
+}
+#endif
+
 // helper
 static void gatt_client_handle_transaction_complete(gatt_client_t *gatt_client, uint8_t att_status) {
     gatt_client->state = P_READY;
     gatt_client_timeout_stop(gatt_client);
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    gatt_client_cache_query_complete(gatt_client, att_status);
+#endif
     emit_gatt_complete_event(gatt_client, att_status);
     gatt_client_notify_can_send_query(gatt_client);
 }
@@ -1107,6 +1733,9 @@ static void report_gatt_services(gatt_client_t * gatt_client, uint8_t * packet,
             return;
         }
         emit_gatt_service_query_result_event(gatt_client, start_group_handle, end_group_handle, uuid128);
+#ifdef ENABLE_GATT_CLIENT_CACHE
+        gatt_client_cache_add_entry(gatt_client, GATT_CLIENT_CACHE_ENTRY_SERVICE, start_group_handle, 0, end_group_handle, 0, uuid128);
+#endif
     }
 }
 
@@ -1141,6 +1770,10 @@ static void report_gatt_characteristic_end_found(gatt_client_t * gatt_client, ui
 
     emit_gatt_characteristic_query_result_event(gatt_client, gatt_client->characteristic_start_handle, gatt_client->attribute_handle,
                                                 end_handle, gatt_client->characteristic_properties, gatt_client->uuid128);
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    gatt_client_cache_add_entry(gatt_client, GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC, gatt_client->characteristic_start_handle,
+                                gatt_client->attribute_handle, end_handle, gatt_client->characteristic_properties, gatt_client->uuid128);
+#endif
 
     gatt_client->characteristic_start_handle = 0;
 }
@@ -1219,6 +1852,9 @@ static void report_gatt_indication(gatt_client_t *gatt_client, uint16_t value_ha
     if (value_handle == gatt_client->gatt_service_changed_value_handle){
         gatt_client_service_emit_service_changed(gatt_client, value, length);
     }
+#endif
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    gatt_client_cache_handle_indication(gatt_client, value_handle, value, (uint16_t) length);
 #endif
     report_gatt_characteristic_value_change(gatt_client, GATT_EVENT_INDICATION, value_handle, value, length);
 }
@@ -1268,6 +1904,9 @@ static void report_gatt_all_characteristic_descriptors(gatt_client_t * gatt_clie
             reverse_128(&packet[i+2], uuid128);
         }        
         emit_gatt_all_characteristic_descriptors_result_event(gatt_client, descriptor_handle, uuid128);
+#ifdef ENABLE_GATT_CLIENT_CACHE
+        gatt_client_cache_add_entry(gatt_client, GATT_CLIENT_CACHE_ENTRY_DESCRIPTOR, descriptor_handle, 0, 0, 0, uuid128);
+#endif
     }
     
 }
@@ -1454,6 +2093,13 @@ static bool gatt_client_run_for_gatt_client(gatt_client_t * gatt_client){
         return true;
     }
 
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    bool cache_request_sent;
+    if (gatt_client_cache_handle_query(gatt_client, &cache_request_sent)){
+        return cache_request_sent;
+    }
+#endif
+
     // check MTU for writes
     switch (gatt_client->state){
         case P_W2_SEND_WRITE_CHARACTERISTIC_VALUE:
@@ -1758,6 +2404,11 @@ static void gatt_client_emit_events(void * context){
             gatt_client->state = P_READY;
             emit_gatt_complete_event(gatt_client, ATT_ERROR_SUCCESS);
         }
+#ifdef ENABLE_GATT_CLIENT_CACHE
+        if (gatt_client->state == P_W2_EMIT_CACHED_QUERY_RESULTS){
+            gatt_client_cache_emit_query_results(gatt_client);
+        }
+#endif
     }
 }
 
@@ -1821,6 +2472,9 @@ static void gatt_client_handle_disconnection_complete(const uint8_t * packet){
 
     gatt_client_report_error_if_pending(gatt_client, ATT_ERROR_HCI_DISCONNECT_RECEIVED);
     gatt_client_timeout_stop(gatt_client);
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    gatt_client_cache_free_for_handle(con_handle);
+#endif
     btstack_linked_list_remove(&gatt_client_connections, (btstack_linked_item_t *) gatt_client);
     btstack_memory_gatt_client_free(gatt_client);
 }
@@ -1847,6 +2501,12 @@ static void gatt_client_event_packet_handler(uint8_t packet_type, uint16_t chann
             // update security level
             gatt_client->security_level = gatt_client_le_security_level_for_connection(con_handle);
 
+#ifdef ENABLE_GATT_CLIENT_CACHE
+            if (sm_event_pairing_complete_get_status(packet) == ERROR_CODE_SUCCESS){
+                gatt_client_cache_update_bonding(con_handle);
+            }
+#endif
+
             if (gatt_client->wait_for_authentication_complete){
                 gatt_client->wait_for_authentication_complete = false;
                 if (sm_event_pairing_complete_get_status(packet) != ERROR_CODE_SUCCESS){
@@ -2023,6 +2683,9 @@ static void gatt_client_handle_att_write_response(gatt_client_t *gatt_client) {
 
 static void gatt_client_handle_att_response(gatt_client_t * gatt_client, uint8_t * packet, uint16_t size) {
     uint8_t att_status;
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    if (gatt_client_cache_handle_att_response(gatt_client, packet, size)) return;
+#endif
     switch (packet[0]) {
         case ATT_EXCHANGE_MTU_RESPONSE: {
             if (size < 3u) break;
@@ -59,6 +59,9 @@ extern "C" {
 typedef enum {
     P_READY,
     P_W2_EMIT_QUERY_COMPLETE_EVENT,
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    P_W2_EMIT_CACHED_QUERY_RESULTS,
+#endif
     P_W2_SEND_SERVICE_QUERY,
     P_W4_SERVICE_QUERY_RESULT,
     P_W2_SEND_SERVICE_WITH_UUID_QUERY,
@@ -291,6 +294,14 @@ typedef struct gatt_client{
     uint16_t                    gatt_service_database_hash_cccd_handle;
     uint16_t                    gatt_service_database_hash_end_handle;
 
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    // GATT Client Cache: discovery query answered from or recorded into cache
+    gatt_client_state_t         cache_query_state;
+    uint16_t                    cache_start_handle;
+    bool                        cache_query_active;
+    bool                        cache_recording;
+#endif
+
 } gatt_client_t;
 
 // Single characteristic, with wildcards for con_handle and attribute_handle
@@ -87,6 +87,16 @@
 #define USE_CMAC_ENGINE
 #endif
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+#ifndef SM_ADDRESS_RESOLUTION_CACHE_SIZE
+#define SM_ADDRESS_RESOLUTION_CACHE_SIZE 8
+#endif
+// default private address timeout TGAP(private_addr_int) is 15 minutes, see Core Spec Vol 3, Part C, Appendix A
+#ifndef SM_ADDRESS_RESOLUTION_CACHE_TIMEOUT_MS
+#define SM_ADDRESS_RESOLUTION_CACHE_TIMEOUT_MS (15 * 60 * 1000)
+#endif
+#endif
+
 
 #define BTSTACK_TAG32(A,B,C,D) (((A) << 24) | ((B) << 16) | ((C) << 8) | (D))
 
@@ -152,6 +162,17 @@ typedef enum {
     ADDRESS_RESOLUTION_FAILED,
 } address_resolution_event_t;
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+// resolvable private address -> le device db index
+typedef struct {
+    bd_addr_t address;
+    bd_addr_t identity_address;
+    uint8_t   identity_addr_type;
+    int16_t   le_device_db_index;
+    uint32_t  resolved_ms;
+} sm_address_resolution_cache_entry_t;
+#endif
+
 typedef enum {
     EC_KEY_GENERATION_IDLE,
     EC_KEY_GENERATION_ACTIVE,
@@ -261,6 +282,9 @@ static bd_addr_t sm_address_resolution_address;
 static void *    sm_address_resolution_context;
 static address_resolution_mode_t sm_address_resolution_mode;
 static btstack_linked_list_t sm_address_resolution_general_queue;
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+static sm_address_resolution_cache_entry_t sm_address_resolution_cache[SM_ADDRESS_RESOLUTION_CACHE_SIZE];
+#endif
 
 // aes128 crypto engine.
 static sm_aes128_state_t  sm_aes128_state;
@@ -274,7 +298,9 @@ static btstack_crypto_ecc_p256_t sm_crypto_ecc_p256_request;
 
 // temp storage for random data
 static uint8_t sm_random_data[8];
+#ifndef ENABLE_SOFTWARE_AES128
 static uint8_t sm_aes128_key[16];
+#endif
 static uint8_t sm_aes128_plaintext[16];
 static uint8_t sm_aes128_ciphertext[16];
 
@@ -406,7 +432,12 @@ static sm_connection_t * sm_get_connection_for_bd_addr_and_type(bd_addr_t addres
 #endif
 static inline int sm_calc_actual_encryption_key_size(int other);
 static int sm_validate_stk_generation_method(void);
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+static void sm_address_resolution_handle_event(address_resolution_event_t event);
+#endif
+#ifndef ENABLE_SOFTWARE_AES128
 static void sm_handle_encryption_result_address_resolution(void *arg);
+#endif
 static void sm_handle_encryption_result_dkg_dhk(void *arg);
 static void sm_handle_encryption_result_dkg_irk(void *arg);
 static void sm_handle_encryption_result_enc_a(void *arg);
@@ -945,6 +976,64 @@ static bool sm_address_resolution_idle(void){
     return sm_address_resolution_mode == ADDRESS_RESOLUTION_IDLE;
 }
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+static bool sm_address_resolution_cache_entry_valid(const sm_address_resolution_cache_entry_t * entry, uint32_t now_ms){
+    if (entry->le_device_db_index < 0) return false;
+    return (uint32_t)(now_ms - entry->resolved_ms) < SM_ADDRESS_RESOLUTION_CACHE_TIMEOUT_MS;
+}
+
+static void sm_address_resolution_cache_reset(void){
+    int i;
+    for (i = 0; i < SM_ADDRESS_RESOLUTION_CACHE_SIZE; i++){
+        sm_address_resolution_cache[i].le_device_db_index = -1;
+    }
+}
+
+// @returns le device db index or -1 if not found
+static int sm_address_resolution_cache_lookup(const bd_addr_t address){
+    uint32_t now_ms = btstack_run_loop_get_time_ms();
+    int i;
+    for (i = 0; i < SM_ADDRESS_RESOLUTION_CACHE_SIZE; i++){
+        sm_address_resolution_cache_entry_t * entry = &sm_address_resolution_cache[i];
+        if (sm_address_resolution_cache_entry_valid(entry, now_ms) == false) continue;
+        if (memcmp(entry->address, address, 6) != 0) continue;
+        // drop entry if le device db entry was removed or replaced
+        int addr_type = BD_ADDR_TYPE_UNKNOWN;
+        bd_addr_t identity_address;
+        le_device_db_info(entry->le_device_db_index, &addr_type, identity_address, NULL);
+        if ((addr_type != entry->identity_addr_type) || (memcmp(identity_address, entry->identity_address, 6) != 0)){
+            entry->le_device_db_index = -1;
+            return -1;
+        }
+        return entry->le_device_db_index;
+    }
+    return -1;
+}
+
+static void sm_address_resolution_cache_add(const bd_addr_t address, int le_device_db_index){
+    uint32_t now_ms = btstack_run_loop_get_time_ms();
+    // use unused or expired entry, or replace oldest one
+    sm_address_resolution_cache_entry_t * entry = &sm_address_resolution_cache[0];
+    int i;
+    for (i = 0; i < SM_ADDRESS_RESOLUTION_CACHE_SIZE; i++){
+        sm_address_resolution_cache_entry_t * candidate = &sm_address_resolution_cache[i];
+        if (sm_address_resolution_cache_entry_valid(candidate, now_ms) == false){
+            entry = candidate;
+            break;
+        }
+        if ((uint32_t)(now_ms - candidate->resolved_ms) > (uint32_t)(now_ms - entry->resolved_ms)){
+            entry = candidate;
+        }
+    }
+    int addr_type = BD_ADDR_TYPE_UNKNOWN;
+    le_device_db_info(le_device_db_index, &addr_type, entry->identity_address, NULL);
+    (void)memcpy(entry->address, address, 6);
+    entry->identity_addr_type = (uint8_t) addr_type;
+    entry->le_device_db_index = (int16_t) le_device_db_index;
+    entry->resolved_ms = now_ms;
+}
+#endif
+
 static void sm_address_resolution_start_lookup(uint8_t addr_type, hci_con_handle_t con_handle, bd_addr_t addr, address_resolution_mode_t mode, void * context){
     (void)memcpy(sm_address_resolution_address, addr, 6);
     sm_address_resolution_addr_type = addr_type;
@@ -952,6 +1041,16 @@ static void sm_address_resolution_start_lookup(uint8_t addr_type, hci_con_handle
     sm_address_resolution_mode = mode;
     sm_address_resolution_context = context;
     sm_notify_client_base(SM_EVENT_IDENTITY_RESOLVING_STARTED, con_handle, addr_type, addr);
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+    if (addr_type == BD_ADDR_TYPE_LE_RANDOM){
+        int le_device_db_index = sm_address_resolution_cache_lookup(addr);
+        if (le_device_db_index >= 0){
+            log_info("LE Device Lookup: found in cache, index %d", le_device_db_index);
+            sm_address_resolution_test = le_device_db_index;
+            sm_address_resolution_handle_event(ADDRESS_RESOLUTION_SUCCEEDED);
+        }
+    }
+#endif
 }
 
 int sm_address_resolution_lookup(uint8_t address_type, bd_addr_t address){
@@ -1439,6 +1538,14 @@ static void sm_address_resolution_handle_event(address_resolution_event_t event)
             break;
     }
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+    // cache resolvable private addresses
+    if ((event == ADDRESS_RESOLUTION_SUCCEEDED) && (sm_address_resolution_addr_type == BD_ADDR_TYPE_LE_RANDOM) &&
+        ((sm_address_resolution_address[0] & 0xc0) == 0x40) && (sm_address_resolution_cache_lookup(sm_address_resolution_address) < 0)){
+        sm_address_resolution_cache_add(sm_address_resolution_address, matched_device_id);
+    }
+#endif
+
     switch (event){
         case ADDRESS_RESOLUTION_SUCCEEDED:
             sm_notify_client_index(SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED, con_handle, sm_address_resolution_addr_type, sm_address_resolution_address, matched_device_id);
@@ -2240,8 +2347,20 @@ static bool sm_run_rau(void){
     return false;
 }
 
-// device lookup with IRK
-static bool sm_run_irk_lookup(void){
+#ifdef ENABLE_SOFTWARE_AES128
+// check if resolvable private address was generated with IRK by calculating ah synchronously
+static bool sm_address_resolution_match_irk(const sm_key_t irk){
+    sm_key_t plaintext;
+    sm_key_t ciphertext;
+    sm_ah_r_prime(sm_address_resolution_address, plaintext);
+    btstack_aes128_calc(irk, plaintext, ciphertext);
+    return memcmp(&sm_address_resolution_address[3], &ciphertext[13], 3) == 0;
+}
+#endif
+
+// start next pending address resolution
+// @returns true if address resolution is active
+static bool sm_address_resolution_start_next(void){
     btstack_linked_list_iterator_t it;
 
     // -- if IRK lookup ready, find connection that require csrk lookup
@@ -2252,9 +2371,9 @@ static bool sm_run_irk_lookup(void){
             sm_connection_t  * sm_connection  = &hci_connection->sm_connection;
             if (sm_connection->sm_irk_lookup_state == IRK_LOOKUP_W4_READY){
                 // and start lookup
-                sm_address_resolution_start_lookup(sm_connection->sm_peer_addr_type, sm_connection->sm_handle, sm_connection->sm_peer_address, ADDRESS_RESOLUTION_FOR_CONNECTION, sm_connection);
                 sm_connection->sm_irk_lookup_state = IRK_LOOKUP_STARTED;
-                break;
+                sm_address_resolution_start_lookup(sm_connection->sm_peer_addr_type, sm_connection->sm_handle, sm_connection->sm_peer_address, ADDRESS_RESOLUTION_FOR_CONNECTION, sm_connection);
+                return true;
             }
         }
     }
@@ -2266,10 +2385,16 @@ static bool sm_run_irk_lookup(void){
             btstack_linked_list_remove(&sm_address_resolution_general_queue, (btstack_linked_item_t *) entry);
             sm_address_resolution_start_lookup(entry->address_type, 0, entry->address, ADDRESS_RESOLUTION_GENERAL, NULL);
             btstack_memory_sm_lookup_entry_free(entry);
+            return true;
         }
     }
 
-    // -- Continue with device lookup by public or resolvable private address
+    return !sm_address_resolution_idle();
+}
+
+// continue with device lookup by public or resolvable private address
+// @returns true if aes128 operation was started
+static bool sm_address_resolution_continue(void){
     if (!sm_address_resolution_idle()){
         bool started_aes128 = false;
         while (sm_address_resolution_test < le_device_db_max_count()){
@@ -2307,6 +2432,15 @@ static bool sm_run_irk_lookup(void){
                 continue;
             }
 
+#ifdef ENABLE_SOFTWARE_AES128
+            // calculate AH directly instead of queuing AES128 operation
+            if (sm_address_resolution_match_irk(irk)){
+                log_info("LE Device Lookup: matched resolvable private address");
+                sm_address_resolution_handle_event(ADDRESS_RESOLUTION_SUCCEEDED);
+                break;
+            }
+            sm_address_resolution_test++;
+#else
             if (sm_aes128_state == SM_AES128_ACTIVE) break;
 
             log_info("LE Device Lookup: calculate AH");
@@ -2318,6 +2452,7 @@ static bool sm_run_irk_lookup(void){
             btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, sm_aes128_key, sm_aes128_plaintext, sm_aes128_ciphertext, sm_handle_encryption_result_address_resolution, NULL);
             started_aes128 = true;
             break;
+#endif
         }
 
         if (started_aes128){
@@ -2332,6 +2467,20 @@ static bool sm_run_irk_lookup(void){
     return false;
 }
 
+// device lookup with IRK
+static bool sm_run_irk_lookup(void){
+#ifdef ENABLE_SOFTWARE_AES128
+    // address resolution completes synchronously, resolve all pending addresses in one batch
+    while (sm_address_resolution_start_next()){
+        (void) sm_address_resolution_continue();
+    }
+    return false;
+#else
+    if (sm_address_resolution_start_next() == false) return false;
+    return sm_address_resolution_continue();
+#endif
+}
+
 // SC OOB
 static bool sm_run_oob(void){
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
@@ -3574,6 +3723,7 @@ static void sm_handle_encryption_result_enc_ph4_ltk(void *arg){
 }
 #endif
 
+#ifndef ENABLE_SOFTWARE_AES128
 static void sm_handle_encryption_result_address_resolution(void *arg){
     UNUSED(arg);
     sm_aes128_state = SM_AES128_IDLE;
@@ -3590,6 +3740,7 @@ static void sm_handle_encryption_result_address_resolution(void *arg){
     sm_address_resolution_test++;
     sm_trigger_run();
 }
+#endif
 
 static void sm_handle_encryption_result_dkg_irk(void *arg){
     UNUSED(arg);
@@ -5158,6 +5309,9 @@ static void sm_state_reset(void) {
     sm_address_resolution_test = -1;    // no private address to resolve yet
     sm_address_resolution_mode = ADDRESS_RESOLUTION_IDLE;
     sm_address_resolution_general_queue = NULL;
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+    sm_address_resolution_cache_reset();
+#endif
     sm_active_connection_handle = HCI_CON_HANDLE_INVALID;
     sm_persistent_keys_random_active = false;
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
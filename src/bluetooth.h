@@ -763,6 +763,7 @@ typedef enum {
 #define ATT_ERROR_INSUFFICIENT_ENCRYPTION          0x0fu
 #define ATT_ERROR_UNSUPPORTED_GROUP_TYPE           0x10u
 #define ATT_ERROR_INSUFFICIENT_RESOURCES           0x11u
+#define ATT_ERROR_DATABASE_OUT_OF_SYNC             0x12u
 #define ATT_ERROR_VALUE_NOT_ALLOWED                0x13u
 
 // MARK: ATT Error Codes defined by BTstack
@@ -836,6 +837,10 @@ typedef enum {
 #define GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION  1
 #define GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_INDICATION    2
 
+#define GATT_CLIENT_SUPPORTED_FEATURES_ROBUST_CACHING                   0x01
+#define GATT_CLIENT_SUPPORTED_FEATURES_ENHANCED_ATT_BEARER              0x02
+#define GATT_CLIENT_SUPPORTED_FEATURES_MULTIPLE_HANDLE_VALUE_NOTIFICATIONS 0x04
+
 #define GATT_CLIENT_ANY_CONNECTION      0xffff
 #define GATT_CLIENT_ANY_VALUE_HANDLE    0x0000
 
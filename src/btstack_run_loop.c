@@ -86,6 +86,135 @@ void btstack_run_loop_base_disable_data_source_callbacks(btstack_data_source_t *
     data_source->flags &= ~callback_types;
 }
 
+#ifdef ENABLE_RUN_LOOP_TIMER_HEAP
+
+// Timers are stored in a pairing heap with the next timer as root. btstack_run_loop_base_timers points to the root,
+// so the first item is the next timer in both implementations.
+
+static uint32_t btstack_run_loop_base_timer_sequence_nr;
+
+static btstack_timer_source_t * btstack_run_loop_base_timer_heap_root(void){
+    return (btstack_timer_source_t *) btstack_run_loop_base_timers;
+}
+
+static btstack_timer_source_t * btstack_run_loop_base_timer_heap_next(const btstack_timer_source_t * timer){
+    return (btstack_timer_source_t *) timer->item.next;
+}
+
+static bool btstack_run_loop_base_timer_before(const btstack_timer_source_t * timer_a, const btstack_timer_source_t * timer_b){
+    int32_t delta = btstack_time_delta(timer_a->timeout, timer_b->timeout);
+    if (delta != 0){
+        return delta < 0;
+    }
+    return (int32_t) (timer_a->sequence_nr - timer_b->sequence_nr) < 0;
+}
+
+// Membership is tracked by a marker that depends on the timer address. Only the timer itself is read, so
+// timers that were never added, e.g. on the stack, or copies of added timers are not taken for heap members.
+#define BTSTACK_RUN_LOOP_TIMER_HEAP_MARKER 0x5A17C0DEu
+
+static uintptr_t btstack_run_loop_base_timer_heap_marker(const btstack_timer_source_t * timer){
+    return ((uintptr_t) timer) ^ (uintptr_t) BTSTACK_RUN_LOOP_TIMER_HEAP_MARKER;
+}
+
+static bool btstack_run_loop_base_timer_heap_contains(const btstack_timer_source_t * timer){
+    return timer->heap_marker == btstack_run_loop_base_timer_heap_marker(timer);
+}
+
+// meld two detached heaps, the later one becomes the first child of the earlier one
+static btstack_timer_source_t * btstack_run_loop_base_timer_heap_meld(btstack_timer_source_t * timer_a, btstack_timer_source_t * timer_b){
+    if (timer_a == NULL) return timer_b;
+    if (timer_b == NULL) return timer_a;
+    if (btstack_run_loop_base_timer_before(timer_b, timer_a)){
+        btstack_timer_source_t * tmp = timer_a;
+        timer_a = timer_b;
+        timer_b = tmp;
+    }
+    timer_b->prev = timer_a;
+    timer_b->item.next = (btstack_linked_item_t *) timer_a->child;
+    if (timer_a->child != NULL){
+        timer_a->child->prev = timer_b;
+    }
+    timer_a->child = timer_b;
+    return timer_a;
+}
+
+// two-pass pairing of a list of siblings without recursion
+static btstack_timer_source_t * btstack_run_loop_base_timer_heap_merge_pairs(btstack_timer_source_t * first){
+    // first pass: meld pairs from left to right, collect results in reverse order
+    btstack_timer_source_t * pairs = NULL;
+    while (first != NULL){
+        btstack_timer_source_t * timer_a = first;
+        btstack_timer_source_t * timer_b = btstack_run_loop_base_timer_heap_next(timer_a);
+        first = NULL;
+        timer_a->item.next = NULL;
+        timer_a->prev = NULL;
+        if (timer_b != NULL){
+            first = btstack_run_loop_base_timer_heap_next(timer_b);
+            timer_b->item.next = NULL;
+            timer_b->prev = NULL;
+        }
+        btstack_timer_source_t * melded = btstack_run_loop_base_timer_heap_meld(timer_a, timer_b);
+        melded->item.next = (btstack_linked_item_t *) pairs;
+        pairs = melded;
+    }
+    // second pass: meld from right to left
+    btstack_timer_source_t * root = NULL;
+    while (pairs != NULL){
+        btstack_timer_source_t * next = btstack_run_loop_base_timer_heap_next(pairs);
+        pairs->item.next = NULL;
+        root = btstack_run_loop_base_timer_heap_meld(root, pairs);
+        pairs = next;
+    }
+    return root;
+}
+
+bool btstack_run_loop_base_remove_timer(btstack_timer_source_t * timer){
+    if (btstack_run_loop_base_timer_heap_contains(timer) == false) return false;
+
+    btstack_timer_source_t * root = btstack_run_loop_base_timer_heap_root();
+    btstack_timer_source_t * children = btstack_run_loop_base_timer_heap_merge_pairs(timer->child);
+    if (timer == root){
+        root = children;
+    } else {
+        // unlink from parent or previous sibling
+        btstack_timer_source_t * next = btstack_run_loop_base_timer_heap_next(timer);
+        if (timer->prev->child == timer){
+            timer->prev->child = next;
+        } else {
+            timer->prev->item.next = (btstack_linked_item_t *) next;
+        }
+        if (next != NULL){
+            next->prev = timer->prev;
+        }
+        root = btstack_run_loop_base_timer_heap_meld(root, children);
+    }
+    btstack_run_loop_base_timers = (btstack_linked_item_t *) root;
+
+    timer->item.next = NULL;
+    timer->child = NULL;
+    timer->prev = NULL;
+    timer->heap_marker = 0;
+    return true;
+}
+
+void btstack_run_loop_base_add_timer(btstack_timer_source_t * timer){
+    if (btstack_run_loop_base_timer_heap_contains(timer)){
+        log_error("Timer %p already registered! Please read source code comment.", (void*)timer);
+        // see comment in list based btstack_run_loop_base_add_timer below
+        btstack_assert(false);
+        return;
+    }
+    timer->item.next = NULL;
+    timer->child = NULL;
+    timer->prev = NULL;
+    timer->sequence_nr = btstack_run_loop_base_timer_sequence_nr++;
+    timer->heap_marker = btstack_run_loop_base_timer_heap_marker(timer);
+    btstack_run_loop_base_timers = (btstack_linked_item_t *) btstack_run_loop_base_timer_heap_meld(btstack_run_loop_base_timer_heap_root(), timer);
+}
+
+#else
+
 bool btstack_run_loop_base_remove_timer(btstack_timer_source_t * timer){
     return btstack_linked_list_remove(&btstack_run_loop_base_timers, (btstack_linked_item_t *) timer);
 }
@@ -119,6 +248,8 @@ void btstack_run_loop_base_add_timer(btstack_timer_source_t * timer){
     it->next = (btstack_linked_item_t *) timer;
 }
 
+#endif
+
 void btstack_run_loop_base_process_timers(uint32_t now){
     // process timers, exit when timeout is in the future
     while (btstack_run_loop_base_timers) {
@@ -132,6 +263,28 @@ void btstack_run_loop_base_process_timers(uint32_t now){
 
 void btstack_run_loop_base_dump_timer(void){
 #ifdef ENABLE_LOG_INFO
+#ifdef ENABLE_RUN_LOOP_TIMER_HEAP
+    // walk heap depth-first, timers are not sorted
+    btstack_timer_source_t * timer = btstack_run_loop_base_timer_heap_root();
+    uint16_t i = 0;
+    while (timer != NULL){
+        log_info("timer %u (%p): timeout %" PRIbtstack_time_t "\n", i++, (void *) timer, timer->timeout);
+        if (timer->child != NULL){
+            timer = timer->child;
+            continue;
+        }
+        // go up until a next sibling is found
+        while ((timer != NULL) && (timer->item.next == NULL)){
+            while ((timer->prev != NULL) && (timer->prev->child != timer)){
+                timer = timer->prev;
+            }
+            timer = timer->prev;
+        }
+        if (timer != NULL){
+            timer = btstack_run_loop_base_timer_heap_next(timer);
+        }
+    }
+#else
     btstack_linked_item_t *it;
     uint16_t i = 0;
     for (it = (btstack_linked_item_t *) btstack_run_loop_base_timers; it ; it = it->next){
@@ -139,6 +292,7 @@ void btstack_run_loop_base_dump_timer(void){
         log_info("timer %u (%p): timeout %" PRIbtstack_time_t "\n", i, (void *) timer, timer->timeout);
     }
 #endif
+#endif
 
 }
 /**
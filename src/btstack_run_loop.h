@@ -104,6 +104,15 @@ typedef struct btstack_timer_source {
     // will be called when timer fired
     void  (*process)(struct btstack_timer_source *ts);
     void * context;
+#ifdef ENABLE_RUN_LOOP_TIMER_HEAP
+    // pairing heap: item.next is next sibling, prev is parent for first child and previous sibling otherwise
+    struct btstack_timer_source * child;
+    struct btstack_timer_source * prev;
+    // keeps insertion order for timers with same timeout
+    uint32_t sequence_nr;
+    // membership marker derived from timer address, only valid while timer is in the heap
+    uintptr_t heap_marker;
+#endif
 } btstack_timer_source_t;
 
 typedef struct btstack_run_loop {
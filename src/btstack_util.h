@@ -349,6 +349,7 @@ uint32_t btstack_crc32_init(void);
 
 /**
  * @brief Update the CRC32 value with new data.
+ * @note With ENABLE_CRC32_SLICING_BY_8, 8 bytes are processed per step using 7 KB of additional lookup tables
  *
  * @param crc      The current crc value.
  * @param data     Pointer to a buffer of \a data_len bytes.
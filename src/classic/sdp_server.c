@@ -64,26 +64,71 @@
 // max reserved ServiceRecordHandle
 #define MAX_RESERVED_SERVICE_RECORD_HANDLE 0xffff
 
+// max number of l2cap connections that are served concurrently, each with its own response buffer
+#ifndef SDP_SERVER_MAX_CHANNELS
+#define SDP_SERVER_MAX_CHANNELS 1
+#endif
+
 // max SDP response matches L2CAP PDU -- allow to use smaller buffer
 #ifndef SDP_RESPONSE_BUFFER_SIZE
 #define SDP_RESPONSE_BUFFER_SIZE (HCI_ACL_PAYLOAD_SIZE-L2CAP_HEADER_SIZE)
 #endif
 
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+// number of cached ServiceSearchAttribute responses
+#ifndef SDP_SERVER_RESPONSE_CACHE_SIZE
+#define SDP_SERVER_RESPONSE_CACHE_SIZE 4
+#endif
+// max size of cached AttributeLists, larger responses are created on demand
+#ifndef SDP_SERVER_RESPONSE_CACHE_ENTRY_SIZE
+#define SDP_SERVER_RESPONSE_CACHE_ENTRY_SIZE 512
+#endif
+// max size of ServiceSearchPattern and AttributeIDList used as cache key
+#define SDP_SERVER_RESPONSE_CACHE_KEY_SIZE 48
+// continuation state for cached responses: database version (1), offset into AttributeLists (2)
+#define SDP_SERVER_RESPONSE_CACHE_CONTINUATION_LEN 3
+#endif
+
 static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
 
+typedef struct {
+    uint16_t l2cap_cid;
+    uint16_t response_size;
+    uint8_t  response_buffer[SDP_RESPONSE_BUFFER_SIZE];
+} sdp_server_channel_t;
+
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+typedef struct {
+    uint32_t last_used;
+    uint16_t key_len;
+    // 0 = unused
+    uint16_t attribute_lists_len;
+    uint8_t  key[SDP_SERVER_RESPONSE_CACHE_KEY_SIZE];
+    uint8_t  attribute_lists[SDP_SERVER_RESPONSE_CACHE_ENTRY_SIZE];
+} sdp_server_response_cache_entry_t;
+#endif
+
 // registered service records
 static btstack_linked_list_t sdp_server_service_records;
 
 // our handles start after the reserved range
 static uint32_t sdp_server_next_service_record_handle;
 
-static uint8_t sdp_response_buffer[SDP_RESPONSE_BUFFER_SIZE];
+static sdp_server_channel_t sdp_server_channels[SDP_SERVER_MAX_CHANNELS];
+
+// responses are created in the buffer of the channel that sent the request
+static uint8_t * sdp_response_buffer = sdp_server_channels[0].response_buffer;
 
-static uint16_t sdp_server_l2cap_cid;
-static uint16_t sdp_server_response_size;
 static uint16_t sdp_server_l2cap_waiting_list_cids[SDP_WAITING_LIST_MAX_COUNT];
 static int      sdp_server_l2cap_waiting_list_count;
 
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+static sdp_server_response_cache_entry_t sdp_server_response_cache[SDP_SERVER_RESPONSE_CACHE_SIZE];
+static uint32_t sdp_server_response_cache_counter;
+// incremented on every change of the service records to detect stale continuation states
+static uint8_t  sdp_server_database_version;
+#endif
+
 #ifdef ENABLE_TESTING_SUPPORT
 static bool sdp_server_testing_single_record_reponse = false;
 #endif
@@ -96,11 +141,23 @@ void sdp_init(void){
 
 void sdp_deinit(void){
     sdp_server_service_records = NULL;
-    sdp_server_l2cap_cid = 0;
-    sdp_server_response_size = 0;
+    memset(sdp_server_channels, 0, sizeof(sdp_server_channels));
+    sdp_response_buffer = sdp_server_channels[0].response_buffer;
     sdp_server_l2cap_waiting_list_count = 0;
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+    memset(sdp_server_response_cache, 0, sizeof(sdp_server_response_cache));
+    sdp_server_response_cache_counter = 0;
+    sdp_server_database_version = 0;
+#endif
 }
 
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+static void sdp_server_response_cache_invalidate(void){
+    memset(sdp_server_response_cache, 0, sizeof(sdp_server_response_cache));
+    sdp_server_database_version++;
+}
+#endif
+
 uint32_t sdp_get_service_record_handle(const uint8_t * record){
     // TODO: make sdp_get_attribute_value_for_attribute_id accept const data to remove cast
     uint8_t * serviceRecordHandleAttribute = sdp_get_attribute_value_for_attribute_id((uint8_t *)record, BLUETOOTH_ATTRIBUTE_SERVICE_RECORD_HANDLE);
@@ -162,7 +219,11 @@ uint8_t sdp_register_service(const uint8_t * record){
     
     // add to linked list
     btstack_linked_list_add(&sdp_server_service_records, (btstack_linked_item_t *) newRecordItem);
-    
+
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+    sdp_server_response_cache_invalidate();
+#endif
+
     return 0;
 }
 
@@ -174,6 +235,9 @@ void sdp_unregister_service(uint32_t service_record_handle){
     if (!record_item) return;
     btstack_linked_list_remove(&sdp_server_service_records, (btstack_linked_item_t *) record_item);
     btstack_memory_service_record_item_free(record_item);
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+    sdp_server_response_cache_invalidate();
+#endif
 }
 
 // PDU
@@ -382,6 +446,92 @@ static uint16_t sdp_get_size_for_service_search_attribute_response(uint8_t * ser
     return total_response_size;
 }
 
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+static bool sdp_server_response_cache_entry_matches(const sdp_server_response_cache_entry_t * entry, const uint8_t * serviceSearchPattern,
+                                                    uint16_t serviceSearchPatternLen, const uint8_t * attributeIDList, uint16_t attributeIDListLen){
+    if (entry->attribute_lists_len == 0) return false;
+    if (entry->key_len != (serviceSearchPatternLen + attributeIDListLen)) return false;
+    if (memcmp(entry->key, serviceSearchPattern, serviceSearchPatternLen) != 0) return false;
+    return memcmp(&entry->key[serviceSearchPatternLen], attributeIDList, attributeIDListLen) == 0;
+}
+
+// get complete AttributeLists for ServiceSearchPattern and AttributeIDList, create if needed
+static const sdp_server_response_cache_entry_t * sdp_server_response_cache_get(uint8_t * serviceSearchPattern, uint16_t serviceSearchPatternLen,
+                                                                               uint8_t * attributeIDList, uint16_t attributeIDListLen){
+    if ((serviceSearchPatternLen + attributeIDListLen) > SDP_SERVER_RESPONSE_CACHE_KEY_SIZE) return NULL;
+
+    // lookup, remember least recently used entry
+    sdp_server_response_cache_entry_t * entry = &sdp_server_response_cache[0];
+    uint16_t i;
+    for (i = 0; i < SDP_SERVER_RESPONSE_CACHE_SIZE; i++){
+        sdp_server_response_cache_entry_t * current = &sdp_server_response_cache[i];
+        if (sdp_server_response_cache_entry_matches(current, serviceSearchPattern, serviceSearchPatternLen, attributeIDList, attributeIDListLen)){
+            current->last_used = ++sdp_server_response_cache_counter;
+            return current;
+        }
+        if (current->last_used < entry->last_used){
+            entry = current;
+        }
+    }
+
+    // check if complete response fits into cache entry
+    uint32_t attribute_lists_len = 3u + sdp_get_size_for_service_search_attribute_response(serviceSearchPattern, attributeIDList);
+    if (attribute_lists_len > SDP_SERVER_RESPONSE_CACHE_ENTRY_SIZE) return NULL;
+
+    // store DES with total size followed by DES with attributes for all matching service records
+    de_store_descriptor_with_len(entry->attribute_lists, DE_DES, DE_SIZE_VAR_16, attribute_lists_len - 3u);
+    uint16_t pos = 3;
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) sdp_server_service_records; it ; it = it->next){
+        service_record_item_t * item = (service_record_item_t *) it;
+        if (!sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern)) continue;
+        uint16_t filtered_attributes_size = sdp_get_filtered_size(item->service_record, attributeIDList);
+        if (filtered_attributes_size == 0) continue;
+        de_store_descriptor_with_len(&entry->attribute_lists[pos], DE_DES, DE_SIZE_VAR_16, filtered_attributes_size);
+        pos += 3;
+        uint16_t bytes_used;
+        (void) sdp_filter_attributes_in_attributeIDList(item->service_record, attributeIDList, 0, SDP_SERVER_RESPONSE_CACHE_ENTRY_SIZE - pos, &bytes_used, &entry->attribute_lists[pos]);
+        pos += bytes_used;
+    }
+
+    (void)memcpy(entry->key, serviceSearchPattern, serviceSearchPatternLen);
+    (void)memcpy(&entry->key[serviceSearchPatternLen], attributeIDList, attributeIDListLen);
+    entry->key_len = serviceSearchPatternLen + attributeIDListLen;
+    entry->attribute_lists_len = pos;
+    entry->last_used = ++sdp_server_response_cache_counter;
+    return entry;
+}
+
+static int sdp_server_create_cached_service_search_attribute_response(uint16_t transaction_id, const sdp_server_response_cache_entry_t * entry,
+                                                                       uint16_t continuation_offset, uint16_t maximumAttributeByteCount){
+    // AttributeLists - starts at offset 7
+    uint16_t pos = 7;
+    uint16_t attributeListsByteCount = btstack_min(entry->attribute_lists_len - continuation_offset, maximumAttributeByteCount);
+    (void)memcpy(&sdp_response_buffer[pos], &entry->attribute_lists[continuation_offset], attributeListsByteCount);
+    pos += attributeListsByteCount;
+    continuation_offset += attributeListsByteCount;
+
+    // Continuation State
+    if (continuation_offset < entry->attribute_lists_len){
+        sdp_response_buffer[pos++] = SDP_SERVER_RESPONSE_CACHE_CONTINUATION_LEN;
+        sdp_response_buffer[pos++] = sdp_server_database_version;
+        big_endian_store_16(sdp_response_buffer, pos, continuation_offset);
+        pos += 2;
+    } else {
+        // complete
+        sdp_response_buffer[pos++] = 0;
+    }
+
+    // create SDP header
+    sdp_response_buffer[0] = SDP_ServiceSearchAttributeResponse;
+    big_endian_store_16(sdp_response_buffer, 1, transaction_id);
+    big_endian_store_16(sdp_response_buffer, 3, pos - 5);  // size of variable payload
+    big_endian_store_16(sdp_response_buffer, 5, attributeListsByteCount);
+
+    return pos;
+}
+#endif
+
 int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remote_mtu){
     
     // SDP header before attribute service list: 7
@@ -421,6 +571,30 @@ int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remot
         maximumAttributeByteCount = maximumAttributeByteCount2;
     }
     
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+    // serve initial request and continuation of cached response from cache
+    if ((continuationState[0] == 0) || (continuationState[0] == SDP_SERVER_RESPONSE_CACHE_CONTINUATION_LEN)){
+        uint16_t cached_offset = 0;
+        if (continuationState[0] == SDP_SERVER_RESPONSE_CACHE_CONTINUATION_LEN){
+            if (continuationState[1] != sdp_server_database_version){
+                // service records changed since initial request
+                return sdp_create_error_response(transaction_id, 0x0005); /// invalid continuation state
+            }
+            cached_offset = big_endian_read_16(continuationState, 2);
+        }
+        const sdp_server_response_cache_entry_t * entry = sdp_server_response_cache_get(serviceSearchPattern, serviceSearchPatternLen, attributeIDList, attributeIDListLen);
+        if (entry != NULL){
+            if (cached_offset >= entry->attribute_lists_len){
+                return sdp_create_error_response(transaction_id, 0x0005); /// invalid continuation state
+            }
+            return sdp_server_create_cached_service_search_attribute_response(transaction_id, entry, cached_offset, maximumAttributeByteCount);
+        }
+        if (cached_offset > 0){
+            return sdp_create_error_response(transaction_id, 0x0005); /// invalid continuation state
+        }
+    }
+#endif
+
     // continuation state contains: index of next service record to examine
     // continuation state contains: byte offset into this service record
     uint16_t continuation_service_index = 0;
@@ -516,14 +690,30 @@ int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remot
     return pos;
 }
 
-static void sdp_respond(void){
-    if (!sdp_server_response_size ) return;
-    if (!sdp_server_l2cap_cid) return;
+static sdp_server_channel_t * sdp_server_channel_for_cid(uint16_t cid){
+    uint16_t i;
+    for (i = 0; i < SDP_SERVER_MAX_CHANNELS; i++){
+        if (sdp_server_channels[i].l2cap_cid == cid){
+            return &sdp_server_channels[i];
+        }
+    }
+    return NULL;
+}
+
+static void sdp_server_accept_connection(sdp_server_channel_t * sdp_channel, uint16_t cid){
+    sdp_channel->l2cap_cid = cid;
+    sdp_channel->response_size = 0;
+    l2cap_accept_connection(cid);
+}
+
+static void sdp_respond(sdp_server_channel_t * sdp_channel){
+    if (!sdp_channel) return;
+    if (!sdp_channel->response_size ) return;
     
     // update state before sending packet (avoid getting called when new l2cap credit gets emitted)
-    uint16_t size = sdp_server_response_size;
-    sdp_server_response_size = 0;
-    l2cap_send(sdp_server_l2cap_cid, sdp_response_buffer, size);
+    uint16_t size = sdp_channel->response_size;
+    sdp_channel->response_size = 0;
+    l2cap_send(sdp_channel->l2cap_cid, sdp_channel->response_buffer, size);
 }
 
 // @pre space in list
@@ -541,16 +731,20 @@ static uint16_t sdp_waiting_list_get(void){
     return cid;
 }
 
-// we assume that we don't get two requests in a row
+// we assume that we don't get two requests in a row on the same channel
 static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
 	uint16_t transaction_id;
     sdp_pdu_id_t pdu_id;
     uint16_t remote_mtu;
     uint16_t param_len;
+    sdp_server_channel_t * sdp_channel;
     
 	switch (packet_type) {
 			
 		case L2CAP_DATA_PACKET:
+            sdp_channel = sdp_server_channel_for_cid(channel);
+            if (!sdp_channel) break;
+            sdp_response_buffer = sdp_channel->response_buffer;
             pdu_id = (sdp_pdu_id_t) packet[0];
             transaction_id = big_endian_read_16(packet, 1);
             param_len = big_endian_read_16(packet, 3);
@@ -569,23 +763,23 @@ static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
             switch (pdu_id){
                     
                 case SDP_ServiceSearchRequest:
-                    sdp_server_response_size = sdp_handle_service_search_request(packet, remote_mtu);
+                    sdp_channel->response_size = sdp_handle_service_search_request(packet, remote_mtu);
                     break;
                                         
                 case SDP_ServiceAttributeRequest:
-                    sdp_server_response_size = sdp_handle_service_attribute_request(packet, remote_mtu);
+                    sdp_channel->response_size = sdp_handle_service_attribute_request(packet, remote_mtu);
                     break;
                     
                 case SDP_ServiceSearchAttributeRequest:
-                    sdp_server_response_size = sdp_handle_service_search_attribute_request(packet, remote_mtu);
+                    sdp_channel->response_size = sdp_handle_service_search_attribute_request(packet, remote_mtu);
                     break;
                     
                 default:
-                    sdp_server_response_size = sdp_create_error_response(transaction_id, 0x0004); // invalid PDU size
+                    sdp_channel->response_size = sdp_create_error_response(transaction_id, 0x0004); // invalid PDU size
                     break;
             }
-            if (!sdp_server_response_size) break;
-            l2cap_request_can_send_now_event(sdp_server_l2cap_cid);
+            if (!sdp_channel->response_size) break;
+            l2cap_request_can_send_now_event(sdp_channel->l2cap_cid);
 			break;
 			
 		case HCI_EVENT_PACKET:
@@ -593,7 +787,8 @@ static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
 			switch (hci_event_packet_get_type(packet)) {
 
 				case L2CAP_EVENT_INCOMING_CONNECTION:
-                    if (sdp_server_l2cap_cid) {
+                    sdp_channel = sdp_server_channel_for_cid(0);
+                    if (!sdp_channel) {
                         // try to queue up
                         if (sdp_server_l2cap_waiting_list_count < SDP_WAITING_LIST_MAX_COUNT){
                             sdp_waiting_list_add(channel);
@@ -606,38 +801,39 @@ static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
                         break;
                     }
                     // accept
-                    sdp_server_l2cap_cid = channel;
-                    sdp_server_response_size = 0;
-                    l2cap_accept_connection(sdp_server_l2cap_cid);
+                    sdp_server_accept_connection(sdp_channel, channel);
 					break;
                     
                 case L2CAP_EVENT_CHANNEL_OPENED:
                     if (packet[2]) {
                         // open failed -> reset
-                        sdp_server_l2cap_cid = 0;
+                        sdp_channel = sdp_server_channel_for_cid(channel);
+                        if (sdp_channel){
+                            sdp_channel->l2cap_cid = 0;
+                        }
                     }
                     break;
 
                 case L2CAP_EVENT_CAN_SEND_NOW:
-                    sdp_respond();
+                    sdp_respond(sdp_server_channel_for_cid(channel));
                     break;
                 
                 case L2CAP_EVENT_CHANNEL_CLOSED:
-                    if (channel == sdp_server_l2cap_cid){
+                    sdp_channel = sdp_server_channel_for_cid(channel);
+                    if (sdp_channel){
                         // reset
-                        sdp_server_l2cap_cid = 0;
+                        sdp_channel->l2cap_cid = 0;
 
                         // other request queued?
                         if (!sdp_server_l2cap_waiting_list_count) break;
 
                         // get first item 
-                        sdp_server_l2cap_cid = sdp_waiting_list_get();
+                        uint16_t waiting_cid = sdp_waiting_list_get();
 
-                        log_info("disconnect, accept queued cid 0x%04x, now %u waiting", sdp_server_l2cap_cid, sdp_server_l2cap_waiting_list_count);
+                        log_info("disconnect, accept queued cid 0x%04x, now %u waiting", waiting_cid, sdp_server_l2cap_waiting_list_count);
 
                         // accept connection
-                        sdp_server_response_size = 0;
-                        l2cap_accept_connection(sdp_server_l2cap_cid);
+                        sdp_server_accept_connection(sdp_channel, waiting_cid);
                     }
                     break;
 					                    
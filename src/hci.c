@@ -59,6 +59,7 @@
 #endif
 
 #include <stdarg.h>
+#include <stddef.h>
 #include <string.h>
 #include <inttypes.h>
 
@@ -218,9 +219,23 @@ static void hci_emit_event(uint8_t * event, uint16_t size, int dump);
 static void hci_emit_btstack_event(uint8_t * event, uint16_t size, int dump);
 static void hci_emit_acl_packet(uint8_t * packet, uint16_t size);
 static void hci_run(void);
+static bool hci_run_commands(void);
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+static void handle_command_complete_event(uint8_t * packet, uint16_t size);
+static void hci_initializing_event_handler(const uint8_t * packet, uint16_t size);
+#endif
 static bool hci_is_le_connection(hci_connection_t * connection);
 static uint8_t hci_send_prepared_cmd_packet(void);
 
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+static void hci_acl_recombination_buffer_release(hci_connection_t * conn);
+#endif
+
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+static void hci_outgoing_acl_buffer_pool_reset(void);
+static void hci_outgoing_acl_buffer_pool_connection_free(hci_connection_t * connection);
+#endif
+
 #ifdef ENABLE_CLASSIC
 static int hci_have_usb_transport(void);
 static void hci_trigger_remote_features_for_connection(hci_connection_t * connection);
@@ -319,6 +334,72 @@ static void hci_connection_init(hci_connection_t * conn){
 #endif
 }
 
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+static inline uint16_t hci_connection_index_bucket_for_handle(hci_con_handle_t con_handle){
+    return con_handle & (HCI_CONNECTION_INDEX_SIZE - 1u);
+}
+
+static uint16_t hci_connection_index_bucket_for_address(const bd_addr_t addr, bd_addr_type_t addr_type){
+    // addresses are either random or assigned per company, use all octets
+    uint16_t hash = (uint16_t) addr_type;
+    uint8_t i;
+    for (i = 0; i < 6; i++){
+        hash = (uint16_t)((hash * 31u) + addr[i]);
+    }
+    return hash & (HCI_CONNECTION_INDEX_SIZE - 1u);
+}
+
+// connections are added in front to match order of hci_stack->connections
+static void hci_connection_index_add_handle(hci_connection_t * conn){
+    if (conn->con_handle == HCI_CON_HANDLE_INVALID) return;
+    uint16_t bucket = hci_connection_index_bucket_for_handle(conn->con_handle);
+    conn->index_next_by_handle = hci_stack->connection_index_by_handle[bucket];
+    hci_stack->connection_index_by_handle[bucket] = conn;
+}
+
+static void hci_connection_index_remove_handle(hci_connection_t * conn){
+    if (conn->con_handle == HCI_CON_HANDLE_INVALID) return;
+    hci_connection_t ** it = &hci_stack->connection_index_by_handle[hci_connection_index_bucket_for_handle(conn->con_handle)];
+    while (*it != NULL){
+        if (*it == conn){
+            *it = conn->index_next_by_handle;
+            break;
+        }
+        it = &(*it)->index_next_by_handle;
+    }
+    conn->index_next_by_handle = NULL;
+}
+
+static void hci_connection_index_add_address(hci_connection_t * conn){
+    uint16_t bucket = hci_connection_index_bucket_for_address(conn->address, conn->address_type);
+    conn->index_next_by_address = hci_stack->connection_index_by_address[bucket];
+    hci_stack->connection_index_by_address[bucket] = conn;
+}
+
+static void hci_connection_index_remove_address(hci_connection_t * conn){
+    hci_connection_t ** it = &hci_stack->connection_index_by_address[hci_connection_index_bucket_for_address(conn->address, conn->address_type)];
+    while (*it != NULL){
+        if (*it == conn){
+            *it = conn->index_next_by_address;
+            break;
+        }
+        it = &(*it)->index_next_by_address;
+    }
+    conn->index_next_by_address = NULL;
+}
+#endif
+
+// con handle is used as lookup key, update index if enabled
+static void hci_connection_set_con_handle(hci_connection_t * conn, hci_con_handle_t con_handle){
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    hci_connection_index_remove_handle(conn);
+    conn->con_handle = con_handle;
+    hci_connection_index_add_handle(conn);
+#else
+    conn->con_handle = con_handle;
+#endif
+}
+
 /**
  * create connection for given address
  *
@@ -337,10 +418,62 @@ create_connection_for_bd_addr_and_type(const bd_addr_t addr, bd_addr_type_t addr
     conn->con_handle = HCI_CON_HANDLE_INVALID;
     conn->role = role;
     btstack_linked_list_add(&hci_stack->connections, (btstack_linked_item_t *) conn);
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    hci_connection_index_add_address(conn);
+#endif
 
     return conn;
 }
 
+// ACL packets in flight are also counted per controller buffer, update totals
+static void hci_connection_set_num_packets_sent(hci_connection_t * conn, uint8_t num_packets_sent){
+    if (hci_is_le_connection(conn)){
+        hci_stack->acl_packets_sent_le = hci_stack->acl_packets_sent_le - conn->num_packets_sent + num_packets_sent;
+    } else if (conn->address_type == BD_ADDR_TYPE_ACL){
+        hci_stack->acl_packets_sent_classic = hci_stack->acl_packets_sent_classic - conn->num_packets_sent + num_packets_sent;
+    }
+    conn->num_packets_sent = num_packets_sent;
+}
+
+#ifdef ENABLE_HCI_ACL_ACCOUNTING_CHECK
+static void hci_acl_accounting_check(void){
+    uint16_t num_packets_sent_classic = 0;
+    uint16_t num_packets_sent_le = 0;
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) hci_stack->connections; it != NULL; it = it->next){
+        hci_connection_t * connection = (hci_connection_t *) it;
+        if (hci_is_le_connection(connection)){
+            num_packets_sent_le += connection->num_packets_sent;
+        }
+        if (connection->address_type == BD_ADDR_TYPE_ACL){
+            num_packets_sent_classic += connection->num_packets_sent;
+        }
+    }
+    btstack_assert(num_packets_sent_classic == hci_stack->acl_packets_sent_classic);
+    btstack_assert(num_packets_sent_le == hci_stack->acl_packets_sent_le);
+}
+#endif
+
+/**
+ * remove connection from connection list (and index) and free it
+ */
+static void hci_connection_free(hci_connection_t * conn){
+    // packets in flight are dropped by controller
+    hci_connection_set_num_packets_sent(conn, 0);
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    hci_connection_index_remove_handle(conn);
+    hci_connection_index_remove_address(conn);
+#endif
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+    hci_outgoing_acl_buffer_pool_connection_free(conn);
+#endif
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+    hci_acl_recombination_buffer_release(conn);
+#endif
+    btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
+    btstack_memory_hci_connection_free(conn);
+}
+
 
 /**
  * get le connection parameter range
@@ -408,6 +541,19 @@ void hci_connections_get_iterator(btstack_linked_list_iterator_t *it){
  * @return connection OR NULL, if not found
  */
 hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    // connections without con handle are not indexed, fall back to list below
+    if (con_handle != HCI_CON_HANDLE_INVALID){
+        hci_connection_t * conn = hci_stack->connection_index_by_handle[hci_connection_index_bucket_for_handle(con_handle)];
+        while (conn != NULL){
+            if (conn->con_handle == con_handle){
+                return conn;
+            }
+            conn = conn->index_next_by_handle;
+        }
+        return NULL;
+    }
+#endif
     btstack_linked_list_iterator_t it;
     btstack_linked_list_iterator_init(&it, &hci_stack->connections);
     while (btstack_linked_list_iterator_has_next(&it)){
@@ -425,6 +571,16 @@ hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
  * @return connection OR NULL, if not found
  */
 hci_connection_t * hci_connection_for_bd_addr_and_type(const bd_addr_t  addr, bd_addr_type_t addr_type){
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    hci_connection_t * conn = hci_stack->connection_index_by_address[hci_connection_index_bucket_for_address(addr, addr_type)];
+    while (conn != NULL){
+        if ((conn->address_type == addr_type) && (memcmp(addr, conn->address, 6) == 0)){
+            return conn;
+        }
+        conn = conn->index_next_by_address;
+    }
+    return NULL;
+#else
     btstack_linked_list_iterator_t it;
     btstack_linked_list_iterator_init(&it, &hci_stack->connections);
     while (btstack_linked_list_iterator_has_next(&it)){
@@ -434,6 +590,7 @@ hci_connection_t * hci_connection_for_bd_addr_and_type(const bd_addr_t  addr, bd
         return connection;   
     } 
     return NULL;
+#endif
 }
 
 #ifdef ENABLE_CLASSIC
@@ -652,20 +809,13 @@ static int nr_hci_connections(void){
 }
 
 uint16_t hci_number_free_acl_slots_for_connection_type(bd_addr_type_t address_type){
-    
-    int num_packets_sent_classic = 0;
-    int num_packets_sent_le = 0;
 
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) hci_stack->connections; it != NULL; it = it->next){
-        hci_connection_t * connection = (hci_connection_t *) it;
-        if (hci_is_le_connection(connection)){
-            num_packets_sent_le += connection->num_packets_sent;
-        }
-        if (connection->address_type == BD_ADDR_TYPE_ACL){
-            num_packets_sent_classic += connection->num_packets_sent;
-        }
-    }
+#ifdef ENABLE_HCI_ACL_ACCOUNTING_CHECK
+    hci_acl_accounting_check();
+#endif
+    int num_packets_sent_classic = hci_stack->acl_packets_sent_classic;
+    int num_packets_sent_le = hci_stack->acl_packets_sent_le;
+
     btstack_assert(hci_stack->acl_packets_total_num  >= num_packets_sent_classic);
     int free_slots_classic = hci_stack->acl_packets_total_num - num_packets_sent_classic;
     int free_slots_le = 0;
@@ -677,7 +827,7 @@ uint16_t hci_number_free_acl_slots_for_connection_type(bd_addr_type_t address_ty
     } else {
         // otherwise, classic slots are used for LE, too
         free_slots_classic -= num_packets_sent_le;
-        btstack_assert(free_slots_classic >= num_packets_sent_le);
+        btstack_assert(free_slots_classic >= 0);
     }
 
     switch (address_type){
@@ -749,9 +899,100 @@ static int hci_can_send_command_packet_transport(void){
     return 1;
 }
 
+// assume that one command can be sent, e.g. after timeout or if Controller does not send Command Complete
+static void hci_reset_num_cmd_packets(void){
+    hci_stack->num_cmd_packets = 1;
+#ifdef ENABLE_HCI_COMMAND_PIPELINING
+    hci_stack->cmd_outstanding_num = 0;
+#endif
+}
+
+#ifdef ENABLE_HCI_COMMAND_PIPELINING
+// commands where the stack does not wait for the result before sending the next command
+static bool hci_command_can_be_pipelined(uint16_t opcode){
+    switch (opcode){
+        case HCI_OPCODE_HCI_LE_SET_ADVERTISING_PARAMETERS:
+        case HCI_OPCODE_HCI_LE_SET_ADVERTISING_DATA:
+        case HCI_OPCODE_HCI_LE_SET_SCAN_RESPONSE_DATA:
+        case HCI_OPCODE_HCI_LE_SET_ADVERTISE_ENABLE:
+        case HCI_OPCODE_HCI_LE_SET_ADVERTISING_SET_RANDOM_ADDRESS:
+        case HCI_OPCODE_HCI_LE_SET_EXTENDED_ADVERTISING_DATA:
+        case HCI_OPCODE_HCI_LE_SET_EXTENDED_SCAN_RESPONSE_DATA:
+        case HCI_OPCODE_HCI_LE_SET_EXTENDED_ADVERTISING_ENABLE:
+        case HCI_OPCODE_HCI_LE_SET_PERIODIC_ADVERTISING_PARAMETERS:
+        case HCI_OPCODE_HCI_LE_SET_PERIODIC_ADVERTISING_DATA:
+        case HCI_OPCODE_HCI_LE_SET_PERIODIC_ADVERTISING_ENABLE:
+        case HCI_OPCODE_HCI_LE_ADD_DEVICE_TO_WHITE_LIST:
+        case HCI_OPCODE_HCI_LE_REMOVE_DEVICE_FROM_WHITE_LIST:
+        case HCI_OPCODE_HCI_LE_ADD_DEVICE_TO_RESOLVING_LIST:
+        case HCI_OPCODE_HCI_LE_REMOVE_DEVICE_FROM_RESOLVING_LIST:
+        case HCI_OPCODE_HCI_LE_SET_PRIVACY_MODE:
+#ifndef ENABLE_HCI_COMMAND_STATUS_DISCARDED_FOR_FAILED_CONNECTIONS_WORKAROUND
+        // workaround tracks con handle of a single pending command
+        case HCI_OPCODE_HCI_LE_CONNECTION_UPDATE:
+        case HCI_OPCODE_HCI_LE_REMOTE_CONNECTION_PARAMETER_REQUEST_REPLY:
+        case HCI_OPCODE_HCI_LE_REMOTE_CONNECTION_PARAMETER_REQUEST_NEGATIVE_REPLY:
+        case HCI_OPCODE_HCI_LE_SET_DATA_LENGTH:
+        case HCI_OPCODE_HCI_LE_SET_PHY:
+#endif
+        case HCI_OPCODE_HCI_WRITE_LINK_SUPERVISION_TIMEOUT:
+        case HCI_OPCODE_HCI_WRITE_LINK_POLICY_SETTINGS:
+        case HCI_OPCODE_HCI_WRITE_CLASS_OF_DEVICE:
+        case HCI_OPCODE_HCI_WRITE_LOCAL_NAME:
+        case HCI_OPCODE_HCI_WRITE_EXTENDED_INQUIRY_RESPONSE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool hci_command_pipeline_ready(void){
+    if (hci_stack->cmd_outstanding_num == 0u) return true;
+    // initialization, halting and falling asleep wait for each command
+    if (hci_stack->state != HCI_STATE_WORKING) return false;
+    if (hci_stack->cmd_outstanding_num >= HCI_COMMAND_PIPELINE_DEPTH) return false;
+    // wait for result of outstanding command
+    uint8_t i;
+    for (i = 0; i < hci_stack->cmd_outstanding_num; i++){
+        if (hci_command_can_be_pipelined(hci_stack->cmd_outstanding_opcodes[i]) == false) return false;
+    }
+    return true;
+}
+
+static void hci_command_pipeline_add(uint16_t opcode){
+    if (hci_stack->cmd_outstanding_num >= HCI_COMMAND_PIPELINE_DEPTH){
+        // command sent without checking hci_can_send_command_packet_now, drop oldest
+        log_error("HCI command pipeline full, opcode %04x", opcode);
+        hci_stack->cmd_outstanding_num--;
+        memmove(&hci_stack->cmd_outstanding_opcodes[0], &hci_stack->cmd_outstanding_opcodes[1], hci_stack->cmd_outstanding_num * sizeof(uint16_t));
+    }
+    hci_stack->cmd_outstanding_opcodes[hci_stack->cmd_outstanding_num++] = opcode;
+}
+
+// handle Command Complete/Status for opcode, opcode 0x0000 only updates number of command packets
+static void hci_command_pipeline_complete(uint16_t opcode, uint8_t num_hci_command_packets){
+    uint8_t i;
+    for (i = 0; i < hci_stack->cmd_outstanding_num; i++){
+        if (hci_stack->cmd_outstanding_opcodes[i] != opcode) continue;
+        hci_stack->cmd_outstanding_num--;
+        memmove(&hci_stack->cmd_outstanding_opcodes[i], &hci_stack->cmd_outstanding_opcodes[i+1], (hci_stack->cmd_outstanding_num - i) * sizeof(uint16_t));
+        break;
+    }
+    // commands sent after this one might not be accounted for by the Controller yet
+    if (num_hci_command_packets > hci_stack->cmd_outstanding_num){
+        hci_stack->num_cmd_packets = num_hci_command_packets - hci_stack->cmd_outstanding_num;
+    } else {
+        hci_stack->num_cmd_packets = 0;
+    }
+}
+#endif
+
 // new functions replacing hci_can_send_packet_now[_using_packet_buffer]
 bool hci_can_send_command_packet_now(void){
     if (hci_can_send_command_packet_transport() == 0) return false;
+#ifdef ENABLE_HCI_COMMAND_PIPELINING
+    if (hci_command_pipeline_ready() == false) return false;
+#endif
     return hci_stack->num_cmd_packets > 0u;
 }
 
@@ -771,11 +1012,20 @@ bool hci_can_send_acl_le_packet_now(void){
     return hci_can_send_prepared_acl_packet_for_address_type(BD_ADDR_TYPE_LE_PUBLIC);
 }
 
-bool hci_can_send_prepared_acl_packet_now(hci_con_handle_t con_handle) {
+static bool hci_can_send_acl_fragment_now(hci_con_handle_t con_handle){
     if (!hci_transport_can_send_prepared_packet_now(HCI_ACL_DATA_PACKET)) return false;
     return hci_number_free_acl_slots_for_handle(con_handle) > 0;
 }
 
+bool hci_can_send_prepared_acl_packet_now(hci_con_handle_t con_handle) {
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+    // next ACL packet has to wait until all fragments of the current one have been sent
+    hci_connection_t * connection = hci_connection_for_handle(con_handle);
+    if ((connection != NULL) && (connection->acl_fragmentation_buffer != NULL)) return false;
+#endif
+    return hci_can_send_acl_fragment_now(con_handle);
+}
+
 bool hci_can_send_acl_packet_now(hci_con_handle_t con_handle){
     if (hci_stack->hci_packet_buffer_reserved) return false;
     return hci_can_send_prepared_acl_packet_now(con_handle);
@@ -868,11 +1118,8 @@ static void hci_controller_dump_packets(void){
 }
 #endif
 
-static uint8_t hci_send_acl_packet_fragments(hci_connection_t *connection){
-
-    // log_info("hci_send_acl_packet_fragments  %u/%u (con 0x%04x)", hci_stack->acl_fragmentation_pos, hci_stack->acl_fragmentation_total_size, connection->con_handle);
-
-    // max ACL data packet length depends on connection type (LE vs. Classic) and available buffers
+// max ACL data packet length depends on connection type (LE vs. Classic) and available buffers
+static uint16_t hci_max_acl_data_packet_length_for_connection(hci_connection_t *connection){
     uint16_t max_acl_data_packet_length = hci_stack->acl_data_packet_length;
     if (hci_is_le_connection(connection) && (hci_stack->le_data_packets_length > 0u)){
         max_acl_data_packet_length = hci_stack->le_data_packets_length;
@@ -883,6 +1130,90 @@ static uint8_t hci_send_acl_packet_fragments(hci_connection_t *connection){
         max_acl_data_packet_length = connection->le_max_tx_octets;
     }
 #endif
+    return max_acl_data_packet_length;
+}
+
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+static void hci_outgoing_acl_buffer_pool_reset(void){
+    hci_stack->hci_packet_buffer = &hci_stack->hci_packet_buffer_data[HCI_OUTGOING_PRE_BUFFER_SIZE];
+    uint8_t i;
+    for (i = 0; i < HCI_OUTGOING_ACL_BUFFER_POOL_SIZE; i++){
+        hci_stack->outgoing_acl_buffer_pool_free[i] = &hci_stack->outgoing_acl_buffer_pool_data[i][HCI_OUTGOING_PRE_BUFFER_SIZE];
+    }
+    hci_stack->outgoing_acl_buffer_pool_num_free = HCI_OUTGOING_ACL_BUFFER_POOL_SIZE;
+    hci_stack->outgoing_acl_buffer_pool_pending_release = NULL;
+}
+
+static void hci_outgoing_acl_buffer_pool_release(uint8_t * buffer){
+    btstack_assert(hci_stack->outgoing_acl_buffer_pool_num_free < HCI_OUTGOING_ACL_BUFFER_POOL_SIZE);
+    hci_stack->outgoing_acl_buffer_pool_free[hci_stack->outgoing_acl_buffer_pool_num_free++] = buffer;
+}
+
+// hand reserved packet buffer over to connection and replace it with a free buffer from the pool
+static bool hci_outgoing_acl_buffer_pool_detach(hci_connection_t * connection){
+    if (hci_stack->outgoing_acl_buffer_pool_num_free == 0u) return false;
+    connection->acl_fragmentation_buffer = hci_stack->hci_packet_buffer;
+    hci_stack->hci_packet_buffer = hci_stack->outgoing_acl_buffer_pool_free[--hci_stack->outgoing_acl_buffer_pool_num_free];
+    // packet buffer is free again, L2CAP retries on HCI_EVENT_TRANSPORT_PACKET_SENT or Number Of Completed Packets
+    hci_stack->hci_packet_buffer_reserved = false;
+    return true;
+}
+
+// all fragments sent, return buffer to pool
+static void hci_outgoing_acl_buffer_pool_fragmentation_done(hci_connection_t * connection){
+    hci_outgoing_acl_buffer_pool_release(connection->acl_fragmentation_buffer);
+    connection->acl_fragmentation_buffer = NULL;
+    connection->acl_fragmentation_tx_active = false;
+}
+
+static void hci_outgoing_acl_buffer_pool_connection_free(hci_connection_t * connection){
+    if (connection->acl_fragmentation_buffer == NULL) return;
+    log_info("drop fragmented ACL data for closed connection 0x%04x", connection->con_handle);
+    if (connection->acl_fragmentation_tx_active && (hci_stack->hci_transport->can_send_packet_now != NULL)){
+        // HCI Transport still uses buffer, release on HCI_EVENT_TRANSPORT_PACKET_SENT
+        btstack_assert(hci_stack->outgoing_acl_buffer_pool_pending_release == NULL);
+        hci_stack->outgoing_acl_buffer_pool_pending_release = connection->acl_fragmentation_buffer;
+        connection->acl_fragmentation_buffer = NULL;
+    } else {
+        hci_outgoing_acl_buffer_pool_fragmentation_done(connection);
+    }
+}
+
+static void hci_outgoing_acl_buffer_pool_packet_sent(void){
+    if (hci_stack->outgoing_acl_buffer_pool_pending_release != NULL){
+        hci_outgoing_acl_buffer_pool_release(hci_stack->outgoing_acl_buffer_pool_pending_release);
+        hci_stack->outgoing_acl_buffer_pool_pending_release = NULL;
+    }
+    btstack_linked_item_t * it;
+    for (it = (btstack_linked_item_t *) hci_stack->connections; it != NULL; it = it->next){
+        hci_connection_t * connection = (hci_connection_t *) it;
+        if (connection->acl_fragmentation_tx_active == false) continue;
+        connection->acl_fragmentation_tx_active = false;
+        if (connection->acl_fragmentation_total_size == 0u){
+            hci_outgoing_acl_buffer_pool_fragmentation_done(connection);
+        }
+    }
+}
+#endif
+
+static uint8_t hci_send_acl_packet_fragments(hci_connection_t *connection){
+
+    // log_info("hci_send_acl_packet_fragments  %u/%u (con 0x%04x)", hci_stack->acl_fragmentation_pos, hci_stack->acl_fragmentation_total_size, connection->con_handle);
+
+    uint16_t max_acl_data_packet_length = hci_max_acl_data_packet_length_for_connection(connection);
+
+    // fragment from shared packet buffer or from pool buffer owned by connection
+    uint8_t  * buffer = hci_stack->hci_packet_buffer;
+    uint16_t * fragmentation_pos = &hci_stack->acl_fragmentation_pos;
+    uint16_t * fragmentation_total_size = &hci_stack->acl_fragmentation_total_size;
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+    bool pool_buffer = connection->acl_fragmentation_buffer != NULL;
+    if (pool_buffer){
+        buffer = connection->acl_fragmentation_buffer;
+        fragmentation_pos = &connection->acl_fragmentation_pos;
+        fragmentation_total_size = &connection->acl_fragmentation_total_size;
+    }
+#endif
 
     log_debug("hci_send_acl_packet_fragments entered");
 
@@ -893,8 +1224,8 @@ static uint8_t hci_send_acl_packet_fragments(hci_connection_t *connection){
         log_debug("hci_send_acl_packet_fragments loop entered");
 
         // get current data
-        const uint16_t acl_header_pos = hci_stack->acl_fragmentation_pos - 4u;
-        int current_acl_data_packet_length = hci_stack->acl_fragmentation_total_size - hci_stack->acl_fragmentation_pos;
+        const uint16_t acl_header_pos = *fragmentation_pos - 4u;
+        int current_acl_data_packet_length = *fragmentation_total_size - *fragmentation_pos;
         bool more_fragments = false;
 
         // if ACL packet is larger than Bluetooth packet buffer, only send max_acl_data_packet_length
@@ -905,33 +1236,41 @@ static uint8_t hci_send_acl_packet_fragments(hci_connection_t *connection){
 
         // copy handle_and_flags if not first fragment and update packet boundary flags to be 01 (continuing fragment)
         if (acl_header_pos > 0u){
-            uint16_t handle_and_flags = little_endian_read_16(hci_stack->hci_packet_buffer, 0);
+            uint16_t handle_and_flags = little_endian_read_16(buffer, 0);
             handle_and_flags = (handle_and_flags & 0xcfffu) | (1u << 12u);
-            little_endian_store_16(hci_stack->hci_packet_buffer, acl_header_pos, handle_and_flags);
+            little_endian_store_16(buffer, acl_header_pos, handle_and_flags);
         }
 
         // update header len
-        little_endian_store_16(hci_stack->hci_packet_buffer, acl_header_pos + 2u, current_acl_data_packet_length);
+        little_endian_store_16(buffer, acl_header_pos + 2u, current_acl_data_packet_length);
         
         // count packet
-        connection->num_packets_sent++;
+        hci_connection_set_num_packets_sent(connection, connection->num_packets_sent + 1u);
         log_debug("hci_send_acl_packet_fragments loop before send (more fragments %d)", (int) more_fragments);
 
         // update state for next fragment (if any) as "transport done" might be sent during send_packet already
         if (more_fragments){
             // update start of next fragment to send
-            hci_stack->acl_fragmentation_pos += current_acl_data_packet_length;
+            *fragmentation_pos += current_acl_data_packet_length;
         } else {
             // done
-            hci_stack->acl_fragmentation_pos = 0;
-            hci_stack->acl_fragmentation_total_size = 0;
+            *fragmentation_pos = 0;
+            *fragmentation_total_size = 0;
         }
 
         // send packet
-        uint8_t * packet = &hci_stack->hci_packet_buffer[acl_header_pos];
+        uint8_t * packet = &buffer[acl_header_pos];
         const int size = current_acl_data_packet_length + 4;
         hci_dump_packet(HCI_ACL_DATA_PACKET, 0, packet, size);
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+        if (pool_buffer){
+            connection->acl_fragmentation_tx_active = true;
+        } else {
+            hci_stack->acl_fragmentation_tx_active = 1;
+        }
+#else
         hci_stack->acl_fragmentation_tx_active = 1;
+#endif
         int err = hci_stack->hci_transport->send_packet(HCI_ACL_DATA_PACKET, packet, size);
         if (err != 0){
             // no error from HCI Transport expected
@@ -949,11 +1288,22 @@ static uint8_t hci_send_acl_packet_fragments(hci_connection_t *connection){
         if (!more_fragments) break;
 
         // can send more?
-        if (!hci_can_send_prepared_acl_packet_now(connection->con_handle)) return status;
+        if (!hci_can_send_acl_fragment_now(connection->con_handle)) return status;
     }
 
     log_debug("hci_send_acl_packet_fragments loop over");
 
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+    if (pool_buffer){
+        // return buffer now for synchronous transport and let L2CAP send next packet for this connection
+        if (hci_transport_synchronous()){
+            hci_outgoing_acl_buffer_pool_fragmentation_done(connection);
+            hci_emit_transport_packet_sent();
+        }
+        return status;
+    }
+#endif
+
     // release buffer now for synchronous transport
     if (hci_transport_synchronous()){
         hci_stack->acl_fragmentation_tx_active = 0;
@@ -990,6 +1340,15 @@ uint8_t hci_send_acl_packet_buffer(int size){
 
     // hci_dump_packet( HCI_ACL_DATA_PACKET, 0, packet, size);
 
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+    // fragment packet from its own buffer, so that packet buffer can be used by other connections meanwhile
+    if (((size - 4) > hci_max_acl_data_packet_length_for_connection(connection)) && hci_outgoing_acl_buffer_pool_detach(connection)){
+        connection->acl_fragmentation_total_size = size;
+        connection->acl_fragmentation_pos = 4;   // start of L2CAP packet
+        return hci_send_acl_packet_fragments(connection);
+    }
+#endif
+
     // setup data
     hci_stack->acl_fragmentation_total_size = size;
     hci_stack->acl_fragmentation_pos = 4;   // start of L2CAP packet
@@ -1167,6 +1526,35 @@ uint8_t hci_send_iso_packet_buffer(uint16_t size){
 }
 #endif
 
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+static bool hci_acl_recombination_buffer_get(hci_connection_t * conn){
+    if (conn->acl_recombination_buffer != NULL) return true;
+    hci_acl_recombination_buffer_t * buffer = (hci_acl_recombination_buffer_t *) btstack_memory_pool_get(&hci_stack->acl_recombination_pool);
+    hci_acl_recombination_pool_statistics_t * statistics = &hci_stack->acl_recombination_pool_statistics;
+    if (buffer == NULL){
+        statistics->pool_exhausted++;
+        return false;
+    }
+    conn->acl_recombination_buffer = buffer->data;
+    statistics->buffers_in_use++;
+    statistics->buffers_in_use_max = btstack_max(statistics->buffers_in_use_max, statistics->buffers_in_use);
+    return true;
+}
+
+static void hci_acl_recombination_buffer_release(hci_connection_t * conn){
+    conn->acl_recombination_pos = 0;
+    conn->acl_recombination_length = 0;
+    if (conn->acl_recombination_buffer == NULL) return;
+    btstack_memory_pool_free(&hci_stack->acl_recombination_pool, conn->acl_recombination_buffer);
+    conn->acl_recombination_buffer = NULL;
+    hci_stack->acl_recombination_pool_statistics.buffers_in_use--;
+}
+
+void hci_get_acl_recombination_pool_statistics(hci_acl_recombination_pool_statistics_t * statistics){
+    *statistics = hci_stack->acl_recombination_pool_statistics;
+}
+#endif
+
 static void acl_handler(uint8_t *packet, uint16_t size){
 
     // get info
@@ -1211,6 +1599,9 @@ static void acl_handler(uint8_t *packet, uint16_t size){
                 log_error( "ACL Cont Fragment to large: combined packet %u > buffer size %u for handle 0x%02x",
                     conn->acl_recombination_pos + acl_length, 4 + HCI_ACL_BUFFER_SIZE, con_handle);
                 conn->acl_recombination_pos = 0;
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+                hci_acl_recombination_buffer_release(conn);
+#endif
                 return;
             }
 
@@ -1225,6 +1616,9 @@ static void acl_handler(uint8_t *packet, uint16_t size){
                 // reset recombination buffer
                 conn->acl_recombination_length = 0;
                 conn->acl_recombination_pos = 0;
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+                hci_acl_recombination_buffer_release(conn);
+#endif
             }
             break;
             
@@ -1244,6 +1638,9 @@ static void acl_handler(uint8_t *packet, uint16_t size){
 
             // compare fragment size to L2CAP packet size
             if (acl_length >= (l2cap_length + 4u)){
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+                hci_acl_recombination_buffer_release(conn);
+#endif
                 // forward fragment as L2CAP packet
                 hci_emit_acl_packet(packet, l2cap_length + 8u);
             } else {
@@ -1254,6 +1651,13 @@ static void acl_handler(uint8_t *packet, uint16_t size){
                     return;
                 }
 
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+                if (hci_acl_recombination_buffer_get(conn) == false){
+                    log_error("ACL First Fragment but no recombination buffer available for handle 0x%02x, dropping packet", con_handle);
+                    return;
+                }
+#endif
+
                 // store first fragment and tweak acl length for complete package
                 (void)memcpy(&conn->acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE],
                              packet, acl_length + 4u);
@@ -1294,8 +1698,7 @@ static void hci_shutdown_connection(hci_connection_t *conn){
 
     hci_connection_stop_timer(conn);
 
-    btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
-    btstack_memory_hci_connection_free( conn );
+    hci_connection_free(conn);
     
     // now it's gone
     hci_emit_nr_connections_changed();
@@ -1813,7 +2216,7 @@ static void hci_initialization_timeout_handler(btstack_timer_source_t * ds){
         case HCI_INIT_W4_SEND_RESET:
             log_info("Resend HCI Reset");
             hci_stack->substate = HCI_INIT_SEND_RESET;
-            hci_stack->num_cmd_packets = 1;
+            hci_reset_num_cmd_packets();
             hci_run();
             break;
         case HCI_INIT_W4_CUSTOM_INIT_CSR_WARM_BOOT_LINK_RESET:
@@ -1827,7 +2230,7 @@ static void hci_initialization_timeout_handler(btstack_timer_source_t * ds){
         case HCI_INIT_W4_CUSTOM_INIT_CSR_WARM_BOOT:
             log_info("Resend HCI Reset - CSR Warm Boot");
             hci_stack->substate = HCI_INIT_SEND_RESET_CSR_WARM_BOOT;
-            hci_stack->num_cmd_packets = 1;
+            hci_reset_num_cmd_packets();
             hci_run();
             break;
         case HCI_INIT_W4_SEND_BAUD_CHANGE:
@@ -1857,6 +2260,179 @@ static void hci_initialization_timeout_handler(btstack_timer_source_t * ds){
 }
 #endif
 
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+#define HCI_CONTROLLER_INFO_CACHE_TAG ((((uint32_t) 'H') << 24u) | (((uint32_t) 'C') << 16u) | (((uint32_t) 'I') << 8u) | ((uint32_t) 'C'))
+
+void hci_set_controller_info_cache_tlv(const btstack_tlv_t * tlv_impl, void * tlv_context){
+    hci_stack->controller_info_cache_tlv_impl = tlv_impl;
+    hci_stack->controller_info_cache_tlv_context = tlv_context;
+}
+
+static void hci_controller_info_cache_get_tlv(const btstack_tlv_t ** tlv_impl, void ** tlv_context){
+    if (hci_stack->controller_info_cache_tlv_impl != NULL){
+        *tlv_impl = hci_stack->controller_info_cache_tlv_impl;
+        *tlv_context = hci_stack->controller_info_cache_tlv_context;
+        return;
+    }
+    btstack_tlv_get_instance(tlv_impl, tlv_context);
+}
+
+// queries that only read static Controller information
+static bool hci_controller_info_cache_opcode_cacheable(uint16_t opcode){
+    switch (opcode){
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_COMMANDS:
+        case HCI_OPCODE_HCI_READ_BUFFER_SIZE:
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_FEATURES:
+        case HCI_OPCODE_HCI_LE_READ_BUFFER_SIZE:
+        case HCI_OPCODE_HCI_LE_READ_BUFFER_SIZE_V2:
+        case HCI_OPCODE_HCI_LE_READ_MAXIMUM_DATA_LENGTH:
+        case HCI_OPCODE_HCI_LE_READ_WHITE_LIST_SIZE:
+        case HCI_OPCODE_HCI_LE_READ_MAXIMUM_ADVERTISING_DATA_LENGTH:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static const uint8_t * hci_controller_info_cache_find(uint16_t opcode, uint16_t * size){
+    hci_controller_info_cache_storage_t * cache = &hci_stack->controller_info_cache;
+    uint16_t pos = 0;
+    while ((pos + 1u + 6u) <= cache->events_len){
+        uint8_t event_len = cache->events[pos];
+        const uint8_t * event = &cache->events[pos + 1u];
+        if (hci_event_command_complete_get_command_opcode(event) == opcode){
+            *size = event_len;
+            return event;
+        }
+        pos += 1u + event_len;
+    }
+    return NULL;
+}
+
+static void hci_controller_info_cache_reset(const uint8_t * local_version_information){
+    hci_stack->controller_info_cache_state = HCI_CONTROLLER_INFO_CACHE_IDLE;
+    hci_stack->controller_info_cache.events_len = 0;
+    (void)memcpy(hci_stack->controller_info_cache.local_version_information, local_version_information, 8);
+}
+
+// Local Version Information received, use stored results if it matches
+static void hci_controller_info_cache_load(const uint8_t * packet){
+    const uint8_t * local_version_information = &packet[OFFSET_OF_DATA_IN_COMMAND_COMPLETE + 1];
+    hci_controller_info_cache_storage_t * cache = &hci_stack->controller_info_cache;
+    hci_controller_info_cache_reset(local_version_information);
+
+    const btstack_tlv_t * tlv_impl = NULL;
+    void * tlv_context;
+    hci_controller_info_cache_get_tlv(&tlv_impl, &tlv_context);
+    if (tlv_impl == NULL) return;
+
+    int size = tlv_impl->get_tag(tlv_context, HCI_CONTROLLER_INFO_CACHE_TAG, (uint8_t *) cache, sizeof(hci_controller_info_cache_storage_t));
+    bool valid = (size >= (int) offsetof(hci_controller_info_cache_storage_t, events))
+            && (cache->events_len <= HCI_CONTROLLER_INFO_CACHE_SIZE)
+            && (size == (int) (offsetof(hci_controller_info_cache_storage_t, events) + cache->events_len))
+            && (memcmp(cache->local_version_information, local_version_information, 8) == 0);
+    if (valid == false){
+        log_info("Controller Info Cache: no entry for this Controller");
+        hci_controller_info_cache_reset(local_version_information);
+        return;
+    }
+    log_info("Controller Info Cache: entry for %s found, verify BD_ADDR", bd_addr_to_str(cache->bd_addr));
+    hci_stack->controller_info_cache_state = HCI_CONTROLLER_INFO_CACHE_CANDIDATE;
+}
+
+// BD_ADDR received, returns false if Local Supported Commands were taken from cache of another Controller
+static bool hci_controller_info_cache_verify_bd_addr(void){
+    hci_controller_info_cache_storage_t * cache = &hci_stack->controller_info_cache;
+    if (hci_stack->controller_info_cache_state == HCI_CONTROLLER_INFO_CACHE_CANDIDATE){
+        if (bd_addr_cmp(cache->bd_addr, hci_stack->local_bd_addr) == 0){
+            log_info("Controller Info Cache: BD_ADDR matches, use cached results");
+            hci_stack->controller_info_cache_state = HCI_CONTROLLER_INFO_CACHE_VALID;
+            return true;
+        }
+        log_info("Controller Info Cache: BD_ADDR differs, read Local Supported Commands again");
+        uint8_t local_version_information[8];
+        (void)memcpy(local_version_information, cache->local_version_information, 8);
+        hci_controller_info_cache_reset(local_version_information);
+        bd_addr_copy(cache->bd_addr, hci_stack->local_bd_addr);
+        return false;
+    }
+    bd_addr_copy(cache->bd_addr, hci_stack->local_bd_addr);
+    return true;
+}
+
+// store result of query sent to Controller
+static void hci_controller_info_cache_record(const uint8_t * packet, uint16_t size){
+    if (hci_stack->controller_info_cache_state == HCI_CONTROLLER_INFO_CACHE_CANDIDATE) return;
+    if (hci_event_packet_get_type(packet) != HCI_EVENT_COMMAND_COMPLETE) return;
+    uint16_t opcode = hci_event_command_complete_get_command_opcode(packet);
+    if (hci_controller_info_cache_opcode_cacheable(opcode) == false) return;
+    if (hci_event_command_complete_get_return_parameters(packet)[0] != ERROR_CODE_SUCCESS) return;
+    hci_controller_info_cache_storage_t * cache = &hci_stack->controller_info_cache;
+    uint16_t cached_size;
+    if (hci_controller_info_cache_find(opcode, &cached_size) != NULL) return;
+    if ((size > 255u) || ((cache->events_len + 1u + size) > HCI_CONTROLLER_INFO_CACHE_SIZE)){
+        log_info("Controller Info Cache: no space for opcode %04x", opcode);
+        return;
+    }
+    cache->events[cache->events_len] = (uint8_t) size;
+    (void)memcpy(&cache->events[cache->events_len + 1u], packet, size);
+    cache->events_len += 1u + size;
+    hci_stack->controller_info_cache_dirty = true;
+}
+
+// answer query from cache, returns true if cached Command Complete was processed instead of sending the command
+static bool hci_controller_info_cache_replay(uint16_t opcode){
+    switch (hci_stack->controller_info_cache_state){
+        case HCI_CONTROLLER_INFO_CACHE_VALID:
+            break;
+        case HCI_CONTROLLER_INFO_CACHE_CANDIDATE:
+            // BD_ADDR is read after Local Supported Commands
+            if (opcode == HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_COMMANDS) break;
+            return false;
+        default:
+            return false;
+    }
+    uint16_t size;
+    const uint8_t * event = hci_controller_info_cache_find(opcode, &size);
+    if (event == NULL) return false;
+
+    log_info("Controller Info Cache: use cached result for opcode %04x", opcode);
+    uint8_t packet[255];
+    (void)memcpy(packet, event, size);
+    // keep current number of HCI command packets
+    packet[2] = hci_stack->num_cmd_packets;
+    hci_stack->last_cmd_opcode = opcode;
+    hci_stack->controller_info_cache_replayed = true;
+    // process like a received event, but without hci_run, as hci_initializing_run continues with next substate
+    hci_dump_packet(HCI_EVENT_PACKET, 1, packet, size);
+    handle_command_complete_event(packet, size);
+    hci_initializing_event_handler(packet, size);
+    hci_emit_event(packet, size, 0);
+    return true;
+}
+
+static void hci_controller_info_cache_store(void){
+    if (hci_stack->controller_info_cache_dirty == false) return;
+    hci_stack->controller_info_cache_dirty = false;
+    const btstack_tlv_t * tlv_impl = NULL;
+    void * tlv_context;
+    hci_controller_info_cache_get_tlv(&tlv_impl, &tlv_context);
+    if (tlv_impl == NULL) return;
+    hci_controller_info_cache_storage_t * cache = &hci_stack->controller_info_cache;
+    uint32_t size = offsetof(hci_controller_info_cache_storage_t, events) + cache->events_len;
+    int result = tlv_impl->store_tag(tlv_context, HCI_CONTROLLER_INFO_CACHE_TAG, (const uint8_t *) cache, size);
+    log_info("Controller Info Cache: store %u bytes, result %d", (int) size, result);
+}
+#endif
+
+// send query during initialization or answer it from cache
+static void hci_initializing_send_query(const hci_cmd_t * cmd){
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+    if (hci_controller_info_cache_replay(cmd->opcode)) return;
+#endif
+    hci_send_cmd(cmd);
+}
+
 static void hci_initializing_next_state(void){
     hci_stack->substate = (hci_substate_t )( ((int) hci_stack->substate) + 1);
 }
@@ -1866,10 +2442,14 @@ static void hci_init_done(void){
     log_info("hci_init_done -> HCI_STATE_WORKING");
     hci_stack->state = HCI_STATE_WORKING;
     hci_emit_state();
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+    // store after app had a chance to set TLV in HCI_STATE_WORKING handler
+    hci_controller_info_cache_store();
+#endif
 }
 
 // assumption: hci_can_send_command_packet_now() == true
-static void hci_initializing_run(void){
+static void hci_initializing_run_substate(void){
     log_debug("hci_initializing_run: substate %u, can send %u", hci_stack->substate, hci_can_send_command_packet_now());
 
     if (!hci_can_send_command_packet_now()) return;
@@ -2046,7 +2626,7 @@ static void hci_initializing_run(void){
 
         case HCI_INIT_READ_LOCAL_SUPPORTED_COMMANDS:
             hci_stack->substate = HCI_INIT_W4_READ_LOCAL_SUPPORTED_COMMANDS;
-            hci_send_cmd(&hci_read_local_supported_commands);
+            hci_initializing_send_query(&hci_read_local_supported_commands);
             break;       
         case HCI_INIT_READ_BD_ADDR:
             hci_stack->substate = HCI_INIT_W4_READ_BD_ADDR;
@@ -2056,7 +2636,7 @@ static void hci_initializing_run(void){
             // only read buffer size if supported
             if (hci_command_supported(SUPPORTED_HCI_COMMAND_READ_BUFFER_SIZE)){
                 hci_stack->substate = HCI_INIT_W4_READ_BUFFER_SIZE;
-                hci_send_cmd(&hci_read_buffer_size);
+                hci_initializing_send_query(&hci_read_buffer_size);
                 break;
             }
 
@@ -2064,7 +2644,7 @@ static void hci_initializing_run(void){
 
         case HCI_INIT_READ_LOCAL_SUPPORTED_FEATURES:
             hci_stack->substate = HCI_INIT_W4_READ_LOCAL_SUPPORTED_FEATURES;
-            hci_send_cmd(&hci_read_local_supported_features);
+            hci_initializing_send_query(&hci_read_local_supported_features);
             break;                
 
 #ifdef ENABLE_HCI_CONTROLLER_TO_HOST_FLOW_CONTROL
@@ -2270,9 +2850,9 @@ static void hci_initializing_run(void){
             if (hci_le_supported()){
                 hci_stack->substate = HCI_INIT_W4_LE_READ_BUFFER_SIZE;
                 if (hci_command_supported(SUPPORTED_HCI_COMMAND_LE_READ_BUFFER_SIZE_V2)){
-                    hci_send_cmd(&hci_le_read_buffer_size_v2);
+                    hci_initializing_send_query(&hci_le_read_buffer_size_v2);
                 } else {
-                    hci_send_cmd(&hci_le_read_buffer_size);
+                    hci_initializing_send_query(&hci_le_read_buffer_size);
                 }
                 break;
             }
@@ -2310,7 +2890,7 @@ static void hci_initializing_run(void){
             if (hci_le_supported()
             && hci_command_supported(SUPPORTED_HCI_COMMAND_LE_READ_MAXIMUM_DATA_LENGTH)) {
                 hci_stack->substate = HCI_INIT_W4_LE_READ_MAX_DATA_LENGTH;
-                hci_send_cmd(&hci_le_read_maximum_data_length);
+                hci_initializing_send_query(&hci_le_read_maximum_data_length);
                 break;
             }
 
@@ -2331,7 +2911,7 @@ static void hci_initializing_run(void){
         case HCI_INIT_READ_WHITE_LIST_SIZE:
             if (hci_le_supported()){
                 hci_stack->substate = HCI_INIT_W4_READ_WHITE_LIST_SIZE;
-                hci_send_cmd(&hci_le_read_white_list_size);
+                hci_initializing_send_query(&hci_le_read_white_list_size);
                 break;
             }
             
@@ -2344,7 +2924,7 @@ static void hci_initializing_run(void){
         case HCI_INIT_LE_READ_MAX_ADV_DATA_LEN:
             if (hci_le_extended_advertising_supported()){
                 hci_stack->substate = HCI_INIT_W4_LE_READ_MAX_ADV_DATA_LEN;
-                hci_send_cmd(&hci_le_read_maximum_advertising_data_length);
+                hci_initializing_send_query(&hci_le_read_maximum_advertising_data_length);
                 break;
             }
 #endif
@@ -2399,6 +2979,18 @@ static void hci_initializing_run(void){
     }
 }
 
+static void hci_initializing_run(void){
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+    // queries answered from cache advance the substate without sending a command
+    do {
+        hci_stack->controller_info_cache_replayed = false;
+        hci_initializing_run_substate();
+    } while (hci_stack->controller_info_cache_replayed && (hci_stack->state == HCI_STATE_INITIALIZING));
+#else
+    hci_initializing_run_substate();
+#endif
+}
+
 static bool hci_initializing_event_handler_command_completed(const uint8_t * packet){
     bool command_completed = false;
     if (hci_event_packet_get_type(packet) == HCI_EVENT_COMMAND_COMPLETE){
@@ -2437,7 +3029,7 @@ static bool hci_initializing_event_handler_command_completed(const uint8_t * pac
         // TODO: track actual command
         command_completed = true;
         // Fix: no HCI Command Complete received, so num_cmd_packets not reset
-        hci_stack->num_cmd_packets = 1;
+        hci_reset_num_cmd_packets();
     }
 #endif
 
@@ -2507,6 +3099,29 @@ static void hci_initializing_event_handler(const uint8_t * packet, uint16_t size
 
     if (!command_completed) return;
 
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+    if (hci_event_packet_get_type(packet) == HCI_EVENT_COMMAND_COMPLETE){
+        switch (hci_stack->substate){
+            case HCI_INIT_W4_SEND_READ_LOCAL_VERSION_INFORMATION:
+                if (hci_event_command_complete_get_return_parameters(packet)[0] == ERROR_CODE_SUCCESS){
+                    hci_controller_info_cache_load(packet);
+                }
+                break;
+            case HCI_INIT_W4_READ_BD_ADDR:
+                if (hci_controller_info_cache_verify_bd_addr() == false){
+                    hci_stack->substate = HCI_INIT_READ_LOCAL_SUPPORTED_COMMANDS;
+                    return;
+                }
+                break;
+            default:
+                if (hci_stack->controller_info_cache_replayed == false){
+                    hci_controller_info_cache_record(packet, size);
+                }
+                break;
+        }
+    }
+#endif
+
     bool need_baud_change = false;
     bool need_addr_change = false;
 
@@ -2638,8 +3253,7 @@ static void hci_handle_connection_failed(hci_connection_t * conn, uint8_t status
 #endif
     
     // connection failed, remove entry
-    btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
-    btstack_memory_hci_connection_free( conn );
+    hci_connection_free(conn);
 
 #ifdef ENABLE_CLASSIC
     // notify client if dedicated bonding
@@ -2820,8 +3434,12 @@ static void handle_command_complete_event(uint8_t * packet, uint16_t size){
     hci_stack->hci_command_con_handle = HCI_CON_HANDLE_INVALID;
 #endif
 
+#ifdef ENABLE_HCI_COMMAND_PIPELINING
+    hci_command_pipeline_complete(hci_event_command_complete_get_command_opcode(packet), packet[2]);
+#else
     // get num cmd packets - limit to 1 to reduce complexity
     hci_stack->num_cmd_packets = packet[2] ? 1 : 0;
+#endif
 
     uint16_t opcode = hci_event_command_complete_get_command_opcode(packet);
     switch (opcode){
@@ -3246,8 +3864,12 @@ static void hci_iso_big_sync_failed(const le_audio_big_sync_t *big_sync, uint8_t
 static void handle_command_status_event(uint8_t * packet, uint16_t size) {
     UNUSED(size);
 
+#ifdef ENABLE_HCI_COMMAND_PIPELINING
+    hci_command_pipeline_complete(hci_event_command_status_get_command_opcode(packet), packet[3]);
+#else
     // get num cmd packets - limit to 1 to reduce complexity
     hci_stack->num_cmd_packets = packet[3] ? 1 : 0;
+#endif
 
     // get opcode and command status
     uint16_t opcode = hci_event_command_status_get_command_opcode(packet);
@@ -3412,8 +4034,7 @@ static void hci_handle_le_connection_complete_event(const uint8_t * hci_event){
         bool cancelled_by_user = hci_stack->le_connecting_request == LE_CONNECTING_IDLE;
 		if ((conn != NULL) && cancelled_by_user){
 			// remove entry
-			btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
-			btstack_memory_hci_connection_free( conn );
+			hci_connection_free(conn);
 		}
 
         // emit GAP_SUBEVENT_LE_CONNECTION_COMPLETE for:
@@ -3464,8 +4085,18 @@ static void hci_handle_le_connection_complete_event(const uint8_t * hci_event){
             // set missing peer address + address type
             conn = hci_connection_for_handle(con_handle);
             if (conn != NULL){
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+                hci_connection_index_remove_address(conn);
+#endif
+                // keep in-flight ACL packet totals in sync with address type
+                uint8_t num_packets_sent = conn->num_packets_sent;
+                hci_connection_set_num_packets_sent(conn, 0);
                 memcpy(conn->address, addr, 6);
                 conn->address_type = addr_type;
+                hci_connection_set_num_packets_sent(conn, num_packets_sent);
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+                hci_connection_index_add_address(conn);
+#endif
             }
         }
         else
@@ -3488,7 +4119,7 @@ static void hci_handle_le_connection_complete_event(const uint8_t * hci_event){
 	}
 
 	conn->state = OPEN;
-	conn->con_handle             = con_handle;
+    hci_connection_set_con_handle(conn, con_handle);
     conn->le_connection_interval = conn_interval;
 
 #ifdef ENABLE_LE_ISOCHRONOUS_STREAMS
@@ -3706,10 +4337,10 @@ static void event_handler(uint8_t *packet, uint16_t size){
                 if (conn != NULL) {
 
                     if (conn->num_packets_sent >= num_packets) {
-                        conn->num_packets_sent -= num_packets;
+                        hci_connection_set_num_packets_sent(conn, conn->num_packets_sent - num_packets);
                     } else {
                         log_error("hci_number_completed_packets, more packet slots freed then sent.");
-                        conn->num_packets_sent = 0;
+                        hci_connection_set_num_packets_sent(conn, 0);
                     }
                     // log_info("hci_number_completed_packet %u processed for handle %u, outstanding %u", num_packets, handle, conn->num_packets_sent);
 #ifdef ENABLE_CLASSIC
@@ -3853,7 +4484,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
                 }
                 if (!packet[2]){
                     conn->state = OPEN;
-                    conn->con_handle = little_endian_read_16(packet, 3);
+                    hci_connection_set_con_handle(conn, little_endian_read_16(packet, 3));
 
                     // trigger write supervision timeout if we're master
                     if ((hci_stack->link_supervision_timeout != HCI_LINK_SUPERVISION_TIMEOUT_DEFAULT) && (conn->role == HCI_ROLE_MASTER)){
@@ -3899,7 +4530,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
             }
 
             conn->state = OPEN;
-            conn->con_handle = little_endian_read_16(packet, 3);            
+            hci_connection_set_con_handle(conn, little_endian_read_16(packet, 3));
 
             // update sco payload length for eSCO connections
             if (hci_event_synchronous_connection_complete_get_tx_packet_length(packet) > 0){
@@ -4308,7 +4939,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
                 // but the connection has failed anyway, so for now, we only set the num hci commands back to 1
                 log_info("Disconnect for conn handle 0x%04x in pending HCI command, assume command failed", handle);
                 hci_stack->hci_command_con_handle = HCI_CON_HANDLE_INVALID;
-                hci_stack->num_cmd_packets = 1;
+                hci_reset_num_cmd_packets();
             }
 #endif
 
@@ -4327,6 +4958,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
             // mark connection for shutdown, stop timers, reset state
             conn->state = RECEIVED_DISCONNECTION_COMPLETE;
             hci_connection_stop_timer(conn);
+            hci_connection_set_num_packets_sent(conn, 0);
             hci_connection_init(conn);
 
 #ifdef ENABLE_BLE
@@ -4368,6 +5000,9 @@ static void event_handler(uint8_t *packet, uint16_t size){
                 return; // instead of break: to avoid re-entering hci_run()
             }
             hci_stack->acl_fragmentation_tx_active = 0;
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+            hci_outgoing_acl_buffer_pool_packet_sent();
+#endif
 #ifdef ENABLE_LE_ISOCHRONOUS_STREAMS
             hci_stack->iso_fragmentation_tx_active = 0;
             if (hci_stack->iso_fragmentation_total_size) break;
@@ -4446,7 +5081,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
                             conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_UNKNOWN, HCI_ROLE_SLAVE);
                             if (conn != NULL){
                                 conn->state = ANNOUNCED;
-                                conn->con_handle = handle;
+                                hci_connection_set_con_handle(conn, handle);
                             }
                         }
                     }
@@ -4692,7 +5327,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
             // To avoid getting stuck as num_cmds_packets is zero, reset it to 1 for controllers with this behaviour
             switch (hci_stack->manufacturer){
                 case BLUETOOTH_COMPANY_ID_CAMBRIDGE_SILICON_RADIO:
-                    hci_stack->num_cmd_packets = 1;
+                    hci_reset_num_cmd_packets();
                     break;
                 default:
                     break;
@@ -4880,6 +5515,9 @@ static void hci_state_reset(void){
 
     // buffer is free
     hci_stack->hci_packet_buffer_reserved = false;
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+    hci_outgoing_acl_buffer_pool_reset();
+#endif
 
     // no pending cmds
     hci_stack->decline_reason = 0;
@@ -4973,6 +5611,14 @@ void hci_init(const hci_transport_t *transport, const void *config){
     // setup pointer for outgoing packet buffer
     hci_stack->hci_packet_buffer = &hci_stack->hci_packet_buffer_data[HCI_OUTGOING_PRE_BUFFER_SIZE];
 
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+    btstack_memory_pool_create(&hci_stack->acl_recombination_pool, hci_stack->acl_recombination_pool_storage,
+                               HCI_ACL_RECOMBINATION_POOL_SIZE, sizeof(hci_acl_recombination_buffer_t));
+#endif
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+    hci_outgoing_acl_buffer_pool_reset();
+#endif
+
     // max acl payload size defined in config.h
     hci_stack->acl_data_packet_length = HCI_ACL_PAYLOAD_SIZE;
     
@@ -5364,7 +6010,12 @@ static int hci_power_control_wake(void){
 
 static void hci_power_enter_initializing_state(void){
     // set up state machine
-    hci_stack->num_cmd_packets = 1; // assume that one cmd can be sent
+    hci_reset_num_cmd_packets();
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+    hci_stack->controller_info_cache_state = HCI_CONTROLLER_INFO_CACHE_IDLE;
+    hci_stack->controller_info_cache_dirty = false;
+    hci_stack->controller_info_cache.events_len = 0;
+#endif
     hci_stack->hci_packet_buffer_reserved = false;
     hci_stack->state = HCI_STATE_INITIALIZING;
 
@@ -5884,11 +6535,22 @@ static void hci_halting_timeout_handler(btstack_timer_source_t * ds){
 }   
 
 static bool hci_run_acl_fragments(void){
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+    btstack_linked_item_t * it;
+    for (it = (btstack_linked_item_t *) hci_stack->connections; it != NULL; it = it->next){
+        hci_connection_t * connection = (hci_connection_t *) it;
+        if (connection->acl_fragmentation_total_size == 0u) continue;
+        if (hci_can_send_acl_fragment_now(connection->con_handle)){
+            hci_send_acl_packet_fragments(connection);
+            return true;
+        }
+    }
+#endif
     if (hci_stack->acl_fragmentation_total_size > 0u) {
         hci_con_handle_t con_handle = READ_ACL_CONNECTION_HANDLE(hci_stack->hci_packet_buffer);
         hci_connection_t *connection = hci_connection_for_handle(con_handle);
         if (connection) {
-            if (hci_can_send_prepared_acl_packet_now(con_handle)){
+            if (hci_can_send_acl_fragment_now(con_handle)){
                 hci_send_acl_packet_fragments(connection);
                 return true;
             }
@@ -7672,7 +8334,22 @@ static void hci_run(void){
     }
 #endif
 
-    if (!hci_can_send_command_packet_now()) return;
+#ifdef ENABLE_HCI_COMMAND_PIPELINING
+    // keep sending commands as long as Controller and command pipeline accept them
+    uint8_t num_cmd_packets;
+    do {
+        num_cmd_packets = hci_stack->num_cmd_packets;
+        done = hci_run_commands();
+    } while (done && (hci_stack->num_cmd_packets < num_cmd_packets) && (hci_stack->state == HCI_STATE_WORKING));
+#else
+    (void) hci_run_commands();
+#endif
+}
+
+static bool hci_run_commands(void){
+    bool done;
+
+    if (!hci_can_send_command_packet_now()) return false;
 
     // global/non-connection oriented commands
 
@@ -7680,23 +8357,23 @@ static void hci_run(void){
 #ifdef ENABLE_CLASSIC
     // general gap classic
     done = hci_run_general_gap_classic();
-    if (done) return;
+    if (done) return true;
 #endif
 
 #ifdef ENABLE_BLE
     // general gap le
     done = hci_run_general_gap_le();
-    if (done) return;
+    if (done) return true;
 
 #ifdef ENABLE_LE_ISOCHRONOUS_STREAMS
     // ISO related tasks, e.g. BIG create/terminate/sync
     done = hci_run_iso_tasks();
-    if (done) return;
+    if (done) return true;
 #endif
 #endif
 
     // send pending HCI commands
-    hci_run_general_pending_commands();
+    return hci_run_general_pending_commands();
 }
 
 #ifdef ENABLE_CLASSIC
@@ -7936,6 +8613,9 @@ uint8_t hci_send_cmd_packet(uint8_t *packet, int size){
     }
 
     hci_stack->num_cmd_packets--;
+#ifdef ENABLE_HCI_COMMAND_PIPELINING
+    hci_command_pipeline_add(opcode);
+#endif
 
     hci_dump_packet(HCI_COMMAND_DATA_PACKET, 0, packet, size);
     int err = hci_stack->hci_transport->send_packet(HCI_COMMAND_DATA_PACKET, packet, size);
@@ -8636,8 +9316,7 @@ uint8_t gap_connect_cancel(void){
                     case SEND_CREATE_CONNECTION:
                         // skip sending create connection and emit event instead
                         hci_emit_le_connection_complete(conn->address_type, conn->address, 0, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
-                        btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
-                        btstack_memory_hci_connection_free( conn );
+                        hci_connection_free(conn);
                         break;
                     case SENT_CREATE_CONNECTION:
                         // let hci_run_general_gap_le cancel outgoing connection
@@ -10900,47 +11579,43 @@ void hci_setup_test_connections_fuzz(void){
     // setup incoming Classic ACL connection with con handle 0x0001, 66:55:44:33:22:01
     addr[5] = 0x01;
     conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_ACL, HCI_ROLE_SLAVE);
-    conn->con_handle = addr[5];
+    hci_connection_set_con_handle(conn, addr[5]);
     conn->state = RECEIVED_CONNECTION_REQUEST;
     conn->sm_connection.sm_role = HCI_ROLE_SLAVE;
 
     // setup incoming Classic SCO connection with con handle 0x0002
     addr[5] = 0x02;
     conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_SCO, HCI_ROLE_SLAVE);
-    conn->con_handle = addr[5];
+    hci_connection_set_con_handle(conn, addr[5]);
     conn->state = RECEIVED_CONNECTION_REQUEST;
     conn->sm_connection.sm_role = HCI_ROLE_SLAVE;
 
     // setup ready Classic ACL connection with con handle 0x0003
     addr[5] = 0x03;
     conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_ACL, HCI_ROLE_SLAVE);
-    conn->con_handle = addr[5];
+    hci_connection_set_con_handle(conn, addr[5]);
     conn->state = OPEN;
     conn->sm_connection.sm_role = HCI_ROLE_SLAVE;
 
     // setup ready Classic SCO connection with con handle 0x0004
     addr[5] = 0x04;
     conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_SCO, HCI_ROLE_SLAVE);
-    conn->con_handle = addr[5];
+    hci_connection_set_con_handle(conn, addr[5]);
     conn->state = OPEN;
     conn->sm_connection.sm_role = HCI_ROLE_SLAVE;
 
     // setup ready LE ACL connection with con handle 0x005 and public address
     addr[5] = 0x05;
     conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_LE_PUBLIC, HCI_ROLE_SLAVE);
-    conn->con_handle = addr[5];
+    hci_connection_set_con_handle(conn, addr[5]);
     conn->state = OPEN;
     conn->sm_connection.sm_role = HCI_ROLE_SLAVE;
     conn->sm_connection.sm_connection_encrypted = 1;
 }
 
 void hci_free_connections_fuzz(void){
-    btstack_linked_list_iterator_t it;
-    btstack_linked_list_iterator_init(&it, &hci_stack->connections);
-    while (btstack_linked_list_iterator_has_next(&it)){
-        hci_connection_t * con = (hci_connection_t*) btstack_linked_list_iterator_next(&it);
-        btstack_linked_list_iterator_remove(&it);
-        btstack_memory_hci_connection_free(con);
+    while (hci_stack->connections != NULL){
+        hci_connection_free((hci_connection_t *) hci_stack->connections);
     }
 }
 void hci_simulate_working_fuzz(void){
@@ -49,6 +49,7 @@
 #include "btstack_chipset.h"
 #include "btstack_control.h"
 #include "btstack_linked_list.h"
+#include "btstack_memory_pool.h"
 #include "btstack_util.h"
 #include "hci_cmd.h"
 #include "gap.h"
@@ -67,6 +68,10 @@
 #include "btstack_sco_transport.h"
 #endif
 
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+#include "btstack_tlv.h"
+#endif
+
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -168,6 +173,44 @@ extern "C" {
 #endif
 #endif
 
+// number of hash buckets used to find connections by handle and by address, must be a power of two
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+#ifndef HCI_CONNECTION_INDEX_SIZE
+#define HCI_CONNECTION_INDEX_SIZE 16
+#endif
+#if (HCI_CONNECTION_INDEX_SIZE & (HCI_CONNECTION_INDEX_SIZE - 1)) != 0
+#error "HCI_CONNECTION_INDEX_SIZE must be a power of two"
+#endif
+#endif
+
+// number of ACL recombination buffers shared by all connections
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+#ifndef HCI_ACL_RECOMBINATION_POOL_SIZE
+#define HCI_ACL_RECOMBINATION_POOL_SIZE 2
+#endif
+#endif
+
+// number of additional outgoing packet buffers, used to send fragmented ACL packets while other connections send
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+#ifndef HCI_OUTGOING_ACL_BUFFER_POOL_SIZE
+#define HCI_OUTGOING_ACL_BUFFER_POOL_SIZE 2
+#endif
+#endif
+
+// max number of HCI commands sent without Command Complete or Command Status event
+#ifdef ENABLE_HCI_COMMAND_PIPELINING
+#ifndef HCI_COMMAND_PIPELINE_DEPTH
+#define HCI_COMMAND_PIPELINE_DEPTH 4
+#endif
+#endif
+
+// max size of stored Command Complete events for ENABLE_HCI_CONTROLLER_INFO_CACHE
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+#ifndef HCI_CONTROLLER_INFO_CACHE_SIZE
+#define HCI_CONTROLLER_INFO_CACHE_SIZE 200
+#endif
+#endif
+
 // 
 #define IS_COMMAND(packet, command) ( little_endian_read_16(packet,0) == command.opcode )
 
@@ -480,6 +523,13 @@ typedef struct sm_connection {
 #define ATT_REQUEST_BUFFER_SIZE HCI_ACL_PAYLOAD_SIZE
 #endif
 
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+// queued notifications per connection, default allows to fill one max size PDU
+#ifndef ATT_SERVER_NOTIFICATION_QUEUE_SIZE
+#define ATT_SERVER_NOTIFICATION_QUEUE_SIZE ATT_REQUEST_BUFFER_SIZE
+#endif
+#endif
+
 typedef enum {
     ATT_SERVER_IDLE,
     ATT_SERVER_REQUEST_RECEIVED,
@@ -518,6 +568,18 @@ typedef struct {
     uint16_t                request_size;
     uint8_t                 request_buffer[ATT_REQUEST_BUFFER_SIZE];
 
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+    // queued notifications: handle, value len, value
+    btstack_context_callback_registration_t notification_queue_request;
+    bool                    multiple_notifications_supported;
+    uint16_t                notification_queue_len;
+    uint8_t                 notification_queue[ATT_SERVER_NOTIFICATION_QUEUE_SIZE];
+    uint32_t                notifications_queued;
+    uint32_t                notifications_rejected;
+    uint32_t                notification_pdus_sent;
+    uint32_t                notification_pdus_saved;
+#endif
+
 } att_server_t;
 
 #endif
@@ -537,11 +599,55 @@ typedef struct {
     uint16_t                  fixed_channels_supported;    // Core V5.3 - only first octet used
 } l2cap_state_t;
 
-//
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+typedef union {
+    // used by btstack_memory_pool while block is free, ensures pointer alignment
+    void *   next_free;
+    // PRE_BUFFER + ACL Header + ACL payload
+    uint8_t  data[HCI_INCOMING_PRE_BUFFER_SIZE + 4 + HCI_ACL_BUFFER_SIZE];
+} hci_acl_recombination_buffer_t;
+
 typedef struct {
+    // buffers currently used by connections
+    uint16_t buffers_in_use;
+    // max number of buffers used at the same time
+    uint16_t buffers_in_use_max;
+    // fragmented packets dropped as no buffer was available
+    uint32_t pool_exhausted;
+} hci_acl_recombination_pool_statistics_t;
+#endif
+
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+typedef enum {
+    // no stored results used, record results of queries
+    HCI_CONTROLLER_INFO_CACHE_IDLE = 0,
+    // Local Version Information matches, BD_ADDR not verified yet
+    HCI_CONTROLLER_INFO_CACHE_CANDIDATE,
+    // Local Version Information and BD_ADDR match, queries are answered from cache
+    HCI_CONTROLLER_INFO_CACHE_VALID,
+} hci_controller_info_cache_state_t;
+
+typedef struct {
+    // HCI Version, HCI Revision, LMP Version, Manufacturer, LMP Subversion as in Command Complete event
+    uint8_t   local_version_information[8];
+    bd_addr_t bd_addr;
+    uint16_t  events_len;
+    // Command Complete events of cached queries, each prefixed with its length
+    uint8_t   events[HCI_CONTROLLER_INFO_CACHE_SIZE];
+} hci_controller_info_cache_storage_t;
+#endif
+
+//
+typedef struct hci_connection {
     // linked list - assert: first field
     btstack_linked_item_t    item;
-    
+
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    // next connection in same con handle / address bucket
+    struct hci_connection * index_next_by_handle;
+    struct hci_connection * index_next_by_address;
+#endif
+
     // remote side
     bd_addr_t address;
     
@@ -639,7 +745,12 @@ typedef struct {
     uint32_t timestamp;
 
     // ACL packet recombination - PRE_BUFFER + ACL Header + ACL payload
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+    // taken from pool while a fragmented packet is received
+    uint8_t * acl_recombination_buffer;
+#else
     uint8_t  acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + 4 + HCI_ACL_BUFFER_SIZE];
+#endif
     uint16_t acl_recombination_pos;
     uint16_t acl_recombination_length;
     
@@ -651,6 +762,14 @@ typedef struct {
     uint8_t num_packets_completed;
 #endif
 
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+    // outgoing ACL packet fragmented from pool buffer - PRE_BUFFER + ACL Header + ACL payload
+    uint8_t * acl_fragmentation_buffer;
+    uint16_t  acl_fragmentation_pos;
+    uint16_t  acl_fragmentation_total_size;
+    bool      acl_fragmentation_tx_active;
+#endif
+
     // LE Connection parameter update
     le_con_parameter_update_state_t le_con_parameter_update_state;
     uint8_t  le_con_param_update_identifier;
@@ -1032,6 +1151,12 @@ typedef struct {
     // list of existing baseband connections
     btstack_linked_list_t     connections;
 
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    // hash buckets for connections by con handle and by address
+    hci_connection_t *        connection_index_by_handle[HCI_CONNECTION_INDEX_SIZE];
+    hci_connection_t *        connection_index_by_address[HCI_CONNECTION_INDEX_SIZE];
+#endif
+
     /* callback to L2CAP layer */
     btstack_packet_handler_t acl_packet_handler;
 
@@ -1128,9 +1253,40 @@ typedef struct {
     uint16_t  acl_fragmentation_pos;
     uint16_t  acl_fragmentation_total_size;
     uint8_t   acl_fragmentation_tx_active;
+
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+    hci_acl_recombination_buffer_t acl_recombination_pool_storage[HCI_ACL_RECOMBINATION_POOL_SIZE];
+    btstack_memory_pool_t          acl_recombination_pool;
+    hci_acl_recombination_pool_statistics_t acl_recombination_pool_statistics;
+#endif
+
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+    const btstack_tlv_t * controller_info_cache_tlv_impl;
+    void *                controller_info_cache_tlv_context;
+    hci_controller_info_cache_state_t   controller_info_cache_state;
+    hci_controller_info_cache_storage_t controller_info_cache;
+    // new query results need to be stored
+    bool controller_info_cache_dirty;
+    // query answered from cache in current hci_initializing_run iteration
+    bool controller_info_cache_replayed;
+#endif
+
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+    // additional packet buffers, hci_packet_buffer is swapped with a free one when a fragmented ACL packet is sent
+    uint8_t   outgoing_acl_buffer_pool_data[HCI_OUTGOING_ACL_BUFFER_POOL_SIZE][HCI_OUTGOING_PRE_BUFFER_SIZE + HCI_OUTGOING_PACKET_BUFFER_SIZE];
+    uint8_t * outgoing_acl_buffer_pool_free[HCI_OUTGOING_ACL_BUFFER_POOL_SIZE];
+    uint8_t   outgoing_acl_buffer_pool_num_free;
+    // buffer of closed connection that is still used by HCI Transport
+    uint8_t * outgoing_acl_buffer_pool_pending_release;
+#endif
      
     /* host to controller flow control */
     uint8_t  num_cmd_packets;
+#ifdef ENABLE_HCI_COMMAND_PIPELINING
+    // opcodes of sent commands waiting for Command Complete or Command Status, oldest first
+    uint16_t cmd_outstanding_opcodes[HCI_COMMAND_PIPELINE_DEPTH];
+    uint8_t  cmd_outstanding_num;
+#endif
     uint8_t  acl_packets_total_num;
     uint16_t acl_data_packet_length;
     uint8_t  sco_packets_total_num;
@@ -1140,6 +1296,11 @@ typedef struct {
     uint16_t le_data_packets_length;
     uint8_t  le_iso_packets_total_num;
     uint16_t le_iso_packets_length;
+
+    // sum of num_packets_sent over Classic ACL and over LE connections
+    uint16_t acl_packets_sent_classic;
+    uint16_t acl_packets_sent_le;
+
     uint8_t  sco_waiting_for_can_send_now;
     bool     sco_can_send_now;
 
@@ -1426,6 +1587,27 @@ uint16_t hci_get_sco_voice_setting(void);
  */
 void hci_set_num_iso_packets_to_queue(uint8_t num_packets);
 
+#ifdef ENABLE_HCI_ACL_RECOMBINATION_POOL
+/**
+ * @brief Get usage of shared ACL recombination buffers
+ * @param statistics
+ */
+void hci_get_acl_recombination_pool_statistics(hci_acl_recombination_pool_statistics_t * statistics);
+#endif
+
+#ifdef ENABLE_HCI_CONTROLLER_INFO_CACHE
+/**
+ * @brief Set TLV used to store Controller information across restarts. Has to be called before power on.
+ * @note Without it, the TLV from btstack_tlv_get_instance is used. As ports usually set it after the BD_ADDR
+ *       was read, the stored information is only available during initialization if a TLV is set here.
+ * @note Cached Command Complete events are logged to hci_dump and passed to registered event handlers as if
+ *       they were received from the Controller, preceded by a log message with the opcode.
+ * @param tlv_impl
+ * @param tlv_context
+ */
+void hci_set_controller_info_cache_tlv(const btstack_tlv_t * tlv_impl, void * tlv_context);
+#endif
+
 /**
  * @brief Set inquiry mode: standard, with RSSI, with RSSI + Extended Inquiry Results. Has to be called before power on.
  * @param inquriy_mode see bluetooth_defines.h
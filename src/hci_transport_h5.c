@@ -75,15 +75,23 @@ typedef enum {
     HCI_TRANSPORT_LINK_SEND_SLEEP                 = 1 <<  5,
     HCI_TRANSPORT_LINK_SEND_WOKEN                 = 1 <<  6,
     HCI_TRANSPORT_LINK_SEND_WAKEUP                = 1 <<  7,
-    HCI_TRANSPORT_LINK_SEND_QUEUED_PACKET         = 1 <<  8,
-    HCI_TRANSPORT_LINK_SEND_ACK_PACKET            = 1 <<  9,
-    HCI_TRANSPORT_LINK_ENTER_SLEEP                = 1 << 10,
-    HCI_TRANSPORT_LINK_SET_BAUDRATE               = 1 << 11,
+    HCI_TRANSPORT_LINK_SEND_ACK_PACKET            = 1 <<  8,
+    HCI_TRANSPORT_LINK_ENTER_SLEEP                = 1 <<  9,
+    HCI_TRANSPORT_LINK_SET_BAUDRATE               = 1 << 10,
 
 } hci_transport_link_actions_t;
 
-// Configuration Field. No packet buffers -> sliding window = 1, no OOF flow control, support data integrity check
-#define LINK_CONFIG_SLIDING_WINDOW_SIZE 1
+// Max number of unacknowledged reliable packets. For a window > 1, outgoing packets are copied into local buffers
+#ifndef H5_SLIDING_WINDOW_SIZE
+#define H5_SLIDING_WINDOW_SIZE 1
+#endif
+
+#if (H5_SLIDING_WINDOW_SIZE < 1) || (H5_SLIDING_WINDOW_SIZE > 7)
+#error "H5_SLIDING_WINDOW_SIZE must be in range 1..7"
+#endif
+
+// Configuration Field. sliding window = H5_SLIDING_WINDOW_SIZE, no OOF flow control, support data integrity check
+#define LINK_CONFIG_SLIDING_WINDOW_SIZE H5_SLIDING_WINDOW_SIZE
 #define LINK_CONFIG_OOF_FLOW_CONTROL 0
 #define LINK_CONFIG_DATA_INTEGRITY_CHECK 1
 #define LINK_CONFIG_VERSION_NR 0
@@ -95,6 +103,9 @@ typedef enum {
 // resend wakeup
 #define LINK_WAKEUP_MS 50
 
+// config field mask for sliding window size
+#define LINK_CONFIG_SLIDING_WINDOW_MASK 0x07
+
 // additional packet types
 #define LINK_ACKNOWLEDGEMENT_TYPE 0x00
 #define LINK_CONTROL_PACKET_TYPE 0x0f
@@ -134,10 +145,34 @@ static uint32_t link_new_baudrate;
 static btstack_timer_source_t inactivity_timer;
 static uint16_t link_inactivity_timeout_ms; // auto-sleep if set
 
-// Outgoing packet
+// Outgoing reliable packet in sliding window
+typedef struct {
+    uint8_t * packet;
+    uint16_t  size;
+    uint8_t   type;
+    // time of last transmission, used for retransmission timeout
+    uint32_t  sent_ms;
+} hci_transport_link_tx_entry_t;
+
+// Sliding window: entries with seq nr link_seq_nr.. are waiting for ack, the first link_tx_num_sent have been sent
+static hci_transport_link_tx_entry_t link_tx_window[H5_SLIDING_WINDOW_SIZE];
+static uint8_t link_tx_window_size;
+static uint8_t link_tx_head;
+static uint8_t link_tx_num_queued;
+static uint8_t link_tx_num_sent;
+// HCI_EVENT_TRANSPORT_PACKET_SENT not emitted for last queued packet yet
+static bool    link_tx_packet_sent_pending;
+
+#if H5_SLIDING_WINDOW_SIZE > 1
+// 4 bytes H5 header + packet + 2 bytes DIC
+static uint8_t link_tx_buffers[H5_SLIDING_WINDOW_SIZE][4 + HCI_OUTGOING_PACKET_BUFFER_SIZE + 2];
+#endif
+
+// Outgoing unreliable packet (SCO)
 static uint8_t   hci_packet_type;
 static uint16_t  hci_packet_size;
 static uint8_t * hci_packet;
+static bool      hci_packet_active;
 
 // restore 2 bytes temp overwritten by DIC
 static uint8_t * hci_packet_restore_dic_address;
@@ -159,7 +194,8 @@ static int  hci_transport_link_have_outgoing_packet(void);
 static void hci_transport_h5_frame_sent(void);
 static void hci_transport_h5_process_frame(uint16_t frame_size);
 static void hci_transport_link_run(void);
-static void hci_transport_link_send_queued_packet(void);
+static void hci_transport_link_send_reliable_packet(void);
+static void hci_transport_link_send_unreliable_packet(void);
 static void hci_transport_link_set_timer(uint16_t timeout_ms);
 static void hci_transport_link_timeout_handler(btstack_timer_source_t * timer);
 static void hci_transport_slip_init(void);
@@ -263,17 +299,42 @@ static void hci_transport_slip_send_frame_with_dic(uint8_t * frame, uint16_t fra
     btstack_uart->send_frame(frame, frame_size);
 }
 
-static void hci_transport_link_send_queued_packet(void){
+static void hci_transport_link_send_reliable_packet(void){
+    hci_transport_link_tx_entry_t * entry = &link_tx_window[(link_tx_head + link_tx_num_sent) % H5_SLIDING_WINDOW_SIZE];
+    uint8_t   seq_nr      = (link_seq_nr + link_tx_num_sent) & 0x07;
+    uint8_t * buffer      = entry->packet - 4;
+    uint16_t  buffer_size = entry->size   + 4;
+
+    // setup header
+    hci_transport_link_calc_header(buffer, seq_nr, link_ack_nr, link_peer_supports_data_integrity_check, 1, entry->type, entry->size);
+
+    // send frame with dic
+    log_debug("send queued packet: seq %u, ack %u, size %u, append dic %u", seq_nr, link_ack_nr, entry->size, link_peer_supports_data_integrity_check);
+    log_debug_hexdump(entry->packet, entry->size);
+    hci_transport_slip_send_frame_with_dic(buffer, buffer_size);
+
+    // start retransmission timer for oldest packet
+    entry->sent_ms = btstack_run_loop_get_time_ms();
+    link_tx_num_sent++;
+    if (link_tx_num_sent == 1){
+        hci_transport_link_set_timer(link_resend_timeout_ms);
+    }
+
+    // reset inactvitiy timer
+    hci_transport_inactivity_timer_set();
+}
+
+static void hci_transport_link_send_unreliable_packet(void){
     uint8_t * buffer =      hci_packet      - 4;
     uint16_t  buffer_size = hci_packet_size + 4;
 
     // setup header
-    int reliable = hci_packet_type == HCI_SCO_DATA_PACKET ? 0 : 1;
-    hci_transport_link_calc_header(buffer, link_seq_nr, link_ack_nr, link_peer_supports_data_integrity_check, reliable, hci_packet_type, hci_packet_size);
+    hci_transport_link_calc_header(buffer, 0, link_ack_nr, link_peer_supports_data_integrity_check, 0, hci_packet_type, hci_packet_size);
 
     // send frame with dic
-    log_debug("send queued packet: seq %u, ack %u, size %u, append dic %u", link_seq_nr, link_ack_nr, hci_packet_size, link_peer_supports_data_integrity_check);
+    log_debug("send unreliable packet: ack %u, size %u, append dic %u", link_ack_nr, hci_packet_size, link_peer_supports_data_integrity_check);
     log_debug_hexdump(hci_packet, hci_packet_size);
+    hci_packet_active = true;
     hci_transport_slip_send_frame_with_dic(buffer, buffer_size);
 
     // reset inactvitiy timer
@@ -384,12 +445,18 @@ static void hci_transport_link_run(void){
         hci_transport_link_send_wakeup();
         return;
     }
-    if (hci_transport_link_actions & HCI_TRANSPORT_LINK_SEND_QUEUED_PACKET){
-        hci_transport_link_actions &= ~HCI_TRANSPORT_LINK_SEND_QUEUED_PACKET;
-        // packet already contains ack, no need to send addtitional one
-        hci_transport_link_actions &= ~HCI_TRANSPORT_LINK_SEND_ACK_PACKET;
-        hci_transport_link_send_queued_packet();
-        return;
+    if (link_peer_asleep == 0){
+        // packets already contain ack, no need to send addtitional one
+        if ((hci_packet != NULL) && !hci_packet_active){
+            hci_transport_link_actions &= ~HCI_TRANSPORT_LINK_SEND_ACK_PACKET;
+            hci_transport_link_send_unreliable_packet();
+            return;
+        }
+        if (link_tx_num_sent < link_tx_num_queued){
+            hci_transport_link_actions &= ~HCI_TRANSPORT_LINK_SEND_ACK_PACKET;
+            hci_transport_link_send_reliable_packet();
+            return;
+        }
     }
     if (hci_transport_link_actions & HCI_TRANSPORT_LINK_SEND_ACK_PACKET){
         hci_transport_link_actions &= ~HCI_TRANSPORT_LINK_SEND_ACK_PACKET;
@@ -406,11 +473,27 @@ static void hci_transport_link_run(void){
 }
 
 static void hci_transport_link_set_timer(uint16_t timeout_ms){
+    btstack_run_loop_remove_timer(&link_timer);
     btstack_run_loop_set_timer_handler(&link_timer, &hci_transport_link_timeout_handler);
     btstack_run_loop_set_timer(&link_timer, timeout_ms);
     btstack_run_loop_add_timer(&link_timer);
 }
 
+// restart retransmission timer for oldest unacknowledged packet
+static void hci_transport_link_update_resend_timer(void){
+    if (link_tx_num_sent == 0){
+        btstack_run_loop_remove_timer(&link_timer);
+        return;
+    }
+    uint32_t sent_ms = link_tx_window[link_tx_head].sent_ms;
+    int32_t  elapsed_ms = (int32_t) (btstack_run_loop_get_time_ms() - sent_ms);
+    uint16_t timeout_ms = 0;
+    if (elapsed_ms < (int32_t) link_resend_timeout_ms){
+        timeout_ms = link_resend_timeout_ms - (uint16_t) elapsed_ms;
+    }
+    hci_transport_link_set_timer(timeout_ms);
+}
+
 static void hci_transport_link_timeout_handler(btstack_timer_source_t * timer){
     switch (link_state){
         case LINK_UNINITIALIZED:
@@ -431,9 +514,9 @@ static void hci_transport_link_timeout_handler(btstack_timer_source_t * timer){
                 hci_transport_link_set_timer(LINK_WAKEUP_MS);
                 break;
             }
-            // resend packet
-            hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_QUEUED_PACKET;
-            hci_transport_link_set_timer(link_resend_timeout_ms);
+            // go-back-n: resend all unacknowledged packets, starting with the oldest one
+            log_info("resend %u packets starting with seq %u", link_tx_num_sent, link_seq_nr);
+            link_tx_num_sent = 0;
             break;
         default:
             break;
@@ -458,18 +541,74 @@ static int hci_transport_link_inc_seq_nr(int seq_nr){
 }
 
 static int hci_transport_link_have_outgoing_packet(void){
-    return hci_packet != 0;
+    return (hci_packet != NULL) || (link_tx_num_queued > 0);
 }
 
 static void hci_transport_link_clear_queue(void){
     btstack_run_loop_remove_timer(&link_timer);
     hci_packet = NULL;
+    hci_packet_active = false;
+    link_tx_head = 0;
+    link_tx_num_queued = 0;
+    link_tx_num_sent = 0;
+    link_tx_packet_sent_pending = false;
 }
 
-static void hci_transport_h5_queue_packet(uint8_t packet_type, uint8_t *packet, int size){
+static void hci_transport_h5_queue_reliable_packet(uint8_t packet_type, uint8_t *packet, int size){
+    uint8_t index = (link_tx_head + link_tx_num_queued) % H5_SLIDING_WINDOW_SIZE;
+    hci_transport_link_tx_entry_t * entry = &link_tx_window[index];
+#if H5_SLIDING_WINDOW_SIZE > 1
+    // copy packet, upper stack can re-use its buffer while packet is waiting for ack
+    (void) memcpy(&link_tx_buffers[index][4], packet, size);
+    entry->packet = &link_tx_buffers[index][4];
+#else
+    entry->packet = packet;
+#endif
+    entry->type = packet_type;
+    entry->size = size;
+    link_tx_num_queued++;
+    link_tx_packet_sent_pending = true;
+}
+
+static void hci_transport_h5_queue_unreliable_packet(uint8_t packet_type, uint8_t *packet, int size){
     hci_packet = packet;
     hci_packet_type = packet_type;
     hci_packet_size = size;
+    hci_packet_active = false;
+}
+
+static void hci_transport_h5_emit_packet_sent(void){
+    uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
+    packet_handler(HCI_EVENT_PACKET, &event[0], sizeof(event));
+}
+
+// notify upper stack that it can send again as soon as there's room in the sliding window
+static void hci_transport_h5_emit_packet_sent_if_ready(void){
+    if (link_tx_packet_sent_pending == false) return;
+    if (link_tx_num_queued >= link_tx_window_size) return;
+    link_tx_packet_sent_pending = false;
+    hci_transport_h5_emit_packet_sent();
+}
+
+// acks are cumulative: ack_nr is the seq nr expected next by the peer
+static void hci_transport_link_process_ack(uint8_t ack_nr){
+    uint8_t num_acked = (ack_nr - link_seq_nr) & 0x07;
+    if (num_acked == 0) return;
+    if (num_acked > link_tx_num_queued){
+        log_info("ack nr %u invalid, seq nr %u, %u packets queued", ack_nr, link_seq_nr, link_tx_num_queued);
+        return;
+    }
+    log_debug("outgoing packets with seq %u..%u ack'ed", link_seq_nr, (ack_nr - 1) & 0x07);
+    link_seq_nr = ack_nr;
+    link_tx_head = (link_tx_head + num_acked) % H5_SLIDING_WINDOW_SIZE;
+    link_tx_num_queued -= num_acked;
+    // packets might have been acked after their retransmission was triggered
+    if (link_tx_num_sent > num_acked){
+        link_tx_num_sent -= num_acked;
+    } else {
+        link_tx_num_sent = 0;
+    }
+    hci_transport_link_update_resend_timer();
 }
 
 static void hci_transport_h5_emit_sleep_state(int sleep_active){
@@ -575,9 +714,18 @@ static void hci_transport_h5_process_frame(uint16_t frame_size){
                 break;
             }
             if (memcmp(slip_payload, link_control_config_response, link_control_config_response_prefix_len) == 0){
-                uint8_t config = slip_payload[2];
+                uint8_t config = 0;
+                if (link_payload_len > link_control_config_response_prefix_len){
+                    config = slip_payload[2];
+                }
                 link_peer_supports_data_integrity_check = (config & 0x10) != 0;
-                log_info("link received config response 0x%02x, data integrity check supported %u", config, link_peer_supports_data_integrity_check);
+                // use smaller sliding window of both sides, peers without config field use window size 1
+                link_tx_window_size = (uint8_t) btstack_min(config & LINK_CONFIG_SLIDING_WINDOW_MASK, H5_SLIDING_WINDOW_SIZE);
+                if (link_tx_window_size == 0){
+                    link_tx_window_size = 1;
+                }
+                log_info("link received config response 0x%02x, data integrity check supported %u, sliding window %u", config,
+                         link_peer_supports_data_integrity_check, link_tx_window_size);
                 link_state = LINK_ACTIVE;
                 btstack_run_loop_remove_timer(&link_timer);
                 log_info("link activated");
@@ -585,16 +733,22 @@ static void hci_transport_h5_process_frame(uint16_t frame_size){
                 link_seq_nr = 0;
                 link_ack_nr = 0;
                 // notify upper stack that it can start
-                uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
-                packet_handler(HCI_EVENT_PACKET, &event[0], sizeof(event));
+                hci_transport_h5_emit_packet_sent();
                 break;
             }
             break;
         case LINK_ACTIVE:
 
+            // Process ACKs in reliable packet and explicit ack packets, also valid for out of sequence packets
+            if (reliable_packet || link_packet_type == LINK_ACKNOWLEDGEMENT_TYPE){
+                hci_transport_link_process_ack(ack_nr);
+                hci_transport_h5_emit_packet_sent_if_ready();
+            }
+
             // validate packet sequence nr in reliable packets (check for out of sequence error)
             if (reliable_packet){
                 if (seq_nr != link_ack_nr){
+                    // drop out of sequence or duplicate packet, peer resends all packets starting with link_ack_nr
                     log_info("expected seq nr %u, but received %u", link_ack_nr, seq_nr);
                     hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_ACK_PACKET;
                     break;
@@ -604,21 +758,6 @@ static void hci_transport_h5_process_frame(uint16_t frame_size){
                 hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_ACK_PACKET;
             }
 
-            // Process ACKs in reliable packet and explicit ack packets
-            if (reliable_packet || link_packet_type == LINK_ACKNOWLEDGEMENT_TYPE){
-                // our packet is good if the remote expects our seq nr + 1
-                int next_seq_nr = hci_transport_link_inc_seq_nr(link_seq_nr);
-                if (hci_transport_link_have_outgoing_packet() && next_seq_nr == ack_nr){
-                    log_debug("outoing packet with seq %u ack'ed", link_seq_nr);
-                    link_seq_nr = next_seq_nr;
-                    hci_transport_link_clear_queue();
-
-                    // notify upper stack that it can send again
-                    uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
-                    packet_handler(HCI_EVENT_PACKET, &event[0], sizeof(event));
-                }
-            } 
-
             switch (link_packet_type){
                 case LINK_CONTROL_PACKET_TYPE:
                     if (memcmp(slip_payload, link_control_config, sizeof(link_control_config)) == 0){
@@ -737,13 +876,16 @@ static void hci_transport_h5_frame_sent(void){
     }
 
     // SCO packets are sent as unreliable, so we're done now
-    if (hci_packet_type == HCI_SCO_DATA_PACKET){
-        hci_transport_link_clear_queue();
+    if (hci_packet_active){
+        hci_packet = NULL;
+        hci_packet_active = false;
         // notify upper stack that it can send again
-        uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
-        packet_handler(HCI_EVENT_PACKET, &event[0], sizeof(event));
+        hci_transport_h5_emit_packet_sent();
     }
 
+    // reliable packets have been copied, upper stack can send next one if window is not full
+    hci_transport_h5_emit_packet_sent_if_ready();
+
     hci_transport_link_run();
 }
 
@@ -817,9 +959,11 @@ static void hci_transport_h5_register_packet_handler(void (*handler)(uint8_t pac
 }
 
 static int hci_transport_h5_can_send_packet_now(uint8_t packet_type){
-    int res = !hci_transport_link_have_outgoing_packet() && link_state == LINK_ACTIVE;
-    // log_info("can_send_packet_now: %u", res);
-    return res;
+    if (link_state != LINK_ACTIVE) return 0;
+    if (link_tx_packet_sent_pending) return 0;
+    if (hci_packet != NULL) return 0;
+    if (packet_type == HCI_SCO_DATA_PACKET) return 1;
+    return link_tx_num_queued < link_tx_window_size;
 }
 
 static int hci_transport_h5_send_packet(uint8_t packet_type, uint8_t *packet, int size){
@@ -828,8 +972,19 @@ static int hci_transport_h5_send_packet(uint8_t packet_type, uint8_t *packet, in
         return -1;
     }
 
+#if H5_SLIDING_WINDOW_SIZE > 1
+    if ((packet_type != HCI_SCO_DATA_PACKET) && (size > HCI_OUTGOING_PACKET_BUFFER_SIZE)){
+        log_error("hci_transport_h5_send_packet: packet size %u larger than buffer", size);
+        return -1;
+    }
+#endif
+
     // store request
-    hci_transport_h5_queue_packet(packet_type, packet, size);
+    if (packet_type == HCI_SCO_DATA_PACKET){
+        hci_transport_h5_queue_unreliable_packet(packet_type, packet, size);
+    } else {
+        hci_transport_h5_queue_reliable_packet(packet_type, packet, size);
+    }
 
     // send wakeup first
     if (link_peer_asleep){
@@ -840,9 +995,6 @@ static int hci_transport_h5_send_packet(uint8_t packet_type, uint8_t *packet, in
         }
         hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_WAKEUP;
         hci_transport_link_set_timer(LINK_WAKEUP_MS);
-    } else {
-        hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_QUEUED_PACKET;
-        hci_transport_link_set_timer(link_resend_timeout_ms);
     }
     hci_transport_link_run();
     return 0;
@@ -197,6 +197,8 @@ static l2cap_channel_t * l2cap_create_channel_entry(btstack_packet_handler_t pac
         uint16_t psm, uint16_t local_mtu, gap_security_level_t security_level);
 static void l2cap_finalize_channel_close(l2cap_channel_t *channel);
 static void l2cap_free_channel_entry(l2cap_channel_t * channel);
+static void l2cap_add_channel(l2cap_channel_t * channel);
+static void l2cap_remove_channel(l2cap_channel_t * channel);
 #endif
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
 static void l2cap_ertm_notify_channel_can_send(l2cap_channel_t * channel);
@@ -241,6 +243,10 @@ static btstack_linked_list_t l2cap_channels;
 #ifdef L2CAP_USES_CHANNELS
 // next channel id for new connections
 static uint16_t  l2cap_local_source_cid;
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+// connection-oriented channels in l2cap_channels by local cid
+static l2cap_channel_t * l2cap_channel_index[L2CAP_CHANNEL_INDEX_SIZE];
+#endif
 #endif
 // next signaling sequence number
 static uint8_t   l2cap_sig_seq_nr;
@@ -683,7 +689,7 @@ uint8_t l2cap_ertm_create_channel(btstack_packet_handler_t packet_handler, bd_ad
     l2cap_ertm_configure_channel(channel, ertm_config, buffer, size);
 
     // add to connections list
-    btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_add_channel(channel);
 
     // store local_cid
     if (out_local_cid){
@@ -992,6 +998,9 @@ void l2cap_init(void){
  */
 void l2cap_deinit(void){
     l2cap_channels = NULL;
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    (void)memset(l2cap_channel_index, 0, sizeof(l2cap_channel_index));
+#endif
     l2cap_signaling_responses_pending = 0;
 #ifdef ENABLE_CLASSIC
     l2cap_require_security_level2_for_outgoing_sdp = 0;
@@ -1242,14 +1251,95 @@ static int l2cap_is_dynamic_channel_type(l2cap_channel_type_t channel_type) {
     }
 }
 
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+static inline uint16_t l2cap_channel_index_bucket_for_cid(uint16_t local_cid){
+    // local cids are assigned sequentially
+    return local_cid & (L2CAP_CHANNEL_INDEX_SIZE - 1u);
+}
+
+// channels are added in front, local cids are unique
+static void l2cap_channel_index_add(l2cap_channel_t * channel){
+    if (channel->local_cid < 0x40u) return;
+    uint16_t bucket = l2cap_channel_index_bucket_for_cid(channel->local_cid);
+    channel->index_next_by_cid = l2cap_channel_index[bucket];
+    l2cap_channel_index[bucket] = channel;
+}
+
+static void l2cap_channel_index_remove(l2cap_channel_t * channel){
+    if (channel->local_cid < 0x40u) return;
+    l2cap_channel_t ** it = &l2cap_channel_index[l2cap_channel_index_bucket_for_cid(channel->local_cid)];
+    while (*it != NULL){
+        if (*it == channel){
+            *it = channel->index_next_by_cid;
+            break;
+        }
+        it = &(*it)->index_next_by_cid;
+    }
+    channel->index_next_by_cid = NULL;
+}
+
+static l2cap_channel_t * l2cap_channel_index_lookup(uint16_t local_cid){
+    l2cap_channel_t * channel = l2cap_channel_index[l2cap_channel_index_bucket_for_cid(local_cid)];
+    while (channel != NULL){
+        if (channel->local_cid == local_cid) {
+            return channel;
+        }
+        channel = channel->index_next_by_cid;
+    }
+    return NULL;
+}
+#endif
+
+// add connection-oriented channel to l2cap_channels (and index)
+static void l2cap_add_channel(l2cap_channel_t * channel){
+    btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    l2cap_channel_index_add(channel);
+#endif
+}
+
+// remove connection-oriented channel from l2cap_channels (and index)
+static void l2cap_remove_channel(l2cap_channel_t * channel){
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    l2cap_channel_index_remove(channel);
+#endif
+    btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+}
+
+// remove connection-oriented channel from l2cap_channels (and index) while iterating over l2cap_channels
+static void l2cap_iterator_remove_channel(btstack_linked_list_iterator_t * it, l2cap_channel_t * channel){
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    l2cap_channel_index_remove(channel);
+#else
+    UNUSED(channel);
+#endif
+    btstack_linked_list_iterator_remove(it);
+}
+
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+// local cid is used as lookup key, update index if enabled
+static void l2cap_channel_set_local_cid(l2cap_channel_t * channel, uint16_t local_cid){
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    l2cap_channel_index_remove(channel);
+    channel->local_cid = local_cid;
+    l2cap_channel_index_add(channel);
+#else
+    channel->local_cid = local_cid;
+#endif
+}
+#endif
+
 static l2cap_channel_t * l2cap_get_channel_for_local_cid(uint16_t local_cid){
     if (local_cid < 0x40u) return NULL;
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    return l2cap_channel_index_lookup(local_cid);
+#else
     return (l2cap_channel_t*) l2cap_channel_item_by_cid(local_cid);
+#endif
 }
 
 static l2cap_channel_t * l2cap_get_channel_for_local_cid_and_handle(uint16_t local_cid, hci_con_handle_t con_handle){
-    if (local_cid < 0x40u) return NULL;
-    l2cap_channel_t * l2cap_channel = (l2cap_channel_t*) l2cap_channel_item_by_cid(local_cid);
+    l2cap_channel_t * l2cap_channel = l2cap_get_channel_for_local_cid(local_cid);
     if (l2cap_channel == NULL)  return NULL;
     if (l2cap_channel->con_handle != con_handle) return NULL;
     return l2cap_channel;
@@ -1404,7 +1494,7 @@ static void l2cap_rtx_timeout(btstack_timer_source_t * ts){
     l2cap_handle_channel_open_failed(channel, L2CAP_CONNECTION_RESPONSE_RESULT_RTX_TIMEOUT);
 
     // discard channel
-    btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_remove_channel(channel);
     l2cap_free_channel_entry(channel);
 }
 
@@ -1685,7 +1775,7 @@ static bool l2cap_run_for_classic_channel(l2cap_channel_t * channel){
             l2cap_send_classic_signaling_packet(channel->con_handle, CONNECTION_RESPONSE, channel->remote_sig_id,
                                                 channel->local_cid, channel->remote_cid, channel->reason, 0);
             // discard channel - l2cap_finialize_channel_close without sending l2cap close event
-            btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+            l2cap_remove_channel(channel);
             l2cap_free_channel_entry(channel);
             channel = NULL;
             break;
@@ -2100,7 +2190,7 @@ static void l2cap_cbm_run_channels(void){
         bool channel_closed = l2cap_cbm_run_channel(channel);
         if (channel_closed) {
             // discard channel - l2cap_finialize_channel_close without sending l2cap close event
-            btstack_linked_list_iterator_remove(&it);
+            l2cap_iterator_remove_channel(&it, channel);
             l2cap_free_channel_entry(channel);
         }
     }
@@ -2281,7 +2371,7 @@ static void l2cap_ecbm_run_channels(void) {
                 l2cap_ecbm_emit_channel_opened(channel, ERROR_CODE_SUCCESS);
             } else {
                 result = channel->reason;
-                btstack_linked_list_iterator_remove(&it);
+                l2cap_iterator_remove_channel(&it, channel);
                 btstack_memory_l2cap_channel_free(channel);
             }
         }
@@ -2555,7 +2645,7 @@ uint8_t l2cap_create_channel(btstack_packet_handler_t channel_packet_handler, bd
 #endif    
 
     // add to connections list
-    btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_add_channel(channel);
 
     // store local_cid
     if (out_local_cid){
@@ -2615,7 +2705,7 @@ static void l2cap_handle_connection_failed_for_addr(bd_addr_t address, uint8_t s
                 // failure, forward error code
                 l2cap_handle_channel_open_failed(channel, status);
                 // discard channel
-                btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+                l2cap_remove_channel(channel);
                 l2cap_free_channel_entry(channel);
                 break;
             }
@@ -2743,8 +2833,8 @@ static void l2cap_notify_channel_can_send(void){
             if (!ready) continue;
 
             // requeue channel for fairness
-            btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
-            btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+            l2cap_remove_channel(channel);
+            l2cap_add_channel(channel);
 
             // trigger sending
             l2cap_channel_trigger_send(channel);
@@ -2922,7 +3012,7 @@ static void l2cap_handle_security_level(hci_con_handle_t handle, gap_security_le
                     } else {
                         // security level insufficient, report error and free channel
                         l2cap_handle_channel_open_failed(channel, L2CAP_CONNECTION_RESPONSE_RESULT_REFUSED_SECURITY);
-                        btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t  *) channel);
+                        l2cap_remove_channel(channel);
                         l2cap_free_channel_entry(channel);
                     }
                     break;
@@ -2945,7 +3035,7 @@ static void l2cap_handle_disconnection_complete(hci_con_handle_t handle){
         l2cap_channel_t *channel = (l2cap_channel_t *) btstack_linked_list_iterator_next(&it);
         if (!l2cap_is_dynamic_channel_type(channel->channel_type)) continue;
         if (channel->con_handle != handle) continue;
-        btstack_linked_list_iterator_remove(&it);
+        l2cap_iterator_remove_channel(&it, channel);
         btstack_linked_list_add(&channels_to_close, (btstack_linked_item_t *) channel);
     }
     // send l2cap open failed or closed events for all channels on this handle and free them
@@ -3176,7 +3266,7 @@ static void l2cap_handle_connection_request(hci_con_handle_t handle, uint8_t sig
     channel->state_var = L2CAP_CHANNEL_STATE_VAR_INCOMING;
 
     // add to connections list
-    btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_add_channel(channel);
 
     //
     if (required_level > LEVEL_0){
@@ -3465,7 +3555,7 @@ static void l2cap_signaling_handler_channel(l2cap_channel_t *channel, uint8_t *c
                             }
                             
                             // discard channel
-                            btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+                            l2cap_remove_channel(channel);
                             l2cap_free_channel_entry(channel);
                             break;
                     }
@@ -3627,7 +3717,7 @@ static void l2cap_handle_information_request_complete(hci_connection_t * connect
                     // map l2cap connection response result to BTstack status enumeration
                     l2cap_handle_channel_open_failed(channel, L2CAP_CONNECTION_RESPONSE_RESULT_ERTM_NOT_SUPPORTED);
                     // discard channel
-                    btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+                    l2cap_remove_channel(channel);
                     l2cap_free_channel_entry(channel);
                     continue;
 
@@ -3747,7 +3837,7 @@ static void l2cap_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t *
                 l2cap_ecbm_emit_channel_opened(channel,
                                                ERROR_CODE_CONNECTION_REJECTED_DUE_TO_LIMITED_RESOURCES);
                 // drop failed channel
-                btstack_linked_list_iterator_remove(&it);
+                l2cap_iterator_remove_channel(&it, channel);
                 l2cap_free_channel_entry(channel);
             }
             break;
@@ -3948,7 +4038,7 @@ static void l2cap_ecbm_handle_security_level_incoming(l2cap_channel_t * channel)
         if (security_sufficient){
             channel->state = L2CAP_STATE_WAIT_CLIENT_ACCEPT_OR_REJECT;
         } else {
-            btstack_linked_list_iterator_remove(&it);
+            l2cap_iterator_remove_channel(&it, channel);
             btstack_memory_l2cap_channel_free(channel);
         }
     }
@@ -4109,7 +4199,7 @@ static int l2cap_ecbm_signaling_handler_dispatch(hci_con_handle_t handle, uint16
                     // if more than one error, we can report any of them
                     channel->reason = result;
 
-                    btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+                    l2cap_add_channel(channel);
 
                     a_channel = channel;
                 }
@@ -4187,7 +4277,7 @@ static int l2cap_ecbm_signaling_handler_dispatch(hci_con_handle_t handle, uint16
                 // open failed
                 l2cap_ecbm_emit_channel_opened(channel, channel_status);
                 // drop failed channel
-                btstack_linked_list_iterator_remove(&it);
+                l2cap_iterator_remove_channel(&it, channel);
                 btstack_memory_l2cap_channel_free(channel);
             }
             return 1;
@@ -4394,7 +4484,7 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
                     l2cap_cbm_emit_channel_opened(channel, L2CAP_CBM_CONNECTION_RESULT_SPSM_NOT_SUPPORTED);
 
                     // discard channel
-                    btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+                    l2cap_remove_channel(channel);
                     l2cap_free_channel_entry(channel);
                     continue;
                 }
@@ -4407,7 +4497,7 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
                     l2cap_ecbm_emit_channel_opened(channel, L2CAP_CONNECTION_RESPONSE_RESULT_REFUSED_PSM);
 
                     // discard channel
-                    btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+                    l2cap_remove_channel(channel);
                     l2cap_free_channel_entry(channel);
                     continue;
                 }
@@ -4496,7 +4586,7 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
                 channel->state_var |= L2CAP_CHANNEL_STATE_VAR_INCOMING;
 
                 // add to connections list
-                btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+                l2cap_add_channel(channel);
 
                 // post connection request event
                 l2cap_cbm_emit_incoming_connection(channel);
@@ -4531,7 +4621,7 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
                 l2cap_cbm_emit_channel_opened(channel, status);
                                 
                 // discard channel
-                btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+                l2cap_remove_channel(channel);
                 l2cap_free_channel_entry(channel);
                 break;
             }
@@ -4967,7 +5057,7 @@ void l2cap_finalize_channel_close(l2cap_channel_t * channel){
     channel->state = L2CAP_STATE_CLOSED;
     l2cap_handle_channel_closed(channel);
     // discard channel
-    btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_remove_channel(channel);
     l2cap_free_channel_entry(channel);
 }
 #endif
@@ -5311,7 +5401,7 @@ static void l2cap_cbm_finalize_channel_close(l2cap_channel_t * channel){
     channel->state = L2CAP_STATE_CLOSED;
     l2cap_emit_simple_event_with_cid(channel, L2CAP_EVENT_CHANNEL_CLOSED);
     // discard channel
-    btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_remove_channel(channel);
     l2cap_free_channel_entry(channel);
 }
 
@@ -5430,7 +5520,7 @@ static void l2cap_cbm_sm_packet_handler(uint8_t packet_type, uint16_t channel_nr
             // pairing failed or wasn't good enough, inform user
             l2cap_cbm_emit_channel_opened(channel, ERROR_CODE_INSUFFICIENT_SECURITY);
             // discard channel
-            btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+            l2cap_remove_channel(channel);
             l2cap_free_channel_entry(channel);
         } else {
             // send conn request now
@@ -5473,7 +5563,7 @@ uint8_t l2cap_cbm_create_channel(btstack_packet_handler_t packet_handler, hci_co
     channel->automatic_credits    = initial_credits == L2CAP_LE_AUTOMATIC_CREDITS;
 
     // add to connections list
-    btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_add_channel(channel);
 
     // check security level
     if (l2cap_cbm_security_level_for_connection(con_handle) < channel->required_security_level){
@@ -5592,7 +5682,7 @@ uint8_t l2cap_ecbm_create_channels(btstack_packet_handler_t packet_handler, hci_
         if (out_local_cid){
             out_local_cid[i] = channel->local_cid;
         }
-        btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+        l2cap_add_channel(channel);
         i++;
     }
 
@@ -5656,7 +5746,7 @@ uint8_t l2cap_ecbm_accept_channels(uint16_t local_cid, uint8_t num_channels, uin
             channel_index++;
         } else {
             // clear local cid for response packet
-            channel->local_cid = 0;
+            l2cap_channel_set_local_cid(channel, 0);
             channel->reason = L2CAP_ECBM_CONNECTION_RESULT_SOME_REFUSED_INSUFFICIENT_RESOURCES_AVAILABLE;
         }
         // update state
@@ -5684,7 +5774,7 @@ uint8_t l2cap_ecbm_decline_channels(uint16_t local_cid, uint16_t result){
         if (channel->state != L2CAP_STATE_WAIT_CLIENT_ACCEPT_OR_REJECT) continue;
 
         // prepare response
-        channel->local_cid = 0;
+        l2cap_channel_set_local_cid(channel, 0);
         channel->reason = result;
         channel->state = L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_RESPONSE;
     }
@@ -5832,17 +5922,17 @@ void l2cap_setup_test_channels_fuzz(void) {
     // 0x41 1setup classic basic
     channel = l2cap_create_channel_entry(fuzz_packet_handler, L2CAP_CHANNEL_TYPE_CLASSIC, address,
         BD_ADDR_TYPE_ACL, 0x01, 100, LEVEL_4);
-    btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_add_channel(channel);
 
     // 0x42 setup le cbm
     channel = l2cap_create_channel_entry(fuzz_packet_handler, L2CAP_CHANNEL_TYPE_CHANNEL_CBM, address,
         BD_ADDR_TYPE_LE_PUBLIC, 0x03, 100, LEVEL_4);
-    btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_add_channel(channel);
 
     // 0x43 setup le ecbm
     channel = l2cap_create_channel_entry(fuzz_packet_handler, L2CAP_CHANNEL_TYPE_CHANNEL_ECBM,
         address, BD_ADDR_TYPE_LE_PUBLIC, 0x05, 100, LEVEL_4);
-    btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_add_channel(channel);
 }
 
 void l2cap_free_channels_fuzz(void){
@@ -5861,7 +5951,7 @@ void l2cap_free_channels_fuzz(void){
                 break;
         }
         if (fixed_channel == false) {
-            btstack_linked_list_iterator_remove(&it);
+            l2cap_iterator_remove_channel(&it, channel);
             btstack_memory_l2cap_channel_free(channel);
         }
     }
@@ -68,6 +68,16 @@ extern "C" {
 
 #define L2CAP_LE_AUTOMATIC_CREDITS 0xffff
 
+// number of hash buckets used to find channels by local cid, must be a power of two
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+#ifndef L2CAP_CHANNEL_INDEX_SIZE
+#define L2CAP_CHANNEL_INDEX_SIZE 16
+#endif
+#if (L2CAP_CHANNEL_INDEX_SIZE & (L2CAP_CHANNEL_INDEX_SIZE - 1)) != 0
+#error "L2CAP_CHANNEL_INDEX_SIZE must be a power of two"
+#endif
+#endif
+
 // private structs
 typedef enum {
     L2CAP_STATE_CLOSED = 1,           // no baseband
@@ -204,7 +214,7 @@ typedef struct l2cap_fixed_channel {
 
 } l2cap_fixed_channel_t;
 
-typedef struct {
+typedef struct l2cap_channel {
     // linked list - assert: first field
     btstack_linked_item_t    item;
     
@@ -222,6 +232,11 @@ typedef struct {
 
     // -- end of shared prefix
 
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    // next channel in same local cid bucket
+    struct l2cap_channel * index_next_by_cid;
+#endif
+
     // timer
     btstack_timer_source_t rtx; // also used for ertx
 
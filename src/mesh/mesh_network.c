@@ -64,7 +64,25 @@
 #endif
 
 // configuration
+
+// number of received Network PDUs remembered to detect duplicates
+#ifndef MESH_NETWORK_CACHE_SIZE
 #define MESH_NETWORK_CACHE_SIZE 2
+#endif
+
+#if MESH_NETWORK_CACHE_SIZE > 0x7fff
+#error "MESH_NETWORK_CACHE_SIZE must not exceed 32767"
+#endif
+
+// hash table with load factor <= 0.5
+#define MESH_NETWORK_CACHE_TABLE_SIZE (2 * MESH_NETWORK_CACHE_SIZE)
+
+// cache find/add are only exported for unit tests
+#ifdef UNIT_TEST
+#define MESH_NETWORK_CACHE_API
+#else
+#define MESH_NETWORK_CACHE_API static
+#endif
 
 // debug config
 #define LOG_NETWORK
@@ -136,9 +154,17 @@ static mesh_network_pdu_t * adv_bearer_network_pdu;
 #endif
 
 
-// mesh network cache - we use 32-bit 'hashes'
-static uint32_t mesh_network_cache[MESH_NETWORK_CACHE_SIZE];
-static int      mesh_network_cache_index;
+// mesh network cache - entries in FIFO order, open addressing hash table with entry index + 1, 0 = empty
+typedef struct {
+    // IVI (1 bit) | SEQ (24 bit)
+    uint32_t ivi_seq;
+    uint16_t src;
+} mesh_network_cache_entry_t;
+
+static mesh_network_cache_entry_t mesh_network_cache_entries[MESH_NETWORK_CACHE_SIZE];
+static uint16_t mesh_network_cache_table[MESH_NETWORK_CACHE_TABLE_SIZE];
+static uint16_t mesh_network_cache_head;
+static uint16_t mesh_network_cache_count;
 
 // register for freed network pdu
 void (*mesh_network_free_pdu_callback)(void);
@@ -149,31 +175,97 @@ static void mesh_network_run(void);
 static void process_network_pdu_validate(void);
 
 // network caching
-static uint32_t mesh_network_cache_hash(mesh_network_pdu_t * network_pdu){
-    // - The SEQ field is a 24-bit integer that when combined with the IV Index, 
-    // shall be a unique value for each new Network PDU originated by this node (=> SRC)
-    // - IV updates only rarely
-    // => 16 bit SRC, 1 bit IVI, 15 bit SEQ
-    uint8_t  ivi = network_pdu->data[0] >> 7;
-    uint16_t seq = big_endian_read_16(network_pdu->data, 3);
-    uint16_t src = big_endian_read_16(network_pdu->data, 5);
-    return (src << 16) | (ivi << 15) | (seq & 0x7fff);
-}
-
-static int mesh_network_cache_find(uint32_t hash){
-    int i;
-    for (i = 0; i < MESH_NETWORK_CACHE_SIZE; i++) {
-        if (mesh_network_cache[i] == hash) {
-            return 1;
+// - The SEQ field is a 24-bit integer that when combined with the IV Index,
+// shall be a unique value for each new Network PDU originated by this node (=> SRC)
+// - IV updates only rarely
+// => key is 1 bit IVI, 24 bit SEQ, 16 bit SRC
+static uint16_t mesh_network_cache_slot(uint32_t ivi_seq, uint16_t src){
+    uint32_t hash = (ivi_seq ^ ((uint32_t) src << 16) ^ ((uint32_t) src >> 8)) * 0x9E3779B1u;
+    return (uint16_t) ((hash >> 16) % MESH_NETWORK_CACHE_TABLE_SIZE);
+}
+
+static uint16_t mesh_network_cache_next_slot(uint16_t slot){
+    slot++;
+    if (slot == MESH_NETWORK_CACHE_TABLE_SIZE){
+        slot = 0;
+    }
+    return slot;
+}
+
+// @returns slot of entry or MESH_NETWORK_CACHE_TABLE_SIZE if not found
+static uint16_t mesh_network_cache_lookup(uint32_t ivi_seq, uint16_t src){
+    uint16_t slot = mesh_network_cache_slot(ivi_seq, src);
+    while (mesh_network_cache_table[slot] != 0){
+        const mesh_network_cache_entry_t * entry = &mesh_network_cache_entries[mesh_network_cache_table[slot] - 1];
+        if ((entry->ivi_seq == ivi_seq) && (entry->src == src)){
+            return slot;
         }
+        slot = mesh_network_cache_next_slot(slot);
     }
-    return 0;
+    return MESH_NETWORK_CACHE_TABLE_SIZE;
+}
+
+// remove from hash table, move following entries back to keep probe sequences intact
+static void mesh_network_cache_remove_slot(uint16_t slot){
+    mesh_network_cache_table[slot] = 0;
+    uint16_t next = mesh_network_cache_next_slot(slot);
+    while (mesh_network_cache_table[next] != 0){
+        const mesh_network_cache_entry_t * entry = &mesh_network_cache_entries[mesh_network_cache_table[next] - 1];
+        uint16_t home = mesh_network_cache_slot(entry->ivi_seq, entry->src);
+        // entry can stay if its home slot is cyclically in (slot, next]
+        bool stays;
+        if (slot <= next){
+            stays = (slot < home) && (home <= next);
+        } else {
+            stays = (slot < home) || (home <= next);
+        }
+        if (!stays){
+            mesh_network_cache_table[slot] = mesh_network_cache_table[next];
+            mesh_network_cache_table[next] = 0;
+            slot = next;
+        }
+        next = mesh_network_cache_next_slot(next);
+    }
+}
+
+static void mesh_network_cache_reset(void){
+    memset(mesh_network_cache_table, 0, sizeof(mesh_network_cache_table));
+    mesh_network_cache_head = 0;
+    mesh_network_cache_count = 0;
 }
 
-static void mesh_network_cache_add(uint32_t hash){
-    mesh_network_cache[mesh_network_cache_index++] = hash;
-    if (mesh_network_cache_index >= MESH_NETWORK_CACHE_SIZE){
-        mesh_network_cache_index = 0;
+MESH_NETWORK_CACHE_API int mesh_network_cache_find(uint8_t ivi, uint16_t src, uint32_t seq){
+    uint32_t ivi_seq = ((uint32_t) (ivi & 1u) << 24) | (seq & 0xffffffu);
+    return mesh_network_cache_lookup(ivi_seq, src) != MESH_NETWORK_CACHE_TABLE_SIZE;
+}
+
+MESH_NETWORK_CACHE_API void mesh_network_cache_add(uint8_t ivi, uint16_t src, uint32_t seq){
+    uint32_t ivi_seq = ((uint32_t) (ivi & 1u) << 24) | (seq & 0xffffffu);
+    mesh_network_cache_entry_t * entry = &mesh_network_cache_entries[mesh_network_cache_head];
+
+    // evict oldest entry if full
+    if (mesh_network_cache_count == MESH_NETWORK_CACHE_SIZE){
+        uint16_t oldest_slot = mesh_network_cache_slot(entry->ivi_seq, entry->src);
+        while (mesh_network_cache_table[oldest_slot] != (mesh_network_cache_head + 1)){
+            oldest_slot = mesh_network_cache_next_slot(oldest_slot);
+        }
+        mesh_network_cache_remove_slot(oldest_slot);
+    } else {
+        mesh_network_cache_count++;
+    }
+
+    // store entry
+    entry->ivi_seq = ivi_seq;
+    entry->src = src;
+    uint16_t slot = mesh_network_cache_slot(ivi_seq, src);
+    while (mesh_network_cache_table[slot] != 0){
+        slot = mesh_network_cache_next_slot(slot);
+    }
+    mesh_network_cache_table[slot] = mesh_network_cache_head + 1;
+
+    mesh_network_cache_head++;
+    if (mesh_network_cache_head == MESH_NETWORK_CACHE_SIZE){
+        mesh_network_cache_head = 0;
     }
 }
 
@@ -560,11 +652,12 @@ static void process_network_pdu_validate_d(void * arg){
         }
 
         // check cache
-        uint32_t hash = mesh_network_cache_hash(incoming_pdu_decoded);
+        uint8_t  ivi = incoming_pdu_decoded->data[0] >> 7;
+        uint32_t seq = big_endian_read_24(incoming_pdu_decoded->data, 2);
 #ifdef LOG_NETWORK
-        printf("RX-Hash (%p): %08" PRIx32 "\n", incoming_pdu_decoded, hash);
+        printf("RX-Cache (%p): IVI %u, SRC %04x, SEQ %06" PRIx32 "\n", incoming_pdu_decoded, ivi, src, seq);
 #endif
-        if (mesh_network_cache_find(hash)){
+        if (mesh_network_cache_find(ivi, src, seq)){
             // found in cache, drop
 #ifdef LOG_NETWORK
             printf("Found in cache -> drop packet (%p)\n", incoming_pdu_decoded);
@@ -576,7 +669,7 @@ static void process_network_pdu_validate_d(void * arg){
         }
 
         // store in network cache
-        mesh_network_cache_add(hash);
+        mesh_network_cache_add(ivi, src, seq);
 
 #ifdef LOG_NETWORK
             printf("RX-Validated (%p) - forward to lower transport\n", incoming_pdu_decoded);
@@ -998,6 +1091,7 @@ static void mesh_netework_gatt_bearer_handle_proxy_configuration(uint8_t packet_
 #endif
 
 void mesh_network_init(void){
+    mesh_network_cache_reset();
 #ifdef ENABLE_MESH_ADV_BEARER
     adv_bearer_register_for_network_pdu(&mesh_adv_bearer_handle_network_event);
 #endif
@@ -1216,6 +1310,7 @@ void mesh_network_dump(void){
 
 }
 void mesh_network_reset(void){
+    mesh_network_cache_reset();
     mesh_network_reset_network_pdus(&network_pdus_received);
     mesh_network_reset_network_pdus(&network_pdus_queued);
     mesh_network_reset_network_pdus(&network_pdus_outgoing_gatt);
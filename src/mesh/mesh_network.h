@@ -467,6 +467,11 @@ void mesh_network_encrypt_proxy_configuration_message(mesh_network_pdu_t * netwo
 void mesh_network_dump(void);
 void mesh_network_reset(void);
 
+#ifdef UNIT_TEST
+int  mesh_network_cache_find(uint8_t ivi, uint16_t src, uint32_t seq);
+void mesh_network_cache_add(uint8_t ivi, uint16_t src, uint32_t seq);
+#endif
+
 #if defined __cplusplus
 }
 #endif
@@ -127,6 +127,38 @@ static uint16_t att_prepare_write_request(uint16_t request_type, uint16_t attrib
 extern "C" void btstack_crypto_aes128_cmac_generator(btstack_crypto_aes128_cmac_t * request, const uint8_t * key, uint16_t size, uint8_t (*get_byte_callback)(uint16_t pos), uint8_t * hash, void (* callback)(void * arg), void * callback_arg){
 }
 
+// reference: linear search in db blob
+static const uint8_t * att_db_reference_find_handle(uint16_t handle){
+	const uint8_t * att_ptr = &att_db_util_get_address()[1];
+	while (true){
+		uint16_t size = little_endian_read_16(att_ptr, 0);
+		if (size == 0) return NULL;
+		if (little_endian_read_16(att_ptr, 4) == handle) return att_ptr;
+		att_ptr += size;
+	}
+}
+
+static void att_db_check_handle_lookup(uint16_t handle){
+	const uint8_t * att_ptr = att_db_reference_find_handle(handle);
+	uint16_t value_len = 0;
+	const uint8_t * value = gatt_server_get_const_value_for_handle(handle, &value_len);
+	if (att_ptr == NULL){
+		CHECK_EQUAL(0, att_uuid_for_handle(handle));
+		CHECK(value == NULL);
+		return;
+	}
+	uint16_t flags = little_endian_read_16(att_ptr, 2);
+	uint16_t expected_uuid = ((flags & ATT_PROPERTY_UUID128) != 0) ? 0 : little_endian_read_16(att_ptr, 6);
+	CHECK_EQUAL(expected_uuid, att_uuid_for_handle(handle));
+	if ((flags & ATT_PROPERTY_DYNAMIC) != 0){
+		CHECK(value == NULL);
+	} else {
+		uint16_t header_len = ((flags & ATT_PROPERTY_UUID128) != 0) ? 22 : 8;
+		CHECK(value == &att_ptr[header_len]);
+		CHECK_EQUAL(little_endian_read_16(att_ptr, 0) - header_len, value_len);
+	}
+}
+
 TEST_GROUP(AttDb){
 	att_connection_t att_connection;
 	uint16_t att_request_len;
@@ -909,6 +941,69 @@ TEST(AttDb, att_read_callback_handle_little_endian_32){
 }
 
 
+TEST(AttDb, handle_lookup_equivalence){
+	uint16_t handle;
+	for (handle = 0; handle < 0x40; handle++){
+		att_db_check_handle_lookup(handle);
+	}
+	att_db_check_handle_lookup(0xffff);
+}
+
+TEST(AttDb, handle_lookup_after_att_set_db){
+	// attributes added after att_set_db are found as well
+	uint16_t value_handle = att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL, ATT_PROPERTY_READ, ATT_SECURITY_NONE, ATT_SECURITY_NONE, &battery_level, 1);
+	CHECK(value_handle > 0x20);
+	CHECK_EQUAL(ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL, att_uuid_for_handle(value_handle));
+	uint16_t handle;
+	for (handle = 0; handle < 0x40; handle++){
+		att_db_check_handle_lookup(handle);
+	}
+}
+
+TEST(AttDb, handle_lookup_unsorted_db){
+	// handles in reverse order: 0x0003, 0x0002, 0x0001
+	static const uint8_t unsorted_db[] = {
+		ATT_DB_VERSION,
+		0x0a, 0x00, 0x02, 0x00, 0x03, 0x00, 0x00, 0x28, 0x0f, 0x18,
+		0x0a, 0x00, 0x02, 0x00, 0x02, 0x00, 0x00, 0x28, 0x0a, 0x18,
+		0x0a, 0x00, 0x02, 0x00, 0x01, 0x00, 0x00, 0x28, 0x00, 0x18,
+		0x00, 0x00,
+	};
+	att_set_db(unsorted_db);
+	uint16_t value_len;
+	const uint8_t * value = gatt_server_get_const_value_for_handle(0x0002, &value_len);
+	CHECK_EQUAL(2, value_len);
+	CHECK_EQUAL(0x180a, little_endian_read_16(value, 0));
+	value = gatt_server_get_const_value_for_handle(0x0001, &value_len);
+	CHECK_EQUAL(0x1800, little_endian_read_16(value, 0));
+	value = gatt_server_get_const_value_for_handle(0x0003, &value_len);
+	CHECK_EQUAL(0x180f, little_endian_read_16(value, 0));
+	CHECK(gatt_server_get_const_value_for_handle(0x0004, &value_len) == NULL);
+}
+
+TEST(AttDb, handle_lookup_large_db){
+	// 100 characteristics with value and CCC = 302 attributes
+	uint16_t i;
+	for (i = 0; i < 100; i++){
+		att_db_util_add_characteristic_uuid16(0x2a00 + i, ATT_PROPERTY_READ | ATT_PROPERTY_NOTIFY, ATT_SECURITY_NONE, ATT_SECURITY_NONE, &battery_level, 1);
+	}
+	att_set_db(att_db_util_get_address());
+	uint16_t handle;
+	for (handle = 0; handle < 0x160; handle++){
+		att_db_check_handle_lookup(handle);
+	}
+
+	// read request for last characteristic
+	uint16_t value_handle = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, 0x2a00 + 99);
+	CHECK(value_handle > 0x100);
+	att_request[0] = ATT_READ_REQUEST;
+	little_endian_store_16(att_request, 1, value_handle);
+	att_response_len = att_handle_request(&att_connection, (uint8_t *) att_request, 3, att_response);
+	CHECK_EQUAL(2, att_response_len);
+	CHECK_EQUAL(ATT_READ_RESPONSE, att_response[0]);
+	CHECK_EQUAL(battery_level, att_response[1]);
+}
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "btstack_crc_benchmark.c"
+
+/*
+ *  btstack_crc_benchmark.c
+ *
+ *  Throughput of btstack_crc8_calc and btstack_crc32_update compared to bitwise CRC-8 and bytewise CRC-32 reference
+ *  implementations. Build as btstack_crc_slicing_by_8_benchmark to measure ENABLE_CRC32_SLICING_BY_8.
+ */
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "btstack_util.h"
+
+#define BENCHMARK_BUFFER_SIZE 1024
+#define BENCHMARK_ROUNDS      2000
+
+static uint8_t benchmark_buffer[BENCHMARK_BUFFER_SIZE];
+
+// bitwise CRC-8 (reversed, poly 0x07) as reference
+static uint8_t benchmark_crc8_bitwise(const uint8_t * data, uint16_t len){
+    uint8_t crc = 0xff;
+    uint16_t i;
+    for (i = 0; i < len; i++){
+        crc ^= data[i];
+        int bit;
+        for (bit = 0; bit < 8; bit++){
+            crc = (crc & 1u) ? ((crc >> 1) ^ 0xe0u) : (crc >> 1);
+        }
+    }
+    return 0xffu - crc;
+}
+
+// bytewise table-driven CRC-32 as used without ENABLE_CRC32_SLICING_BY_8
+static uint32_t benchmark_crc32_table[256];
+
+static void benchmark_crc32_init_table(void){
+    uint32_t i;
+    for (i = 0; i < 256; i++){
+        uint32_t crc = i;
+        int bit;
+        for (bit = 0; bit < 8; bit++){
+            crc = (crc & 1u) ? ((crc >> 1) ^ 0xedb88320u) : (crc >> 1);
+        }
+        benchmark_crc32_table[i] = crc;
+    }
+}
+
+static uint32_t benchmark_crc32_bytewise(uint32_t crc, const uint8_t * data, uint32_t data_len){
+    while (data_len--){
+        crc = benchmark_crc32_table[(crc ^ *data++) & 0xffu] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static double benchmark_time_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+static void benchmark_report(const char * name, double duration_s){
+    const double num_bytes = (double) BENCHMARK_BUFFER_SIZE * BENCHMARK_ROUNDS;
+    printf("%s,%.1f\n", name, (num_bytes / duration_s) / 1e6);
+}
+
+int main(void){
+    volatile uint32_t sink = 0;
+    int round;
+    double start;
+    uint16_t i;
+
+    benchmark_crc32_init_table();
+    srand(1);
+    for (i = 0; i < sizeof(benchmark_buffer); i++){
+        benchmark_buffer[i] = (uint8_t) rand();
+    }
+
+    // results must match before timing
+    if ((benchmark_crc8_bitwise(benchmark_buffer, BENCHMARK_BUFFER_SIZE) != btstack_crc8_calc(benchmark_buffer, BENCHMARK_BUFFER_SIZE)) ||
+        (benchmark_crc32_bytewise(0xffffffffu, benchmark_buffer, BENCHMARK_BUFFER_SIZE) != btstack_crc32_update(0xffffffffu, benchmark_buffer, BENCHMARK_BUFFER_SIZE))){
+        printf("CRC mismatch\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("implementation,mb_per_s\n");
+
+    start = benchmark_time_s();
+    for (round = 0; round < BENCHMARK_ROUNDS; round++){
+        sink ^= benchmark_crc8_bitwise(benchmark_buffer, BENCHMARK_BUFFER_SIZE);
+    }
+    benchmark_report("crc8_bitwise", benchmark_time_s() - start);
+
+    start = benchmark_time_s();
+    for (round = 0; round < BENCHMARK_ROUNDS; round++){
+        sink ^= btstack_crc8_calc(benchmark_buffer, BENCHMARK_BUFFER_SIZE);
+    }
+    benchmark_report("btstack_crc8_calc", benchmark_time_s() - start);
+
+    start = benchmark_time_s();
+    for (round = 0; round < BENCHMARK_ROUNDS; round++){
+        sink ^= benchmark_crc32_bytewise(0xffffffffu, benchmark_buffer, BENCHMARK_BUFFER_SIZE);
+    }
+    benchmark_report("crc32_bytewise", benchmark_time_s() - start);
+
+    start = benchmark_time_s();
+    for (round = 0; round < BENCHMARK_ROUNDS; round++){
+        sink ^= btstack_crc32_update(0xffffffffu, benchmark_buffer, BENCHMARK_BUFFER_SIZE);
+    }
+    benchmark_report("btstack_crc32_update", benchmark_time_s() - start);
+
+    (void) sink;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "btstack_run_loop_benchmark.c"
+
+/*
+ *  btstack_run_loop_benchmark.c
+ *
+ *  Wakeup latency and CPU time per wakeup of the POSIX (select) and Linux (epoll) run loops with 10, 100 and
+ *  1000 data sources. Each data source is an eventfd, its handler triggers the eventfd of another data source,
+ *  so that wakeups are spread over all data sources.
+ */
+
+// enable POSIX and Linux functions (needed for -std=c99)
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_linux.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+
+#define BENCHMARK_WAKEUPS      20000
+#define BENCHMARK_MAX_SOURCES  1000
+
+static btstack_data_source_t benchmark_data_sources[BENCHMARK_MAX_SOURCES];
+static uint32_t benchmark_num_data_sources;
+static uint32_t benchmark_wakeups;
+static int      benchmark_failed;
+
+static void benchmark_trigger_eventfd(int fd){
+    const uint64_t value = 1;
+    if (write(fd, &value, sizeof(value)) != (ssize_t) sizeof(value)){
+        benchmark_failed = 1;
+    }
+}
+
+static void benchmark_ping_pong_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    uint64_t value;
+    ssize_t bytes_read = read(ds->source.fd, &value, sizeof(value));
+    UNUSED(bytes_read);
+    benchmark_wakeups++;
+    if (benchmark_wakeups == BENCHMARK_WAKEUPS){
+        btstack_run_loop_trigger_exit();
+        return;
+    }
+    // wake up a different data source, spread over all
+    uint32_t next = ((uint32_t) (ds - benchmark_data_sources) + 7919) % benchmark_num_data_sources;
+    benchmark_trigger_eventfd(benchmark_data_sources[next].source.fd);
+}
+
+static bool benchmark_add_data_sources(uint32_t count){
+    for (benchmark_num_data_sources = 0; benchmark_num_data_sources < count; benchmark_num_data_sources++){
+        int fd = eventfd(0, EFD_NONBLOCK);
+        if (fd < 0) return false;
+        btstack_data_source_t * ds = &benchmark_data_sources[benchmark_num_data_sources];
+        memset(ds, 0, sizeof(btstack_data_source_t));
+        btstack_run_loop_set_data_source_fd(ds, fd);
+        btstack_run_loop_set_data_source_handler(ds, &benchmark_ping_pong_handler);
+        btstack_run_loop_enable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
+        btstack_run_loop_add_data_source(ds);
+    }
+    return true;
+}
+
+static void benchmark_remove_data_sources(void){
+    uint32_t i;
+    for (i = 0; i < benchmark_num_data_sources; i++){
+        btstack_run_loop_remove_data_source(&benchmark_data_sources[i]);
+        close(benchmark_data_sources[i].source.fd);
+    }
+    benchmark_num_data_sources = 0;
+}
+
+static double benchmark_time_ns(clockid_t clock_id){
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return ((double) ts.tv_sec * 1000000000.0) + (double) ts.tv_nsec;
+}
+
+static void benchmark_run(const char * name, const btstack_run_loop_t * run_loop, uint32_t count){
+    btstack_run_loop_init(run_loop);
+    if (benchmark_add_data_sources(count) == false){
+        fprintf(stderr, "%s with %u data sources skipped, eventfd failed\n", name, count);
+    } else if ((run_loop == btstack_run_loop_posix_get_instance()) && (benchmark_data_sources[count-1].source.fd >= FD_SETSIZE)){
+        fprintf(stderr, "%s with %u data sources skipped, fd exceeds FD_SETSIZE\n", name, count);
+    } else {
+        benchmark_wakeups = 0;
+        double start_ns     = benchmark_time_ns(CLOCK_MONOTONIC);
+        double start_cpu_ns = benchmark_time_ns(CLOCK_PROCESS_CPUTIME_ID);
+        benchmark_trigger_eventfd(benchmark_data_sources[0].source.fd);
+        btstack_run_loop_execute();
+        double wakeup_ns = (benchmark_time_ns(CLOCK_MONOTONIC) - start_ns) / BENCHMARK_WAKEUPS;
+        double cpu_ns    = (benchmark_time_ns(CLOCK_PROCESS_CPUTIME_ID) - start_cpu_ns) / BENCHMARK_WAKEUPS;
+        if (benchmark_wakeups != BENCHMARK_WAKEUPS){
+            benchmark_failed = 1;
+        }
+        printf("%s,%u,%.0f,%.0f\n", name, count, wakeup_ns, cpu_ns);
+    }
+    benchmark_remove_data_sources();
+    btstack_run_loop_deinit();
+}
+
+int main(int argc, char * argv[]){
+    UNUSED(argc);
+    UNUSED(argv);
+
+    // allow for more than FD_SETSIZE file descriptors
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < limit.rlim_max){
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    static const uint32_t data_source_counts[] = { 10, 100, 1000 };
+    printf("run_loop,data_sources,wakeup_latency_ns,cpu_ns_per_wakeup\n");
+    uint32_t i;
+    for (i = 0; i < sizeof(data_source_counts) / sizeof(data_source_counts[0]); i++){
+        benchmark_run("select", btstack_run_loop_posix_get_instance(), data_source_counts[i]);
+        benchmark_run("epoll",  btstack_run_loop_linux_get_instance(), data_source_counts[i]);
+    }
+
+    if (benchmark_failed){
+        printf("wakeups lost\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "btstack_tlv_posix_benchmark.c"
+
+/*
+ *  btstack_tlv_posix_benchmark.c
+ *
+ *  Store throughput, startup load time and lookup cost of the POSIX TLV for 100, 1000 and 5000 tags, with and
+ *  without write coalescing. Each tag is stored twice, e.g. bonding information followed by an updated CCC.
+ */
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack_tlv.h"
+#include "btstack_tlv_posix.h"
+#include "btstack_util.h"
+
+#define BENCHMARK_DEFAULT_DB_PATH "/tmp/btstack_tlv_posix_benchmark.tlv"
+#define BENCHMARK_VALUE_SIZE 64
+
+#define BENCHMARK_TAG(a,b,c,d) ( ((a)<<24) | ((b)<<16) | ((c)<<8) | (d) )
+
+static double benchmark_time_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((double) ts.tv_sec * 1000.0) + ((double) ts.tv_nsec / 1000000.0);
+}
+
+// returns 0 if all tags were read back with the last value
+static int benchmark_run(const char * db_path, uint32_t num_tags, bool coalescing){
+    btstack_tlv_posix_t tlv_context;
+    const btstack_tlv_t * tlv_impl;
+    uint8_t value[BENCHMARK_VALUE_SIZE];
+    uint32_t round;
+    uint32_t i;
+
+    memset(value, 0x55, sizeof(value));
+    unlink(db_path);
+    tlv_impl = btstack_tlv_posix_init_instance(&tlv_context, db_path);
+    btstack_tlv_posix_set_write_coalescing(&tlv_context, coalescing);
+
+    // store each tag twice
+    double start_ms = benchmark_time_ms();
+    for (round = 0; round < 2; round++){
+        for (i = 0; i < num_tags; i++){
+            value[0] = (uint8_t) round;
+            tlv_impl->store_tag(&tlv_context, BENCHMARK_TAG('b','n',0,0) + i, value, sizeof(value));
+        }
+    }
+    btstack_tlv_posix_sync(&tlv_context);
+    double store_ms = benchmark_time_ms() - start_ms;
+
+    // startup load
+    btstack_tlv_posix_deinit(&tlv_context);
+    start_ms = benchmark_time_ms();
+    tlv_impl = btstack_tlv_posix_init_instance(&tlv_context, db_path);
+    double load_ms = benchmark_time_ms() - start_ms;
+
+    // lookup
+    uint8_t buffer[BENCHMARK_VALUE_SIZE];
+    uint32_t num_valid = 0;
+    start_ms = benchmark_time_ms();
+    for (i = 0; i < num_tags; i++){
+        int len = tlv_impl->get_tag(&tlv_context, BENCHMARK_TAG('b','n',0,0) + i, buffer, sizeof(buffer));
+        if ((len == (int) sizeof(buffer)) && (buffer[0] == 1u)){
+            num_valid++;
+        }
+    }
+    double get_ms = benchmark_time_ms() - start_ms;
+
+    btstack_tlv_posix_deinit(&tlv_context);
+    unlink(db_path);
+
+    printf("%u,%u,%.0f,%.2f,%.0f\n", num_tags, coalescing ? 1 : 0, (2.0 * num_tags) / (store_ms / 1000.0), load_ms,
+           (get_ms * 1000000.0) / num_tags);
+    return (num_valid == num_tags) ? 0 : 1;
+}
+
+int main(int argc, char * argv[]){
+    const char * db_path = (argc > 1) ? argv[1] : BENCHMARK_DEFAULT_DB_PATH;
+
+    static const uint32_t tag_counts[] = { 100, 1000, 5000 };
+    int failed = 0;
+    printf("tags,coalescing,stores_per_s,load_ms,get_ns\n");
+    uint32_t i;
+    for (i = 0; i < sizeof(tag_counts) / sizeof(tag_counts[0]); i++){
+        failed |= benchmark_run(db_path, tag_counts[i], false);
+        failed |= benchmark_run(db_path, tag_counts[i], true);
+    }
+
+    if (failed){
+        printf("stored values not found\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "hci_connection_lookup_benchmark.c"
+
+/*
+ *  hci_connection_lookup_benchmark.c
+ *
+ *  Cost of HCI connection lookup by con handle and by address for an increasing number of LE connections.
+ *  Built as hci_connection_lookup_benchmark with the linked list only and as hci_connection_lookup_index_benchmark
+ *  with ENABLE_HCI_CONNECTION_INDEX. HCI is powered on with the virtual HCI Controller, connections are created
+ *  by feeding LE Connection Complete events into HCI.
+ */
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "btstack.h"
+#include "btstack_run_loop_posix.h"
+#include "hci_transport_virtual_posix.h"
+
+#define BENCHMARK_LOOKUPS 1000000
+
+static hci_transport_virtual_posix_config_t benchmark_transport_config;
+static hci_transport_t benchmark_transport;
+static btstack_packet_callback_registration_t benchmark_hci_event_callback_registration;
+
+// HCI packet handler, used to inject LE Connection Complete events
+static void (*benchmark_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+static void benchmark_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    benchmark_packet_handler = handler;
+    hci_transport_virtual_posix_instance()->register_packet_handler(handler);
+}
+
+static void benchmark_hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != BTSTACK_EVENT_STATE) return;
+    if (btstack_event_state_get_state(packet) != HCI_STATE_WORKING) return;
+    btstack_run_loop_trigger_exit();
+}
+
+static double benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((double) ts.tv_sec * 1000000000.0) + (double) ts.tv_nsec;
+}
+
+static void benchmark_address_for_index(uint16_t index, bd_addr_t addr){
+    addr[0] = 0xC0;
+    addr[1] = 0x11;
+    addr[2] = 0x22;
+    addr[3] = 0x33;
+    addr[4] = index >> 8;
+    addr[5] = index & 0xff;
+}
+
+static hci_con_handle_t benchmark_con_handle_for_index(uint16_t index){
+    // controllers often assign handles sparse
+    return (hci_con_handle_t) (0x40 + (index * 3));
+}
+
+static void benchmark_le_connection_complete(uint16_t index){
+    bd_addr_t addr;
+    benchmark_address_for_index(index, addr);
+    uint8_t event[] = { HCI_EVENT_LE_META, 19, HCI_SUBEVENT_LE_CONNECTION_COMPLETE,
+                        ERROR_CODE_SUCCESS, 0, 0, HCI_ROLE_SLAVE, BD_ADDR_TYPE_LE_RANDOM,
+                        0, 0, 0, 0, 0, 0,
+                        0x18, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00};
+    little_endian_store_16(event, 4, benchmark_con_handle_for_index(index));
+    reverse_bd_addr(addr, &event[8]);
+    (*benchmark_packet_handler)(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+int main(int argc, char * argv[]){
+    UNUSED(argc);
+    UNUSED(argv);
+
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+
+    // virtual Controller without peer, HCI packet handler is recorded by the wrapper
+    benchmark_transport = *hci_transport_virtual_posix_instance();
+    benchmark_transport.register_packet_handler = &benchmark_transport_register_packet_handler;
+    benchmark_transport_config.acl_data_packet_length = 1021;
+    benchmark_transport_config.total_num_acl_data_packets = 4;
+    benchmark_transport_config.le_acl_data_packet_length = 251;
+    benchmark_transport_config.total_num_le_acl_data_packets = 4;
+    benchmark_transport_config.link_fd = -1;
+    hci_init(&benchmark_transport, &benchmark_transport_config);
+    benchmark_hci_event_callback_registration.callback = &benchmark_hci_event_handler;
+    hci_add_event_handler(&benchmark_hci_event_callback_registration);
+    hci_power_control(HCI_POWER_ON);
+    btstack_run_loop_execute();
+
+    static const uint16_t connection_counts[] = { 1, 4, 16, 64, 256 };
+    uint16_t num_created = 0;
+    int failed = 0;
+
+    printf("connections,by_handle_ns,by_address_ns\n");
+    uint16_t i;
+    for (i = 0; i < sizeof(connection_counts) / sizeof(connection_counts[0]); i++){
+        uint16_t num_connections = connection_counts[i];
+        while (num_created < num_connections){
+            benchmark_le_connection_complete(num_created++);
+        }
+
+        // lookup by con handle
+        uint32_t found = 0;
+        uint32_t j;
+        double start_ns = benchmark_time_ns();
+        for (j = 0; j < BENCHMARK_LOOKUPS; j++){
+            if (hci_connection_for_handle(benchmark_con_handle_for_index(j % num_connections)) != NULL){
+                found++;
+            }
+        }
+        double handle_ns = (benchmark_time_ns() - start_ns) / BENCHMARK_LOOKUPS;
+        if (found != BENCHMARK_LOOKUPS){
+            failed = 1;
+        }
+
+        // lookup by address
+        bd_addr_t addr;
+        found = 0;
+        start_ns = benchmark_time_ns();
+        for (j = 0; j < BENCHMARK_LOOKUPS; j++){
+            benchmark_address_for_index(j % num_connections, addr);
+            if (hci_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_LE_RANDOM) != NULL){
+                found++;
+            }
+        }
+        double address_ns = (benchmark_time_ns() - start_ns) / BENCHMARK_LOOKUPS;
+        if (found != BENCHMARK_LOOKUPS){
+            failed = 1;
+        }
+
+        printf("%u,%.1f,%.1f\n", num_connections, handle_ns, address_ns);
+    }
+
+    hci_power_control(HCI_POWER_OFF);
+    hci_close();
+    btstack_run_loop_deinit();
+    btstack_memory_deinit();
+
+    if (failed){
+        printf("lookup failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
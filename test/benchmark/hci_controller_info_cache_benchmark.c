@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "hci_controller_info_cache_benchmark.c"
+
+/*
+ *  hci_controller_info_cache_benchmark.c
+ *
+ *  HCI commands sent and time until HCI is working for a cold boot without cached Controller information and
+ *  a warm boot with ENABLE_HCI_CONTROLLER_INFO_CACHE. The virtual HCI Controller answers immediately, the
+ *  estimated boot time assumes a fixed round trip time per HCI command as seen with UART Controllers.
+ */
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_tlv_posix.h"
+#include "hci_transport_virtual_posix.h"
+
+#define BENCHMARK_DEFAULT_DB_PATH "/tmp/hci_controller_info_cache_benchmark.tlv"
+
+// assumed round trip time of a single HCI command over UART
+#define BENCHMARK_COMMAND_LATENCY_MS 5
+
+static hci_transport_virtual_posix_config_t benchmark_transport_config;
+static hci_transport_t benchmark_transport;
+static btstack_packet_callback_registration_t benchmark_hci_event_callback_registration;
+static uint16_t benchmark_num_commands;
+
+static int benchmark_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type == HCI_COMMAND_DATA_PACKET){
+        benchmark_num_commands++;
+    }
+    return hci_transport_virtual_posix_instance()->send_packet(packet_type, packet, size);
+}
+
+static void benchmark_hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != BTSTACK_EVENT_STATE) return;
+    if (btstack_event_state_get_state(packet) != HCI_STATE_WORKING) return;
+    btstack_run_loop_trigger_exit();
+}
+
+static double benchmark_time_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((double) ts.tv_sec * 1000.0) + ((double) ts.tv_nsec / 1000000.0);
+}
+
+// power on until HCI is working and report number of HCI commands, returns number of commands
+static uint16_t benchmark_boot(const char * name, const btstack_tlv_t * tlv_impl, btstack_tlv_posix_t * tlv_context){
+    hci_init(&benchmark_transport, &benchmark_transport_config);
+    hci_set_controller_info_cache_tlv(tlv_impl, tlv_context);
+    benchmark_hci_event_callback_registration.callback = &benchmark_hci_event_handler;
+    hci_add_event_handler(&benchmark_hci_event_callback_registration);
+
+    benchmark_num_commands = 0;
+    double start_ms = benchmark_time_ms();
+    hci_power_control(HCI_POWER_ON);
+    btstack_run_loop_execute();
+    double boot_ms = benchmark_time_ms() - start_ms;
+    uint16_t num_commands = benchmark_num_commands;
+
+    hci_power_control(HCI_POWER_OFF);
+    hci_close();
+
+    printf("%s,%u,%.2f,%u\n", name, num_commands, boot_ms, num_commands * BENCHMARK_COMMAND_LATENCY_MS);
+    return num_commands;
+}
+
+int main(int argc, char * argv[]){
+    const char * db_path = (argc > 1) ? argv[1] : BENCHMARK_DEFAULT_DB_PATH;
+
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+
+    // virtual Controller without peer, HCI commands are counted by the wrapper
+    benchmark_transport = *hci_transport_virtual_posix_instance();
+    benchmark_transport.send_packet = &benchmark_transport_send_packet;
+    benchmark_transport_config.acl_data_packet_length = 1021;
+    benchmark_transport_config.total_num_acl_data_packets = 4;
+    benchmark_transport_config.le_acl_data_packet_length = 251;
+    benchmark_transport_config.total_num_le_acl_data_packets = 4;
+    benchmark_transport_config.link_fd = -1;
+
+    // start without cached information
+    btstack_tlv_posix_t tlv_context;
+    unlink(db_path);
+    const btstack_tlv_t * tlv_impl = btstack_tlv_posix_init_instance(&tlv_context, db_path);
+
+    printf("boot,hci_commands,boot_ms,estimated_uart_ms\n");
+    uint16_t cold_commands = benchmark_boot("cold", tlv_impl, &tlv_context);
+    uint16_t warm_commands = benchmark_boot("warm", tlv_impl, &tlv_context);
+
+    btstack_tlv_posix_deinit(&tlv_context);
+    unlink(db_path);
+    btstack_run_loop_deinit();
+    btstack_memory_deinit();
+
+    if (warm_commands >= cold_commands){
+        printf("warm boot did not skip HCI commands\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
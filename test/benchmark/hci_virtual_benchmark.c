@@ -0,0 +1,674 @@
+/*
+ * Copyright (C) 2026 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "hci_virtual_benchmark.c"
+
+/*
+ *  hci_virtual_benchmark.c
+ *
+ *  Throughput, latency and CPU usage for GATT Notifications, L2CAP LE Credit-Based channels, RFCOMM and
+ *  A2DP media packets between two BTstack instances with virtual HCI Controllers, no Bluetooth hardware needed.
+ *
+ *  As BTstack supports a single HCI instance per process, an initiator and a responder process are forked
+ *  and linked by a socketpair. The first 8 bytes of each payload contain the send time, the receiver reports
+ *  bytes and latency, both report the CPU time used during the measurement.
+ */
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack.h"
+#include "btstack_run_loop_posix.h"
+#include "hci_transport_virtual_posix.h"
+
+#include "hci_virtual_benchmark.h"
+
+#define BENCHMARK_SETUP_TIMEOUT_MS     5000
+#define BENCHMARK_RETRY_MS              100
+#define BENCHMARK_DEFAULT_DURATION_MS  2000
+#define BENCHMARK_CBM_PSM              0x0081
+#define BENCHMARK_CBM_MTU              1000
+#define BENCHMARK_RFCOMM_CHANNEL       1
+#define BENCHMARK_TIMESTAMP_SIZE       8
+#define BENCHMARK_RTP_HEADER_SIZE      12
+
+#define BENCHMARK_NOTIFICATION_VALUE_HANDLE ATT_CHARACTERISTIC_0000FF11_0000_1000_8000_00805F9B34FB_01_VALUE_HANDLE
+#define BENCHMARK_NOTIFICATION_CCCD_HANDLE  ATT_CHARACTERISTIC_0000FF11_0000_1000_8000_00805F9B34FB_01_CLIENT_CONFIGURATION_HANDLE
+
+typedef enum {
+    BENCHMARK_GATT = 0,
+    BENCHMARK_CBM,
+    BENCHMARK_RFCOMM,
+    BENCHMARK_A2DP,
+    BENCHMARK_COUNT,
+} benchmark_type_t;
+
+static const char * benchmark_names[BENCHMARK_COUNT] = { "gatt", "cbm", "rfcomm", "a2dp" };
+
+typedef struct {
+    uint8_t  status;
+    uint32_t packets;
+    uint64_t bytes;
+    uint32_t duration_ms;
+    uint64_t latency_sum_us;
+    uint32_t latency_max_us;
+    uint32_t cpu_ms;
+} benchmark_result_t;
+
+static const bd_addr_t benchmark_initiator_addr = { 0x00, 0x1B, 0xDC, 0x00, 0x00, 0x01 };
+static const bd_addr_t benchmark_responder_addr = { 0x00, 0x1B, 0xDC, 0x00, 0x00, 0x02 };
+
+// options
+static uint32_t benchmark_duration_ms = BENCHMARK_DEFAULT_DURATION_MS;
+static uint32_t benchmark_link_rate_bps;
+static uint16_t benchmark_num_acl_packets = 8;
+static uint8_t  benchmark_num_le_acl_packets = 8;
+
+// process state
+static benchmark_type_t benchmark_type;
+static bool             benchmark_initiator;
+static bool             benchmark_sender;
+static int              benchmark_result_fd;
+static bd_addr_t        benchmark_peer_addr;
+static hci_transport_virtual_posix_config_t benchmark_transport_config;
+
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static btstack_timer_source_t benchmark_timer;
+static btstack_timer_source_t benchmark_retry_timer;
+static bool               benchmark_running;
+static bool               benchmark_done;
+static uint64_t           benchmark_start_time_us;
+static uint64_t           benchmark_start_cpu_us;
+static benchmark_result_t benchmark_result;
+static uint8_t            benchmark_payload[HCI_ACL_PAYLOAD_SIZE];
+
+// GATT
+static hci_con_handle_t benchmark_con_handle = HCI_CON_HANDLE_INVALID;
+static gatt_client_notification_t   benchmark_notification_listener;
+static gatt_client_characteristic_t benchmark_characteristic;
+
+// L2CAP CBM
+static uint16_t benchmark_cbm_cid;
+static uint16_t benchmark_cbm_mtu;
+static uint8_t  benchmark_cbm_receive_buffer[BENCHMARK_CBM_MTU];
+
+// RFCOMM
+static uint16_t benchmark_rfcomm_cid;
+static uint16_t benchmark_rfcomm_mtu;
+
+// A2DP
+static uint16_t benchmark_a2dp_cid;
+static uint8_t  benchmark_a2dp_local_seid;
+static uint32_t benchmark_a2dp_rtp_timestamp;
+static uint8_t  benchmark_sdp_service_buffer[150];
+static uint8_t  benchmark_sbc_codec_capabilities[] = { 0xFF, 0xFF, 2, 53 };
+static uint8_t  benchmark_sbc_codec_configuration[4];
+
+static void benchmark_rfcomm_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
+
+static uint64_t benchmark_time_us(clockid_t clock_id){
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000u) + ((uint64_t) ts.tv_nsec / 1000u);
+}
+
+static void benchmark_report(uint8_t status){
+    if (benchmark_done) return;
+    benchmark_done = true;
+    benchmark_running = false;
+    btstack_run_loop_remove_timer(&benchmark_timer);
+    btstack_run_loop_remove_timer(&benchmark_retry_timer);
+    benchmark_result.status = status;
+    if (status == ERROR_CODE_SUCCESS){
+        benchmark_result.duration_ms = (uint32_t) ((benchmark_time_us(CLOCK_MONOTONIC) - benchmark_start_time_us) / 1000u);
+        benchmark_result.cpu_ms = (uint32_t) ((benchmark_time_us(CLOCK_PROCESS_CPUTIME_ID) - benchmark_start_cpu_us) / 1000u);
+    }
+    // parent terminates process after receiving both results
+    if (write(benchmark_result_fd, &benchmark_result, sizeof(benchmark_result)) != (ssize_t) sizeof(benchmark_result)){
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void benchmark_timeout_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    // setup timeout if measurement didn't start
+    benchmark_report(benchmark_running ? ERROR_CODE_SUCCESS : ERROR_CODE_CONNECTION_ACCEPT_TIMEOUT_EXCEEDED);
+}
+
+static void benchmark_start(void){
+    if (benchmark_running || benchmark_done) return;
+    benchmark_running = true;
+    benchmark_start_time_us = benchmark_time_us(CLOCK_MONOTONIC);
+    benchmark_start_cpu_us = benchmark_time_us(CLOCK_PROCESS_CPUTIME_ID);
+    btstack_run_loop_remove_timer(&benchmark_timer);
+    btstack_run_loop_set_timer(&benchmark_timer, benchmark_duration_ms);
+    btstack_run_loop_add_timer(&benchmark_timer);
+}
+
+static uint8_t * benchmark_prepare_payload(uint16_t size){
+    uint64_t now_us = benchmark_time_us(CLOCK_MONOTONIC);
+    little_endian_store_32(benchmark_payload, 0, (uint32_t) now_us);
+    little_endian_store_32(benchmark_payload, 4, (uint32_t) (now_us >> 32));
+    benchmark_result.packets++;
+    benchmark_result.bytes += size;
+    return benchmark_payload;
+}
+
+static void benchmark_receive(const uint8_t * data, uint16_t size){
+    if (benchmark_running == false) return;
+    benchmark_result.packets++;
+    benchmark_result.bytes += size;
+    if (size < BENCHMARK_TIMESTAMP_SIZE) return;
+    uint64_t sent_us = ((uint64_t) little_endian_read_32(data, 4) << 32) | little_endian_read_32(data, 0);
+    uint32_t latency_us = (uint32_t) (benchmark_time_us(CLOCK_MONOTONIC) - sent_us);
+    benchmark_result.latency_sum_us += latency_us;
+    benchmark_result.latency_max_us = btstack_max(benchmark_result.latency_max_us, latency_us);
+}
+
+static void benchmark_connect(void){
+    uint8_t status = ERROR_CODE_SUCCESS;
+    switch (benchmark_type){
+        case BENCHMARK_GATT:
+        case BENCHMARK_CBM:
+            status = gap_connect(benchmark_peer_addr, BD_ADDR_TYPE_LE_PUBLIC);
+            break;
+        case BENCHMARK_RFCOMM:
+            status = rfcomm_create_channel(&benchmark_rfcomm_packet_handler, benchmark_peer_addr, BENCHMARK_RFCOMM_CHANNEL, &benchmark_rfcomm_cid);
+            break;
+        case BENCHMARK_A2DP:
+            status = a2dp_source_establish_stream(benchmark_peer_addr, &benchmark_a2dp_cid);
+            break;
+        default:
+            btstack_unreachable();
+            break;
+    }
+    if (status != ERROR_CODE_SUCCESS){
+        benchmark_report(status);
+    }
+}
+
+// Classic connections fail until peer enabled page scan
+static void benchmark_retry_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    benchmark_connect();
+}
+
+static void benchmark_retry_connect(void){
+    btstack_run_loop_remove_timer(&benchmark_retry_timer);
+    btstack_run_loop_set_timer_handler(&benchmark_retry_timer, &benchmark_retry_handler);
+    btstack_run_loop_set_timer(&benchmark_retry_timer, BENCHMARK_RETRY_MS);
+    btstack_run_loop_add_timer(&benchmark_retry_timer);
+}
+
+// GATT: responder sends notifications as soon as initiator enabled them
+
+static void benchmark_gatt_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case GATT_EVENT_NOTIFICATION:
+            benchmark_receive(gatt_event_notification_get_value(packet), gatt_event_notification_get_value_length(packet));
+            break;
+        case GATT_EVENT_QUERY_COMPLETE:
+            if (gatt_event_query_complete_get_att_status(packet) != ATT_ERROR_SUCCESS){
+                benchmark_report(ERROR_CODE_UNSPECIFIED_ERROR);
+                break;
+            }
+            benchmark_start();
+            break;
+        default:
+            break;
+    }
+}
+
+static void benchmark_gatt_client_enable_notifications(void){
+    static uint8_t cccd_value[2] = { GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION, 0 };
+    benchmark_characteristic.value_handle = BENCHMARK_NOTIFICATION_VALUE_HANDLE;
+    benchmark_characteristic.end_handle = BENCHMARK_NOTIFICATION_CCCD_HANDLE;
+    gatt_client_listen_for_characteristic_value_updates(&benchmark_notification_listener, &benchmark_gatt_client_packet_handler,
+                                                        benchmark_con_handle, &benchmark_characteristic);
+    gatt_client_write_value_of_characteristic(&benchmark_gatt_client_packet_handler, benchmark_con_handle,
+                                              BENCHMARK_NOTIFICATION_CCCD_HANDLE, sizeof(cccd_value), cccd_value);
+}
+
+static int benchmark_att_write_callback(hci_con_handle_t con_handle, uint16_t attribute_handle, uint16_t transaction_mode,
+                                        uint16_t offset, uint8_t *buffer, uint16_t buffer_size){
+    UNUSED(transaction_mode);
+    UNUSED(offset);
+    if (attribute_handle != BENCHMARK_NOTIFICATION_CCCD_HANDLE) return 0;
+    if ((buffer_size < 2u) || (little_endian_read_16(buffer, 0) != GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION)) return 0;
+    benchmark_con_handle = con_handle;
+    benchmark_start();
+    att_server_request_can_send_now_event(con_handle);
+    return 0;
+}
+
+static void benchmark_att_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != ATT_EVENT_CAN_SEND_NOW) return;
+    if ((benchmark_running == false) || (benchmark_sender == false)) return;
+    uint16_t value_len = att_server_get_mtu(benchmark_con_handle) - 3u;
+    att_server_notify(benchmark_con_handle, BENCHMARK_NOTIFICATION_VALUE_HANDLE, benchmark_prepare_payload(value_len), value_len);
+    att_server_request_can_send_now_event(benchmark_con_handle);
+}
+
+// L2CAP CBM: initiator sends SDUs with remote MTU
+
+static void benchmark_l2cap_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    if (packet_type == L2CAP_DATA_PACKET){
+        benchmark_receive(packet, size);
+        return;
+    }
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case L2CAP_EVENT_CBM_INCOMING_CONNECTION:
+            l2cap_cbm_accept_connection(l2cap_event_cbm_incoming_connection_get_local_cid(packet), benchmark_cbm_receive_buffer,
+                                        sizeof(benchmark_cbm_receive_buffer), L2CAP_LE_AUTOMATIC_CREDITS);
+            break;
+        case L2CAP_EVENT_CBM_CHANNEL_OPENED:
+            if (l2cap_event_cbm_channel_opened_get_status(packet) != ERROR_CODE_SUCCESS){
+                benchmark_report(l2cap_event_cbm_channel_opened_get_status(packet));
+                break;
+            }
+            benchmark_cbm_cid = l2cap_event_cbm_channel_opened_get_local_cid(packet);
+            benchmark_cbm_mtu = l2cap_event_cbm_channel_opened_get_remote_mtu(packet);
+            benchmark_start();
+            if (benchmark_sender){
+                l2cap_request_can_send_now_event(benchmark_cbm_cid);
+            }
+            break;
+        case L2CAP_EVENT_CAN_SEND_NOW:
+            if ((benchmark_running == false) || (benchmark_sender == false)) break;
+            l2cap_send(benchmark_cbm_cid, benchmark_prepare_payload(benchmark_cbm_mtu), benchmark_cbm_mtu);
+            l2cap_request_can_send_now_event(benchmark_cbm_cid);
+            break;
+        default:
+            break;
+    }
+}
+
+// RFCOMM: initiator sends frames with max frame size
+
+static void benchmark_rfcomm_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    if (packet_type == RFCOMM_DATA_PACKET){
+        benchmark_receive(packet, size);
+        return;
+    }
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case RFCOMM_EVENT_INCOMING_CONNECTION:
+            rfcomm_accept_connection(rfcomm_event_incoming_connection_get_rfcomm_cid(packet));
+            break;
+        case RFCOMM_EVENT_CHANNEL_OPENED:
+            if (rfcomm_event_channel_opened_get_status(packet) != ERROR_CODE_SUCCESS){
+                if (benchmark_initiator){
+                    benchmark_retry_connect();
+                }
+                break;
+            }
+            benchmark_rfcomm_cid = rfcomm_event_channel_opened_get_rfcomm_cid(packet);
+            benchmark_rfcomm_mtu = rfcomm_event_channel_opened_get_max_frame_size(packet);
+            benchmark_start();
+            if (benchmark_sender){
+                rfcomm_request_can_send_now_event(benchmark_rfcomm_cid);
+            }
+            break;
+        case RFCOMM_EVENT_CAN_SEND_NOW:
+            if ((benchmark_running == false) || (benchmark_sender == false)) break;
+            rfcomm_send(benchmark_rfcomm_cid, benchmark_prepare_payload(benchmark_rfcomm_mtu), benchmark_rfcomm_mtu);
+            rfcomm_request_can_send_now_event(benchmark_rfcomm_cid);
+            break;
+        default:
+            break;
+    }
+}
+
+// A2DP: initiator is Source and sends media packets with max payload size, SBC frames are not encoded
+
+static void benchmark_a2dp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != HCI_EVENT_A2DP_META) return;
+    uint16_t payload_size;
+    switch (hci_event_a2dp_meta_get_subevent_code(packet)){
+        case A2DP_SUBEVENT_SIGNALING_CONNECTION_ESTABLISHED:
+            if (a2dp_subevent_signaling_connection_established_get_status(packet) == ERROR_CODE_SUCCESS) break;
+            if (benchmark_initiator){
+                benchmark_retry_connect();
+            }
+            break;
+        case A2DP_SUBEVENT_STREAM_ESTABLISHED:
+            if (a2dp_subevent_stream_established_get_status(packet) != ERROR_CODE_SUCCESS){
+                benchmark_report(a2dp_subevent_stream_established_get_status(packet));
+                break;
+            }
+            if (benchmark_initiator){
+                benchmark_a2dp_cid = a2dp_subevent_stream_established_get_a2dp_cid(packet);
+                a2dp_source_start_stream(benchmark_a2dp_cid, benchmark_a2dp_local_seid);
+            }
+            break;
+        case A2DP_SUBEVENT_STREAM_STARTED:
+            benchmark_start();
+            if (benchmark_sender){
+                a2dp_source_stream_endpoint_request_can_send_now(benchmark_a2dp_cid, benchmark_a2dp_local_seid);
+            }
+            break;
+        case A2DP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW:
+            if ((benchmark_running == false) || (benchmark_sender == false)) break;
+            payload_size = (uint16_t) a2dp_max_media_payload_size(benchmark_a2dp_cid, benchmark_a2dp_local_seid);
+            a2dp_source_stream_send_media_payload_rtp(benchmark_a2dp_cid, benchmark_a2dp_local_seid, 0, benchmark_a2dp_rtp_timestamp,
+                                                      benchmark_prepare_payload(payload_size), payload_size);
+            benchmark_a2dp_rtp_timestamp += 128;
+            a2dp_source_stream_endpoint_request_can_send_now(benchmark_a2dp_cid, benchmark_a2dp_local_seid);
+            break;
+        default:
+            break;
+    }
+}
+
+static void benchmark_a2dp_media_handler(uint8_t local_seid, uint8_t *packet, uint16_t size){
+    UNUSED(local_seid);
+    if (size < BENCHMARK_RTP_HEADER_SIZE) return;
+    benchmark_receive(&packet[BENCHMARK_RTP_HEADER_SIZE], size - BENCHMARK_RTP_HEADER_SIZE);
+}
+
+// setup
+
+static void benchmark_hci_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    bd_addr_t null_addr;
+    switch (hci_event_packet_get_type(packet)){
+        case BTSTACK_EVENT_STATE:
+            if (btstack_event_state_get_state(packet) != HCI_STATE_WORKING) break;
+            if (benchmark_initiator){
+                benchmark_connect();
+                break;
+            }
+            if ((benchmark_type == BENCHMARK_GATT) || (benchmark_type == BENCHMARK_CBM)){
+                memset(null_addr, 0, sizeof(null_addr));
+                gap_advertisements_set_params(0x0030, 0x0030, 0, 0, null_addr, 0x07, 0x00);
+                gap_advertisements_enable(1);
+            }
+            break;
+        case HCI_EVENT_META_GAP:
+            if (hci_event_gap_meta_get_subevent_code(packet) != GAP_SUBEVENT_LE_CONNECTION_COMPLETE) break;
+            if (gap_subevent_le_connection_complete_get_status(packet) != ERROR_CODE_SUCCESS){
+                benchmark_report(gap_subevent_le_connection_complete_get_status(packet));
+                break;
+            }
+            if (benchmark_initiator == false) break;
+            benchmark_con_handle = gap_subevent_le_connection_complete_get_connection_handle(packet);
+            if (benchmark_type == BENCHMARK_GATT){
+                benchmark_gatt_client_enable_notifications();
+            } else {
+                l2cap_cbm_create_channel(&benchmark_l2cap_packet_handler, benchmark_con_handle, BENCHMARK_CBM_PSM,
+                                         benchmark_cbm_receive_buffer, sizeof(benchmark_cbm_receive_buffer),
+                                         L2CAP_LE_AUTOMATIC_CREDITS, LEVEL_0, &benchmark_cbm_cid);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void benchmark_setup(void){
+    l2cap_init();
+    // virtual Controller does not support pairing
+    gap_set_security_level(LEVEL_0);
+
+    switch (benchmark_type){
+        case BENCHMARK_GATT:
+            sm_init();
+            if (benchmark_initiator){
+                gatt_client_init();
+            } else {
+                att_server_init(profile_data, NULL, &benchmark_att_write_callback);
+                att_server_register_packet_handler(&benchmark_att_packet_handler);
+            }
+            break;
+        case BENCHMARK_CBM:
+            sm_init();
+            if (benchmark_initiator == false){
+                l2cap_cbm_register_service(&benchmark_l2cap_packet_handler, BENCHMARK_CBM_PSM, LEVEL_0);
+            }
+            break;
+        case BENCHMARK_RFCOMM:
+            rfcomm_init();
+            if (benchmark_initiator == false){
+                rfcomm_register_service(&benchmark_rfcomm_packet_handler, BENCHMARK_RFCOMM_CHANNEL, 0xffff);
+                gap_connectable_control(1);
+            }
+            break;
+        case BENCHMARK_A2DP:
+            sdp_init();
+            if (benchmark_initiator){
+                a2dp_source_init();
+                a2dp_source_register_packet_handler(&benchmark_a2dp_packet_handler);
+                avdtp_stream_endpoint_t * stream_endpoint = a2dp_source_create_stream_endpoint(AVDTP_AUDIO, AVDTP_CODEC_SBC,
+                    benchmark_sbc_codec_capabilities, sizeof(benchmark_sbc_codec_capabilities),
+                    benchmark_sbc_codec_configuration, sizeof(benchmark_sbc_codec_configuration));
+                btstack_assert(stream_endpoint != NULL);
+                benchmark_a2dp_local_seid = avdtp_local_seid(stream_endpoint);
+            } else {
+                a2dp_sink_init();
+                a2dp_sink_register_packet_handler(&benchmark_a2dp_packet_handler);
+                a2dp_sink_register_media_handler(&benchmark_a2dp_media_handler);
+                avdtp_stream_endpoint_t * stream_endpoint = a2dp_sink_create_stream_endpoint(AVDTP_AUDIO, AVDTP_CODEC_SBC,
+                    benchmark_sbc_codec_capabilities, sizeof(benchmark_sbc_codec_capabilities),
+                    benchmark_sbc_codec_configuration, sizeof(benchmark_sbc_codec_configuration));
+                btstack_assert(stream_endpoint != NULL);
+                benchmark_a2dp_local_seid = avdtp_local_seid(stream_endpoint);
+                a2dp_sink_create_sdp_record(benchmark_sdp_service_buffer, sdp_create_service_record_handle(),
+                                            AVDTP_SINK_FEATURE_MASK_HEADPHONE, NULL, NULL);
+                btstack_assert(de_get_len(benchmark_sdp_service_buffer) <= sizeof(benchmark_sdp_service_buffer));
+                sdp_register_service(benchmark_sdp_service_buffer);
+                gap_connectable_control(1);
+            }
+            break;
+        default:
+            btstack_unreachable();
+            break;
+    }
+}
+
+static void benchmark_process_main(benchmark_type_t type, bool initiator, int link_fd, int result_fd){
+    benchmark_type = type;
+    benchmark_initiator = initiator;
+    // GATT Server sends notifications, in all other benchmarks the initiator sends
+    benchmark_sender = (type == BENCHMARK_GATT) ? !initiator : initiator;
+    benchmark_result_fd = result_fd;
+    bd_addr_copy(benchmark_peer_addr, initiator ? benchmark_responder_addr : benchmark_initiator_addr);
+    memset(benchmark_payload, 0x55, sizeof(benchmark_payload));
+
+    bd_addr_copy(benchmark_transport_config.bd_addr, initiator ? benchmark_initiator_addr : benchmark_responder_addr);
+    benchmark_transport_config.acl_data_packet_length = 1021;
+    benchmark_transport_config.total_num_acl_data_packets = benchmark_num_acl_packets;
+    benchmark_transport_config.le_acl_data_packet_length = 251;
+    benchmark_transport_config.total_num_le_acl_data_packets = benchmark_num_le_acl_packets;
+    benchmark_transport_config.link_rate_bps = benchmark_link_rate_bps;
+    benchmark_transport_config.link_fd = link_fd;
+
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    hci_init(hci_transport_virtual_posix_instance(), &benchmark_transport_config);
+
+    hci_event_callback_registration.callback = &benchmark_hci_packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+
+    benchmark_setup();
+
+    btstack_run_loop_set_timer_handler(&benchmark_timer, &benchmark_timeout_handler);
+    btstack_run_loop_set_timer(&benchmark_timer, BENCHMARK_SETUP_TIMEOUT_MS);
+    btstack_run_loop_add_timer(&benchmark_timer);
+
+    hci_power_control(HCI_POWER_ON);
+    btstack_run_loop_execute();
+    exit(EXIT_SUCCESS);
+}
+
+static pid_t benchmark_fork(benchmark_type_t type, bool initiator, int link_fds[2], int result_fds[2]){
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+    int link_fd = initiator ? link_fds[0] : link_fds[1];
+    close(initiator ? link_fds[1] : link_fds[0]);
+    close(result_fds[0]);
+    benchmark_process_main(type, initiator, link_fd, result_fds[1]);
+    return 0;
+}
+
+static bool benchmark_read_result(int fd, benchmark_result_t * result){
+    ssize_t res = read(fd, result, sizeof(benchmark_result_t));
+    return (res == (ssize_t) sizeof(benchmark_result_t)) && (result->status == ERROR_CODE_SUCCESS);
+}
+
+static int benchmark_run(benchmark_type_t type){
+    int link_fds[2];
+    int initiator_fds[2];
+    int responder_fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, link_fds) < 0) return -1;
+    if (pipe(initiator_fds) < 0) return -1;
+    if (pipe(responder_fds) < 0) return -1;
+
+    fflush(stdout);
+    pid_t responder_pid = benchmark_fork(type, false, link_fds, responder_fds);
+    pid_t initiator_pid = benchmark_fork(type, true,  link_fds, initiator_fds);
+    close(link_fds[0]);
+    close(link_fds[1]);
+    close(initiator_fds[1]);
+    close(responder_fds[1]);
+
+    benchmark_result_t initiator_result;
+    benchmark_result_t responder_result;
+    memset(&initiator_result, 0, sizeof(initiator_result));
+    memset(&responder_result, 0, sizeof(responder_result));
+    bool initiator_ok = benchmark_read_result(initiator_fds[0], &initiator_result);
+    bool responder_ok = benchmark_read_result(responder_fds[0], &responder_result);
+
+    kill(initiator_pid, SIGTERM);
+    kill(responder_pid, SIGTERM);
+    waitpid(initiator_pid, NULL, 0);
+    waitpid(responder_pid, NULL, 0);
+    close(initiator_fds[0]);
+    close(responder_fds[0]);
+
+    if (!initiator_ok || !responder_ok){
+        fprintf(stderr, "%s: failed, initiator status 0x%02x, responder status 0x%02x\n",
+                benchmark_names[type], initiator_result.status, responder_result.status);
+        return -1;
+    }
+
+    // GATT Server sends notifications, in all other benchmarks the initiator sends
+    const benchmark_result_t * sender   = (type == BENCHMARK_GATT) ? &responder_result : &initiator_result;
+    const benchmark_result_t * receiver = (type == BENCHMARK_GATT) ? &initiator_result : &responder_result;
+    uint32_t duration_ms = btstack_max(receiver->duration_ms, 1u);
+    uint32_t packets = btstack_max(receiver->packets, 1u);
+    printf("%s,%llu,%u,%llu,%llu,%u,%u,%u\n", benchmark_names[type],
+           (unsigned long long) receiver->bytes, duration_ms,
+           (unsigned long long) ((receiver->bytes * 8u) / duration_ms),
+           (unsigned long long) (receiver->latency_sum_us / packets), receiver->latency_max_us,
+           sender->cpu_ms, receiver->cpu_ms);
+    return 0;
+}
+
+static void benchmark_usage(const char * name){
+    printf("Usage: %s [-b gatt|cbm|rfcomm|a2dp|all] [-d duration ms] [-r link rate bps] [-n ACL buffers] [-l LE ACL buffers]\n", name);
+}
+
+int main(int argc, char * argv[]){
+    const char * selected = "all";
+    int opt;
+    while ((opt = getopt(argc, argv, "b:d:r:n:l:h")) != -1){
+        switch (opt){
+            case 'b':
+                selected = optarg;
+                break;
+            case 'd':
+                benchmark_duration_ms = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                benchmark_link_rate_bps = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                benchmark_num_acl_packets = (uint16_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                benchmark_num_le_acl_packets = (uint8_t) strtoul(optarg, NULL, 10);
+                break;
+            default:
+                benchmark_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    // get write error instead of SIGPIPE if peer process is gone
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("benchmark,bytes,duration_ms,throughput_kbps,latency_avg_us,latency_max_us,cpu_sender_ms,cpu_receiver_ms\n");
+    int failed = 0;
+    bool found = false;
+    uint16_t i;
+    for (i = 0; i < BENCHMARK_COUNT; i++){
+        if ((strcmp(selected, "all") != 0) && (strcmp(selected, benchmark_names[i]) != 0)) continue;
+        found = true;
+        if (benchmark_run((benchmark_type_t) i) != 0){
+            failed = 1;
+        }
+    }
+    if (found == false){
+        benchmark_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -16,5 +16,6 @@ extern void test_assert(bool condition);
 #endif
 
 #define ENABLE_PRINTF_HEXDUMP
+#define ENABLE_CRC32_SLICING_BY_8
 
 #endif
\ No newline at end of file
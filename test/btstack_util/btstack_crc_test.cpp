@@ -0,0 +1,127 @@
+
+// *****************************************************************************
+//
+// test CRC-8 and CRC-32 against bitwise and bytewise reference implementations
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_util.h"
+#include "btstack_config.h"
+
+void test_assert(bool condition){
+    (void) condition;
+}
+
+static const uint8_t check_input[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+
+// bitwise CRC-8 (reversed, poly 0x07) as reference
+static uint8_t reference_crc8_calc(const uint8_t * data, uint16_t len){
+    uint8_t crc = 0xff;
+    uint16_t i;
+    for (i = 0; i < len; i++){
+        crc ^= data[i];
+        int bit;
+        for (bit = 0; bit < 8; bit++){
+            crc = (crc & 1u) ? ((crc >> 1) ^ 0xe0u) : (crc >> 1);
+        }
+    }
+    return 0xffu - crc;
+}
+
+// bytewise table-driven CRC-32 as used without ENABLE_CRC32_SLICING_BY_8
+static uint32_t reference_crc32_table[256];
+
+static void reference_crc32_init_table(void){
+    uint32_t i;
+    for (i = 0; i < 256; i++){
+        uint32_t crc = i;
+        int bit;
+        for (bit = 0; bit < 8; bit++){
+            crc = (crc & 1u) ? ((crc >> 1) ^ 0xedb88320u) : (crc >> 1);
+        }
+        reference_crc32_table[i] = crc;
+    }
+}
+
+static uint32_t reference_crc32_update(uint32_t crc, const uint8_t * data, uint32_t data_len){
+    while (data_len--){
+        crc = reference_crc32_table[(crc ^ *data++) & 0xffu] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#define TEST_BUFFER_SIZE 1024
+
+static uint8_t test_buffer[TEST_BUFFER_SIZE];
+
+TEST_GROUP(btstack_crc){
+    void setup(void){
+        reference_crc32_init_table();
+        uint16_t i;
+        srand(1);
+        for (i = 0; i < sizeof(test_buffer); i++){
+            test_buffer[i] = (uint8_t) rand();
+        }
+    }
+};
+
+TEST(btstack_crc, crc8_check_value){
+    // CRC-8/ROHC check value is 0xd0, FCS is its ones complement
+    CHECK_EQUAL(0xff - 0xd0, btstack_crc8_calc((uint8_t *) check_input, sizeof(check_input)));
+    CHECK_EQUAL(reference_crc8_calc(check_input, sizeof(check_input)), btstack_crc8_calc((uint8_t *) check_input, sizeof(check_input)));
+}
+
+TEST(btstack_crc, crc8_matches_reference){
+    CHECK_EQUAL(reference_crc8_calc(test_buffer, TEST_BUFFER_SIZE), btstack_crc8_calc(test_buffer, TEST_BUFFER_SIZE));
+}
+
+TEST(btstack_crc, crc8_rfcomm_fcs){
+    // UIH header for DLCI 2 with credits, FCS covers address and control
+    uint8_t header[] = { 0x09, 0xff };
+    uint8_t fcs = btstack_crc8_calc(header, sizeof(header));
+    CHECK_EQUAL(0, btstack_crc8_check(header, sizeof(header), fcs));
+    CHECK_EQUAL(1, btstack_crc8_check(header, sizeof(header), fcs ^ 0x01));
+}
+
+TEST(btstack_crc, crc32_check_value){
+    uint32_t crc = btstack_crc32_init();
+    crc = btstack_crc32_update(crc, check_input, sizeof(check_input));
+    CHECK_EQUAL(0xcbf43926u, btstack_crc32_finalize(crc));
+}
+
+TEST(btstack_crc, crc32_matches_reference_for_all_lengths_and_alignments){
+    uint16_t offset;
+    for (offset = 0; offset < 8; offset++){
+        uint16_t len;
+        for (len = 0; len < 64; len++){
+            uint32_t expected = reference_crc32_update(0xffffffffu, &test_buffer[offset], len);
+            CHECK_EQUAL(expected, btstack_crc32_update(btstack_crc32_init(), &test_buffer[offset], len));
+        }
+    }
+}
+
+TEST(btstack_crc, crc32_incremental_update){
+    uint32_t expected = reference_crc32_update(0xffffffffu, test_buffer, sizeof(test_buffer));
+    uint32_t crc = btstack_crc32_init();
+    uint16_t pos = 0;
+    uint16_t chunk = 1;
+    while (pos < sizeof(test_buffer)){
+        uint16_t len = btstack_min(chunk, sizeof(test_buffer) - pos);
+        crc = btstack_crc32_update(crc, &test_buffer[pos], len);
+        pos += len;
+        chunk = (chunk * 3u) % 37u + 1u;
+    }
+    CHECK_EQUAL(expected, crc);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
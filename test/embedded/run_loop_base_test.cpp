@@ -6,16 +6,71 @@
 
 #define HEARTBEAT_PERIOD_MS 1000
 
+#define NUM_TIMERS 10000
+
 static btstack_timer_source_t timer_1;
 static btstack_timer_source_t timer_2;
 static btstack_data_source_t  data_source;
 static bool data_source_called;
 static bool timer_called;
 
+static btstack_timer_source_t timers[NUM_TIMERS];
+static uint32_t timers_fired;
+static uint32_t timer_last_timeout;
+static uintptr_t timer_last_registration;
+static uintptr_t timer_registrations;
+static bool     timer_order_ok;
+
 static void heartbeat_timeout_handler(btstack_timer_source_t * ts){
     UNUSED(ts);
     timer_called = true;
 }
+
+// timers must fire ordered by timeout, and in order of registration for same timeout
+static void ordered_timeout_handler(btstack_timer_source_t * ts){
+    uintptr_t registration = (uintptr_t) ts->context;
+    if (timers_fired > 0){
+        int32_t delta = btstack_time_delta(ts->timeout, timer_last_timeout);
+        if ((delta < 0) || ((delta == 0) && (registration < timer_last_registration))){
+            timer_order_ok = false;
+        }
+    }
+    timer_last_timeout = ts->timeout;
+    timer_last_registration = registration;
+    timers_fired++;
+}
+
+static void add_ordered_timer(btstack_timer_source_t * ts){
+    ts->context = (void *) timer_registrations++;
+    btstack_run_loop_base_add_timer(ts);
+}
+
+static void restart_timeout_handler(btstack_timer_source_t * ts){
+    timers_fired++;
+    if (timers_fired < 10){
+        ts->timeout += HEARTBEAT_PERIOD_MS;
+        btstack_run_loop_base_add_timer(ts);
+    }
+}
+
+static uint32_t pseudo_random(uint32_t * state){
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static void add_random_timers(uint32_t num_timers, uint32_t max_timeout){
+    uint32_t state = 0x12345678;
+    for (uint32_t i = 0; i < num_timers; i++){
+        btstack_run_loop_set_timer_handler(&timers[i], ordered_timeout_handler);
+        timers[i].timeout = pseudo_random(&state) % max_timeout;
+        add_ordered_timer(&timers[i]);
+    }
+}
 static void data_source_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
     UNUSED(ds);
     UNUSED(callback_type);
@@ -28,6 +83,8 @@ TEST_GROUP(RunLoopBase){
             btstack_run_loop_base_init();
             data_source_called = false;
             timer_called = false;
+            timers_fired = 0;
+            timer_order_ok = true;
         }
         void teardown(void){
             btstack_memory_deinit();
@@ -110,6 +167,79 @@ TEST(RunLoopBase, Overrun){
     CHECK(timer_called == true);
 }
 
+TEST(RunLoopBase, TimerOrder){
+    add_random_timers(1000, 100);
+    btstack_run_loop_base_process_timers(50);
+    CHECK(timers_fired > 0);
+    CHECK(timers_fired < 1000);
+    CHECK_EQUAL(btstack_run_loop_base_get_time_until_timeout(50), 1);
+    btstack_run_loop_base_process_timers(100);
+    CHECK_EQUAL(1000, timers_fired);
+    CHECK(timer_order_ok);
+    CHECK(btstack_run_loop_base_timers == NULL);
+}
+
+TEST(RunLoopBase, TimerRemove){
+    add_random_timers(1000, 1000);
+    // remove every third timer
+    for (uint32_t i = 0; i < 1000; i += 3){
+        CHECK(btstack_run_loop_base_remove_timer(&timers[i]));
+    }
+    for (uint32_t i = 0; i < 1000; i += 3){
+        CHECK_FALSE(btstack_run_loop_base_remove_timer(&timers[i]));
+    }
+    // re-add some of them
+    for (uint32_t i = 0; i < 1000; i += 6){
+        add_ordered_timer(&timers[i]);
+    }
+    btstack_run_loop_base_dump_timer();
+    btstack_run_loop_base_process_timers(1000);
+    CHECK_EQUAL(1000 - 334 + 167, timers_fired);
+    CHECK(timer_order_ok);
+    CHECK(btstack_run_loop_base_timers == NULL);
+}
+
+TEST(RunLoopBase, TimerRemoveNeverAdded){
+    // timer on stack that was never added, fields are garbage
+    btstack_timer_source_t timer;
+    memset(&timer, 0x55, sizeof(timer));
+    CHECK_FALSE(btstack_run_loop_base_remove_timer(&timer));
+    add_random_timers(10, 100);
+    // copy of an added timer is not added
+    timer = timers[0];
+    CHECK_FALSE(btstack_run_loop_base_remove_timer(&timer));
+    btstack_run_loop_set_timer_handler(&timer, ordered_timeout_handler);
+    timer.timeout = 50;
+    add_ordered_timer(&timer);
+    btstack_run_loop_base_process_timers(100);
+    CHECK_EQUAL(11, timers_fired);
+    CHECK(timer_order_ok);
+    CHECK(btstack_run_loop_base_timers == NULL);
+}
+
+TEST(RunLoopBase, TimerRestartFromCallback){
+    btstack_run_loop_set_timer_handler(&timer_1, restart_timeout_handler);
+    timer_1.timeout = HEARTBEAT_PERIOD_MS;
+    btstack_run_loop_base_add_timer(&timer_1);
+    btstack_run_loop_base_process_timers(100 * HEARTBEAT_PERIOD_MS);
+    CHECK_EQUAL(10, timers_fired);
+    CHECK(btstack_run_loop_base_timers == NULL);
+}
+
+TEST(RunLoopBase, TimerRestartMany){
+    add_random_timers(NUM_TIMERS, 60000);
+    // remove and re-add half of them, e.g. restart of supervision timeouts
+    for (uint32_t i = 0; i < NUM_TIMERS; i += 2){
+        CHECK(btstack_run_loop_base_remove_timer(&timers[i]));
+        timers[i].timeout += 1000;
+        add_ordered_timer(&timers[i]);
+    }
+    btstack_run_loop_base_process_timers(61000);
+    CHECK_EQUAL(NUM_TIMERS, timers_fired);
+    CHECK(timer_order_ok);
+    CHECK(btstack_run_loop_base_timers == NULL);
+}
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
@@ -306,6 +306,194 @@ TEST(BSTACK_TLV, TestFullBankPlusMigrate){
     CHECK_EQUAL(8 + 2 * (TAG_OVERHEAD + sizeof(blob)), btstack_tlv_context.write_offset);
 }
 
+/// TLV lookup with flash read counting
+#define HAL_FLASH_BANK_COUNTING_STORAGE_SIZE 4096
+#define NUM_TAGS_INDEXED     12
+#define NUM_TAGS_OVERFLOW    40
+
+static uint8_t hal_flash_bank_counting_storage[HAL_FLASH_BANK_COUNTING_STORAGE_SIZE];
+static const hal_flash_bank_t * hal_flash_bank_memory_impl;
+static uint32_t hal_flash_bank_read_count;
+
+// forwards to hal_flash_bank_memory and counts reads
+static uint32_t hal_flash_bank_counting_get_size(void * context){
+    return hal_flash_bank_memory_impl->get_size(context);
+}
+static uint32_t hal_flash_bank_counting_get_alignment(void * context){
+    return hal_flash_bank_memory_impl->get_alignment(context);
+}
+static void hal_flash_bank_counting_erase(void * context, int bank){
+    hal_flash_bank_memory_impl->erase(context, bank);
+}
+static void hal_flash_bank_counting_read(void * context, int bank, uint32_t offset, uint8_t * buffer, uint32_t size){
+    hal_flash_bank_read_count++;
+    hal_flash_bank_memory_impl->read(context, bank, offset, buffer, size);
+}
+static void hal_flash_bank_counting_write(void * context, int bank, uint32_t offset, const uint8_t * data, uint32_t size){
+    hal_flash_bank_memory_impl->write(context, bank, offset, data, size);
+}
+
+static const hal_flash_bank_t hal_flash_bank_counting = {
+    /* uint32_t (*get_size)(..) */      &hal_flash_bank_counting_get_size,
+    /* uint32_t (*get_alignment)(..); */ &hal_flash_bank_counting_get_alignment,
+    /* void (*erase)(..);    */          &hal_flash_bank_counting_erase,
+    /* void (*read)(..);      */         &hal_flash_bank_counting_read,
+    /* void (*write)(..);     */         &hal_flash_bank_counting_write,
+};
+
+static uint32_t tag_for_index(uint32_t index){
+    return 0x54000000 | index;
+}
+
+TEST_GROUP(TLV_READ_COUNT){
+    hal_flash_bank_memory_t  hal_flash_bank_context;
+
+    const btstack_tlv_t *    btstack_tlv_impl;
+    btstack_tlv_flash_bank_t btstack_tlv_context;
+
+    void setup(void){
+        hal_flash_bank_memory_impl = hal_flash_bank_memory_init_instance(&hal_flash_bank_context, hal_flash_bank_counting_storage, HAL_FLASH_BANK_COUNTING_STORAGE_SIZE);
+        hal_flash_bank_read_count = 0;
+        init();
+    }
+
+    void init(void){
+        btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, &hal_flash_bank_counting, &hal_flash_bank_context);
+    }
+
+    void store(uint32_t index, uint32_t value){
+        uint8_t data[8];
+        big_endian_store_32(data, 0, index);
+        big_endian_store_32(data, 4, value);
+        int status = btstack_tlv_impl->store_tag(&btstack_tlv_context, tag_for_index(index), data, sizeof(data));
+        CHECK_EQUAL(0, status);
+    }
+
+    void check(uint32_t index, uint32_t value){
+        uint8_t data[8];
+        int size = btstack_tlv_impl->get_tag(&btstack_tlv_context, tag_for_index(index), data, sizeof(data));
+        CHECK_EQUAL(8, size);
+        CHECK_EQUAL(index, big_endian_read_32(data, 0));
+        CHECK_EQUAL(value, big_endian_read_32(data, 4));
+    }
+
+    void check_missing(uint32_t index){
+        CHECK_EQUAL(0, btstack_tlv_impl->get_tag(&btstack_tlv_context, tag_for_index(index), NULL, 0));
+    }
+};
+
+TEST(TLV_READ_COUNT, GetTag){
+    uint32_t i;
+    for (i = 0; i < NUM_TAGS_INDEXED; i++){
+        store(i, 1);
+    }
+    // overwrite all tags
+    uint32_t start = hal_flash_bank_read_count;
+    for (i = 0; i < NUM_TAGS_INDEXED; i++){
+        store(i, 2);
+    }
+    uint32_t store_reads = hal_flash_bank_read_count - start;
+
+    start = hal_flash_bank_read_count;
+    for (i = 0; i < NUM_TAGS_INDEXED; i++){
+        check(i, 2);
+    }
+    uint32_t get_reads = hal_flash_bank_read_count - start;
+
+    start = hal_flash_bank_read_count;
+    check_missing(NUM_TAGS_INDEXED);
+    uint32_t missing_reads = hal_flash_bank_read_count - start;
+
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+    // single read of value, no scan
+    CHECK_EQUAL(NUM_TAGS_INDEXED, get_reads);
+    CHECK_EQUAL(0, missing_reads);
+    CHECK_EQUAL(0, store_reads);
+#else
+    // each lookup scans the bank
+    CHECK(get_reads > NUM_TAGS_INDEXED);
+    CHECK(missing_reads > 0);
+    // store reads depend on ENABLE_TLV_FLASH_WRITE_ONCE
+    UNUSED(store_reads);
+#endif
+}
+
+TEST(TLV_READ_COUNT, GetTagAfterInit){
+    uint32_t i;
+    for (i = 0; i < NUM_TAGS_INDEXED; i++){
+        store(i, i);
+    }
+    btstack_tlv_impl->delete_tag(&btstack_tlv_context, tag_for_index(0));
+    init();
+    check_missing(0);
+    uint32_t start = hal_flash_bank_read_count;
+    for (i = 1; i < NUM_TAGS_INDEXED; i++){
+        check(i, i);
+    }
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+    CHECK_EQUAL(NUM_TAGS_INDEXED - 1, hal_flash_bank_read_count - start);
+#else
+    CHECK(hal_flash_bank_read_count - start > NUM_TAGS_INDEXED - 1);
+#endif
+}
+
+TEST(TLV_READ_COUNT, IndexOverflow){
+    uint32_t i;
+    for (i = 0; i < NUM_TAGS_OVERFLOW; i++){
+        store(i, i);
+    }
+    for (i = 0; i < NUM_TAGS_OVERFLOW; i += 3){
+        btstack_tlv_impl->delete_tag(&btstack_tlv_context, tag_for_index(i));
+    }
+    for (i = 0; i < NUM_TAGS_OVERFLOW; i += 2){
+        store(i, i + 1000);
+    }
+    for (int round = 0; round < 2; round++){
+        for (i = 0; i < NUM_TAGS_OVERFLOW; i++){
+            if ((i % 2) == 0){
+                check(i, i + 1000);
+            } else if ((i % 3) == 0){
+                check_missing(i);
+            } else {
+                check(i, i);
+            }
+        }
+        check_missing(NUM_TAGS_OVERFLOW);
+        init();
+    }
+}
+
+TEST(TLV_READ_COUNT, Migrate){
+    uint32_t values[NUM_TAGS_INDEXED];
+    uint32_t i;
+    // each round writes 12 entries of 16 (20) bytes, bank holds ~100 entries
+    int8_t start_bank = btstack_tlv_context.current_bank;
+    uint32_t num_migrations = 0;
+    for (uint32_t round = 0; round < 40; round++){
+        for (i = 0; i < NUM_TAGS_INDEXED; i++){
+            if (((i + round) % 5) == 0) continue;
+            values[i] = (round << 8) | i;
+            store(i, values[i]);
+        }
+        if (btstack_tlv_context.current_bank != start_bank){
+            start_bank = btstack_tlv_context.current_bank;
+            num_migrations++;
+        }
+        for (i = 0; i < NUM_TAGS_INDEXED; i++){
+            if ((round == 0) && ((i % 5) == 0)) {
+                check_missing(i);
+            } else {
+                check(i, values[i]);
+            }
+        }
+    }
+    CHECK(num_migrations >= 2);
+    init();
+    for (i = 0; i < NUM_TAGS_INDEXED; i++){
+        check(i, values[i]);
+    }
+}
+
 //
 TEST_GROUP(LINK_KEY_DB){
 	const hal_flash_bank_t * hal_flash_bank_impl;
@@ -390,7 +578,11 @@ TEST(LINK_KEY_DB, KeyReplacement){
 
 int main (int argc, const char * argv[]){
     // log into file using HCI_DUMP_PACKETLOGGER format
-#ifdef ENABLE_TLV_FLASH_WRITE_ONCE
+#if defined(ENABLE_TLV_FLASH_BANK_INDEX) && defined(ENABLE_TLV_FLASH_WRITE_ONCE)
+    const char * pklg_path = "hci_dump_index_write_once.pklg";
+#elif defined(ENABLE_TLV_FLASH_BANK_INDEX)
+    const char * pklg_path = "hci_dump_index.pklg";
+#elif defined(ENABLE_TLV_FLASH_WRITE_ONCE)
     const char * pklg_path = "hci_dump_write_once.pklg";
 #elif defined(ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD)
     const char * pklg_path = "hci_dump_delete_field.pklg";
@@ -0,0 +1,306 @@
+// Test fragmentation of outgoing ACL packets, with and without the outgoing ACL buffer pool
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define MAX_HCI_PACKETS 16
+#define ACL_DATA_PACKET_LENGTH 27
+
+// connections created by hci_setup_test_connections_fuzz
+static const hci_con_handle_t con_handle_classic_pending = 0x0001;
+static const hci_con_handle_t con_handle_classic = 0x0003;
+static const hci_con_handle_t con_handle_le      = 0x0005;
+
+typedef struct {
+    uint8_t  type;
+    uint16_t size;
+    uint8_t  buffer[4 + ACL_DATA_PACKET_LENGTH];
+} hci_packet_t;
+
+static hci_packet_t transport_packets[MAX_HCI_PACKETS];
+static uint16_t transport_count_packets;
+static int transport_can_send_now;
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static uint16_t pending_packet_size;
+static hci_con_handle_t pending_packet_con_handle;
+
+// asynchronous transport: one packet at a time, HCI_EVENT_TRANSPORT_PACKET_SENT emitted by test
+static int hci_transport_test_can_send_now(uint8_t packet_type){
+    UNUSED(packet_type);
+    return transport_can_send_now;
+}
+
+static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    btstack_assert(transport_can_send_now != 0);
+    btstack_assert(transport_count_packets < MAX_HCI_PACKETS);
+    btstack_assert(size <= (int) sizeof(transport_packets[0].buffer));
+    memcpy(transport_packets[transport_count_packets].buffer, packet, size);
+    transport_packets[transport_count_packets].type = packet_type;
+    transport_packets[transport_count_packets].size = (uint16_t) size;
+    transport_count_packets++;
+    transport_can_send_now = 0;
+    return 0;
+}
+
+static void hci_transport_test_init(const void * transport_config){
+    UNUSED(transport_config);
+}
+
+static int hci_transport_test_open(void){
+    return 0;
+}
+
+static int hci_transport_test_close(void){
+    return 0;
+}
+
+static void hci_transport_test_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static const hci_transport_t hci_transport_test = {
+        /* const char * name; */                                        "TEST",
+        /* void   (*init) (const void *transport_config); */            &hci_transport_test_init,
+        /* int    (*open)(void); */                                     &hci_transport_test_open,
+        /* int    (*close)(void); */                                    &hci_transport_test_close,
+        /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_test_register_packet_handler,
+        /* int    (*can_send_packet_now)(uint8_t packet_type); */       &hci_transport_test_can_send_now,
+        /* int    (*send_packet)(...); */                               &hci_transport_test_send_packet,
+        /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+        /* void   (*reset_link)(void); */                               NULL,
+        /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+static void transport_emit_packet_sent(void){
+    static const uint8_t packet_sent_event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
+    transport_can_send_now = 1;
+    packet_handler(HCI_EVENT_PACKET, (uint8_t *) packet_sent_event, sizeof(packet_sent_event));
+}
+
+// reserve packet buffer and send L2CAP packet with payload_len bytes, payload is a counter
+static uint8_t send_l2cap_packet(hci_con_handle_t con_handle, uint16_t payload_len){
+    hci_reserve_packet_buffer();
+    uint8_t * acl_buffer = hci_get_outgoing_packet_buffer();
+    little_endian_store_16(acl_buffer, 0, con_handle | (0x02 << 12));
+    little_endian_store_16(acl_buffer, 2, payload_len + 4);
+    little_endian_store_16(acl_buffer, 4, payload_len);
+    little_endian_store_16(acl_buffer, 6, 0x0040);
+    uint16_t i;
+    for (i = 0; i < payload_len; i++){
+        acl_buffer[8 + i] = (uint8_t) i;
+    }
+    return hci_send_acl_packet_buffer(8 + payload_len);
+}
+
+// send pending packet as soon as HCI allows it, similar to L2CAP
+static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != HCI_EVENT_TRANSPORT_PACKET_SENT) return;
+    if (pending_packet_size == 0) return;
+    if (!hci_can_send_acl_packet_now(pending_packet_con_handle)) return;
+    uint16_t payload_len = pending_packet_size;
+    pending_packet_size = 0;
+    send_l2cap_packet(pending_packet_con_handle, payload_len);
+}
+
+static hci_con_handle_t packet_con_handle(uint16_t index){
+    return little_endian_read_16(transport_packets[index].buffer, 0) & 0x0fff;
+}
+
+static uint8_t packet_boundary_flags(uint16_t index){
+    return (little_endian_read_16(transport_packets[index].buffer, 0) >> 12) & 0x03;
+}
+
+TEST_GROUP(HCI_ACL_FRAGMENTATION){
+    hci_stack_t * hci_stack;
+
+    void setup(void){
+        transport_count_packets = 0;
+        transport_can_send_now = 1;
+        pending_packet_size = 0;
+        hci_init(&hci_transport_test, NULL);
+        hci_stack = hci_get_stack();
+        hci_simulate_working_fuzz();
+        hci_setup_test_connections_fuzz();
+        hci_stack->acl_data_packet_length = ACL_DATA_PACKET_LENGTH;
+        hci_stack->acl_packets_total_num = 32;
+        hci_event_callback_registration.callback = &hci_event_handler;
+        hci_add_event_handler(&hci_event_callback_registration);
+    }
+
+    void teardown(void){
+        hci_free_connections_fuzz();
+        hci_deinit();
+    }
+
+    void check_reassembled_payload(hci_con_handle_t con_handle, uint16_t payload_len){
+        uint8_t l2cap_packet[4 + 256];
+        uint16_t l2cap_len = 0;
+        uint16_t i;
+        for (i = 0; i < transport_count_packets; i++){
+            if (packet_con_handle(i) != con_handle) continue;
+            uint16_t acl_len = little_endian_read_16(transport_packets[i].buffer, 2);
+            CHECK_EQUAL(acl_len + 4, transport_packets[i].size);
+            CHECK_EQUAL(l2cap_len == 0 ? 0x02 : 0x01, packet_boundary_flags(i));
+            memcpy(&l2cap_packet[l2cap_len], &transport_packets[i].buffer[4], acl_len);
+            l2cap_len += acl_len;
+        }
+        CHECK_EQUAL(4 + payload_len, l2cap_len);
+        CHECK_EQUAL(payload_len, little_endian_read_16(l2cap_packet, 0));
+        for (i = 0; i < payload_len; i++){
+            CHECK_EQUAL((uint8_t) i, l2cap_packet[4 + i]);
+        }
+    }
+};
+
+#ifdef ENABLE_HCI_OUTGOING_ACL_BUFFER_POOL
+TEST(HCI_ACL_FRAGMENTATION, OtherConnectionSendsBetweenFragments){
+    // 104 byte L2CAP packet -> 4 fragments
+    uint8_t status = send_l2cap_packet(con_handle_classic, 100);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(1, transport_count_packets);
+
+    // packet buffer is available, but connection has to wait for its fragments
+    CHECK_FALSE(hci_is_packet_buffer_reserved());
+    CHECK_FALSE(hci_can_send_acl_packet_now(con_handle_classic));
+    CHECK_EQUAL(HCI_OUTGOING_ACL_BUFFER_POOL_SIZE - 1, hci_stack->outgoing_acl_buffer_pool_num_free);
+
+    // LE connection sends as soon as transport is ready
+    pending_packet_con_handle = con_handle_le;
+    pending_packet_size = 10;
+    transport_emit_packet_sent();
+    CHECK_EQUAL(2, transport_count_packets);
+    CHECK_EQUAL(con_handle_le, packet_con_handle(1));
+
+    while (transport_can_send_now == 0){
+        transport_emit_packet_sent();
+    }
+    CHECK_EQUAL(5, transport_count_packets);
+    CHECK_EQUAL(con_handle_classic, packet_con_handle(0));
+    CHECK_EQUAL(con_handle_classic, packet_con_handle(4));
+    check_reassembled_payload(con_handle_classic, 100);
+    check_reassembled_payload(con_handle_le, 10);
+
+    // buffer returned after last fragment
+    CHECK_EQUAL(HCI_OUTGOING_ACL_BUFFER_POOL_SIZE, hci_stack->outgoing_acl_buffer_pool_num_free);
+    CHECK_TRUE(hci_can_send_acl_packet_now(con_handle_classic));
+}
+
+TEST(HCI_ACL_FRAGMENTATION, SmallPacketUsesPacketBuffer){
+    uint8_t status = send_l2cap_packet(con_handle_classic, 10);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_TRUE(hci_is_packet_buffer_reserved());
+    CHECK_EQUAL(HCI_OUTGOING_ACL_BUFFER_POOL_SIZE, hci_stack->outgoing_acl_buffer_pool_num_free);
+    transport_emit_packet_sent();
+    CHECK_FALSE(hci_is_packet_buffer_reserved());
+}
+
+TEST(HCI_ACL_FRAGMENTATION, PoolExhausted){
+    CHECK_EQUAL(2, HCI_OUTGOING_ACL_BUFFER_POOL_SIZE);
+
+    send_l2cap_packet(con_handle_classic, 100);
+    pending_packet_con_handle = con_handle_le;
+    pending_packet_size = 100;
+    transport_emit_packet_sent();
+    CHECK_EQUAL(0, hci_stack->outgoing_acl_buffer_pool_num_free);
+
+    // no pool buffer left, fragment from packet buffer which stays reserved
+    pending_packet_con_handle = con_handle_classic_pending;
+    pending_packet_size = 100;
+    transport_emit_packet_sent();
+    CHECK_EQUAL(3, transport_count_packets);
+    CHECK_TRUE(hci_is_packet_buffer_reserved());
+
+    while (transport_can_send_now == 0){
+        transport_emit_packet_sent();
+    }
+    CHECK_EQUAL(12, transport_count_packets);
+    check_reassembled_payload(con_handle_classic, 100);
+    check_reassembled_payload(con_handle_le, 100);
+    check_reassembled_payload(con_handle_classic_pending, 100);
+    CHECK_FALSE(hci_is_packet_buffer_reserved());
+    CHECK_EQUAL(HCI_OUTGOING_ACL_BUFFER_POOL_SIZE, hci_stack->outgoing_acl_buffer_pool_num_free);
+}
+
+TEST(HCI_ACL_FRAGMENTATION, DisconnectWhileFragmentInFlight){
+    send_l2cap_packet(con_handle_classic, 100);
+    CHECK_EQUAL(HCI_OUTGOING_ACL_BUFFER_POOL_SIZE - 1, hci_stack->outgoing_acl_buffer_pool_num_free);
+
+    uint8_t event[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, ERROR_CODE_SUCCESS, 0, 0, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION};
+    little_endian_store_16(event, 3, con_handle_classic);
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    CHECK(hci_connection_for_handle(con_handle_classic) == NULL);
+
+    // buffer still used by transport
+    CHECK_EQUAL(HCI_OUTGOING_ACL_BUFFER_POOL_SIZE - 1, hci_stack->outgoing_acl_buffer_pool_num_free);
+    transport_emit_packet_sent();
+    CHECK_EQUAL(HCI_OUTGOING_ACL_BUFFER_POOL_SIZE, hci_stack->outgoing_acl_buffer_pool_num_free);
+    CHECK_EQUAL(1, transport_count_packets);
+}
+
+#endif
+
+TEST(HCI_ACL_FRAGMENTATION, FreeSlotsTrackSentAndCompletedPackets){
+    // without LE buffers, LE uses Classic ACL buffers
+    CHECK_EQUAL(32, hci_number_free_acl_slots_for_connection_type(BD_ADDR_TYPE_ACL));
+
+    send_l2cap_packet(con_handle_classic, 100);
+    pending_packet_con_handle = con_handle_le;
+    pending_packet_size = 10;
+    while (transport_can_send_now == 0){
+        transport_emit_packet_sent();
+    }
+    CHECK_EQUAL(5, transport_count_packets);
+    CHECK_EQUAL(27, hci_number_free_acl_slots_for_connection_type(BD_ADDR_TYPE_ACL));
+    CHECK_EQUAL(27, hci_number_free_acl_slots_for_connection_type(BD_ADDR_TYPE_LE_PUBLIC));
+
+    // Number Of Completed Packets for 3 Classic fragments
+    uint8_t event[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 3, 0};
+    little_endian_store_16(event, 3, con_handle_classic);
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    CHECK_EQUAL(30, hci_number_free_acl_slots_for_connection_type(BD_ADDR_TYPE_ACL));
+
+    // more packets completed than sent
+    little_endian_store_16(event, 5, 5);
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    CHECK_EQUAL(31, hci_number_free_acl_slots_for_connection_type(BD_ADDR_TYPE_ACL));
+
+    // controller flushes packets of disconnected connection
+    uint8_t disconnect_event[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, ERROR_CODE_SUCCESS, 0, 0, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION};
+    little_endian_store_16(disconnect_event, 3, con_handle_le);
+    packet_handler(HCI_EVENT_PACKET, disconnect_event, sizeof(disconnect_event));
+    CHECK_EQUAL(32, hci_number_free_acl_slots_for_connection_type(BD_ADDR_TYPE_ACL));
+}
+
+TEST(HCI_ACL_FRAGMENTATION, FreeSlotsWithSeparateLeBuffers){
+    hci_stack->le_acl_packets_total_num = 4;
+    send_l2cap_packet(con_handle_le, 60);
+    while (transport_can_send_now == 0){
+        transport_emit_packet_sent();
+    }
+    CHECK_EQUAL(3, transport_count_packets);
+    CHECK_EQUAL(1, hci_number_free_acl_slots_for_connection_type(BD_ADDR_TYPE_LE_PUBLIC));
+    CHECK_EQUAL(32, hci_number_free_acl_slots_for_connection_type(BD_ADDR_TYPE_ACL));
+}
+
+int main (int argc, const char * argv[]){
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
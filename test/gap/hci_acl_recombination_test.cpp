@@ -0,0 +1,190 @@
+// Test recombination of incoming ACL packets with buffers from the shared recombination pool
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_memory.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+// connections created by hci_setup_test_connections_fuzz
+static const hci_con_handle_t con_handles[] = { 0x0001, 0x0003, 0x0005 };
+
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+static uint16_t acl_packets_received;
+static hci_con_handle_t acl_packet_con_handle;
+static uint16_t acl_packet_size;
+static uint8_t  acl_packet[4 + 4 + 100];
+
+static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    UNUSED(packet_type);
+    UNUSED(packet);
+    UNUSED(size);
+    return 0;
+}
+
+static void hci_transport_test_init(const void * transport_config){
+    UNUSED(transport_config);
+}
+
+static int hci_transport_test_open(void){
+    return 0;
+}
+
+static int hci_transport_test_close(void){
+    return 0;
+}
+
+static void hci_transport_test_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static const hci_transport_t hci_transport_test = {
+        /* const char * name; */                                        "TEST",
+        /* void   (*init) (const void *transport_config); */            &hci_transport_test_init,
+        /* int    (*open)(void); */                                     &hci_transport_test_open,
+        /* int    (*close)(void); */                                    &hci_transport_test_close,
+        /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_test_register_packet_handler,
+        /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+        /* int    (*send_packet)(...); */                               &hci_transport_test_send_packet,
+        /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+        /* void   (*reset_link)(void); */                               NULL,
+        /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+static void acl_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(packet_type);
+    UNUSED(channel);
+    acl_packets_received++;
+    acl_packet_con_handle = little_endian_read_16(packet, 0) & 0x0fff;
+    acl_packet_size = size;
+    memcpy(acl_packet, packet, btstack_min(size, sizeof(acl_packet)));
+}
+
+// L2CAP packet with payload_len bytes, payload is a counter. Fragment contains bytes [offset, offset + len) of the L2CAP packet
+static void receive_fragment(hci_con_handle_t con_handle, uint16_t payload_len, uint16_t offset, uint16_t len){
+    uint8_t l2cap_packet[4 + 100];
+    little_endian_store_16(l2cap_packet, 0, payload_len);
+    little_endian_store_16(l2cap_packet, 2, 0x0040);
+    uint16_t i;
+    for (i = 0; i < payload_len; i++){
+        l2cap_packet[4 + i] = (uint8_t) i;
+    }
+    uint8_t fragment[4 + sizeof(l2cap_packet)];
+    uint8_t packet_boundary_flags = (offset == 0) ? 0x02 : 0x01;
+    little_endian_store_16(fragment, 0, con_handle | (packet_boundary_flags << 12));
+    little_endian_store_16(fragment, 2, len);
+    memcpy(&fragment[4], &l2cap_packet[offset], len);
+    packet_handler(HCI_ACL_DATA_PACKET, fragment, 4 + len);
+}
+
+static hci_acl_recombination_pool_statistics_t get_statistics(void){
+    hci_acl_recombination_pool_statistics_t statistics;
+    hci_get_acl_recombination_pool_statistics(&statistics);
+    return statistics;
+}
+
+TEST_GROUP(HCI_ACL_RECOMBINATION){
+    void setup(void){
+        acl_packets_received = 0;
+        hci_init(&hci_transport_test, NULL);
+        hci_simulate_working_fuzz();
+        hci_setup_test_connections_fuzz();
+        hci_register_acl_packet_handler(&acl_packet_handler);
+    }
+
+    void teardown(void){
+        hci_free_connections_fuzz();
+        hci_deinit();
+    }
+
+    void check_received_packet(hci_con_handle_t con_handle, uint16_t payload_len){
+        CHECK_EQUAL(con_handle, acl_packet_con_handle);
+        CHECK_EQUAL(4 + 4 + payload_len, acl_packet_size);
+        CHECK_EQUAL(4 + payload_len, little_endian_read_16(acl_packet, 2));
+        CHECK_EQUAL(payload_len, little_endian_read_16(acl_packet, 4));
+        uint16_t i;
+        for (i = 0; i < payload_len; i++){
+            CHECK_EQUAL((uint8_t) i, acl_packet[8 + i]);
+        }
+    }
+};
+
+TEST(HCI_ACL_RECOMBINATION, UnfragmentedPacket){
+    receive_fragment(con_handles[0], 20, 0, 24);
+    CHECK_EQUAL(1, acl_packets_received);
+    check_received_packet(con_handles[0], 20);
+    CHECK_EQUAL(0, get_statistics().buffers_in_use_max);
+}
+
+TEST(HCI_ACL_RECOMBINATION, FragmentedPacket){
+    receive_fragment(con_handles[0], 60, 0, 27);
+    CHECK_EQUAL(0, acl_packets_received);
+    CHECK_EQUAL(1, get_statistics().buffers_in_use);
+    receive_fragment(con_handles[0], 60, 27, 27);
+    receive_fragment(con_handles[0], 60, 54, 10);
+    CHECK_EQUAL(1, acl_packets_received);
+    check_received_packet(con_handles[0], 60);
+
+    hci_acl_recombination_pool_statistics_t statistics = get_statistics();
+    CHECK_EQUAL(0, statistics.buffers_in_use);
+    CHECK_EQUAL(1, statistics.buffers_in_use_max);
+    CHECK_EQUAL(0, statistics.pool_exhausted);
+}
+
+TEST(HCI_ACL_RECOMBINATION, PoolExhausted){
+    CHECK_EQUAL(2, HCI_ACL_RECOMBINATION_POOL_SIZE);
+    int i;
+    for (i = 0; i < 3; i++){
+        receive_fragment(con_handles[i], 40, 0, 27);
+    }
+    hci_acl_recombination_pool_statistics_t statistics = get_statistics();
+    CHECK_EQUAL(2, statistics.buffers_in_use);
+    CHECK_EQUAL(1, statistics.pool_exhausted);
+
+    // continuation of dropped packet is ignored
+    receive_fragment(con_handles[2], 40, 27, 17);
+    CHECK_EQUAL(0, acl_packets_received);
+
+    receive_fragment(con_handles[1], 40, 27, 17);
+    CHECK_EQUAL(1, acl_packets_received);
+    check_received_packet(con_handles[1], 40);
+
+    // buffer available again
+    receive_fragment(con_handles[2], 40, 0, 27);
+    receive_fragment(con_handles[2], 40, 27, 17);
+    CHECK_EQUAL(2, acl_packets_received);
+    check_received_packet(con_handles[2], 40);
+
+    receive_fragment(con_handles[0], 40, 27, 17);
+    CHECK_EQUAL(3, acl_packets_received);
+    check_received_packet(con_handles[0], 40);
+
+    statistics = get_statistics();
+    CHECK_EQUAL(0, statistics.buffers_in_use);
+    CHECK_EQUAL(2, statistics.buffers_in_use_max);
+}
+
+TEST(HCI_ACL_RECOMBINATION, DisconnectDuringRecombination){
+    receive_fragment(con_handles[1], 40, 0, 27);
+    CHECK_EQUAL(1, get_statistics().buffers_in_use);
+
+    uint8_t event[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, ERROR_CODE_SUCCESS, 0, 0, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION};
+    little_endian_store_16(event, 3, con_handles[1]);
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    CHECK(hci_connection_for_handle(con_handles[1]) == NULL);
+    CHECK_EQUAL(0, get_statistics().buffers_in_use);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
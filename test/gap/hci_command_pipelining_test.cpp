@@ -0,0 +1,179 @@
+// Test pipelined HCI command submission limited by Num_HCI_Command_Packets
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_debug.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define MAX_HCI_COMMANDS 16
+
+static uint16_t command_opcodes[MAX_HCI_COMMANDS];
+static uint16_t num_commands;
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    UNUSED(size);
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    btstack_assert(num_commands < MAX_HCI_COMMANDS);
+    command_opcodes[num_commands++] = little_endian_read_16(packet, 0);
+    return 0;
+}
+
+static void hci_transport_test_init(const void * transport_config){
+    UNUSED(transport_config);
+}
+
+static int hci_transport_test_open(void){
+    return 0;
+}
+
+static int hci_transport_test_close(void){
+    return 0;
+}
+
+static void hci_transport_test_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static const hci_transport_t hci_transport_test = {
+        /* const char * name; */                                        "TEST",
+        /* void   (*init) (const void *transport_config); */            &hci_transport_test_init,
+        /* int    (*open)(void); */                                     &hci_transport_test_open,
+        /* int    (*close)(void); */                                    &hci_transport_test_close,
+        /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_test_register_packet_handler,
+        /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+        /* int    (*send_packet)(...); */                               &hci_transport_test_send_packet,
+        /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+        /* void   (*reset_link)(void); */                               NULL,
+        /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+static void emit_command_complete(uint16_t opcode, uint8_t num_hci_command_packets){
+    uint8_t event[] = { HCI_EVENT_COMMAND_COMPLETE, 4, 0, 0, 0, ERROR_CODE_SUCCESS};
+    event[2] = num_hci_command_packets;
+    little_endian_store_16(event, 3, opcode);
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void emit_command_status(uint16_t opcode, uint8_t num_hci_command_packets){
+    uint8_t event[] = { HCI_EVENT_COMMAND_STATUS, 4, ERROR_CODE_SUCCESS, 0, 0, 0};
+    event[3] = num_hci_command_packets;
+    little_endian_store_16(event, 4, opcode);
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void send_add_to_whitelist(uint8_t index){
+    bd_addr_t addr = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x00 };
+    addr[5] = index;
+    hci_send_cmd(&hci_le_add_device_to_white_list, BD_ADDR_TYPE_LE_PUBLIC, addr);
+}
+
+TEST_GROUP(HCI_COMMAND_PIPELINING){
+    hci_stack_t * hci_stack;
+
+    void setup(void){
+        num_commands = 0;
+        hci_init(&hci_transport_test, NULL);
+        hci_stack = hci_get_stack();
+        hci_simulate_working_fuzz();
+        hci_stack->le_whitelist_capacity = 8;
+    }
+
+    void teardown(void){
+        hci_deinit();
+    }
+};
+
+TEST(HCI_COMMAND_PIPELINING, SingleCommandPacket){
+    emit_command_complete(0, 1);
+    CHECK_TRUE(hci_can_send_command_packet_now());
+    send_add_to_whitelist(1);
+    CHECK_FALSE(hci_can_send_command_packet_now());
+    emit_command_complete(HCI_OPCODE_HCI_LE_ADD_DEVICE_TO_WHITE_LIST, 1);
+    CHECK_TRUE(hci_can_send_command_packet_now());
+}
+
+TEST(HCI_COMMAND_PIPELINING, IndependentCommandsPipelined){
+    emit_command_complete(0, 3);
+    uint8_t i;
+    for (i = 0; i < 3; i++){
+        CHECK_TRUE(hci_can_send_command_packet_now());
+        send_add_to_whitelist(i);
+    }
+    CHECK_EQUAL(3, num_commands);
+    CHECK_FALSE(hci_can_send_command_packet_now());
+
+    // two commands still outstanding, only one of the advertised command packets is available
+    emit_command_complete(HCI_OPCODE_HCI_LE_ADD_DEVICE_TO_WHITE_LIST, 3);
+    CHECK_EQUAL(1, hci_stack->num_cmd_packets);
+    CHECK_TRUE(hci_can_send_command_packet_now());
+}
+
+TEST(HCI_COMMAND_PIPELINING, PipelineDepthLimit){
+    emit_command_complete(0, 255);
+    uint8_t i;
+    for (i = 0; i < HCI_COMMAND_PIPELINE_DEPTH; i++){
+        CHECK_TRUE(hci_can_send_command_packet_now());
+        send_add_to_whitelist(i);
+    }
+    CHECK_FALSE(hci_can_send_command_packet_now());
+}
+
+TEST(HCI_COMMAND_PIPELINING, WaitForResultOfDependentCommand){
+    emit_command_complete(0, 4);
+    send_add_to_whitelist(1);
+    CHECK_TRUE(hci_can_send_command_packet_now());
+
+    // other commands are sent one at a time, although Controller would accept more
+    hci_send_cmd(&hci_write_page_timeout, 0x2000);
+    CHECK_FALSE(hci_can_send_command_packet_now());
+    emit_command_complete(HCI_OPCODE_HCI_WRITE_PAGE_TIMEOUT, 4);
+    CHECK_TRUE(hci_can_send_command_packet_now());
+    CHECK_EQUAL(3, hci_stack->num_cmd_packets);
+}
+
+TEST(HCI_COMMAND_PIPELINING, CommandStatusReturnsCommandPacket){
+    emit_command_complete(0, 2);
+    hci_send_cmd(&hci_le_connection_update, 0x0005, 6, 6, 0, 100, 0, 0);
+    hci_send_cmd(&hci_le_connection_update, 0x0006, 6, 6, 0, 100, 0, 0);
+    CHECK_FALSE(hci_can_send_command_packet_now());
+    emit_command_status(HCI_OPCODE_HCI_LE_CONNECTION_UPDATE, 2);
+    CHECK_EQUAL(1, hci_stack->num_cmd_packets);
+    emit_command_status(HCI_OPCODE_HCI_LE_CONNECTION_UPDATE, 2);
+    CHECK_EQUAL(2, hci_stack->num_cmd_packets);
+}
+
+TEST(HCI_COMMAND_PIPELINING, WhitelistUpdatesSentWithoutWaiting){
+    emit_command_complete(0, 3);
+    bd_addr_t addr = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x00 };
+    uint8_t i;
+    for (i = 0; i < 4; i++){
+        addr[5] = i;
+        gap_whitelist_add(BD_ADDR_TYPE_LE_PUBLIC, addr);
+    }
+    CHECK_EQUAL(3, num_commands);
+    for (i = 0; i < 3; i++){
+        CHECK_EQUAL(HCI_OPCODE_HCI_LE_ADD_DEVICE_TO_WHITE_LIST, command_opcodes[i]);
+    }
+
+    // last entry is sent as soon as a command packet is available
+    emit_command_complete(HCI_OPCODE_HCI_LE_ADD_DEVICE_TO_WHITE_LIST, 3);
+    CHECK_EQUAL(4, num_commands);
+    CHECK_EQUAL(HCI_OPCODE_HCI_LE_ADD_DEVICE_TO_WHITE_LIST, command_opcodes[3]);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,158 @@
+// Test HCI connection lookup by con handle and by address
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_memory.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    UNUSED(packet_type);
+    UNUSED(packet);
+    UNUSED(size);
+    return 0;
+}
+
+static void hci_transport_test_init(const void * transport_config){
+    UNUSED(transport_config);
+}
+
+static int hci_transport_test_open(void){
+    return 0;
+}
+
+static int hci_transport_test_close(void){
+    return 0;
+}
+
+static void hci_transport_test_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static const hci_transport_t hci_transport_test = {
+        /* const char * name; */                                        "TEST",
+        /* void   (*init) (const void *transport_config); */            &hci_transport_test_init,
+        /* int    (*open)(void); */                                     &hci_transport_test_open,
+        /* int    (*close)(void); */                                    &hci_transport_test_close,
+        /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_test_register_packet_handler,
+        /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+        /* int    (*send_packet)(...); */                               &hci_transport_test_send_packet,
+        /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+        /* void   (*reset_link)(void); */                               NULL,
+        /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+static void address_for_index(uint16_t index, bd_addr_t addr){
+    addr[0] = 0xC0;
+    addr[1] = 0x11;
+    addr[2] = 0x22;
+    addr[3] = 0x33;
+    addr[4] = index >> 8;
+    addr[5] = index & 0xff;
+}
+
+static hci_con_handle_t con_handle_for_index(uint16_t index){
+    // controllers often assign handles sparse
+    return (hci_con_handle_t) (0x40 + (index * 3));
+}
+
+static void simulate_le_connection_complete(uint16_t index){
+    bd_addr_t addr;
+    address_for_index(index, addr);
+    uint8_t event[] = { HCI_EVENT_LE_META, 19, HCI_SUBEVENT_LE_CONNECTION_COMPLETE,
+                        ERROR_CODE_SUCCESS, 0, 0, HCI_ROLE_SLAVE, BD_ADDR_TYPE_LE_RANDOM,
+                        0, 0, 0, 0, 0, 0,
+                        0x18, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00};
+    little_endian_store_16(event, 4, con_handle_for_index(index));
+    reverse_bd_addr(addr, &event[8]);
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void simulate_disconnection_complete(uint16_t index){
+    uint8_t event[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, ERROR_CODE_SUCCESS, 0, 0, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION};
+    little_endian_store_16(event, 3, con_handle_for_index(index));
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+TEST_GROUP(HCI_CONNECTION_LOOKUP){
+    void setup(void){
+        hci_init(&hci_transport_test, NULL);
+        hci_simulate_working_fuzz();
+    }
+    void teardown(void){
+        hci_free_connections_fuzz();
+        hci_deinit();
+    }
+
+    void create_connections(uint16_t num_connections){
+        for (uint16_t i = 0; i < num_connections; i++){
+            simulate_le_connection_complete(i);
+        }
+    }
+
+    void check_connections(uint16_t num_connections){
+        for (uint16_t i = 0; i < num_connections; i++){
+            bd_addr_t addr;
+            address_for_index(i, addr);
+            hci_connection_t * conn = hci_connection_for_handle(con_handle_for_index(i));
+            CHECK(conn != NULL);
+            CHECK_EQUAL(con_handle_for_index(i), conn->con_handle);
+            MEMCMP_EQUAL(addr, conn->address, 6);
+            CHECK(conn == hci_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_LE_RANDOM));
+            CHECK(NULL == hci_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_LE_PUBLIC));
+        }
+    }
+};
+
+TEST(HCI_CONNECTION_LOOKUP, Lookup){
+    create_connections(50);
+    check_connections(50);
+    CHECK(NULL == hci_connection_for_handle(con_handle_for_index(50)));
+    CHECK(NULL == hci_connection_for_handle(HCI_CON_HANDLE_INVALID));
+}
+
+TEST(HCI_CONNECTION_LOOKUP, LookupAfterDisconnect){
+    create_connections(50);
+    // disconnect every other connection
+    for (uint16_t i = 0; i < 50; i += 2){
+        simulate_disconnection_complete(i);
+    }
+    for (uint16_t i = 0; i < 50; i++){
+        bd_addr_t addr;
+        address_for_index(i, addr);
+        hci_connection_t * conn = hci_connection_for_handle(con_handle_for_index(i));
+        if ((i & 1) == 0){
+            CHECK(conn == NULL);
+            CHECK(NULL == hci_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_LE_RANDOM));
+        } else {
+            CHECK(conn != NULL);
+            CHECK(conn == hci_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_LE_RANDOM));
+        }
+    }
+    // reconnect with same handles
+    for (uint16_t i = 0; i < 50; i += 2){
+        simulate_le_connection_complete(i);
+    }
+    check_connections(50);
+}
+
+TEST(HCI_CONNECTION_LOOKUP, ManyConnections){
+    create_connections(256);
+    check_connections(256);
+    CHECK(NULL == hci_connection_for_handle(con_handle_for_index(256)));
+}
+
+int main (int argc, const char * argv[]){
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,372 @@
+// Test warm boot with cached Controller information with a simulated Controller
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth_company_id.h"
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_tlv.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_cmd.h"
+#include "hci_dump.h"
+
+#define MAX_PENDING_EVENTS 4
+
+static bd_addr_t controller_bd_addr = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+static uint16_t  controller_lmp_subversion = 0x1234;
+
+static uint8_t  pending_events[MAX_PENDING_EVENTS][260];
+static uint16_t pending_events_len[MAX_PENDING_EVENTS];
+static uint16_t num_pending_events;
+static uint16_t num_commands;
+static uint16_t num_cached_opcodes_sent;
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// Command Complete events for cacheable opcodes seen in packet log and by event handler
+static uint16_t num_cacheable_events_logged;
+static uint16_t num_cacheable_events_received;
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+
+// single tag in-memory TLV
+static uint32_t tlv_tag;
+static uint8_t  tlv_value[sizeof(hci_controller_info_cache_storage_t)];
+static uint32_t tlv_value_len;
+static uint16_t tlv_num_stores;
+
+static int test_tlv_get_tag(void * context, uint32_t tag, uint8_t * buffer, uint32_t buffer_size){
+    UNUSED(context);
+    if ((tlv_value_len == 0) || (tag != tlv_tag)) return 0;
+    uint32_t len = btstack_min(buffer_size, tlv_value_len);
+    memcpy(buffer, tlv_value, len);
+    return (int) len;
+}
+
+static int test_tlv_store_tag(void * context, uint32_t tag, const uint8_t * data, uint32_t data_size){
+    UNUSED(context);
+    btstack_assert(data_size <= sizeof(tlv_value));
+    tlv_tag = tag;
+    memcpy(tlv_value, data, data_size);
+    tlv_value_len = data_size;
+    tlv_num_stores++;
+    return 0;
+}
+
+static void test_tlv_delete_tag(void * context, uint32_t tag){
+    UNUSED(context);
+    if (tag == tlv_tag){
+        tlv_value_len = 0;
+    }
+}
+
+static const btstack_tlv_t test_tlv = {
+    &test_tlv_get_tag,
+    &test_tlv_store_tag,
+    &test_tlv_delete_tag,
+};
+
+// simulated Controller: answer every command with Command Complete and plausible return parameters
+static void controller_handle_command(const uint8_t * packet){
+    uint16_t opcode = little_endian_read_16(packet, 0);
+    uint8_t params[255];
+    uint16_t params_len;
+    memset(params, 0, sizeof(params));
+    params[0] = ERROR_CODE_SUCCESS;
+    switch (opcode){
+        case HCI_OPCODE_HCI_READ_LOCAL_VERSION_INFORMATION:
+            params[1] = 0x0b;
+            little_endian_store_16(params, 2, 0x0001);
+            params[4] = 0x0b;
+            little_endian_store_16(params, 5, BLUETOOTH_COMPANY_ID_PACKETCRAFT_INC);
+            little_endian_store_16(params, 7, controller_lmp_subversion);
+            params_len = 9;
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_COMMANDS:
+            memset(&params[1], 0xff, 64);
+            params_len = 65;
+            break;
+        case HCI_OPCODE_HCI_READ_BD_ADDR:
+            reverse_bd_addr(controller_bd_addr, &params[1]);
+            params_len = 7;
+            break;
+        case HCI_OPCODE_HCI_READ_BUFFER_SIZE:
+            little_endian_store_16(params, 1, 1021);
+            params[3] = 64;
+            little_endian_store_16(params, 4, 8);
+            little_endian_store_16(params, 6, 8);
+            params_len = 8;
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_FEATURES:
+            // LE Supported (Controller), no BR/EDR
+            params[5] = 0x60;
+            params[7] = 0x01;
+            params_len = 9;
+            break;
+        case HCI_OPCODE_HCI_LE_READ_BUFFER_SIZE_V2:
+            little_endian_store_16(params, 1, 251);
+            params[3] = 8;
+            little_endian_store_16(params, 4, 0);
+            params[6] = 0;
+            params_len = 7;
+            break;
+        case HCI_OPCODE_HCI_LE_READ_BUFFER_SIZE:
+            little_endian_store_16(params, 1, 251);
+            params[3] = 8;
+            params_len = 4;
+            break;
+        case HCI_OPCODE_HCI_LE_READ_MAXIMUM_DATA_LENGTH:
+            little_endian_store_16(params, 1, 251);
+            little_endian_store_16(params, 3, 2120);
+            little_endian_store_16(params, 5, 251);
+            little_endian_store_16(params, 7, 2120);
+            params_len = 9;
+            break;
+        case HCI_OPCODE_HCI_LE_READ_WHITE_LIST_SIZE:
+            params[1] = 16;
+            params_len = 2;
+            break;
+        case HCI_OPCODE_HCI_LE_READ_MAXIMUM_ADVERTISING_DATA_LENGTH:
+            little_endian_store_16(params, 1, 1650);
+            params_len = 3;
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_NAME:
+            params_len = 249;
+            break;
+        default:
+            // zero return parameters, sufficient for all remaining commands
+            params_len = 16;
+            break;
+    }
+
+    btstack_assert(num_pending_events < MAX_PENDING_EVENTS);
+    uint8_t * event = pending_events[num_pending_events];
+    memset(event, 0, sizeof(pending_events[0]));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = 3 + params_len;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    memcpy(&event[5], params, params_len);
+    pending_events_len[num_pending_events] = 5 + params_len;
+    num_pending_events++;
+}
+
+static bool opcode_is_cacheable(uint16_t opcode){
+    switch (opcode){
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_COMMANDS:
+        case HCI_OPCODE_HCI_READ_BUFFER_SIZE:
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_FEATURES:
+        case HCI_OPCODE_HCI_LE_READ_BUFFER_SIZE:
+        case HCI_OPCODE_HCI_LE_READ_BUFFER_SIZE_V2:
+        case HCI_OPCODE_HCI_LE_READ_MAXIMUM_DATA_LENGTH:
+        case HCI_OPCODE_HCI_LE_READ_WHITE_LIST_SIZE:
+        case HCI_OPCODE_HCI_LE_READ_MAXIMUM_ADVERTISING_DATA_LENGTH:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool event_is_cacheable_command_complete(uint8_t packet_type, const uint8_t * packet){
+    if (packet_type != HCI_EVENT_PACKET) return false;
+    if (hci_event_packet_get_type(packet) != HCI_EVENT_COMMAND_COMPLETE) return false;
+    return opcode_is_cacheable(hci_event_command_complete_get_command_opcode(packet));
+}
+
+static void test_hci_dump_log_packet(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t len){
+    UNUSED(len);
+    if ((in != 0) && event_is_cacheable_command_complete(packet_type, packet)){
+        num_cacheable_events_logged++;
+    }
+}
+
+static void test_hci_dump_log_message(int log_level, const char * format, va_list argptr){
+    UNUSED(log_level);
+    UNUSED(format);
+    UNUSED(argptr);
+}
+
+static const hci_dump_t test_hci_dump = {
+    NULL,
+    &test_hci_dump_log_packet,
+    &test_hci_dump_log_message,
+};
+
+static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (event_is_cacheable_command_complete(packet_type, packet)){
+        num_cacheable_events_received++;
+    }
+}
+
+static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    UNUSED(size);
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    num_commands++;
+    if (opcode_is_cacheable(little_endian_read_16(packet, 0))){
+        num_cached_opcodes_sent++;
+    }
+    controller_handle_command(packet);
+    return 0;
+}
+
+static void hci_transport_test_init(const void * transport_config){
+    UNUSED(transport_config);
+}
+
+static int hci_transport_test_open(void){
+    return 0;
+}
+
+static int hci_transport_test_close(void){
+    return 0;
+}
+
+static void hci_transport_test_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static const hci_transport_t hci_transport_test = {
+        /* const char * name; */                                        "TEST",
+        /* void   (*init) (const void *transport_config); */            &hci_transport_test_init,
+        /* int    (*open)(void); */                                     &hci_transport_test_open,
+        /* int    (*close)(void); */                                    &hci_transport_test_close,
+        /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_test_register_packet_handler,
+        /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+        /* int    (*send_packet)(...); */                               &hci_transport_test_send_packet,
+        /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+        /* void   (*reset_link)(void); */                               NULL,
+        /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+// power on and deliver Controller events until HCI is working, returns number of commands sent
+static uint16_t power_on(void){
+    hci_init(&hci_transport_test, NULL);
+    hci_set_controller_info_cache_tlv(&test_tlv, NULL);
+    hci_event_callback_registration.callback = &hci_event_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    num_commands = 0;
+    num_cached_opcodes_sent = 0;
+    num_cacheable_events_logged = 0;
+    num_cacheable_events_received = 0;
+    num_pending_events = 0;
+    hci_power_control(HCI_POWER_ON);
+    while ((num_pending_events > 0) && (hci_get_state() != HCI_STATE_WORKING)){
+        uint8_t event[sizeof(pending_events[0])];
+        uint16_t event_len = pending_events_len[0];
+        memcpy(event, pending_events[0], sizeof(event));
+        num_pending_events--;
+        memmove(&pending_events[0], &pending_events[1], num_pending_events * sizeof(pending_events[0]));
+        memmove(&pending_events_len[0], &pending_events_len[1], num_pending_events * sizeof(pending_events_len[0]));
+        packet_handler(HCI_EVENT_PACKET, event, event_len);
+    }
+    CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+    return num_commands;
+}
+
+static void power_off(void){
+    hci_power_control(HCI_POWER_OFF);
+    hci_deinit();
+}
+
+TEST_GROUP(HCI_CONTROLLER_INFO_CACHE){
+    void setup(void){
+        tlv_value_len = 0;
+        tlv_num_stores = 0;
+        controller_bd_addr[5] = 0x66;
+        controller_lmp_subversion = 0x1234;
+        hci_dump_init(&test_hci_dump);
+    }
+
+    void teardown(void){
+        hci_dump_init(NULL);
+    }
+};
+
+TEST(HCI_CONTROLLER_INFO_CACHE, ColdBootStoresCache){
+    power_on();
+    CHECK(num_cached_opcodes_sent >= 5);
+    CHECK_EQUAL(1, tlv_num_stores);
+    CHECK(tlv_value_len > offsetof(hci_controller_info_cache_storage_t, events));
+    power_off();
+}
+
+TEST(HCI_CONTROLLER_INFO_CACHE, WarmBootSkipsQueries){
+    uint16_t cold_commands = power_on();
+    hci_stack_t cold_stack = *hci_get_stack();
+    power_off();
+
+    uint16_t warm_commands = power_on();
+    CHECK_EQUAL(0, num_cached_opcodes_sent);
+    CHECK(warm_commands < cold_commands);
+    // nothing new to store
+    CHECK_EQUAL(1, tlv_num_stores);
+
+    // same results as on cold boot
+    hci_stack_t * hci_stack = hci_get_stack();
+    CHECK_EQUAL(cold_stack.local_supported_commands, hci_stack->local_supported_commands);
+    MEMCMP_EQUAL(cold_stack.local_supported_features, hci_stack->local_supported_features, sizeof(hci_stack->local_supported_features));
+    CHECK_EQUAL(cold_stack.le_data_packets_length, hci_stack->le_data_packets_length);
+    CHECK_EQUAL(cold_stack.le_acl_packets_total_num, hci_stack->le_acl_packets_total_num);
+    CHECK_EQUAL(cold_stack.le_whitelist_capacity, hci_stack->le_whitelist_capacity);
+    CHECK_EQUAL(cold_stack.le_supported_max_tx_octets, hci_stack->le_supported_max_tx_octets);
+    power_off();
+}
+
+TEST(HCI_CONTROLLER_INFO_CACHE, WarmBootReplaysCachedEvents){
+    power_on();
+    uint16_t cold_events = num_cacheable_events_received;
+    CHECK(cold_events >= 5);
+    CHECK_EQUAL(cold_events, num_cacheable_events_logged);
+    power_off();
+
+    // cached Command Complete events are logged and delivered to event handlers like received ones
+    power_on();
+    CHECK_EQUAL(0, num_cached_opcodes_sent);
+    CHECK_EQUAL(cold_events, num_cacheable_events_received);
+    CHECK_EQUAL(cold_events, num_cacheable_events_logged);
+    power_off();
+}
+
+TEST(HCI_CONTROLLER_INFO_CACHE, DifferentBdAddrReadsAgain){
+    uint16_t cold_commands = power_on();
+    power_off();
+
+    // Read Local Supported Commands was answered from cache before BD_ADDR was known,
+    // it is sent again followed by another Read BD_ADDR
+    controller_bd_addr[5] = 0x77;
+    uint16_t commands = power_on();
+    CHECK_EQUAL(cold_commands + 1, commands);
+    CHECK_EQUAL(2, tlv_num_stores);
+    power_off();
+
+    // new Controller now cached
+    commands = power_on();
+    CHECK(commands < cold_commands);
+    power_off();
+}
+
+TEST(HCI_CONTROLLER_INFO_CACHE, DifferentVersionReadsAgain){
+    uint16_t cold_commands = power_on();
+    power_off();
+
+    controller_lmp_subversion = 0x1235;
+    uint16_t commands = power_on();
+    CHECK_EQUAL(cold_commands, commands);
+    CHECK_EQUAL(2, tlv_num_stores);
+    power_off();
+}
+
+int main (int argc, const char * argv[]){
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
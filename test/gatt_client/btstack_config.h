@@ -23,6 +23,7 @@
 
 // #define ENABLE_LE_SECURE_CONNECTIONS
 #define ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
+#define ENABLE_GATT_CLIENT_CACHE
 #define ENABLE_LE_CENTRAL
 #define ENABLE_LE_PERIPHERAL
 #define ENABLE_LE_SIGNED_WRITE
@@ -0,0 +1,300 @@
+
+// *****************************************************************************
+//
+// test gatt client cache
+//
+// *****************************************************************************
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "hci.h"
+#include "btstack_event.h"
+#include "btstack_tlv.h"
+#include "btstack_util.h"
+#include "bluetooth_gatt.h"
+#include "ble/att_db.h"
+#include "ble/att_db_util.h"
+#include "ble/gatt_client.h"
+#include "ble/le_device_db.h"
+#include "mock_btstack_tlv.h"
+
+extern "C" void hci_setup_le_connection(uint16_t con_handle);
+extern "C" void l2cap_set_can_send_fixed_channel_packet_now(bool value);
+extern "C" void mock_simulate_disconnected(void);
+extern "C" uint16_t mock_get_att_packets_sent(void);
+extern "C" void mock_reset_att_packets_sent(void);
+extern "C" uint16_t mock_get_att_database_hash_reads(void);
+extern "C" void mock_set_le_device_index(int index);
+
+static const hci_con_handle_t con_handle = 0x40;
+static const uint8_t custom_service_uuid128[] = { 0x00, 0x00, 0xFF, 0x10, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0x80, 0x5F, 0x9B, 0x34, 0xFB};
+static const uint8_t custom_characteristic_uuid128[] = { 0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x11, 0xFF, 0x00, 0x00};
+
+static uint8_t value[] = { 0x00 };
+
+static int query_complete;
+static uint8_t query_status;
+
+static int num_services;
+static gatt_client_service_t services[16];
+static int num_characteristics;
+static gatt_client_characteristic_t characteristics[16];
+static int num_descriptors;
+static gatt_client_characteristic_descriptor_t descriptors[16];
+
+static void handle_gatt_client_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(packet_type);
+    UNUSED(channel);
+    UNUSED(size);
+    switch (hci_event_packet_get_type(packet)){
+        case GATT_EVENT_SERVICE_QUERY_RESULT:
+            gatt_event_service_query_result_get_service(packet, &services[num_services++]);
+            break;
+        case GATT_EVENT_CHARACTERISTIC_QUERY_RESULT:
+            gatt_event_characteristic_query_result_get_characteristic(packet, &characteristics[num_characteristics++]);
+            break;
+        case GATT_EVENT_ALL_CHARACTERISTIC_DESCRIPTORS_QUERY_RESULT:
+            gatt_event_all_characteristic_descriptors_query_result_get_characteristic_descriptor(packet, &descriptors[num_descriptors++]);
+            break;
+        case GATT_EVENT_QUERY_COMPLETE:
+            query_complete = 1;
+            query_status = gatt_event_query_complete_get_att_status(packet);
+            break;
+        default:
+            break;
+    }
+}
+
+// GAP service, GATT service with optional Database Hash, custom service with two characteristics
+static void setup_database(bool with_database_hash, uint8_t hash_value, bool extra_characteristic){
+    uint8_t database_hash[16];
+    memset(database_hash, hash_value, sizeof(database_hash));
+
+    att_db_util_init();
+    att_db_util_add_service_uuid16(ORG_BLUETOOTH_SERVICE_GENERIC_ACCESS);
+    att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_GAP_DEVICE_NAME, ATT_PROPERTY_READ, ATT_SECURITY_NONE, ATT_SECURITY_NONE, value, sizeof(value));
+    att_db_util_add_service_uuid16(ORG_BLUETOOTH_SERVICE_GENERIC_ATTRIBUTE);
+    if (with_database_hash){
+        att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_DATABASE_HASH, ATT_PROPERTY_READ, ATT_SECURITY_NONE, ATT_SECURITY_NONE, database_hash, sizeof(database_hash));
+    }
+    att_db_util_add_service_uuid128(custom_service_uuid128);
+    att_db_util_add_characteristic_uuid128(custom_characteristic_uuid128, ATT_PROPERTY_READ | ATT_PROPERTY_NOTIFY, ATT_SECURITY_NONE, ATT_SECURITY_NONE, value, sizeof(value));
+    att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL, ATT_PROPERTY_READ | ATT_PROPERTY_INDICATE, ATT_SECURITY_NONE, ATT_SECURITY_NONE, value, sizeof(value));
+    if (extra_characteristic){
+        att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL_STATE, ATT_PROPERTY_READ, ATT_SECURITY_NONE, ATT_SECURITY_NONE, value, sizeof(value));
+    }
+    att_set_db(att_db_util_get_address());
+}
+
+TEST_GROUP(GATTClientCache){
+    mock_btstack_tlv_t tlv_context;
+    const btstack_tlv_t * tlv_impl;
+
+    void setup(void){
+        tlv_impl = mock_btstack_tlv_init_instance(&tlv_context);
+        btstack_tlv_set_instance(tlv_impl, &tlv_context);
+
+        bd_addr_t addr = { 0x00, 0x1B, 0xDC, 0x07, 0x32, 0xEF };
+        sm_key_t irk;
+        memset(irk, 0x11, sizeof(irk));
+        le_device_db_init();
+        le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, addr, irk);
+
+        mock_set_le_device_index(0);
+        hci_setup_le_connection(con_handle);
+        l2cap_set_can_send_fixed_channel_packet_now(true);
+        gatt_client_init();
+        gatt_client_mtu_enable_auto_negotiation(0);
+    }
+
+    void teardown(void){
+        mock_simulate_disconnected();
+        btstack_tlv_set_instance(NULL, NULL);
+        mock_btstack_tlv_deinit(&tlv_context);
+    }
+
+    void reconnect(void){
+        mock_simulate_disconnected();
+        hci_setup_le_connection(con_handle);
+    }
+
+    void reset_results(void){
+        query_complete = 0;
+        query_status = ATT_ERROR_SUCCESS;
+        num_services = 0;
+        num_characteristics = 0;
+        num_descriptors = 0;
+        mock_reset_att_packets_sent();
+    }
+
+    void discover_all(void){
+        reset_results();
+        uint8_t status = gatt_client_discover_primary_services(&handle_gatt_client_event, con_handle);
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+        CHECK_EQUAL(1, query_complete);
+        CHECK_EQUAL(ATT_ERROR_SUCCESS, query_status);
+
+        int i;
+        for (i = 0; i < num_services; i++){
+            query_complete = 0;
+            status = gatt_client_discover_characteristics_for_service(&handle_gatt_client_event, con_handle, &services[i]);
+            CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+            CHECK_EQUAL(1, query_complete);
+        }
+
+        for (i = 0; i < num_characteristics; i++){
+            query_complete = 0;
+            status = gatt_client_discover_characteristic_descriptors(&handle_gatt_client_event, con_handle, &characteristics[i]);
+            CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+            CHECK_EQUAL(1, query_complete);
+        }
+    }
+};
+
+TEST(GATTClientCache, DiscoveryFromCache){
+    setup_database(true, 0x01, false);
+
+    discover_all();
+    CHECK_EQUAL(3, num_services);
+    CHECK_EQUAL(4, num_characteristics);
+    CHECK_EQUAL(2, num_descriptors);
+    uint16_t packets_sent_remote = mock_get_att_packets_sent();
+
+    gatt_client_service_t services_remote[3];
+    gatt_client_characteristic_t characteristics_remote[4];
+    gatt_client_characteristic_descriptor_t descriptors_remote[2];
+    memcpy(services_remote, services, sizeof(services_remote));
+    memcpy(characteristics_remote, characteristics, sizeof(characteristics_remote));
+    memcpy(descriptors_remote, descriptors, sizeof(descriptors_remote));
+
+    reconnect();
+    discover_all();
+
+    // only Database Hash is read
+    CHECK_EQUAL(1, mock_get_att_packets_sent());
+    CHECK(packets_sent_remote > 1);
+
+    CHECK_EQUAL(3, num_services);
+    CHECK_EQUAL(4, num_characteristics);
+    CHECK_EQUAL(2, num_descriptors);
+    MEMCMP_EQUAL(services_remote, services, sizeof(services_remote));
+    MEMCMP_EQUAL(characteristics_remote, characteristics, sizeof(characteristics_remote));
+    MEMCMP_EQUAL(descriptors_remote, descriptors, sizeof(descriptors_remote));
+}
+
+TEST(GATTClientCache, QueriesWithUuidFromCache){
+    setup_database(true, 0x01, false);
+    discover_all();
+
+    reconnect();
+    discover_all();
+
+    reset_results();
+    uint8_t status = gatt_client_discover_primary_services_by_uuid128(&handle_gatt_client_event, con_handle, custom_service_uuid128);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(1, query_complete);
+    CHECK_EQUAL(1, num_services);
+    MEMCMP_EQUAL(custom_service_uuid128, services[0].uuid128, 16);
+
+    query_complete = 0;
+    status = gatt_client_discover_characteristics_for_service_by_uuid16(&handle_gatt_client_event, con_handle, &services[0], ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(1, query_complete);
+    CHECK_EQUAL(1, num_characteristics);
+    CHECK_EQUAL(ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL, characteristics[0].uuid16);
+    CHECK_EQUAL(services[0].end_group_handle, characteristics[0].end_handle);
+
+    CHECK_EQUAL(0, mock_get_att_packets_sent());
+}
+
+TEST(GATTClientCache, DatabaseHashChanged){
+    setup_database(true, 0x01, false);
+    discover_all();
+    CHECK_EQUAL(4, num_characteristics);
+
+    setup_database(true, 0x02, true);
+    reconnect();
+    discover_all();
+    CHECK(mock_get_att_packets_sent() > 1);
+    CHECK_EQUAL(3, num_services);
+    CHECK_EQUAL(5, num_characteristics);
+
+    // new database is cached
+    reconnect();
+    discover_all();
+    CHECK_EQUAL(1, mock_get_att_packets_sent());
+    CHECK_EQUAL(5, num_characteristics);
+}
+
+TEST(GATTClientCache, StoredInBoundedTags){
+    setup_database(true, 0x01, true);
+    // more entries than fit into a single TLV value
+    int i;
+    for (i = 0; i < 8; i++){
+        att_db_util_add_service_uuid16(ORG_BLUETOOTH_SERVICE_BATTERY_SERVICE);
+        att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL, ATT_PROPERTY_READ | ATT_PROPERTY_NOTIFY, ATT_SECURITY_NONE, ATT_SECURITY_NONE, value, sizeof(value));
+    }
+    att_set_db(att_db_util_get_address());
+
+    discover_all();
+    CHECK_EQUAL(11, num_services);
+    CHECK_EQUAL(13, num_characteristics);
+    CHECK_EQUAL(10, num_descriptors);
+
+    reconnect();
+    discover_all();
+    CHECK_EQUAL(1, mock_get_att_packets_sent());
+    CHECK_EQUAL(11, num_services);
+    CHECK_EQUAL(13, num_characteristics);
+    CHECK_EQUAL(10, num_descriptors);
+}
+
+TEST(GATTClientCache, UnbondedWithoutDatabaseHashRead){
+    setup_database(true, 0x01, false);
+    mock_set_le_device_index(-1);
+    discover_all();
+    CHECK_EQUAL(3, num_services);
+    CHECK_EQUAL(0, mock_get_att_database_hash_reads());
+    uint16_t packets_sent_remote = mock_get_att_packets_sent();
+
+    reconnect();
+    discover_all();
+    CHECK_EQUAL(0, mock_get_att_database_hash_reads());
+    CHECK_EQUAL(packets_sent_remote, mock_get_att_packets_sent());
+}
+
+TEST(GATTClientCache, BondedWithoutCacheReadsDatabaseHashOnce){
+    setup_database(true, 0x01, false);
+    reset_results();
+    uint8_t status = gatt_client_discover_primary_services(&handle_gatt_client_event, con_handle);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(1, query_complete);
+    // no stored cache, nothing to validate yet
+    CHECK_EQUAL(0, mock_get_att_database_hash_reads());
+
+    discover_all();
+    CHECK_EQUAL(1, mock_get_att_database_hash_reads());
+}
+
+TEST(GATTClientCache, NoDatabaseHash){
+    setup_database(false, 0x00, false);
+    discover_all();
+    CHECK_EQUAL(3, num_services);
+    uint16_t packets_sent_remote = mock_get_att_packets_sent();
+
+    reconnect();
+    discover_all();
+    CHECK_EQUAL(3, num_services);
+    CHECK_EQUAL(packets_sent_remote, mock_get_att_packets_sent());
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
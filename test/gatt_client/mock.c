@@ -8,6 +8,7 @@
 
 #include "ble/att_db.h"
 #include "ble/sm.h"
+#include "bluetooth_gatt.h"
 #include "gap.h"
 #include "btstack_debug.h"
 
@@ -25,6 +26,10 @@ static hci_connection_t hci_connection;
 static uint8_t packet_buffer[256];
 static uint16_t packet_buffer_len;
 
+static uint16_t att_packets_sent;
+static uint16_t att_database_hash_reads;
+static int      le_device_index;
+
 uint16_t get_gatt_client_handle(void){
 	return gatt_client_handle;
 }
@@ -70,6 +75,28 @@ void mock_simulate_connected(void){
 	registered_hci_event_handler(HCI_EVENT_PACKET, 0, gap_event, sizeof(gap_event));
 }
 
+void mock_simulate_disconnected(void){
+	uint8_t packet[] = {HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, (uint8_t) (gatt_client_handle & 0xff), (uint8_t) (gatt_client_handle >> 8), ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION};
+	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
+}
+
+uint16_t mock_get_att_packets_sent(void){
+	return att_packets_sent;
+}
+
+void mock_reset_att_packets_sent(void){
+	att_packets_sent = 0;
+	att_database_hash_reads = 0;
+}
+
+uint16_t mock_get_att_database_hash_reads(void){
+	return att_database_hash_reads;
+}
+
+void mock_set_le_device_index(int index){
+	le_device_index = index;
+}
+
 void mock_simulate_scan_response(void){
 	uint8_t packet[] = {GAP_EVENT_ADVERTISING_REPORT, 0x13, 0xE2, 0x01, 0x34, 0xB1, 0xF7, 0xD1, 0x77, 0x9B, 0xCC, 0x09, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
 	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
@@ -187,6 +214,11 @@ uint8_t l2cap_send_prepared_connectionless(uint16_t handle, uint16_t cid, uint16
 	att_init_connection(&att_connection);
 	uint8_t response_buffer[PREBUFFER_SIZE + TEST_MAX_MTU];
 	uint8_t * response = &response_buffer[PREBUFFER_SIZE];
+	att_packets_sent++;
+	const uint8_t * request = l2cap_get_outgoing_buffer();
+	if ((request[0] == ATT_READ_BY_TYPE_REQUEST) && (len == 7u) && (little_endian_read_16(request, 5) == ORG_BLUETOOTH_CHARACTERISTIC_DATABASE_HASH)){
+		att_database_hash_reads++;
+	}
 	uint16_t response_len = att_handle_request(&att_connection, l2cap_get_outgoing_buffer(), len, response);
 	if (response_len){
 		att_packet_handler(ATT_DATA_PACKET, gatt_client_handle, &response[0], response_len);
@@ -204,7 +236,7 @@ void sm_cmac_signed_write_start(const sm_key_t key, uint8_t opcode, uint16_t att
 	//sm_notify_client(SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED, sm_central_device_addr_type, sm_central_device_address, 0, sm_central_device_matched);      
 }
 int sm_le_device_index(uint16_t handle ){
-	return 0;
+	return le_device_index;
 }
 void sm_send_security_request(hci_con_handle_t con_handle){
 }
@@ -36,6 +36,10 @@ extern "C" void mock_call_att_packet_handler(uint8_t packet_type, uint16_t chann
 extern "C" void mock_l2cap_set_max_mtu(uint16_t mtu);
 extern "C" void hci_setup_classic_connection(uint16_t con_handle);
 extern "C" void set_cmac_ready(int ready);
+extern "C" void mock_process_main_thread_callbacks(void);
+extern "C" uint16_t mock_get_packets_sent(void);
+extern "C" const uint8_t * mock_get_last_packet(uint16_t * len);
+extern "C" void mock_reset_packets_sent(void);
 
 static uint8_t att_request[255];
 static uint16_t att_write_request(uint16_t request_type, uint16_t attribute_handle, uint16_t value_length, const uint8_t * value){
@@ -666,6 +670,143 @@ TEST(ATT_SERVER, att_server_register_service_handler) {
     att_server_register_service_handler(&test_service);
 }   
 
+TEST_GROUP(ATT_SERVER_NOTIFICATION_COALESCING){
+    uint16_t att_con_handle;
+    uint16_t client_supported_features_handle;
+    uint16_t value_handles[3];
+
+    void setup(void){
+        att_con_handle = 0x01;
+        hci_setup_le_connection(att_con_handle);
+        l2cap_can_send_fixed_channel_packet_now_set_status(1);
+
+        att_db_util_init();
+        att_db_util_add_service_uuid16(ORG_BLUETOOTH_SERVICE_GENERIC_ATTRIBUTE);
+        client_supported_features_handle = att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_CLIENT_SUPPORTED_FEATURES, ATT_PROPERTY_READ | ATT_PROPERTY_WRITE | ATT_PROPERTY_DYNAMIC, ATT_SECURITY_NONE, ATT_SECURITY_NONE, NULL, 0);
+        att_db_util_add_service_uuid16(ORG_BLUETOOTH_SERVICE_BATTERY_SERVICE);
+        value_handles[0] = att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL,       ATT_PROPERTY_READ | ATT_PROPERTY_NOTIFY, ATT_SECURITY_NONE, ATT_SECURITY_NONE, &battery_level, 1);
+        value_handles[1] = att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL_STATE, ATT_PROPERTY_READ | ATT_PROPERTY_NOTIFY, ATT_SECURITY_NONE, ATT_SECURITY_NONE, &battery_level, 1);
+        value_handles[2] = att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_POWER_STATE, ATT_PROPERTY_READ | ATT_PROPERTY_NOTIFY, ATT_SECURITY_NONE, ATT_SECURITY_NONE, &battery_level, 1);
+        att_server_init(att_db_util_get_address(), att_read_callback, att_write_callback);
+        att_server_enable_notification_coalescing(true);
+        mock_reset_packets_sent();
+    }
+
+    void teardown(void) {
+        att_server_deinit();
+        hci_deinit();
+    }
+
+    void enable_multiple_notifications(void){
+        uint8_t features = GATT_CLIENT_SUPPORTED_FEATURES_MULTIPLE_HANDLE_VALUE_NOTIFICATIONS;
+        uint16_t att_request_len = att_write_request(ATT_WRITE_REQUEST, client_supported_features_handle, 1, &features);
+        mock_call_att_server_packet_handler(ATT_DATA_PACKET, att_con_handle, &att_request[0], att_request_len);
+        mock_reset_packets_sent();
+    }
+
+    void notify(uint16_t value_handle, uint8_t value){
+        uint8_t status = att_server_notify(att_con_handle, value_handle, &value, 1);
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    }
+};
+
+TEST(ATT_SERVER_NOTIFICATION_COALESCING, multiple_handle_value_notification){
+    enable_multiple_notifications();
+    notify(value_handles[0], 0x11);
+    notify(value_handles[1], 0x22);
+    notify(value_handles[2], 0x33);
+    // nothing sent before run loop iteration completes
+    CHECK_EQUAL(0, mock_get_packets_sent());
+
+    mock_process_main_thread_callbacks();
+    CHECK_EQUAL(1, mock_get_packets_sent());
+
+    uint16_t packet_len;
+    const uint8_t * packet = mock_get_last_packet(&packet_len);
+    CHECK_EQUAL(1 + 3 * 5, packet_len);
+    CHECK_EQUAL(ATT_MULTIPLE_HANDLE_VALUE_NTF, packet[0]);
+    CHECK_EQUAL(value_handles[0], little_endian_read_16(packet, 1));
+    CHECK_EQUAL(1, little_endian_read_16(packet, 3));
+    CHECK_EQUAL(0x11, packet[5]);
+    CHECK_EQUAL(value_handles[2], little_endian_read_16(packet, 11));
+    CHECK_EQUAL(0x33, packet[15]);
+
+    att_server_notification_counters_t counters;
+    uint8_t status = att_server_get_notification_counters(att_con_handle, &counters);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(3, counters.notifications_queued);
+    CHECK_EQUAL(0, counters.notifications_rejected);
+    CHECK_EQUAL(1, counters.pdus_sent);
+    CHECK_EQUAL(2, counters.pdus_saved);
+}
+
+TEST(ATT_SERVER_NOTIFICATION_COALESCING, split_at_mtu){
+    enable_multiple_notifications();
+    // ATT_MTU 23 fits three 1-byte values per PDU
+    int i;
+    for (i = 0; i < 5; i++){
+        notify(value_handles[i % 3], (uint8_t) i);
+    }
+    mock_process_main_thread_callbacks();
+    CHECK_EQUAL(2, mock_get_packets_sent());
+
+    uint16_t packet_len;
+    const uint8_t * packet = mock_get_last_packet(&packet_len);
+    CHECK_EQUAL(ATT_MULTIPLE_HANDLE_VALUE_NTF, packet[0]);
+    CHECK_EQUAL(1 + 2 * 5, packet_len);
+    CHECK_EQUAL(4, packet[10]);
+}
+
+TEST(ATT_SERVER_NOTIFICATION_COALESCING, client_without_support){
+    notify(value_handles[0], 0x11);
+    notify(value_handles[1], 0x22);
+    mock_process_main_thread_callbacks();
+    CHECK_EQUAL(2, mock_get_packets_sent());
+
+    uint16_t packet_len;
+    const uint8_t * packet = mock_get_last_packet(&packet_len);
+    CHECK_EQUAL(4, packet_len);
+    CHECK_EQUAL(ATT_HANDLE_VALUE_NOTIFICATION, packet[0]);
+    CHECK_EQUAL(value_handles[1], little_endian_read_16(packet, 1));
+    CHECK_EQUAL(0x22, packet[3]);
+
+    att_server_notification_counters_t counters;
+    (void) att_server_get_notification_counters(att_con_handle, &counters);
+    CHECK_EQUAL(2, counters.pdus_sent);
+    CHECK_EQUAL(0, counters.pdus_saved);
+}
+
+TEST(ATT_SERVER_NOTIFICATION_COALESCING, queue_full){
+    const int num_fit = ATT_SERVER_NOTIFICATION_QUEUE_SIZE / 5;
+    uint8_t value = 0;
+    int i;
+    for (i = 0; i < num_fit; i++){
+        notify(value_handles[0], value);
+    }
+    uint8_t status = att_server_notify(att_con_handle, value_handles[0], &value, 1);
+    CHECK_EQUAL(BTSTACK_ACL_BUFFERS_FULL, status);
+
+    att_server_notification_counters_t counters;
+    (void) att_server_get_notification_counters(att_con_handle, &counters);
+    CHECK_EQUAL(num_fit, counters.notifications_queued);
+    CHECK_EQUAL(1, counters.notifications_rejected);
+
+    // queue is drained when L2CAP can send
+    mock_process_main_thread_callbacks();
+    CHECK_EQUAL(num_fit, mock_get_packets_sent());
+    status = att_server_notify(att_con_handle, value_handles[0], &value, 1);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+}
+
+TEST(ATT_SERVER_NOTIFICATION_COALESCING, invalid_connection){
+    uint8_t value = 0;
+    uint8_t status = att_server_notify(0x50, value_handles[0], &value, 1);
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, status);
+    att_server_notification_counters_t counters;
+    status = att_server_get_notification_counters(0x50, &counters);
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, status);
+}
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
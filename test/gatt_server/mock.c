@@ -18,6 +18,7 @@ static btstack_packet_handler_t att_server_packet_handler;
 static void (*registered_hci_event_handler) (uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size) = NULL;
 
 static btstack_linked_list_t     connections;
+static btstack_linked_list_t     main_thread_callbacks;	// executed by mock_process_main_thread_callbacks
 static uint16_t max_mtu = 23;
 static uint8_t  l2cap_stack_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + 8 + ATT_DEFAULT_MTU];	// pre buffer + HCI Header + L2CAP header
 static uint16_t gatt_client_handle = 0x40;
@@ -129,7 +130,16 @@ void hci_deinit(void){
     hci_connection.att_server.ir_le_device_db_index = 0;
     hci_connection.att_server.notification_requests = NULL;
     hci_connection.att_server.indication_requests = NULL;
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+    hci_connection.att_server.multiple_notifications_supported = false;
+    hci_connection.att_server.notification_queue_len = 0;
+    hci_connection.att_server.notifications_queued = 0;
+    hci_connection.att_server.notifications_rejected = 0;
+    hci_connection.att_server.notification_pdus_sent = 0;
+    hci_connection.att_server.notification_pdus_saved = 0;
+#endif
     connections = NULL;
+    main_thread_callbacks = NULL;
 }
 
 void hci_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
@@ -195,7 +205,28 @@ void l2cap_request_can_send_fix_channel_now_event(uint16_t handle, uint16_t chan
     att_server_packet_handler(HCI_EVENT_PACKET, 0, (uint8_t*)event, sizeof(event));
 }
 
+static uint16_t mock_packets_sent;
+static uint8_t  mock_last_packet[sizeof(l2cap_stack_buffer)];
+static uint16_t mock_last_packet_len;
+
+uint16_t mock_get_packets_sent(void){
+    return mock_packets_sent;
+}
+
+const uint8_t * mock_get_last_packet(uint16_t * len){
+    *len = mock_last_packet_len;
+    return mock_last_packet;
+}
+
+void mock_reset_packets_sent(void){
+    mock_packets_sent = 0;
+    mock_last_packet_len = 0;
+}
+
 uint8_t l2cap_send_prepared_connectionless(uint16_t handle, uint16_t cid, uint16_t len){
+    mock_packets_sent++;
+    mock_last_packet_len = btstack_min(len, sizeof(mock_last_packet));
+    (void)memcpy(mock_last_packet, l2cap_get_outgoing_buffer(), mock_last_packet_len);
 	att_connection_t att_connection;
     hci_setup_le_connection(handle);
 	uint8_t response[max_mtu];
@@ -252,6 +283,17 @@ void * btstack_run_loop_get_timer_context(btstack_timer_source_t *ts){
     return ts->context;
 }
 
+void btstack_run_loop_execute_on_main_thread(btstack_context_callback_registration_t * callback_registration){
+    btstack_linked_list_add_tail(&main_thread_callbacks, (btstack_linked_item_t *) callback_registration);
+}
+
+void mock_process_main_thread_callbacks(void){
+    while (btstack_linked_list_empty(&main_thread_callbacks) == false){
+        btstack_context_callback_registration_t * callback_registration = (btstack_context_callback_registration_t *) btstack_linked_list_pop(&main_thread_callbacks);
+        (*callback_registration->callback)(callback_registration->context);
+    }
+}
+
 // todo:
 hci_connection_t * hci_connection_for_bd_addr_and_type(const bd_addr_t addr, bd_addr_type_t addr_type){
 	printf("hci_connection_for_bd_addr_and_type not implemented in mock backend\n");
@@ -0,0 +1,20 @@
+//
+// btstack_config.h for hci_dump_posix_fs test
+//
+
+#ifndef BTSTACK_CONFIG_H
+#define BTSTACK_CONFIG_H
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_FILE_IO
+#define HAVE_POSIX_TIME
+#define HAVE_ZLIB
+
+// BTstack features that can be enabled
+#define ENABLE_LOG_ERROR
+#define ENABLE_LOG_INFO
+#define ENABLE_PRINTF_HEXDUMP
+#define ENABLE_HCI_DUMP_POSIX_FS_ASYNC
+
+#endif
@@ -0,0 +1,179 @@
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "hci_dump.h"
+#include "hci_dump_posix_fs.h"
+#include "btstack_util.h"
+#include "btstack_config.h"
+#include "btstack_debug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_LOG "/tmp/hci_dump_posix_fs_test.pklg"
+
+#define BTSNOOP_FILE_HEADER_SIZE 16
+
+typedef struct {
+    uint32_t len;
+    uint32_t flags;
+    uint32_t cumulative_drops;
+    uint8_t  packet_type;
+    uint8_t  data[2048];
+} btsnoop_record_t;
+
+static uint8_t * log_data;
+static long      log_size;
+
+static void read_log(void){
+    free(log_data);
+    log_data = NULL;
+    FILE * file = fopen(TEST_LOG, "rb");
+    CHECK(file != NULL);
+    fseek(file, 0, SEEK_END);
+    log_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    log_data = (uint8_t *) malloc(log_size);
+    CHECK_EQUAL(log_size, (long) fread(log_data, 1, log_size, file));
+    fclose(file);
+}
+
+// returns offset of next record or 0 if end of log
+static long read_btsnoop_record(long offset, btsnoop_record_t * record){
+    if ((offset + HCI_DUMP_HEADER_SIZE_BTSNOOP) > log_size) return 0;
+    record->len              = big_endian_read_32(log_data, offset + 4) - 1;
+    record->flags            = big_endian_read_32(log_data, offset + 8);
+    record->cumulative_drops = big_endian_read_32(log_data, offset + 12);
+    record->packet_type      = log_data[offset + HCI_DUMP_HEADER_SIZE_BTSNOOP];
+    CHECK(record->len <= sizeof(record->data));
+    memcpy(record->data, &log_data[offset + HCI_DUMP_HEADER_SIZE_BTSNOOP + 1], record->len);
+    return offset + HCI_DUMP_HEADER_SIZE_BTSNOOP + 1 + record->len;
+}
+
+static void log_acl_packet(uint16_t len, uint8_t value){
+    static uint8_t packet[2048];
+    memset(packet, value, len);
+    hci_dump_packet(HCI_ACL_DATA_PACKET, 1, packet, len);
+}
+
+TEST_GROUP(HCI_DUMP_POSIX_FS_ASYNC){
+    void setup(void){
+        unlink(TEST_LOG);
+        hci_dump_init(hci_dump_posix_fs_get_instance());
+    }
+    void teardown(void){
+        hci_dump_init(NULL);
+        free(log_data);
+        log_data = NULL;
+        unlink(TEST_LOG);
+    }
+};
+
+TEST(HCI_DUMP_POSIX_FS_ASYNC, PacketsStoredOnClose){
+    CHECK_EQUAL(0, hci_dump_posix_fs_open_async(TEST_LOG, HCI_DUMP_BTSNOOP, 16384));
+    const uint16_t num_packets = 100;
+    uint16_t i;
+    for (i = 0; i < num_packets; i++){
+        log_acl_packet(27 + (i % 50), (uint8_t) i);
+    }
+    hci_dump_posix_fs_close();
+    CHECK_EQUAL(0u, hci_dump_posix_fs_get_dropped_packets());
+
+    read_log();
+    MEMCMP_EQUAL("btsnoop", log_data, 8);
+    long offset = BTSNOOP_FILE_HEADER_SIZE;
+    btsnoop_record_t record;
+    i = 0;
+    while ((offset = read_btsnoop_record(offset, &record)) != 0){
+        CHECK_EQUAL(HCI_ACL_DATA_PACKET, record.packet_type);
+        CHECK_EQUAL(27 + (i % 50), record.len);
+        CHECK_EQUAL(1, record.flags);
+        CHECK_EQUAL(0, record.cumulative_drops);
+        CHECK_EQUAL((uint8_t) i, record.data[0]);
+        CHECK_EQUAL((uint8_t) i, record.data[record.len - 1]);
+        i++;
+    }
+    CHECK_EQUAL(num_packets, i);
+}
+
+TEST(HCI_DUMP_POSIX_FS_ASYNC, DroppedPacketsInCumulativeDrops){
+    // packets larger than the ring buffer are always dropped
+    CHECK_EQUAL(0, hci_dump_posix_fs_open_async(TEST_LOG, HCI_DUMP_BTSNOOP, 1024));
+    log_acl_packet(100, 1);
+    log_acl_packet(1500, 2);
+    log_acl_packet(100, 3);
+    log_acl_packet(1500, 4);
+    log_acl_packet(1500, 5);
+    log_acl_packet(100, 6);
+    CHECK_EQUAL(3u, hci_dump_posix_fs_get_dropped_packets());
+    hci_dump_posix_fs_close();
+
+    read_log();
+    const uint8_t  expected_values[] = { 1, 3, 6 };
+    const uint32_t expected_drops[]  = { 0, 1, 3 };
+    long offset = BTSNOOP_FILE_HEADER_SIZE;
+    btsnoop_record_t record;
+    uint16_t i = 0;
+    while ((offset = read_btsnoop_record(offset, &record)) != 0){
+        CHECK(i < sizeof(expected_values));
+        CHECK_EQUAL(expected_values[i], record.data[0]);
+        CHECK_EQUAL(expected_drops[i], record.cumulative_drops);
+        i++;
+    }
+    CHECK_EQUAL(3, i);
+}
+
+TEST(HCI_DUMP_POSIX_FS_ASYNC, RingBufferWrapAround){
+    // more data than fits into the ring buffer, packets are written while logging continues
+    CHECK_EQUAL(0, hci_dump_posix_fs_open_async(TEST_LOG, HCI_DUMP_PACKETLOGGER, 8192));
+    const uint16_t num_packets = 500;
+    uint16_t i;
+    for (i = 0; i < num_packets; i++){
+        log_acl_packet(200, (uint8_t) i);
+        if (hci_dump_posix_fs_get_dropped_packets() > 0) break;
+        if ((i % 20) == 19){
+            // give writer thread time to catch up
+            usleep(2000);
+        }
+    }
+    hci_dump_posix_fs_close();
+    uint32_t dropped_packets = hci_dump_posix_fs_get_dropped_packets();
+
+    read_log();
+    const long record_size = HCI_DUMP_HEADER_SIZE_PACKETLOGGER + 200;
+    if (dropped_packets == 0){
+        CHECK_EQUAL(num_packets * record_size, log_size);
+    }
+    long offset;
+    uint16_t stored_packets = (uint16_t) (log_size / record_size);
+    for (i = 0; i < stored_packets; i++){
+        offset = i * record_size;
+        CHECK_EQUAL(HCI_DUMP_HEADER_SIZE_PACKETLOGGER - 4 + 200, big_endian_read_32(log_data, offset));
+        CHECK_EQUAL((uint8_t) i, log_data[offset + HCI_DUMP_HEADER_SIZE_PACKETLOGGER]);
+        CHECK_EQUAL((uint8_t) i, log_data[offset + record_size - 1]);
+    }
+}
+
+TEST(HCI_DUMP_POSIX_FS_ASYNC, Reset){
+    CHECK_EQUAL(0, hci_dump_posix_fs_open_async(TEST_LOG, HCI_DUMP_PACKETLOGGER, 4096));
+    hci_dump_set_max_packets(5);
+    uint16_t i;
+    for (i = 0; i < 7; i++){
+        log_acl_packet(10, (uint8_t) i);
+    }
+    hci_dump_posix_fs_close();
+
+    // file was truncated after 5 packets
+    read_log();
+    const long record_size = HCI_DUMP_HEADER_SIZE_PACKETLOGGER + 10;
+    CHECK_EQUAL(2 * record_size, log_size);
+    CHECK_EQUAL(5, log_data[HCI_DUMP_HEADER_SIZE_PACKETLOGGER]);
+    CHECK_EQUAL(6, log_data[record_size + HCI_DUMP_HEADER_SIZE_PACKETLOGGER]);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
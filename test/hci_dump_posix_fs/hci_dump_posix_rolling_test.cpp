@@ -0,0 +1,219 @@
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "hci_dump.h"
+#include "hci_dump_posix_rolling.h"
+#include "btstack_util.h"
+#include "btstack_config.h"
+#include "btstack_debug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define TEST_LOG     "/tmp/hci_dump_posix_rolling_test.btsnoop"
+#define TEST_HISTORY "/tmp/hci_dump_posix_rolling_test_history.btsnoop"
+
+#define BTSNOOP_FILE_HEADER_SIZE 16
+#define PACKET_LEN               100
+#define RECORD_LEN               (HCI_DUMP_HEADER_SIZE_BTSNOOP + 1 + PACKET_LEN)
+
+static uint8_t file_data[16384];
+
+static char * file_name(uint16_t index, const char * suffix){
+    static char path[100];
+    if (index == 0){
+        snprintf(path, sizeof(path), "%s", TEST_LOG);
+    } else {
+        snprintf(path, sizeof(path), "%s.%u%s", TEST_LOG, index, suffix);
+    }
+    return path;
+}
+
+static long read_file(const char * path){
+    FILE * file = fopen(path, "rb");
+    if (file == NULL) return -1;
+    long size = (long) fread(file_data, 1, sizeof(file_data), file);
+    fclose(file);
+    return size;
+}
+
+static long read_gz_file(const char * path){
+    gzFile file = gzopen(path, "rb");
+    if (file == NULL) return -1;
+    long size = gzread(file, file_data, sizeof(file_data));
+    gzclose(file);
+    return size;
+}
+
+static void remove_files(void){
+    uint16_t i;
+    for (i = 0; i < 5; i++){
+        unlink(file_name(i, ""));
+        unlink(file_name(i, ".gz"));
+    }
+    unlink(TEST_HISTORY);
+    rmdir(file_name(1, ""));
+    rmdir(TEST_LOG ".gz.tmp");
+}
+
+static void log_acl_packet(uint8_t value){
+    uint8_t packet[PACKET_LEN];
+    memset(packet, value, sizeof(packet));
+    hci_dump_packet(HCI_ACL_DATA_PACKET, 1, packet, sizeof(packet));
+}
+
+// check file contains btsnoop header and packets with consecutive values starting with first_value
+static void check_btsnoop_file(long size, uint16_t num_packets, uint8_t first_value){
+    CHECK_EQUAL(BTSNOOP_FILE_HEADER_SIZE + num_packets * RECORD_LEN, size);
+    MEMCMP_EQUAL("btsnoop", file_data, 8);
+    uint16_t i;
+    for (i = 0; i < num_packets; i++){
+        long offset = BTSNOOP_FILE_HEADER_SIZE + i * RECORD_LEN;
+        CHECK_EQUAL(PACKET_LEN + 1, big_endian_read_32(file_data, offset));
+        CHECK_EQUAL((uint8_t)(first_value + i), file_data[offset + RECORD_LEN - 1]);
+    }
+}
+
+TEST_GROUP(HCI_DUMP_POSIX_ROLLING){
+    hci_dump_posix_rolling_config_t config;
+    void setup(void){
+        remove_files();
+        memset(&config, 0, sizeof(config));
+        config.path = TEST_LOG;
+        config.format = HCI_DUMP_BTSNOOP;
+        config.max_file_size = BTSNOOP_FILE_HEADER_SIZE + 3 * RECORD_LEN;
+        config.num_files = 3;
+        hci_dump_init(hci_dump_posix_rolling_get_instance());
+    }
+    void teardown(void){
+        hci_dump_posix_rolling_close();
+        hci_dump_init(NULL);
+        remove_files();
+    }
+};
+
+TEST(HCI_DUMP_POSIX_ROLLING, NoRotation){
+    CHECK_EQUAL(0, hci_dump_posix_rolling_open(&config));
+    uint8_t i;
+    for (i = 0; i < 3; i++){
+        log_acl_packet(i);
+    }
+    hci_dump_posix_rolling_close();
+    check_btsnoop_file(read_file(TEST_LOG), 3, 0);
+    CHECK_EQUAL(-1, read_file(file_name(1, "")));
+}
+
+TEST(HCI_DUMP_POSIX_ROLLING, RotateAndDropOldest){
+    CHECK_EQUAL(0, hci_dump_posix_rolling_open(&config));
+    uint8_t i;
+    for (i = 0; i < 11; i++){
+        log_acl_packet(i);
+    }
+    hci_dump_posix_rolling_close();
+
+    // packets 0..2 in dropped file, 3..5 in .2, 6..8 in .1, 9..10 in current file
+    check_btsnoop_file(read_file(TEST_LOG), 2, 9);
+    check_btsnoop_file(read_file(file_name(1, "")), 3, 6);
+    check_btsnoop_file(read_file(file_name(2, "")), 3, 3);
+    CHECK_EQUAL(-1, read_file(file_name(3, "")));
+}
+
+TEST(HCI_DUMP_POSIX_ROLLING, CompressRotatedFiles){
+    config.compress = true;
+    CHECK_EQUAL(0, hci_dump_posix_rolling_open(&config));
+    uint8_t i;
+    for (i = 0; i < 7; i++){
+        log_acl_packet(i);
+    }
+    hci_dump_posix_rolling_close();
+
+    check_btsnoop_file(read_file(TEST_LOG), 1, 6);
+    CHECK_EQUAL(-1, read_file(file_name(1, "")));
+    check_btsnoop_file(read_gz_file(file_name(1, ".gz")), 3, 3);
+    check_btsnoop_file(read_gz_file(file_name(2, ".gz")), 3, 0);
+}
+
+TEST(HCI_DUMP_POSIX_ROLLING, KeepUncompressedFileIfCompressionFails){
+    // temp file for compression cannot be created
+    CHECK_EQUAL(0, mkdir(TEST_LOG ".gz.tmp", 0700));
+    config.compress = true;
+    CHECK_EQUAL(0, hci_dump_posix_rolling_open(&config));
+    uint8_t i;
+    for (i = 0; i < 4; i++){
+        log_acl_packet(i);
+    }
+    hci_dump_posix_rolling_close();
+
+    check_btsnoop_file(read_file(TEST_LOG), 1, 3);
+    check_btsnoop_file(read_file(file_name(1, "")), 3, 0);
+    CHECK_EQUAL(-1, read_gz_file(file_name(1, ".gz")));
+}
+
+TEST(HCI_DUMP_POSIX_ROLLING, KeepCurrentFileIfRenameFails){
+    // current file cannot be renamed to .1
+    CHECK_EQUAL(0, mkdir(file_name(1, ""), 0700));
+    config.num_files = 2;
+    CHECK_EQUAL(0, hci_dump_posix_rolling_open(&config));
+    uint8_t i;
+    for (i = 0; i < 4; i++){
+        log_acl_packet(i);
+    }
+    hci_dump_posix_rolling_close();
+
+    check_btsnoop_file(read_file(TEST_LOG), 4, 0);
+}
+
+TEST(HCI_DUMP_POSIX_ROLLING, ExplicitRotate){
+    CHECK_EQUAL(0, hci_dump_posix_rolling_open(&config));
+    log_acl_packet(0);
+    CHECK_EQUAL(0, hci_dump_posix_rolling_rotate());
+    log_acl_packet(1);
+    hci_dump_posix_rolling_close();
+
+    check_btsnoop_file(read_file(TEST_LOG), 1, 1);
+    check_btsnoop_file(read_file(file_name(1, "")), 1, 0);
+}
+
+TEST(HCI_DUMP_POSIX_ROLLING, SaveHistory){
+    // history keeps last 4 packets
+    config.history_duration_ms = 60000;
+    config.history_buffer_size = 4 * (8 + RECORD_LEN) + 10;
+    CHECK_EQUAL(0, hci_dump_posix_rolling_open(&config));
+    uint8_t i;
+    for (i = 0; i < 10; i++){
+        log_acl_packet(i);
+    }
+    CHECK_EQUAL(0, hci_dump_posix_rolling_save_history(TEST_HISTORY));
+    check_btsnoop_file(read_file(TEST_HISTORY), 4, 6);
+
+    // history is kept after save
+    log_acl_packet(10);
+    CHECK_EQUAL(0, hci_dump_posix_rolling_save_history(TEST_HISTORY));
+    check_btsnoop_file(read_file(TEST_HISTORY), 4, 7);
+}
+
+TEST(HCI_DUMP_POSIX_ROLLING, HistoryDuration){
+    config.history_duration_ms = 50;
+    config.history_buffer_size = 8192;
+    CHECK_EQUAL(0, hci_dump_posix_rolling_open(&config));
+    log_acl_packet(0);
+    log_acl_packet(1);
+    usleep(100000);
+    log_acl_packet(2);
+    CHECK_EQUAL(0, hci_dump_posix_rolling_save_history(TEST_HISTORY));
+    check_btsnoop_file(read_file(TEST_HISTORY), 1, 2);
+}
+
+TEST(HCI_DUMP_POSIX_ROLLING, NoHistory){
+    CHECK_EQUAL(0, hci_dump_posix_rolling_open(&config));
+    CHECK(hci_dump_posix_rolling_save_history(TEST_HISTORY) != 0);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
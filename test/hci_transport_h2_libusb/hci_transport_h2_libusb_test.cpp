@@ -0,0 +1,471 @@
+// Test endpoint counters of the libusb HCI Transport with a fake libusb that keeps submitted transfers for the test
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include <libusb.h>
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+#include "hci_transport_usb.h"
+#include "hci_transport_h2_libusb.h"
+
+#define MAX_TRANSFERS 32
+
+// fake USB Bluetooth Controller with HCI Event, ACL In and ACL Out endpoints
+static const struct libusb_endpoint_descriptor fake_endpoints[] = {
+    { 0x81, LIBUSB_TRANSFER_TYPE_INTERRUPT, 16 },
+    { 0x82, LIBUSB_TRANSFER_TYPE_BULK,      64 },
+    { 0x02, LIBUSB_TRANSFER_TYPE_BULK,      64 },
+};
+static const struct libusb_interface_descriptor fake_interface_descriptor = { 3, fake_endpoints };
+static const struct libusb_interface fake_interface = { &fake_interface_descriptor, 1 };
+static struct libusb_config_descriptor fake_config_descriptor = { 1, &fake_interface };
+
+static int fake_device;
+static int fake_device_handle;
+static libusb_device * fake_device_list[] = { (libusb_device *) &fake_device, NULL };
+
+// transfers submitted and not completed yet
+static struct libusb_transfer * submitted_transfers[MAX_TRANSFERS];
+static int num_submitted_transfers;
+static struct libusb_transfer * cancelled_transfers[MAX_TRANSFERS];
+static int num_cancelled_transfers;
+static int submit_error;
+
+static void remove_submitted_transfer(struct libusb_transfer * transfer){
+    int i;
+    for (i = 0; i < num_submitted_transfers; i++){
+        if (submitted_transfers[i] != transfer) continue;
+        submitted_transfers[i] = submitted_transfers[--num_submitted_transfers];
+        return;
+    }
+}
+
+int libusb_init(libusb_context **ctx){
+    UNUSED(ctx);
+    return 0;
+}
+
+void libusb_exit(libusb_context *ctx){
+    UNUSED(ctx);
+}
+
+int libusb_set_option(libusb_context *ctx, enum libusb_option option, ...){
+    UNUSED(ctx);
+    UNUSED(option);
+    return 0;
+}
+
+const char * libusb_error_name(int error_code){
+    UNUSED(error_code);
+    return "LIBUSB_ERROR";
+}
+
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list){
+    UNUSED(ctx);
+    *list = fake_device_list;
+    return 1;
+}
+
+void libusb_free_device_list(libusb_device **list, int unref_devices){
+    UNUSED(list);
+    UNUSED(unref_devices);
+}
+
+int libusb_get_device_descriptor(libusb_device *dev, struct libusb_device_descriptor *desc){
+    UNUSED(dev);
+    memset(desc, 0, sizeof(struct libusb_device_descriptor));
+    desc->bDeviceClass = 0xE0;
+    desc->bDeviceSubClass = 0x01;
+    desc->bDeviceProtocol = 0x01;
+    desc->idVendor = 0x1234;
+    desc->idProduct = 0x5678;
+    return 0;
+}
+
+int libusb_get_active_config_descriptor(libusb_device *dev, struct libusb_config_descriptor **config){
+    UNUSED(dev);
+    *config = &fake_config_descriptor;
+    return 0;
+}
+
+void libusb_free_config_descriptor(struct libusb_config_descriptor *config){
+    UNUSED(config);
+}
+
+uint8_t libusb_get_bus_number(libusb_device *dev){
+    UNUSED(dev);
+    return 1;
+}
+
+uint8_t libusb_get_device_address(libusb_device *dev){
+    UNUSED(dev);
+    return 2;
+}
+
+int libusb_get_port_numbers(libusb_device *dev, uint8_t *port_numbers, int port_numbers_len){
+    UNUSED(dev);
+    UNUSED(port_numbers_len);
+    port_numbers[0] = 1;
+    return 1;
+}
+
+int libusb_open(libusb_device *dev, libusb_device_handle **dev_handle){
+    UNUSED(dev);
+    *dev_handle = (libusb_device_handle *) &fake_device_handle;
+    return 0;
+}
+
+libusb_device_handle * libusb_open_device_with_vid_pid(libusb_context *ctx, uint16_t vendor_id, uint16_t product_id){
+    UNUSED(ctx);
+    UNUSED(vendor_id);
+    UNUSED(product_id);
+    return (libusb_device_handle *) &fake_device_handle;
+}
+
+void libusb_close(libusb_device_handle *dev_handle){
+    UNUSED(dev_handle);
+}
+
+libusb_device * libusb_get_device(libusb_device_handle *dev_handle){
+    UNUSED(dev_handle);
+    return (libusb_device *) &fake_device;
+}
+
+int libusb_reset_device(libusb_device_handle *dev_handle){
+    UNUSED(dev_handle);
+    return 0;
+}
+
+int libusb_kernel_driver_active(libusb_device_handle *dev_handle, int interface_number){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    return 0;
+}
+
+int libusb_detach_kernel_driver(libusb_device_handle *dev_handle, int interface_number){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    return 0;
+}
+
+int libusb_attach_kernel_driver(libusb_device_handle *dev_handle, int interface_number){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    return 0;
+}
+
+int libusb_set_configuration(libusb_device_handle *dev_handle, int configuration){
+    UNUSED(dev_handle);
+    UNUSED(configuration);
+    return 0;
+}
+
+int libusb_claim_interface(libusb_device_handle *dev_handle, int interface_number){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    return 0;
+}
+
+int libusb_release_interface(libusb_device_handle *dev_handle, int interface_number){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    return 0;
+}
+
+int libusb_set_interface_alt_setting(libusb_device_handle *dev_handle, int interface_number, int alternate_setting){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    UNUSED(alternate_setting);
+    return 0;
+}
+
+int libusb_clear_halt(libusb_device_handle *dev_handle, unsigned char endpoint){
+    UNUSED(dev_handle);
+    UNUSED(endpoint);
+    return 0;
+}
+
+struct libusb_transfer * libusb_alloc_transfer(int iso_packets){
+    struct libusb_transfer * transfer = (struct libusb_transfer *) calloc(1, sizeof(struct libusb_transfer) + iso_packets * sizeof(struct libusb_iso_packet_descriptor));
+    transfer->num_iso_packets = iso_packets;
+    return transfer;
+}
+
+void libusb_free_transfer(struct libusb_transfer *transfer){
+    free(transfer);
+}
+
+int libusb_submit_transfer(struct libusb_transfer *transfer){
+    if (submit_error != 0){
+        int r = submit_error;
+        submit_error = 0;
+        return r;
+    }
+    CHECK(num_submitted_transfers < MAX_TRANSFERS);
+    submitted_transfers[num_submitted_transfers++] = transfer;
+    return 0;
+}
+
+// cancelled transfers are reported by the next libusb_handle_events_timeout call
+int libusb_cancel_transfer(struct libusb_transfer *transfer){
+    remove_submitted_transfer(transfer);
+    CHECK(num_cancelled_transfers < MAX_TRANSFERS);
+    cancelled_transfers[num_cancelled_transfers++] = transfer;
+    return 0;
+}
+
+int libusb_handle_events_timeout(libusb_context *ctx, struct timeval *tv){
+    UNUSED(ctx);
+    UNUSED(tv);
+    while (num_cancelled_transfers > 0){
+        struct libusb_transfer * transfer = cancelled_transfers[--num_cancelled_transfers];
+        transfer->status = LIBUSB_TRANSFER_CANCELLED;
+        (*transfer->callback)(transfer);
+    }
+    return 0;
+}
+
+int libusb_handle_events_timeout_completed(libusb_context *ctx, struct timeval *tv, int *completed){
+    UNUSED(completed);
+    return libusb_handle_events_timeout(ctx, tv);
+}
+
+// use polling timer in transport
+int libusb_pollfds_handle_timeouts(libusb_context *ctx){
+    UNUSED(ctx);
+    return 0;
+}
+
+void libusb_set_pollfd_notifiers(libusb_context *ctx, libusb_pollfd_added_cb added_cb, libusb_pollfd_removed_cb removed_cb, void *user_data){
+    UNUSED(ctx);
+    UNUSED(added_cb);
+    UNUSED(removed_cb);
+    UNUSED(user_data);
+}
+
+const struct libusb_pollfd ** libusb_get_pollfds(libusb_context *ctx){
+    UNUSED(ctx);
+    return NULL;
+}
+
+void libusb_free_pollfds(const struct libusb_pollfd **pollfds){
+    UNUSED(pollfds);
+}
+
+static const hci_transport_t * transport;
+static btstack_timer_source_t timeout_timer;
+static int num_events_received;
+static int num_acl_packets_received;
+
+static void packet_handler(uint8_t packet_type, uint8_t *packet, uint16_t size){
+    UNUSED(size);
+    switch (packet_type){
+        case HCI_EVENT_PACKET:
+            // ignore events generated by the transport itself
+            if (packet[0] == HCI_EVENT_TRANSPORT_USB_INFO) return;
+            if (packet[0] == HCI_EVENT_TRANSPORT_PACKET_SENT) return;
+            num_events_received++;
+            break;
+        case HCI_ACL_DATA_PACKET:
+            num_acl_packets_received++;
+            break;
+        default:
+            return;
+    }
+    btstack_run_loop_trigger_exit();
+}
+
+static void timeout_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    btstack_run_loop_trigger_exit();
+}
+
+// completed transfers are handled by the transport from its polling timer
+static void run_loop_process(void){
+    btstack_run_loop_set_timer_handler(&timeout_timer, &timeout_handler);
+    btstack_run_loop_set_timer(&timeout_timer, 100);
+    btstack_run_loop_add_timer(&timeout_timer);
+    btstack_run_loop_execute();
+    btstack_run_loop_remove_timer(&timeout_timer);
+}
+
+static int num_submitted_for_endpoint(uint8_t endpoint){
+    int count = 0;
+    int i;
+    for (i = 0; i < num_submitted_transfers; i++){
+        if (submitted_transfers[i]->endpoint == endpoint){
+            count++;
+        }
+    }
+    return count;
+}
+
+// complete oldest submitted transfer for endpoint
+static void complete_transfer(uint8_t endpoint, enum libusb_transfer_status status, const uint8_t * data, int len){
+    int i;
+    for (i = 0; i < num_submitted_transfers; i++){
+        struct libusb_transfer * transfer = submitted_transfers[i];
+        if (transfer->endpoint != endpoint) continue;
+        memmove(&submitted_transfers[i], &submitted_transfers[i+1], (num_submitted_transfers - i - 1) * sizeof(struct libusb_transfer *));
+        num_submitted_transfers--;
+        if (data != NULL){
+            memcpy(transfer->buffer, data, len);
+        }
+        transfer->actual_length = len;
+        transfer->status = status;
+        (*transfer->callback)(transfer);
+        return;
+    }
+    FAIL("no transfer submitted for endpoint");
+}
+
+static hci_transport_usb_endpoint_counters_t get_counters(hci_transport_usb_endpoint_t endpoint){
+    hci_transport_usb_endpoint_counters_t counters;
+    hci_transport_usb_get_endpoint_counters(endpoint, &counters);
+    return counters;
+}
+
+static const uint8_t hci_event_command_status[] = { 0x0f, 0x04, 0x00, 0x01, 0x03, 0x0c };
+static const uint8_t hci_acl_packet[] = { 0x01, 0x20, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00 };
+static const uint8_t hci_command_reset[] = { 0x03, 0x0c, 0x00 };
+
+TEST_GROUP(HCI_TRANSPORT_H2_LIBUSB){
+    void setup(void){
+        num_submitted_transfers = 0;
+        num_cancelled_transfers = 0;
+        submit_error = 0;
+        num_events_received = 0;
+        num_acl_packets_received = 0;
+        btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+        hci_transport_usb_set_event_in_transfers(2);
+        hci_transport_usb_set_acl_in_transfers(4, 0);
+        transport = hci_transport_usb_instance();
+        transport->register_packet_handler(&packet_handler);
+        CHECK_EQUAL(0, transport->open());
+    }
+
+    void teardown(void){
+        transport->close();
+        CHECK_EQUAL(0, num_submitted_transfers);
+        btstack_run_loop_deinit();
+    }
+};
+
+TEST(HCI_TRANSPORT_H2_LIBUSB, OpenSubmitsInTransfers){
+    hci_transport_usb_endpoint_counters_t counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_EVENT_IN);
+    CHECK_EQUAL(2, counters.submitted);
+    CHECK_EQUAL(2, counters.in_flight);
+    CHECK_EQUAL(0, counters.completed);
+    CHECK_EQUAL(UINT16_MAX, counters.min_in_flight);
+    CHECK_EQUAL(2, num_submitted_for_endpoint(0x81));
+
+    counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_ACL_IN);
+    CHECK_EQUAL(4, counters.submitted);
+    CHECK_EQUAL(4, counters.in_flight);
+    CHECK_EQUAL(4, num_submitted_for_endpoint(0x82));
+
+    counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_COMMAND_OUT);
+    CHECK_EQUAL(0, counters.submitted);
+    counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_ACL_OUT);
+    CHECK_EQUAL(0, counters.submitted);
+}
+
+TEST(HCI_TRANSPORT_H2_LIBUSB, CompletedInTransferIsResubmitted){
+    complete_transfer(0x81, LIBUSB_TRANSFER_COMPLETED, hci_event_command_status, sizeof(hci_event_command_status));
+    hci_transport_usb_endpoint_counters_t counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_EVENT_IN);
+    CHECK_EQUAL(1, counters.completed);
+    CHECK_EQUAL(1, counters.in_flight);
+    CHECK_EQUAL(1, counters.min_in_flight);
+
+    run_loop_process();
+    CHECK_EQUAL(1, num_events_received);
+    counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_EVENT_IN);
+    CHECK_EQUAL(3, counters.submitted);
+    CHECK_EQUAL(2, counters.in_flight);
+    CHECK_EQUAL(1, counters.min_in_flight);
+
+    // two ACL packets before the transport resubmits, min in flight tracks the lowest level
+    complete_transfer(0x82, LIBUSB_TRANSFER_COMPLETED, hci_acl_packet, sizeof(hci_acl_packet));
+    complete_transfer(0x82, LIBUSB_TRANSFER_COMPLETED, hci_acl_packet, sizeof(hci_acl_packet));
+    counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_ACL_IN);
+    CHECK_EQUAL(2, counters.completed);
+    CHECK_EQUAL(2, counters.in_flight);
+    CHECK_EQUAL(2, counters.min_in_flight);
+    run_loop_process();
+    CHECK_EQUAL(2, num_acl_packets_received);
+    counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_ACL_IN);
+    CHECK_EQUAL(6, counters.submitted);
+    CHECK_EQUAL(4, counters.in_flight);
+    CHECK_EQUAL(4, num_submitted_for_endpoint(0x82));
+}
+
+TEST(HCI_TRANSPORT_H2_LIBUSB, StallAndErrorAreCounted){
+    complete_transfer(0x82, LIBUSB_TRANSFER_STALL, NULL, 0);
+    hci_transport_usb_endpoint_counters_t counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_ACL_IN);
+    CHECK_EQUAL(1, counters.stalls);
+    CHECK_EQUAL(0, counters.errors);
+    CHECK_EQUAL(0, counters.completed);
+    CHECK_EQUAL(5, counters.submitted);
+    CHECK_EQUAL(4, counters.in_flight);
+    CHECK_EQUAL(UINT16_MAX, counters.min_in_flight);
+
+    complete_transfer(0x82, LIBUSB_TRANSFER_ERROR, NULL, 0);
+    counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_ACL_IN);
+    CHECK_EQUAL(1, counters.stalls);
+    CHECK_EQUAL(1, counters.errors);
+    CHECK_EQUAL(6, counters.submitted);
+    CHECK_EQUAL(4, counters.in_flight);
+    CHECK_EQUAL(4, num_submitted_for_endpoint(0x82));
+}
+
+TEST(HCI_TRANSPORT_H2_LIBUSB, OutTransfersAreCounted){
+    CHECK_EQUAL(0, transport->send_packet(HCI_COMMAND_DATA_PACKET, (uint8_t *) hci_command_reset, sizeof(hci_command_reset)));
+    hci_transport_usb_endpoint_counters_t counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_COMMAND_OUT);
+    CHECK_EQUAL(1, counters.submitted);
+    CHECK_EQUAL(1, counters.in_flight);
+    complete_transfer(0x00, LIBUSB_TRANSFER_COMPLETED, NULL, sizeof(hci_command_reset));
+    counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_COMMAND_OUT);
+    CHECK_EQUAL(1, counters.completed);
+    CHECK_EQUAL(0, counters.in_flight);
+
+    CHECK_EQUAL(0, transport->send_packet(HCI_ACL_DATA_PACKET, (uint8_t *) hci_acl_packet, sizeof(hci_acl_packet)));
+    counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_ACL_OUT);
+    CHECK_EQUAL(1, counters.submitted);
+    CHECK_EQUAL(1, counters.in_flight);
+}
+
+TEST(HCI_TRANSPORT_H2_LIBUSB, SubmitErrorIsCounted){
+    submit_error = LIBUSB_ERROR_IO;
+    CHECK_EQUAL(-1, transport->send_packet(HCI_COMMAND_DATA_PACKET, (uint8_t *) hci_command_reset, sizeof(hci_command_reset)));
+    hci_transport_usb_endpoint_counters_t counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_COMMAND_OUT);
+    CHECK_EQUAL(0, counters.submitted);
+    CHECK_EQUAL(1, counters.errors);
+    CHECK_EQUAL(0, counters.in_flight);
+}
+
+TEST(HCI_TRANSPORT_H2_LIBUSB, CountersResetOnOpen){
+    complete_transfer(0x81, LIBUSB_TRANSFER_ERROR, NULL, 0);
+    CHECK_EQUAL(1, get_counters(HCI_TRANSPORT_USB_ENDPOINT_EVENT_IN).errors);
+    transport->close();
+    CHECK_EQUAL(0, num_submitted_transfers);
+    CHECK_EQUAL(0, transport->open());
+    hci_transport_usb_endpoint_counters_t counters = get_counters(HCI_TRANSPORT_USB_ENDPOINT_EVENT_IN);
+    CHECK_EQUAL(0, counters.errors);
+    CHECK_EQUAL(2, counters.submitted);
+    CHECK_EQUAL(2, counters.in_flight);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,214 @@
+//
+// Minimal libusb API used by hci_transport_h2_libusb.c, implemented by the test
+//
+
+#ifndef LIBUSB_H
+#define LIBUSB_H
+
+#include <stdint.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#define LIBUSB_API_VERSION 0x01000109
+#define LIBUSB_CALL
+
+#define LIBUSB_CONTROL_SETUP_SIZE 8
+
+enum libusb_transfer_type {
+    LIBUSB_TRANSFER_TYPE_CONTROL = 0,
+    LIBUSB_TRANSFER_TYPE_ISOCHRONOUS = 1,
+    LIBUSB_TRANSFER_TYPE_BULK = 2,
+    LIBUSB_TRANSFER_TYPE_INTERRUPT = 3,
+};
+
+enum libusb_transfer_status {
+    LIBUSB_TRANSFER_COMPLETED,
+    LIBUSB_TRANSFER_ERROR,
+    LIBUSB_TRANSFER_TIMED_OUT,
+    LIBUSB_TRANSFER_CANCELLED,
+    LIBUSB_TRANSFER_STALL,
+    LIBUSB_TRANSFER_NO_DEVICE,
+    LIBUSB_TRANSFER_OVERFLOW,
+};
+
+enum libusb_request_type {
+    LIBUSB_REQUEST_TYPE_CLASS = (0x01 << 5),
+};
+
+enum libusb_request_recipient {
+    LIBUSB_RECIPIENT_INTERFACE = 0x01,
+};
+
+enum libusb_log_level {
+    LIBUSB_LOG_LEVEL_NONE = 0,
+    LIBUSB_LOG_LEVEL_ERROR,
+    LIBUSB_LOG_LEVEL_WARNING,
+};
+
+enum libusb_option {
+    LIBUSB_OPTION_LOG_LEVEL = 0,
+};
+
+enum libusb_error {
+    LIBUSB_SUCCESS = 0,
+    LIBUSB_ERROR_IO = -1,
+    LIBUSB_ERROR_NO_DEVICE = -4,
+    LIBUSB_ERROR_NOT_FOUND = -5,
+};
+
+typedef struct libusb_context libusb_context;
+typedef struct libusb_device libusb_device;
+typedef struct libusb_device_handle libusb_device_handle;
+
+struct libusb_device_descriptor {
+    uint8_t  bDeviceClass;
+    uint8_t  bDeviceSubClass;
+    uint8_t  bDeviceProtocol;
+    uint16_t idVendor;
+    uint16_t idProduct;
+};
+
+struct libusb_endpoint_descriptor {
+    uint8_t  bEndpointAddress;
+    uint8_t  bmAttributes;
+    uint16_t wMaxPacketSize;
+};
+
+struct libusb_interface_descriptor {
+    uint8_t bNumEndpoints;
+    const struct libusb_endpoint_descriptor * endpoint;
+};
+
+struct libusb_interface {
+    const struct libusb_interface_descriptor * altsetting;
+    int num_altsetting;
+};
+
+struct libusb_config_descriptor {
+    uint8_t bNumInterfaces;
+    const struct libusb_interface * interface;
+};
+
+struct libusb_pollfd {
+    int   fd;
+    short events;
+};
+
+struct libusb_iso_packet_descriptor {
+    unsigned int length;
+    unsigned int actual_length;
+    enum libusb_transfer_status status;
+};
+
+struct libusb_transfer;
+typedef void (LIBUSB_CALL *libusb_transfer_cb_fn)(struct libusb_transfer *transfer);
+
+struct libusb_transfer {
+    libusb_device_handle * dev_handle;
+    uint8_t flags;
+    unsigned char endpoint;
+    unsigned char type;
+    unsigned int timeout;
+    enum libusb_transfer_status status;
+    int length;
+    int actual_length;
+    libusb_transfer_cb_fn callback;
+    void * user_data;
+    unsigned char * buffer;
+    int num_iso_packets;
+    struct libusb_iso_packet_descriptor iso_packet_desc[0];
+};
+
+typedef void (LIBUSB_CALL *libusb_pollfd_added_cb)(int fd, short events, void *user_data);
+typedef void (LIBUSB_CALL *libusb_pollfd_removed_cb)(int fd, void *user_data);
+
+int  libusb_init(libusb_context **ctx);
+void libusb_exit(libusb_context *ctx);
+int  libusb_set_option(libusb_context *ctx, enum libusb_option option, ...);
+const char * libusb_error_name(int error_code);
+
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list);
+void libusb_free_device_list(libusb_device **list, int unref_devices);
+int  libusb_get_device_descriptor(libusb_device *dev, struct libusb_device_descriptor *desc);
+int  libusb_get_active_config_descriptor(libusb_device *dev, struct libusb_config_descriptor **config);
+void libusb_free_config_descriptor(struct libusb_config_descriptor *config);
+uint8_t libusb_get_bus_number(libusb_device *dev);
+uint8_t libusb_get_device_address(libusb_device *dev);
+int  libusb_get_port_numbers(libusb_device *dev, uint8_t *port_numbers, int port_numbers_len);
+
+int  libusb_open(libusb_device *dev, libusb_device_handle **dev_handle);
+libusb_device_handle * libusb_open_device_with_vid_pid(libusb_context *ctx, uint16_t vendor_id, uint16_t product_id);
+void libusb_close(libusb_device_handle *dev_handle);
+libusb_device * libusb_get_device(libusb_device_handle *dev_handle);
+int  libusb_reset_device(libusb_device_handle *dev_handle);
+int  libusb_kernel_driver_active(libusb_device_handle *dev_handle, int interface_number);
+int  libusb_detach_kernel_driver(libusb_device_handle *dev_handle, int interface_number);
+int  libusb_attach_kernel_driver(libusb_device_handle *dev_handle, int interface_number);
+int  libusb_set_configuration(libusb_device_handle *dev_handle, int configuration);
+int  libusb_claim_interface(libusb_device_handle *dev_handle, int interface_number);
+int  libusb_release_interface(libusb_device_handle *dev_handle, int interface_number);
+int  libusb_set_interface_alt_setting(libusb_device_handle *dev_handle, int interface_number, int alternate_setting);
+int  libusb_clear_halt(libusb_device_handle *dev_handle, unsigned char endpoint);
+
+struct libusb_transfer * libusb_alloc_transfer(int iso_packets);
+void libusb_free_transfer(struct libusb_transfer *transfer);
+int  libusb_submit_transfer(struct libusb_transfer *transfer);
+int  libusb_cancel_transfer(struct libusb_transfer *transfer);
+
+int  libusb_handle_events_timeout(libusb_context *ctx, struct timeval *tv);
+int  libusb_handle_events_timeout_completed(libusb_context *ctx, struct timeval *tv, int *completed);
+int  libusb_pollfds_handle_timeouts(libusb_context *ctx);
+void libusb_set_pollfd_notifiers(libusb_context *ctx, libusb_pollfd_added_cb added_cb, libusb_pollfd_removed_cb removed_cb, void *user_data);
+const struct libusb_pollfd ** libusb_get_pollfds(libusb_context *ctx);
+void libusb_free_pollfds(const struct libusb_pollfd **pollfds);
+
+static inline void libusb_fill_control_setup(unsigned char *buffer, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength){
+    buffer[0] = bmRequestType;
+    buffer[1] = bRequest;
+    buffer[2] = (unsigned char) (wValue & 0xff);
+    buffer[3] = (unsigned char) (wValue >> 8);
+    buffer[4] = (unsigned char) (wIndex & 0xff);
+    buffer[5] = (unsigned char) (wIndex >> 8);
+    buffer[6] = (unsigned char) (wLength & 0xff);
+    buffer[7] = (unsigned char) (wLength >> 8);
+}
+
+static inline void libusb_fill_control_transfer(struct libusb_transfer *transfer, libusb_device_handle *dev_handle, unsigned char *buffer,
+                                                libusb_transfer_cb_fn callback, void *user_data, unsigned int timeout){
+    transfer->dev_handle = dev_handle;
+    transfer->endpoint = 0;
+    transfer->type = LIBUSB_TRANSFER_TYPE_CONTROL;
+    transfer->timeout = timeout;
+    transfer->buffer = buffer;
+    transfer->length = LIBUSB_CONTROL_SETUP_SIZE + (buffer[6] | (buffer[7] << 8));
+    transfer->user_data = user_data;
+    transfer->callback = callback;
+}
+
+static inline void libusb_fill_bulk_transfer(struct libusb_transfer *transfer, libusb_device_handle *dev_handle, unsigned char endpoint,
+                                             unsigned char *buffer, int length, libusb_transfer_cb_fn callback, void *user_data, unsigned int timeout){
+    transfer->dev_handle = dev_handle;
+    transfer->endpoint = endpoint;
+    transfer->type = LIBUSB_TRANSFER_TYPE_BULK;
+    transfer->timeout = timeout;
+    transfer->buffer = buffer;
+    transfer->length = length;
+    transfer->user_data = user_data;
+    transfer->callback = callback;
+}
+
+static inline void libusb_fill_interrupt_transfer(struct libusb_transfer *transfer, libusb_device_handle *dev_handle, unsigned char endpoint,
+                                                  unsigned char *buffer, int length, libusb_transfer_cb_fn callback, void *user_data, unsigned int timeout){
+    libusb_fill_bulk_transfer(transfer, dev_handle, endpoint, buffer, length, callback, user_data, timeout);
+    transfer->type = LIBUSB_TRANSFER_TYPE_INTERRUPT;
+}
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // LIBUSB_H
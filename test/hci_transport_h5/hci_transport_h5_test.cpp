@@ -0,0 +1,556 @@
+// Loopback test for H5 transport: simulated UART and controller side of the Three-Wire link
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_run_loop.h"
+#include "btstack_uart.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+#include "hci_transport_h5.h"
+
+// default from hci_transport_h5.c
+#ifndef H5_SLIDING_WINDOW_SIZE
+#define H5_SLIDING_WINDOW_SIZE 1
+#endif
+
+#define UART_BAUDRATE 921600
+#define MAX_FRAME_SIZE (4 + HCI_INCOMING_PACKET_BUFFER_SIZE + 2)
+#define CONTROLLER_QUEUE_SIZE 16
+#define NUM_PACKETS 20
+
+// simulated time
+static uint32_t sim_time_ms;
+
+static void sim_set_timer(btstack_timer_source_t * timer, uint32_t timeout_in_ms){
+    timer->timeout = sim_time_ms + timeout_in_ms;
+}
+
+static uint32_t sim_get_time_ms(void){
+    return sim_time_ms;
+}
+
+static const btstack_run_loop_t sim_run_loop = {
+    &btstack_run_loop_base_init,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    &sim_set_timer,
+    &btstack_run_loop_base_add_timer,
+    &btstack_run_loop_base_remove_timer,
+    NULL,
+    &btstack_run_loop_base_dump_timer,
+    &sim_get_time_ms,
+    NULL,
+    NULL,
+    NULL,
+};
+
+static uint32_t sim_frame_time_ms(uint16_t len){
+    // 10 bit per byte, SLIP overhead ignored
+    return 1 + (len * 10000) / UART_BAUDRATE;
+}
+
+// process timers until condition is met or time limit is reached
+static bool sim_run_until(bool (*done)(void), uint32_t max_duration_ms){
+    uint32_t end_ms = sim_time_ms + max_duration_ms;
+    while ((done == NULL) || !done()){
+        int32_t delta = btstack_run_loop_base_get_time_until_timeout(sim_time_ms);
+        if (delta < 0) break;
+        if ((int32_t) (sim_time_ms + delta - end_ms) > 0) break;
+        sim_time_ms += delta;
+        btstack_run_loop_base_process_timers(sim_time_ms);
+    }
+    if (done == NULL) {
+        sim_time_ms = end_ms;
+        return true;
+    }
+    return done();
+}
+
+// Simulated controller
+typedef struct {
+    // config
+    uint8_t  config_field;
+    bool     config_field_present;
+    uint16_t ack_delay_ms;
+    int      drop_reliable_frame;
+    int      drop_ack;
+
+    // link state
+    bool     sync_received;
+    bool     config_received;
+    uint8_t  expected_seq_nr;
+    uint8_t  last_ack_sent;
+    uint8_t  last_host_ack;
+    bool     ack_pending;
+
+    // stats
+    uint16_t num_reliable_frames;
+    uint16_t num_acks_sent;
+    uint16_t num_dropped;
+    uint16_t num_out_of_sequence;
+    uint16_t num_received;
+    uint16_t num_received_sco;
+    uint16_t num_payload_errors;
+    uint8_t  max_outstanding;
+    bool     dic_present;
+} controller_t;
+
+static controller_t controller;
+
+// UART: host to controller
+static void (*uart_frame_received)(uint16_t frame_size);
+static void (*uart_frame_sent)(void);
+static uint8_t * uart_receive_buffer;
+static uint16_t  uart_receive_buffer_len;
+static uint8_t   uart_tx_frame[MAX_FRAME_SIZE];
+static uint16_t  uart_tx_len;
+static btstack_timer_source_t uart_tx_timer;
+
+// UART: controller to host
+static uint8_t  controller_queue[CONTROLLER_QUEUE_SIZE][MAX_FRAME_SIZE];
+static uint16_t controller_queue_len[CONTROLLER_QUEUE_SIZE];
+static uint8_t  controller_queue_head;
+static uint8_t  controller_queue_count;
+static btstack_timer_source_t controller_tx_timer;
+static btstack_timer_source_t controller_ack_timer;
+
+// upper stack
+static const hci_transport_t * transport;
+static uint8_t  host_buffer[HCI_OUTGOING_PRE_BUFFER_SIZE + HCI_OUTGOING_PACKET_BUFFER_SIZE];
+static uint16_t host_num_to_send;
+static uint16_t host_num_sent;
+static uint16_t host_num_packet_sent_events;
+static uint16_t host_num_events;
+static uint8_t  host_events[8];
+
+static uint16_t payload_len_for_index(uint16_t index){
+    return 20 + (index % 50);
+}
+
+static uint8_t payload_byte(uint16_t index, uint16_t pos){
+    return (uint8_t) (index + pos);
+}
+
+static void controller_tx_timeout(btstack_timer_source_t * timer);
+
+static void controller_tx_timer_start(void){
+    btstack_run_loop_set_timer_handler(&controller_tx_timer, &controller_tx_timeout);
+    btstack_run_loop_set_timer(&controller_tx_timer, sim_frame_time_ms(controller_queue_len[controller_queue_head]));
+    btstack_run_loop_add_timer(&controller_tx_timer);
+}
+
+static void controller_tx_timeout(btstack_timer_source_t * timer){
+    UNUSED(timer);
+    uint16_t len = controller_queue_len[controller_queue_head];
+    CHECK(len <= uart_receive_buffer_len);
+    memcpy(uart_receive_buffer, controller_queue[controller_queue_head], len);
+    controller_queue_head = (controller_queue_head + 1) % CONTROLLER_QUEUE_SIZE;
+    controller_queue_count--;
+    if (controller_queue_count > 0){
+        controller_tx_timer_start();
+    }
+    (*uart_frame_received)(len);
+}
+
+static void controller_send_frame(uint8_t seq_nr, bool reliable, uint8_t packet_type, const uint8_t * payload, uint16_t payload_len){
+    CHECK(controller_queue_count < CONTROLLER_QUEUE_SIZE);
+    uint8_t index = (controller_queue_head + controller_queue_count) % CONTROLLER_QUEUE_SIZE;
+    uint8_t * frame = controller_queue[index];
+    frame[0] = (reliable ? (seq_nr | 0x80) : 0) | (controller.expected_seq_nr << 3);
+    frame[1] = packet_type | ((payload_len & 0x0f) << 4);
+    frame[2] = payload_len >> 4;
+    frame[3] = 0xff - (frame[0] + frame[1] + frame[2]);
+    memcpy(&frame[4], payload, payload_len);
+    controller_queue_len[index] = 4 + payload_len;
+    controller.last_ack_sent = controller.expected_seq_nr;
+    controller_queue_count++;
+    if (controller_queue_count == 1){
+        controller_tx_timer_start();
+    }
+}
+
+static void controller_send_ack(void){
+    controller_send_frame(0, false, 0, NULL, 0);
+    controller.num_acks_sent++;
+}
+
+static void controller_ack_timeout(btstack_timer_source_t * timer){
+    UNUSED(timer);
+    controller.ack_pending = false;
+    if (controller.drop_ack == 0){
+        controller.drop_ack = -1;
+        return;
+    }
+    if (controller.drop_ack > 0){
+        controller.drop_ack--;
+    }
+    controller_send_ack();
+}
+
+static void controller_schedule_ack(void){
+    if (controller.ack_pending) return;
+    controller.ack_pending = true;
+    btstack_run_loop_set_timer_handler(&controller_ack_timer, &controller_ack_timeout);
+    btstack_run_loop_set_timer(&controller_ack_timer, controller.ack_delay_ms);
+    btstack_run_loop_add_timer(&controller_ack_timer);
+}
+
+static void controller_send_event(uint8_t seq_nr, uint8_t event_type){
+    uint8_t event[] = { event_type, 1, seq_nr };
+    controller_send_frame(seq_nr, true, HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_handle_link_control(const uint8_t * payload, uint16_t len){
+    static const uint8_t sync[] = { 0x01, 0x7e };
+    static const uint8_t sync_response[] = { 0x02, 0x7d };
+    static const uint8_t config[] = { 0x03, 0xfc };
+    if ((len == 2) && (memcmp(payload, sync, 2) == 0)){
+        controller.sync_received = true;
+        controller_send_frame(0, false, 0x0f, sync_response, sizeof(sync_response));
+        return;
+    }
+    if ((len >= 2) && (memcmp(payload, config, 2) == 0)){
+        controller.config_received = true;
+        uint8_t config_response[] = { 0x04, 0x7b, controller.config_field };
+        controller_send_frame(0, false, 0x0f, config_response, controller.config_field_present ? 3 : 2);
+        return;
+    }
+}
+
+static void controller_handle_reliable_packet(uint8_t seq_nr, uint8_t packet_type, const uint8_t * payload, uint16_t len){
+    uint16_t frame_index = controller.num_reliable_frames++;
+    if (frame_index == controller.drop_reliable_frame){
+        controller.num_dropped++;
+        return;
+    }
+    uint8_t outstanding = ((seq_nr - controller.last_ack_sent) & 0x07) + 1;
+    controller.max_outstanding = btstack_max(controller.max_outstanding, outstanding);
+    controller_schedule_ack();
+    if (seq_nr != controller.expected_seq_nr){
+        controller.num_out_of_sequence++;
+        return;
+    }
+    controller.expected_seq_nr = (controller.expected_seq_nr + 1) & 0x07;
+    // verify payload
+    uint16_t index = controller.num_received++;
+    if ((packet_type != HCI_ACL_DATA_PACKET) || (len != payload_len_for_index(index))){
+        controller.num_payload_errors++;
+        return;
+    }
+    for (uint16_t i = 0; i < len; i++){
+        if (payload[i] != payload_byte(index, i)){
+            controller.num_payload_errors++;
+            return;
+        }
+    }
+}
+
+static void controller_handle_frame(const uint8_t * frame, uint16_t frame_len){
+    CHECK(frame_len >= 4);
+    CHECK_EQUAL(0xff, (uint8_t) (frame[0] + frame[1] + frame[2] + frame[3]));
+    uint8_t  seq_nr      = frame[0] & 0x07;
+    uint8_t  ack_nr      = (frame[0] >> 3) & 0x07;
+    bool     dic_present = (frame[0] & 0x40) != 0;
+    bool     reliable    = (frame[0] & 0x80) != 0;
+    uint8_t  packet_type = frame[1] & 0x0f;
+    uint16_t len         = (frame[1] >> 4) | (frame[2] << 4);
+    CHECK_EQUAL(4 + len + (dic_present ? 2 : 0), frame_len);
+    if (len > 0){
+        controller.dic_present = dic_present;
+    }
+    const uint8_t * payload = &frame[4];
+    if (reliable || (packet_type == 0)){
+        controller.last_host_ack = ack_nr;
+    }
+    if (reliable){
+        controller_handle_reliable_packet(seq_nr, packet_type, payload, len);
+        return;
+    }
+    switch (packet_type){
+        case 0x0f:
+            controller_handle_link_control(payload, len);
+            break;
+        case HCI_SCO_DATA_PACKET:
+            controller.num_received_sco++;
+            break;
+        default:
+            break;
+    }
+}
+
+// UART driver
+static void uart_tx_timeout(btstack_timer_source_t * timer){
+    UNUSED(timer);
+    controller_handle_frame(uart_tx_frame, uart_tx_len);
+    (*uart_frame_sent)();
+}
+
+static int uart_init(const btstack_uart_config_t * config){
+    UNUSED(config);
+    return 0;
+}
+
+static int uart_open(void){
+    return 0;
+}
+
+static int uart_close(void){
+    return 0;
+}
+
+static int uart_set_baudrate(uint32_t baudrate){
+    UNUSED(baudrate);
+    return 0;
+}
+
+static int uart_set_parity(int parity){
+    UNUSED(parity);
+    return 0;
+}
+
+static void uart_set_frame_received(void (*handler)(uint16_t frame_size)){
+    uart_frame_received = handler;
+}
+
+static void uart_set_frame_sent(void (*handler)(void)){
+    uart_frame_sent = handler;
+}
+
+static void uart_receive_frame(uint8_t * buffer, uint16_t len){
+    uart_receive_buffer = buffer;
+    uart_receive_buffer_len = len;
+}
+
+static void uart_send_frame(const uint8_t * buffer, uint16_t length){
+    CHECK(length <= MAX_FRAME_SIZE);
+    memcpy(uart_tx_frame, buffer, length);
+    uart_tx_len = length;
+    btstack_run_loop_set_timer_handler(&uart_tx_timer, &uart_tx_timeout);
+    btstack_run_loop_set_timer(&uart_tx_timer, sim_frame_time_ms(length));
+    btstack_run_loop_add_timer(&uart_tx_timer);
+}
+
+static const btstack_uart_t uart_driver = {
+    /* int  (*init)(hci_transport_config_uart_t * config); */         &uart_init,
+    /* int  (*open)(void); */                                         &uart_open,
+    /* int  (*close)(void); */                                        &uart_close,
+    /* void (*set_block_received)(void (*handler)(void)); */          NULL,
+    /* void (*set_block_sent)(void (*handler)(void)); */              NULL,
+    /* int  (*set_baudrate)(uint32_t baudrate); */                    &uart_set_baudrate,
+    /* int  (*set_parity)(int parity); */                             &uart_set_parity,
+    /* int  (*set_flowcontrol)(int flowcontrol); */                   NULL,
+    /* void (*receive_block)(uint8_t *buffer, uint16_t len); */       NULL,
+    /* void (*send_block)(const uint8_t *buffer, uint16_t length); */ NULL,
+    /* int (*get_supported_sleep_modes); */                           NULL,
+    /* void (*set_sleep)(btstack_uart_sleep_mode_t sleep_mode); */    NULL,
+    /* void (*set_wakeup_handler)(void (*handler)(void)); */          NULL,
+    /* void (*set_frame_received)(void (*handler)(uint16_t frame_size); */ &uart_set_frame_received,
+    /* void (*set_frame_sent)(void (*handler)(void)); */              &uart_set_frame_sent,
+    /* void (*receive_frame)(uint8_t *buffer, uint16_t len); */       &uart_receive_frame,
+    /* void (*send_frame)(const uint8_t *buffer, uint16_t length); */ &uart_send_frame,
+};
+
+static const hci_transport_config_uart_t transport_config = {
+    HCI_TRANSPORT_CONFIG_UART,
+    UART_BAUDRATE,
+    0,
+    1,
+    NULL,
+    BTSTACK_UART_PARITY_OFF,
+};
+
+// upper stack
+static void host_send_next(void){
+    if (host_num_sent >= host_num_to_send) return;
+    if (!transport->can_send_packet_now(HCI_ACL_DATA_PACKET)) return;
+    uint8_t * packet = &host_buffer[HCI_OUTGOING_PRE_BUFFER_SIZE];
+    uint16_t len = payload_len_for_index(host_num_sent);
+    for (uint16_t i = 0; i < len; i++){
+        packet[i] = payload_byte(host_num_sent, i);
+    }
+    CHECK_EQUAL(0, transport->send_packet(HCI_ACL_DATA_PACKET, packet, len));
+    host_num_sent++;
+}
+
+static void host_packet_handler(uint8_t packet_type, uint8_t * packet, uint16_t size){
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (packet[0]){
+        case HCI_EVENT_TRANSPORT_PACKET_SENT:
+            host_num_packet_sent_events++;
+            host_send_next();
+            break;
+        case HCI_EVENT_TRANSPORT_SLEEP_MODE:
+            break;
+        default:
+            if (host_num_events < sizeof(host_events)){
+                host_events[host_num_events] = packet[2];
+            }
+            host_num_events++;
+            break;
+    }
+}
+
+static bool link_active(void){
+    return host_num_packet_sent_events > 0;
+}
+
+static bool all_packets_acked(void){
+    return (controller.num_received == host_num_to_send) && (controller.last_ack_sent == (host_num_to_send & 0x07))
+        && (controller_queue_count == 0) && (host_num_sent == host_num_to_send) && !controller.ack_pending;
+}
+
+TEST_GROUP(H5){
+    void setup(void){
+        btstack_run_loop_base_init();
+        memset(&controller, 0, sizeof(controller));
+        controller.config_field = 0x10 | 7;
+        controller.config_field_present = true;
+        controller.ack_delay_ms = 5;
+        controller.drop_reliable_frame = -1;
+        controller.drop_ack = -1;
+        controller_queue_head = 0;
+        controller_queue_count = 0;
+        host_num_to_send = 0;
+        host_num_sent = 0;
+        host_num_packet_sent_events = 0;
+        host_num_events = 0;
+        transport = hci_transport_h5_instance(&uart_driver);
+        transport->init(&transport_config);
+        transport->register_packet_handler(&host_packet_handler);
+    }
+
+    void open_link(void){
+        CHECK_EQUAL(0, transport->open());
+        CHECK(sim_run_until(&link_active, 2000));
+        CHECK(controller.sync_received);
+        CHECK(controller.config_received);
+    }
+
+    void send_packets(uint16_t num_packets){
+        host_num_to_send = num_packets;
+        host_send_next();
+        CHECK(sim_run_until(&all_packets_acked, 10000));
+        CHECK_EQUAL(num_packets, controller.num_received);
+        CHECK_EQUAL(0, controller.num_payload_errors);
+    }
+
+    void teardown(void){
+        transport->close();
+    }
+};
+
+TEST(H5, LinkEstablishment){
+    open_link();
+    CHECK_EQUAL(1, host_num_packet_sent_events);
+    CHECK(transport->can_send_packet_now(HCI_ACL_DATA_PACKET));
+    send_packets(1);
+    CHECK(controller.dic_present);
+}
+
+TEST(H5, SendPackets){
+    // delay acks until window is full
+    controller.ack_delay_ms = 20;
+    open_link();
+    send_packets(NUM_PACKETS);
+    CHECK_EQUAL(btstack_min(H5_SLIDING_WINDOW_SIZE, 7), controller.max_outstanding);
+    CHECK_EQUAL(NUM_PACKETS, controller.num_reliable_frames);
+    CHECK_EQUAL(0, controller.num_out_of_sequence);
+}
+
+TEST(H5, WindowNegotiation){
+    controller.config_field = 0x10 | 2;
+    controller.ack_delay_ms = 20;
+    open_link();
+    send_packets(NUM_PACKETS);
+    CHECK_EQUAL(btstack_min(H5_SLIDING_WINDOW_SIZE, 2), controller.max_outstanding);
+}
+
+TEST(H5, PeerWithoutConfigField){
+    controller.config_field_present = false;
+    open_link();
+    send_packets(NUM_PACKETS);
+    CHECK_EQUAL(1, controller.max_outstanding);
+    CHECK(!controller.dic_present);
+}
+
+TEST(H5, RetransmissionLostPacket){
+    controller.drop_reliable_frame = 2;
+    open_link();
+    send_packets(NUM_PACKETS);
+    CHECK_EQUAL(1, controller.num_dropped);
+    CHECK(controller.num_reliable_frames > NUM_PACKETS);
+}
+
+TEST(H5, RetransmissionLostAck){
+    controller.drop_ack = 0;
+    open_link();
+    send_packets(1);
+    CHECK_EQUAL(2, controller.num_reliable_frames);
+    CHECK_EQUAL(1, controller.num_out_of_sequence);
+    send_packets(NUM_PACKETS);
+}
+
+TEST(H5, ReceiveOutOfSequence){
+    open_link();
+    // seq 1 before seq 0 is dropped
+    controller_send_event(1, 0xf0);
+    CHECK(sim_run_until(NULL, 100));
+    CHECK_EQUAL(0, host_num_events);
+    CHECK_EQUAL(0, controller.last_host_ack);
+    controller_send_event(0, 0xf0);
+    controller_send_event(1, 0xf0);
+    CHECK(sim_run_until(NULL, 100));
+    CHECK_EQUAL(2, host_num_events);
+    CHECK_EQUAL(0, host_events[0]);
+    CHECK_EQUAL(1, host_events[1]);
+    CHECK_EQUAL(2, controller.last_host_ack);
+    // duplicate is dropped and ack'ed again
+    controller.last_host_ack = 0;
+    controller_send_event(1, 0xf0);
+    CHECK(sim_run_until(NULL, 100));
+    CHECK_EQUAL(2, host_num_events);
+    CHECK_EQUAL(2, controller.last_host_ack);
+}
+
+TEST(H5, SendScoPacket){
+    open_link();
+    uint8_t * packet = &host_buffer[HCI_OUTGOING_PRE_BUFFER_SIZE];
+    memset(packet, 0, 63);
+    CHECK(transport->can_send_packet_now(HCI_SCO_DATA_PACKET));
+    CHECK_EQUAL(0, transport->send_packet(HCI_SCO_DATA_PACKET, packet, 63));
+    CHECK(!transport->can_send_packet_now(HCI_ACL_DATA_PACKET));
+    CHECK(sim_run_until(NULL, 100));
+    CHECK_EQUAL(1, controller.num_received_sco);
+    CHECK_EQUAL(2, host_num_packet_sent_events);
+    send_packets(NUM_PACKETS);
+}
+
+TEST(H5, Throughput){
+    const uint16_t num_packets = 200;
+    open_link();
+    uint32_t start_ms = sim_time_ms;
+    send_packets(num_packets);
+    uint32_t duration_ms = sim_time_ms - start_ms;
+#if H5_SLIDING_WINDOW_SIZE > 1
+    // packets are sent while waiting for acks
+    CHECK(duration_ms < (num_packets * controller.ack_delay_ms));
+#else
+    // each packet waits for its ack
+    CHECK(duration_ms >= (num_packets * controller.ack_delay_ms));
+#endif
+}
+
+int main (int argc, const char * argv[]){
+    btstack_run_loop_init(&sim_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
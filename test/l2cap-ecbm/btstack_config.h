@@ -23,6 +23,7 @@
 #define ENABLE_LE_PERIPHERAL
 #define ENABLE_L2CAP_LE_CREDIT_BASED_FLOW_CONTROL_MODE
 #define ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+#define L2CAP_CHANNEL_INDEX_SIZE 4
 
 // for ready-to-use hci channels
 #define FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
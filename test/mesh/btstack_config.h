@@ -43,6 +43,9 @@
 // allow for one NetKey update
 #define MAX_NR_MESH_NETWORK_KEYS      (MAX_NR_MESH_SUBNETS+1)
 
+// relay in large mesh
+#define MESH_NETWORK_CACHE_SIZE 2048
+
 #define NVM_NUM_LINK_KEYS 2
 
 #endif
@@ -0,0 +1,186 @@
+// Test mesh network message cache
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_util.h"
+#include "mesh/adv_bearer.h"
+#include "mesh/gatt_bearer.h"
+#include "mesh/mesh_network.h"
+
+// default from mesh_network.c
+#ifndef MESH_NETWORK_CACHE_SIZE
+#define MESH_NETWORK_CACHE_SIZE 2
+#endif
+
+#define NUM_SOURCES        200
+#define NUM_PDUS           20000
+
+// bearers are not used
+#ifdef ENABLE_MESH_ADV_BEARER
+void adv_bearer_register_for_network_pdu(btstack_packet_handler_t packet_handler){
+    UNUSED(packet_handler);
+}
+void adv_bearer_request_can_send_now_for_network_pdu(void){
+}
+void adv_bearer_send_network_pdu(const uint8_t * network_pdu, uint16_t size, uint8_t count, uint16_t interval){
+    UNUSED(network_pdu);
+    UNUSED(size);
+    UNUSED(count);
+    UNUSED(interval);
+}
+#endif
+
+#ifdef ENABLE_MESH_GATT_BEARER
+void gatt_bearer_register_for_network_pdu(btstack_packet_handler_t packet_handler){
+    UNUSED(packet_handler);
+}
+void gatt_bearer_register_for_mesh_proxy_configuration(btstack_packet_handler_t packet_handler){
+    UNUSED(packet_handler);
+}
+void gatt_bearer_request_can_send_now_for_network_pdu(void){
+}
+void gatt_bearer_send_network_pdu(const uint8_t * network_pdu, uint16_t size){
+    UNUSED(network_pdu);
+    UNUSED(size);
+}
+#endif
+
+typedef struct {
+    uint8_t  ivi;
+    uint16_t src;
+    uint32_t seq;
+} pdu_key_t;
+
+// unique PDUs from NUM_SOURCES sources with increasing SEQ per source
+static pdu_key_t pdus[NUM_PDUS];
+
+static uint32_t random_state;
+
+static uint32_t random_next(void){
+    random_state = (random_state * 1103515245u) + 12345u;
+    return random_state >> 8;
+}
+
+static void create_pdus(void){
+    uint32_t seq[NUM_SOURCES];
+    random_state = 0x1234;
+    for (uint16_t i = 0; i < NUM_SOURCES; i++){
+        seq[i] = random_next() & 0xffffff;
+    }
+    for (uint32_t i = 0; i < NUM_PDUS; i++){
+        uint16_t source = random_next() % NUM_SOURCES;
+        pdus[i].ivi = 0;
+        pdus[i].src = 0x0100 + source;
+        pdus[i].seq = seq[source];
+        seq[source] = (seq[source] + 1) & 0xffffff;
+    }
+}
+
+// previous implementation: 32-bit key with 15 bit SEQ
+static uint32_t reference_cache_hash(const pdu_key_t * pdu){
+    return ((uint32_t) pdu->src << 16) | ((uint32_t) pdu->ivi << 15) | (pdu->seq & 0x7fff);
+}
+
+static int cache_find(const pdu_key_t * pdu){
+    return mesh_network_cache_find(pdu->ivi, pdu->src, pdu->seq);
+}
+
+static void cache_add(const pdu_key_t * pdu){
+    mesh_network_cache_add(pdu->ivi, pdu->src, pdu->seq);
+}
+
+// each PDU is received once directly and relayed twice with delay < cache size
+static uint32_t relay_delay(uint32_t copy){
+    uint32_t delay = (copy == 0) ? 5 : 37;
+    return btstack_min(delay, MESH_NETWORK_CACHE_SIZE / 4);
+}
+
+typedef struct {
+    uint32_t false_drops;
+    uint32_t missed_duplicates;
+} run_result_t;
+
+static run_result_t run_traffic(int (*find)(const pdu_key_t * pdu), void (*add)(const pdu_key_t * pdu)){
+    run_result_t result = { 0, 0 };
+    for (uint32_t i = 0; i < NUM_PDUS; i++){
+        // new PDU
+        if ((*find)(&pdus[i])){
+            result.false_drops++;
+        } else {
+            (*add)(&pdus[i]);
+        }
+        // relayed copies
+        for (uint32_t copy = 0; copy < 2; copy++){
+            uint32_t delay = relay_delay(copy);
+            if ((delay == 0) || (i < delay)) continue;
+            if (!(*find)(&pdus[i - delay])){
+                result.missed_duplicates++;
+                (*add)(&pdus[i - delay]);
+            }
+        }
+    }
+    return result;
+}
+
+TEST_GROUP(MeshNetworkCache){
+    void setup(void){
+        mesh_network_reset();
+    }
+};
+
+TEST(MeshNetworkCache, FindAdded){
+    pdu_key_t pdu = { 0, 0x1234, 0x123456 };
+    CHECK_EQUAL(0, cache_find(&pdu));
+    cache_add(&pdu);
+    CHECK_EQUAL(1, cache_find(&pdu));
+    mesh_network_reset();
+    CHECK_EQUAL(0, cache_find(&pdu));
+}
+
+TEST(MeshNetworkCache, FullKey){
+    pdu_key_t pdu = { 0, 0x1234, 0x000001 };
+    cache_add(&pdu);
+    // SEQ differs only above bit 15
+    pdu_key_t other_seq = { 0, 0x1234, 0x008001 };
+    CHECK_EQUAL(0, cache_find(&other_seq));
+    CHECK_EQUAL(1, reference_cache_hash(&pdu) == reference_cache_hash(&other_seq));
+    pdu_key_t other_seq_high = { 0, 0x1234, 0x010001 };
+    CHECK_EQUAL(0, cache_find(&other_seq_high));
+    pdu_key_t other_ivi = { 1, 0x1234, 0x000001 };
+    CHECK_EQUAL(0, cache_find(&other_ivi));
+    pdu_key_t other_src = { 0, 0x1235, 0x000001 };
+    CHECK_EQUAL(0, cache_find(&other_src));
+}
+
+TEST(MeshNetworkCache, FifoEviction){
+    create_pdus();
+    const uint32_t num_pdus = (MESH_NETWORK_CACHE_SIZE * 3) + 1;
+    for (uint32_t i = 0; i < num_pdus; i++){
+        cache_add(&pdus[i]);
+        // oldest entry is evicted
+        if (i >= MESH_NETWORK_CACHE_SIZE){
+            CHECK_EQUAL(0, cache_find(&pdus[i - MESH_NETWORK_CACHE_SIZE]));
+        }
+    }
+    // last entries are still found after evictions
+    for (uint32_t i = num_pdus - MESH_NETWORK_CACHE_SIZE; i < num_pdus; i++){
+        CHECK_EQUAL(1, cache_find(&pdus[i]));
+    }
+}
+
+TEST(MeshNetworkCache, DropAccuracy){
+    create_pdus();
+    run_result_t result = run_traffic(&cache_find, &cache_add);
+    CHECK_EQUAL(0, result.false_drops);
+    CHECK_EQUAL(0, result.missed_duplicates);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
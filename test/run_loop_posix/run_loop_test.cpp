@@ -0,0 +1,275 @@
+// Tests for POSIX and Linux run loop
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_linux.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+
+#define NUM_WAKEUPS       2000
+#define MAX_DATA_SOURCES  1000
+
+static btstack_data_source_t data_sources[MAX_DATA_SOURCES];
+static uint32_t num_data_sources;
+static uint32_t read_count[MAX_DATA_SOURCES];
+static uint32_t write_count[MAX_DATA_SOURCES];
+static uint32_t wakeups;
+
+static btstack_timer_source_t timer;
+static uint32_t timer_fired_ms;
+
+static btstack_context_callback_registration_t callback_registration;
+static bool callback_executed;
+
+static int create_eventfd(void){
+    int fd = eventfd(0, EFD_NONBLOCK);
+    CHECK(fd >= 0);
+    return fd;
+}
+
+static void trigger_eventfd(int fd){
+    const uint64_t value = 1;
+    ssize_t bytes_written = write(fd, &value, sizeof(value));
+    CHECK_EQUAL((ssize_t) sizeof(value), bytes_written);
+}
+
+static void read_eventfd(int fd){
+    uint64_t value;
+    ssize_t bytes_read = read(fd, &value, sizeof(value));
+    UNUSED(bytes_read);
+}
+
+static uint32_t index_for_data_source(btstack_data_source_t * ds){
+    return (uint32_t) (ds - data_sources);
+}
+
+static void add_data_sources(uint32_t count, void (*process)(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)){
+    for (num_data_sources = 0; num_data_sources < count; num_data_sources++){
+        btstack_data_source_t * ds = &data_sources[num_data_sources];
+        memset(ds, 0, sizeof(btstack_data_source_t));
+        btstack_run_loop_set_data_source_fd(ds, create_eventfd());
+        btstack_run_loop_set_data_source_handler(ds, process);
+        btstack_run_loop_enable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
+        btstack_run_loop_add_data_source(ds);
+        read_count[num_data_sources] = 0;
+        write_count[num_data_sources] = 0;
+    }
+}
+
+static void remove_data_sources(void){
+    uint32_t i;
+    for (i = 0; i < num_data_sources; i++){
+        btstack_run_loop_remove_data_source(&data_sources[i]);
+        close(data_sources[i].source.fd);
+    }
+    num_data_sources = 0;
+}
+
+static void count_and_exit_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    uint32_t index = index_for_data_source(ds);
+    switch (callback_type){
+        case DATA_SOURCE_CALLBACK_READ:
+            read_eventfd(ds->source.fd);
+            read_count[index]++;
+            break;
+        case DATA_SOURCE_CALLBACK_WRITE:
+            write_count[index]++;
+            btstack_run_loop_disable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_WRITE);
+            break;
+        default:
+            break;
+    }
+    btstack_run_loop_trigger_exit();
+}
+
+static void remove_other_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    uint32_t index = index_for_data_source(ds);
+    read_eventfd(ds->source.fd);
+    read_count[index]++;
+    // remove the other data source, its pending event must not be delivered
+    btstack_run_loop_remove_data_source(&data_sources[1 - index]);
+    btstack_run_loop_trigger_exit();
+}
+
+static void hangup_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    uint32_t index = index_for_data_source(ds);
+    if (callback_type == DATA_SOURCE_CALLBACK_READ){
+        read_count[index]++;
+    }
+    btstack_run_loop_disable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
+    btstack_run_loop_trigger_exit();
+}
+
+static void timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    timer_fired_ms = btstack_run_loop_get_time_ms();
+    btstack_run_loop_trigger_exit();
+}
+
+static void callback_handler(void * context){
+    UNUSED(context);
+    callback_executed = true;
+    btstack_run_loop_trigger_exit();
+}
+
+static void * execute_on_main_thread_from_thread(void * context){
+    UNUSED(context);
+    usleep(10000);
+    btstack_run_loop_execute_on_main_thread(&callback_registration);
+    return NULL;
+}
+
+static void ping_pong_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    read_eventfd(ds->source.fd);
+    wakeups++;
+    if (wakeups == NUM_WAKEUPS){
+        btstack_run_loop_trigger_exit();
+        return;
+    }
+    // wake up a different data source, spread over all
+    uint32_t next = (index_for_data_source(ds) + 7919) % num_data_sources;
+    trigger_eventfd(data_sources[next].source.fd);
+}
+
+static double time_ns(clockid_t clock_id){
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return (ts.tv_sec * 1000000000.0) + ts.tv_nsec;
+}
+
+static void run_loop_tests(const btstack_run_loop_t * run_loop){
+    btstack_run_loop_init(run_loop);
+
+    // read
+    add_data_sources(2, &count_and_exit_handler);
+    trigger_eventfd(data_sources[1].source.fd);
+    btstack_run_loop_execute();
+    CHECK_EQUAL(0, read_count[0]);
+    CHECK_EQUAL(1, read_count[1]);
+
+    // write after enable
+    btstack_run_loop_enable_data_source_callbacks(&data_sources[0], DATA_SOURCE_CALLBACK_WRITE);
+    btstack_run_loop_execute();
+    CHECK_EQUAL(1, write_count[0]);
+    CHECK_EQUAL(0, write_count[1]);
+
+    // disabled read callback
+    btstack_run_loop_disable_data_source_callbacks(&data_sources[0], DATA_SOURCE_CALLBACK_READ);
+    trigger_eventfd(data_sources[0].source.fd);
+    trigger_eventfd(data_sources[1].source.fd);
+    btstack_run_loop_execute();
+    CHECK_EQUAL(0, read_count[0]);
+    CHECK_EQUAL(2, read_count[1]);
+    remove_data_sources();
+
+    // remove data source with pending event from callback
+    add_data_sources(2, &remove_other_handler);
+    trigger_eventfd(data_sources[0].source.fd);
+    trigger_eventfd(data_sources[1].source.fd);
+    btstack_run_loop_execute();
+    CHECK_EQUAL(1, read_count[0] + read_count[1]);
+    remove_data_sources();
+
+    // hung up fd without enabled callbacks does not wake up run loop
+    int pipe_fds[2];
+    CHECK_EQUAL(0, pipe(pipe_fds));
+    close(pipe_fds[1]);
+    memset(&data_sources[0], 0, sizeof(btstack_data_source_t));
+    read_count[0] = 0;
+    num_data_sources = 1;
+    btstack_run_loop_set_data_source_fd(&data_sources[0], pipe_fds[0]);
+    btstack_run_loop_set_data_source_handler(&data_sources[0], &hangup_handler);
+    btstack_run_loop_add_data_source(&data_sources[0]);
+    btstack_run_loop_set_timer_handler(&timer, &timer_handler);
+    btstack_run_loop_set_timer(&timer, 50);
+    btstack_run_loop_add_timer(&timer);
+    double start_cpu_ns = time_ns(CLOCK_PROCESS_CPUTIME_ID);
+    btstack_run_loop_execute();
+    CHECK(time_ns(CLOCK_PROCESS_CPUTIME_ID) - start_cpu_ns < 25000000.0);
+    CHECK_EQUAL(0, read_count[0]);
+
+    // hangup reported as ready to read after enable
+    btstack_run_loop_enable_data_source_callbacks(&data_sources[0], DATA_SOURCE_CALLBACK_READ);
+    btstack_run_loop_execute();
+    CHECK_EQUAL(1, read_count[0]);
+    remove_data_sources();
+
+    // timer
+    uint32_t start_ms = btstack_run_loop_get_time_ms();
+    btstack_run_loop_set_timer_handler(&timer, &timer_handler);
+    btstack_run_loop_set_timer(&timer, 20);
+    btstack_run_loop_add_timer(&timer);
+    btstack_run_loop_execute();
+    CHECK(btstack_time_delta(timer_fired_ms, start_ms) >= 20);
+    CHECK(btstack_time_delta(timer_fired_ms, start_ms) < 200);
+
+    // execute on main thread from other thread
+    pthread_t thread;
+    callback_executed = false;
+    callback_registration.callback = &callback_handler;
+    callback_registration.context = NULL;
+    pthread_create(&thread, NULL, &execute_on_main_thread_from_thread, NULL);
+    btstack_run_loop_execute();
+    pthread_join(thread, NULL);
+    CHECK_EQUAL(true, callback_executed);
+
+    btstack_run_loop_deinit();
+}
+
+static void run_loop_many_data_sources(const btstack_run_loop_t * run_loop, uint32_t count){
+    btstack_run_loop_init(run_loop);
+    add_data_sources(count, &ping_pong_handler);
+    wakeups = 0;
+    trigger_eventfd(data_sources[0].source.fd);
+    btstack_run_loop_execute();
+    CHECK_EQUAL(NUM_WAKEUPS, wakeups);
+    remove_data_sources();
+    btstack_run_loop_deinit();
+}
+
+TEST_GROUP(RUN_LOOP){
+    void setup(void){
+    }
+};
+
+TEST(RUN_LOOP, Posix){
+    run_loop_tests(btstack_run_loop_posix_get_instance());
+}
+
+TEST(RUN_LOOP, Linux){
+    run_loop_tests(btstack_run_loop_linux_get_instance());
+}
+
+TEST(RUN_LOOP, ManyDataSources){
+    // allow for more than FD_SETSIZE file descriptors
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < limit.rlim_max){
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    // select is limited to FD_SETSIZE, epoll is not
+    run_loop_many_data_sources(btstack_run_loop_posix_get_instance(), 100);
+    if (limit.rlim_cur > MAX_DATA_SOURCES + 10){
+        run_loop_many_data_sources(btstack_run_loop_linux_get_instance(), MAX_DATA_SOURCES);
+    }
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
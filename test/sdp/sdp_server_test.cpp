@@ -0,0 +1,274 @@
+// Test SDP server: concurrent channels and ServiceSearchAttribute continuation
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth_sdp.h"
+#include "btstack_event.h"
+#include "btstack_util.h"
+#include "classic/sdp_server.h"
+#include "classic/sdp_util.h"
+#include "classic/spp_server.h"
+#include "l2cap.h"
+
+// default from sdp_server.c
+#ifndef SDP_SERVER_MAX_CHANNELS
+#define SDP_SERVER_MAX_CHANNELS 1
+#endif
+
+#define NUM_RECORDS        10
+#define MAX_CIDS           16
+#define SMALL_MTU          48
+#define LARGE_MTU          (HCI_ACL_PAYLOAD_SIZE - L2CAP_HEADER_SIZE)
+
+static uint8_t  records[NUM_RECORDS + 1][150];
+
+// mock l2cap
+static btstack_packet_handler_t sdp_packet_handler;
+static uint16_t remote_mtu;
+static uint16_t accepted_cids[MAX_CIDS];
+static uint16_t num_accepted;
+static uint16_t num_declined;
+static uint16_t num_can_send_now_requests;
+static uint8_t  responses[MAX_CIDS][LARGE_MTU];
+static uint16_t response_sizes[MAX_CIDS];
+
+uint8_t l2cap_register_service(btstack_packet_handler_t packet_handler, uint16_t psm, uint16_t mtu, gap_security_level_t security_level){
+    UNUSED(psm);
+    UNUSED(mtu);
+    UNUSED(security_level);
+    sdp_packet_handler = packet_handler;
+    return ERROR_CODE_SUCCESS;
+}
+
+void l2cap_accept_connection(uint16_t local_cid){
+    accepted_cids[num_accepted++] = local_cid;
+}
+
+void l2cap_decline_connection(uint16_t local_cid){
+    UNUSED(local_cid);
+    num_declined++;
+}
+
+uint16_t l2cap_get_remote_mtu_for_local_cid(uint16_t local_cid){
+    UNUSED(local_cid);
+    return remote_mtu;
+}
+
+uint8_t l2cap_request_can_send_now_event(uint16_t local_cid){
+    UNUSED(local_cid);
+    num_can_send_now_requests++;
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_send(uint16_t local_cid, const uint8_t *data, uint16_t len){
+    CHECK(local_cid < MAX_CIDS);
+    CHECK(len <= remote_mtu);
+    memcpy(responses[local_cid], data, len);
+    response_sizes[local_cid] = len;
+    return ERROR_CODE_SUCCESS;
+}
+
+static void emit_event(uint8_t event_type, uint16_t cid, uint8_t status){
+    uint8_t event[3] = { event_type, 1, status };
+    sdp_packet_handler(HCI_EVENT_PACKET, cid, event, sizeof(event));
+}
+
+static void open_channel(uint16_t cid){
+    emit_event(L2CAP_EVENT_INCOMING_CONNECTION, cid, 0);
+    emit_event(L2CAP_EVENT_CHANNEL_OPENED, cid, ERROR_CODE_SUCCESS);
+}
+
+static void send_service_search_attribute_request(uint16_t cid, uint16_t transaction_id, const uint8_t * continuation_state){
+    static const uint8_t request_template[] = {
+        SDP_ServiceSearchAttributeRequest, 0, 0, 0, 0,
+        // ServiceSearchPattern: SPP
+        0x35, 0x03, 0x19, 0x11, 0x01,
+        // MaximumAttributeByteCount
+        0xff, 0xff,
+        // AttributeIDList: 0x0000-0xffff
+        0x35, 0x05, 0x0a, 0x00, 0x00, 0xff, 0xff,
+    };
+    uint8_t request[sizeof(request_template) + 17];
+    memcpy(request, request_template, sizeof(request_template));
+    uint16_t pos = sizeof(request_template);
+    memcpy(&request[pos], continuation_state, 1 + continuation_state[0]);
+    pos += 1 + continuation_state[0];
+    big_endian_store_16(request, 1, transaction_id);
+    big_endian_store_16(request, 3, pos - 5);
+    sdp_packet_handler(L2CAP_DATA_PACKET, cid, request, pos);
+}
+
+static void respond(uint16_t cid){
+    response_sizes[cid] = 0;
+    emit_event(L2CAP_EVENT_CAN_SEND_NOW, cid, 0);
+    CHECK(response_sizes[cid] > 0);
+}
+
+// collect complete AttributeLists, returns number of responses
+static uint16_t query_attribute_lists(uint16_t cid, uint8_t * attribute_lists, uint16_t * attribute_lists_len){
+    uint8_t continuation_state[17] = { 0 };
+    uint16_t num_responses = 0;
+    *attribute_lists_len = 0;
+    while (true){
+        send_service_search_attribute_request(cid, num_responses, continuation_state);
+        respond(cid);
+        num_responses++;
+        const uint8_t * response = responses[cid];
+        CHECK_EQUAL(SDP_ServiceSearchAttributeResponse, response[0]);
+        CHECK_EQUAL(num_responses - 1, big_endian_read_16(response, 1));
+        uint16_t byte_count = big_endian_read_16(response, 5);
+        memcpy(&attribute_lists[*attribute_lists_len], &response[7], byte_count);
+        *attribute_lists_len += byte_count;
+        const uint8_t * continuation = &response[7 + byte_count];
+        CHECK_EQUAL(response_sizes[cid], 7 + byte_count + 1 + continuation[0]);
+        if (continuation[0] == 0) break;
+        memcpy(continuation_state, continuation, 1 + continuation[0]);
+    }
+    return num_responses;
+}
+
+// returns number of service records in AttributeLists
+static uint16_t count_attribute_lists(uint8_t * attribute_lists, uint16_t attribute_lists_len){
+    CHECK_EQUAL(DE_DES, de_get_element_type(attribute_lists));
+    CHECK_EQUAL(attribute_lists_len, de_get_len(attribute_lists));
+    uint16_t num_records = 0;
+    des_iterator_t it;
+    for (des_iterator_init(&it, attribute_lists); des_iterator_has_more(&it); des_iterator_next(&it)){
+        CHECK_EQUAL(DE_DES, des_iterator_get_type(&it));
+        uint8_t * record_handle = sdp_get_attribute_value_for_attribute_id(des_iterator_get_element(&it), BLUETOOTH_ATTRIBUTE_SERVICE_RECORD_HANDLE);
+        CHECK(record_handle != NULL);
+        num_records++;
+    }
+    return num_records;
+}
+
+static void register_record(uint16_t index){
+    spp_create_sdp_record(records[index], sdp_create_service_record_handle(), 1 + index, "SPP");
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, sdp_register_service(records[index]));
+}
+
+TEST_GROUP(SDPServer){
+    void setup(void){
+        sdp_deinit();
+        sdp_init();
+        remote_mtu = LARGE_MTU;
+        num_accepted = 0;
+        num_declined = 0;
+        num_can_send_now_requests = 0;
+        memset(response_sizes, 0, sizeof(response_sizes));
+        for (uint16_t i = 0; i < NUM_RECORDS; i++){
+            register_record(i);
+        }
+    }
+    void teardown(void){
+        for (uint16_t i = 0; i <= NUM_RECORDS; i++){
+            sdp_unregister_service(sdp_get_service_record_handle(records[i]));
+        }
+        sdp_deinit();
+    }
+};
+
+TEST(SDPServer, ConcurrentChannels){
+    const uint16_t num_channels = SDP_SERVER_MAX_CHANNELS + 2;
+    for (uint16_t cid = 1; cid <= num_channels; cid++){
+        open_channel(cid);
+    }
+    // additional channels are queued
+    CHECK_EQUAL(SDP_SERVER_MAX_CHANNELS, num_accepted);
+    CHECK_EQUAL(0, num_declined);
+
+    // requests on all active channels before first response
+    uint8_t no_continuation[] = { 0 };
+    for (uint16_t cid = 1; cid <= SDP_SERVER_MAX_CHANNELS; cid++){
+        send_service_search_attribute_request(cid, 0x100 + cid, no_continuation);
+    }
+    CHECK_EQUAL(SDP_SERVER_MAX_CHANNELS, num_can_send_now_requests);
+    for (uint16_t cid = SDP_SERVER_MAX_CHANNELS; cid > 0; cid--){
+        respond(cid);
+        CHECK_EQUAL(SDP_ServiceSearchAttributeResponse, responses[cid][0]);
+        CHECK_EQUAL(0x100 + cid, big_endian_read_16(responses[cid], 1));
+    }
+
+    // request on queued channel is ignored
+    send_service_search_attribute_request(num_channels, 0x200, no_continuation);
+    CHECK_EQUAL(SDP_SERVER_MAX_CHANNELS, num_can_send_now_requests);
+
+    // closing a channel accepts queued channel
+    emit_event(L2CAP_EVENT_CHANNEL_CLOSED, 1, 0);
+    CHECK_EQUAL(SDP_SERVER_MAX_CHANNELS + 1, num_accepted);
+    CHECK_EQUAL(SDP_SERVER_MAX_CHANNELS + 1, accepted_cids[SDP_SERVER_MAX_CHANNELS]);
+    uint8_t attribute_lists[2000];
+    uint16_t attribute_lists_len;
+    query_attribute_lists(SDP_SERVER_MAX_CHANNELS + 1, attribute_lists, &attribute_lists_len);
+    CHECK_EQUAL(NUM_RECORDS, count_attribute_lists(attribute_lists, attribute_lists_len));
+}
+
+TEST(SDPServer, ServiceSearchAttributeContinuation){
+    open_channel(1);
+    uint8_t  single_response[2000];
+    uint16_t single_response_len;
+    CHECK_EQUAL(1, query_attribute_lists(1, single_response, &single_response_len));
+    CHECK_EQUAL(NUM_RECORDS, count_attribute_lists(single_response, single_response_len));
+
+    // same result with continuation
+    remote_mtu = SMALL_MTU;
+    uint8_t  attribute_lists[2000];
+    uint16_t attribute_lists_len;
+    CHECK(query_attribute_lists(1, attribute_lists, &attribute_lists_len) > NUM_RECORDS);
+    CHECK_EQUAL(single_response_len, attribute_lists_len);
+    MEMCMP_EQUAL(single_response, attribute_lists, attribute_lists_len);
+}
+
+TEST(SDPServer, ServiceRecordsChangedDuringContinuation){
+    open_channel(1);
+    remote_mtu = SMALL_MTU;
+    uint8_t no_continuation[] = { 0 };
+    send_service_search_attribute_request(1, 1, no_continuation);
+    respond(1);
+    uint8_t continuation_state[17];
+    const uint8_t * continuation = &responses[1][7 + big_endian_read_16(responses[1], 5)];
+    memcpy(continuation_state, continuation, 1 + continuation[0]);
+
+    register_record(NUM_RECORDS);
+    send_service_search_attribute_request(1, 2, continuation_state);
+    respond(1);
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+    // cached response got invalidated
+    CHECK_EQUAL(SDP_ErrorResponse, responses[1][0]);
+    CHECK_EQUAL(0x0005, big_endian_read_16(responses[1], 5));
+#else
+    CHECK_EQUAL(SDP_ServiceSearchAttributeResponse, responses[1][0]);
+#endif
+
+    // new query finds new record
+    uint8_t  attribute_lists[2000];
+    uint16_t attribute_lists_len;
+    query_attribute_lists(1, attribute_lists, &attribute_lists_len);
+    CHECK_EQUAL(NUM_RECORDS + 1, count_attribute_lists(attribute_lists, attribute_lists_len));
+}
+
+TEST(SDPServer, RepeatedQueries){
+    open_channel(1);
+    remote_mtu = SMALL_MTU;
+    uint8_t  first_attribute_lists[2000];
+    uint16_t first_attribute_lists_len;
+    uint16_t num_responses = query_attribute_lists(1, first_attribute_lists, &first_attribute_lists_len);
+    // same responses for each query, e.g. from response cache
+    for (uint16_t i = 0; i < 3; i++){
+        uint8_t  attribute_lists[2000];
+        uint16_t attribute_lists_len;
+        CHECK_EQUAL(num_responses, query_attribute_lists(1, attribute_lists, &attribute_lists_len));
+        CHECK_EQUAL(first_attribute_lists_len, attribute_lists_len);
+        MEMCMP_EQUAL(first_attribute_lists, attribute_lists, attribute_lists_len);
+    }
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -24,6 +24,7 @@
 #define ENABLE_LE_SECURE_CONNECTIONS
 #define ENABLE_LE_SIGNED_WRITE
 #define ENABLE_SDP_EXTRA_QUERIES
+#define ENABLE_SM_ADDRESS_RESOLUTION_CACHE
 #define ENABLE_SOFTWARE_AES128
 
 // BTstack configuration. buffers, sizes, ...
@@ -31,6 +32,7 @@
 #define HCI_INCOMING_PRE_BUFFER_SIZE 4
 
 #define MAX_NR_LE_DEVICE_DB_ENTRIES 4
+#define SM_ADDRESS_RESOLUTION_CACHE_SIZE 4
 
 #define NVM_NUM_LINK_KEYS 2
 
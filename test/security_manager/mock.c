@@ -325,3 +325,6 @@ static uint32_t time_ms;
 uint32_t hal_time_ms(void){
 	return time_ms++;
 }
+void mock_advance_time_ms(uint32_t ms){
+	time_ms += ms;
+}
@@ -24,7 +24,10 @@
 #include "hci_dump.h"
 #include "hci_dump_posix_fs.h"
 #include "l2cap.h"
+#include "ble/le_device_db.h"
 #include "ble/sm.h"
+#include "btstack_crypto.h"
+#include "btstack_event.h"
 
 uint8_t test_command_packet_sc_read_public_key[] = { 0x25, 0x20, 0x00 };
 
@@ -109,6 +112,16 @@ bd_addr_t test_device_addr = {0x34, 0xb1, 0xf7, 0xd1, 0x77, 0x9b};
 
 static btstack_packet_callback_registration_t sm_event_callback_registration;
 
+// shared by all test groups, independent of execution order
+static void init_memory_and_run_loop(void){
+    static int first = 1;
+    if (first){
+        first = 0;
+        btstack_memory_init();
+        btstack_run_loop_init(btstack_run_loop_embedded_get_instance());
+    }
+}
+
 extern "C" {
     void mock_init(void);
     void mock_simulate_hci_state_working(void);
@@ -120,6 +133,7 @@ extern "C" {
     uint8_t * mock_packet_buffer(void);
     uint16_t mock_packet_buffer_len(void);
     void mock_clear_packet_buffer(void);
+    void mock_advance_time_ms(uint32_t ms);
 }
 
 void app_packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
@@ -224,14 +238,190 @@ bool get_ltk_callback(hci_con_handle_t con_handle, uint8_t address_type, bd_addr
 }
 
 
+// address resolution
+#define NUM_RESOLUTION_RESULTS 8
+
+static btstack_packet_callback_registration_t address_resolution_callback_registration;
+static int  address_resolution_num_results;
+static int  address_resolution_results[NUM_RESOLUTION_RESULTS];
+
+static void address_resolution_handler (uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    int result;
+    switch (hci_event_packet_get_type(packet)){
+        case SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED:
+            result = sm_event_identity_resolving_succeeded_get_index(packet);
+            break;
+        case SM_EVENT_IDENTITY_RESOLVING_FAILED:
+            result = -1;
+            break;
+        default:
+            return;
+    }
+    if (address_resolution_num_results < NUM_RESOLUTION_RESULTS){
+        address_resolution_results[address_resolution_num_results++] = result;
+    }
+}
+
+static void irk_for_device(int device, sm_key_t irk){
+    for (int i = 0; i < 16; i++){
+        irk[i] = (uint8_t) ((device << 4) + i + 1);
+    }
+}
+
+static void identity_address_for_device(int device, bd_addr_t address){
+    bd_addr_t identity_address = { 0x00, 0x1b, 0xdc, 0x07, 0x32, (uint8_t) device };
+    bd_addr_copy(address, identity_address);
+}
+
+// rpa = hash || prand with hash = ah(irk, prand)
+static void rpa_for_irk(const sm_key_t irk, uint8_t id, bd_addr_t rpa){
+    sm_key_t plaintext;
+    sm_key_t ciphertext;
+    memset(plaintext, 0, sizeof(plaintext));
+    plaintext[13] = 0x40 | id;
+    plaintext[14] = 0x12;
+    plaintext[15] = 0x34;
+    btstack_aes128_calc(irk, plaintext, ciphertext);
+    memcpy(&rpa[0], &plaintext[13], 3);
+    memcpy(&rpa[3], &ciphertext[13], 3);
+}
+
+TEST_GROUP(SecurityManagerAddressResolution){
+    void setup(void){
+        init_memory_and_run_loop();
+        sm_init();
+        le_device_db_init();
+        for (int device = 0; device < MAX_NR_LE_DEVICE_DB_ENTRIES; device++){
+            add_device(device);
+        }
+        address_resolution_num_results = 0;
+        address_resolution_callback_registration.callback = &address_resolution_handler;
+        sm_add_event_handler(&address_resolution_callback_registration);
+    }
+    void teardown(void){
+        sm_remove_event_handler(&address_resolution_callback_registration);
+    }
+    int add_device(int device){
+        bd_addr_t identity_address;
+        sm_key_t irk;
+        identity_address_for_device(device, identity_address);
+        irk_for_device(device, irk);
+        return le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, identity_address, irk);
+    }
+    void lookup(const sm_key_t irk, uint8_t id){
+        bd_addr_t rpa;
+        rpa_for_irk(irk, id, rpa);
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, sm_address_resolution_lookup((uint8_t) BD_ADDR_TYPE_LE_RANDOM, rpa));
+    }
+    void lookup_device(int device, uint8_t id){
+        sm_key_t irk;
+        irk_for_device(device, irk);
+        lookup(irk, id);
+    }
+    void run(void){
+        for (int i = 0; i < 10; i++){
+            btstack_run_loop_embedded_execute_once();
+        }
+    }
+};
+
+TEST(SecurityManagerAddressResolution, Resolve){
+    lookup_device(2, 0);
+    run();
+    CHECK_EQUAL(1, address_resolution_num_results);
+    CHECK_EQUAL(2, address_resolution_results[0]);
+
+    // unknown irk
+    sm_key_t irk;
+    irk_for_device(MAX_NR_LE_DEVICE_DB_ENTRIES, irk);
+    lookup(irk, 0);
+    run();
+    CHECK_EQUAL(2, address_resolution_num_results);
+    CHECK_EQUAL(-1, address_resolution_results[1]);
+}
+
+TEST(SecurityManagerAddressResolution, ResolveBatch){
+    // all pending lookups complete within a single run with software AES128
+    lookup_device(0, 0);
+    lookup_device(3, 0);
+    lookup_device(1, 0);
+    btstack_run_loop_embedded_execute_once();
+    CHECK_EQUAL(3, address_resolution_num_results);
+    // results in any order
+    int resolved_devices = 0;
+    for (int i = 0; i < address_resolution_num_results; i++){
+        CHECK(address_resolution_results[i] >= 0);
+        resolved_devices |= 1 << address_resolution_results[i];
+    }
+    CHECK_EQUAL((1 << 0) | (1 << 1) | (1 << 3), resolved_devices);
+}
+
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+TEST(SecurityManagerAddressResolution, Cache){
+    sm_key_t irk;
+    irk_for_device(1, irk);
+    lookup(irk, 1);
+    run();
+
+    // replace irk of device 1, cached rpa still resolves to same identity
+    le_device_db_remove(1);
+    bd_addr_t identity_address;
+    identity_address_for_device(1, identity_address);
+    sm_key_t new_irk;
+    irk_for_device(MAX_NR_LE_DEVICE_DB_ENTRIES, new_irk);
+    CHECK_EQUAL(1, le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, identity_address, new_irk));
+    lookup(irk, 1);
+    run();
+    CHECK_EQUAL(2, address_resolution_num_results);
+    CHECK_EQUAL(1, address_resolution_results[1]);
+
+    // cache entry expires after private address timeout
+    mock_advance_time_ms(60 * 60 * 1000);
+    lookup(irk, 1);
+    run();
+    CHECK_EQUAL(3, address_resolution_num_results);
+    CHECK_EQUAL(-1, address_resolution_results[2]);
+}
+
+TEST(SecurityManagerAddressResolution, CacheInvalidatedByDeviceRemoval){
+    sm_key_t irk;
+    irk_for_device(3, irk);
+    lookup(irk, 2);
+    run();
+    CHECK_EQUAL(3, address_resolution_results[0]);
+
+    // different device stored at same index
+    le_device_db_remove(3);
+    CHECK_EQUAL(3, add_device(MAX_NR_LE_DEVICE_DB_ENTRIES));
+    lookup(irk, 2);
+    run();
+    CHECK_EQUAL(2, address_resolution_num_results);
+    CHECK_EQUAL(-1, address_resolution_results[1]);
+}
+
+TEST(SecurityManagerAddressResolution, CacheReplacement){
+    // more resolved addresses than cache entries
+    int i;
+    for (i = 0; i < (SM_ADDRESS_RESOLUTION_CACHE_SIZE + 4); i++){
+        lookup_device(i % MAX_NR_LE_DEVICE_DB_ENTRIES, (uint8_t) i);
+        run();
+    }
+    for (i = 0; i < (SM_ADDRESS_RESOLUTION_CACHE_SIZE + 4); i++){
+        address_resolution_num_results = 0;
+        lookup_device(i % MAX_NR_LE_DEVICE_DB_ENTRIES, (uint8_t) i);
+        run();
+        CHECK_EQUAL(1, address_resolution_num_results);
+        CHECK_EQUAL(i % MAX_NR_LE_DEVICE_DB_ENTRIES, address_resolution_results[0]);
+    }
+}
+#endif
+
 TEST_GROUP(SecurityManager){
 	void setup(void){
-        static int first = 1;
-        if (first){
-            first = 0;
-            btstack_memory_init();
-            btstack_run_loop_init(btstack_run_loop_embedded_get_instance());
-        }
+        init_memory_and_run_loop();
 	    sm_init();
 	    sm_set_io_capabilities(IO_CAPABILITY_NO_INPUT_NO_OUTPUT);
 	    sm_set_authentication_requirements( SM_AUTHREQ_BONDING ); 
@@ -9,12 +9,19 @@
 #include "btstack_util.h"
 #include "btstack_config.h"
 #include "btstack_debug.h"
+#include <sys/stat.h>
 #include <unistd.h>
 
 #define TEST_DB "/tmp/test.tlv"
 
 #define TAG(a,b,c,d) ( ((a)<<24) | ((b)<<16) | ((c)<<8) | (d) )
 
+static long file_size(const char * path){
+	struct stat st;
+	if (stat(path, &st) != 0) return -1;
+	return (long) st.st_size;
+}
+
 /// TLV
 TEST_GROUP(BSTACK_TLV){
 	const btstack_tlv_t * btstack_tlv_impl;
@@ -28,16 +35,13 @@ TEST_GROUP(BSTACK_TLV){
     }
     void reopen_db(void){
     	log_info("reopen");
-    	// close file 
-    	fclose(btstack_tlv_context.file);
-    	// reopen
+    	// close file and reopen
         btstack_tlv_posix_deinit(&btstack_tlv_context);
 		btstack_tlv_impl = btstack_tlv_posix_init_instance(&btstack_tlv_context, TEST_DB);
     }
     void teardown(void){
     	log_info("teardown");
     	// close file
-    	fclose(btstack_tlv_context.file);
         btstack_tlv_posix_deinit(&btstack_tlv_context);
     }
 };
@@ -185,6 +189,124 @@ TEST(BSTACK_TLV, TestWriteDeleteResetReadDeleteRead){
 }
 
 
+TEST(BSTACK_TLV, TestManyTags){
+	uint32_t i;
+	uint8_t  buffer[16];
+	for (i = 0; i < 2000; i++){
+		memset(buffer, (uint8_t) i, sizeof(buffer));
+		btstack_tlv_impl->store_tag(&btstack_tlv_context, TAG('l','k',0,0) + i, buffer, 1 + (i % 16));
+	}
+	for (i = 0; i < 2000; i += 2){
+		btstack_tlv_impl->delete_tag(&btstack_tlv_context, TAG('l','k',0,0) + i);
+	}
+
+	reopen_db();
+
+	for (i = 0; i < 2000; i++){
+		int size = btstack_tlv_impl->get_tag(&btstack_tlv_context, TAG('l','k',0,0) + i, buffer, sizeof(buffer));
+		if ((i & 1) == 0){
+			CHECK_EQUAL(0, size);
+		} else {
+			CHECK_EQUAL(1 + (i % 16), size);
+			CHECK_EQUAL((uint8_t) i, buffer[0]);
+		}
+	}
+}
+
+TEST(BSTACK_TLV, TestCompaction){
+	uint32_t tag = TAG('a','b','c','d');
+	uint32_t i;
+	uint8_t  data[8];
+	memcpy(data, "01234567", 8);
+	for (i = 0; i < 1000; i++){
+		data[0] = (uint8_t) i;
+		btstack_tlv_impl->store_tag(&btstack_tlv_context, tag, data, 8);
+	}
+	// file is compacted instead of containing all 1000 records
+	CHECK(file_size(TEST_DB) < (8 + (200 * 16)));
+	CHECK(btstack_tlv_context.num_records < 200);
+
+	reopen_db();
+
+	uint8_t buffer[8];
+	btstack_tlv_impl->get_tag(&btstack_tlv_context, tag, buffer, 8);
+	MEMCMP_EQUAL(data, buffer, 8);
+}
+
+TEST(BSTACK_TLV, TestWriteCoalescing){
+	uint32_t tag_a = TAG('a','a','a','a');
+	uint32_t tag_b = TAG('b','b','b','b');
+	uint8_t  data = 7;
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, tag_b, &data, 1);
+	long size_before = file_size(TEST_DB);
+
+	btstack_tlv_posix_set_write_coalescing(&btstack_tlv_context, true);
+	uint32_t i;
+	for (i = 0; i < 100; i++){
+		data = (uint8_t) i;
+		btstack_tlv_impl->store_tag(&btstack_tlv_context, tag_a, &data, 1);
+	}
+	btstack_tlv_impl->delete_tag(&btstack_tlv_context, tag_b);
+	// nothing written yet, but visible
+	CHECK_EQUAL(size_before, file_size(TEST_DB));
+	CHECK_EQUAL(0, btstack_tlv_impl->get_tag(&btstack_tlv_context, tag_b, NULL, 0));
+	uint8_t buffer = 0;
+	btstack_tlv_impl->get_tag(&btstack_tlv_context, tag_a, &buffer, 1);
+	CHECK_EQUAL(99, buffer);
+
+	// a single store and a single delete are written on sync
+	btstack_tlv_posix_sync(&btstack_tlv_context);
+	CHECK_EQUAL(size_before + 9 + 8, file_size(TEST_DB));
+
+	reopen_db();
+
+	CHECK_EQUAL(0, btstack_tlv_impl->get_tag(&btstack_tlv_context, tag_b, NULL, 0));
+	btstack_tlv_impl->get_tag(&btstack_tlv_context, tag_a, &buffer, 1);
+	CHECK_EQUAL(99, buffer);
+}
+
+TEST(BSTACK_TLV, TestWriteCoalescingDeinit){
+	uint32_t tag = TAG('a','b','c','d');
+	uint8_t  data = 7;
+	btstack_tlv_posix_set_write_coalescing(&btstack_tlv_context, true);
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, tag, &data, 1);
+
+	// deinit writes pending changes
+	reopen_db();
+
+	uint8_t buffer = 0;
+	CHECK_EQUAL(1, btstack_tlv_impl->get_tag(&btstack_tlv_context, tag, &buffer, 1));
+	CHECK_EQUAL(data, buffer);
+}
+
+TEST(BSTACK_TLV, TestStoreEachTagTwice){
+	uint8_t value[64];
+	memset(value, 0x55, sizeof(value));
+	for (int coalescing = 0; coalescing < 2; coalescing++){
+		btstack_tlv_posix_deinit(&btstack_tlv_context);
+		unlink(TEST_DB);
+		btstack_tlv_impl = btstack_tlv_posix_init_instance(&btstack_tlv_context, TEST_DB);
+		btstack_tlv_posix_set_write_coalescing(&btstack_tlv_context, coalescing != 0);
+
+		// store each tag twice, e.g. bonding info and updated CCC
+		uint32_t j;
+		for (uint32_t round = 0; round < 2; round++){
+			for (j = 0; j < 1000; j++){
+				value[0] = (uint8_t) round;
+				btstack_tlv_impl->store_tag(&btstack_tlv_context, TAG('b','n',0,0) + j, value, sizeof(value));
+			}
+		}
+
+		reopen_db();
+
+		uint8_t buffer[64];
+		for (j = 0; j < 1000; j++){
+			CHECK_EQUAL(sizeof(buffer), btstack_tlv_impl->get_tag(&btstack_tlv_context, TAG('b','n',0,0) + j, buffer, sizeof(buffer)));
+			CHECK_EQUAL(1, buffer[0]);
+		}
+	}
+}
+
 int main (int argc, const char * argv[]){
     // log into file using HCI_DUMP_PACKETLOGGER format
     const char * log_path = "hci_dump.pklg";
@@ -0,0 +1,21 @@
+//
+// btstack_config.h for btstack_uart_posix test
+//
+
+#ifndef BTSTACK_CONFIG_H
+#define BTSTACK_CONFIG_H
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_FILE_IO
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_LOG_ERROR
+#define ENABLE_LOG_INFO
+#define ENABLE_PRINTF_HEXDUMP
+
+// small read-ahead buffer to also test direct reads of large blocks
+#define BTSTACK_UART_POSIX_RECEIVE_BUFFER_SIZE 64
+
+#endif
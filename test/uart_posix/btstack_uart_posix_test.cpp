@@ -0,0 +1,238 @@
+// Test POSIX UART block reads from read-ahead buffer with a pseudo terminal as Controller
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_uart.h"
+#include "btstack_util.h"
+
+#define MAX_BLOCKS      8
+#define LARGE_BLOCK_LEN 200
+
+static int pty_master_fd;
+static char pty_slave_name[64];
+
+static const btstack_uart_t * uart;
+static btstack_uart_config_t uart_config;
+
+// blocks requested in order, block_received requests next block if auto_receive is set
+static uint16_t block_lens[MAX_BLOCKS];
+static uint8_t  block_buffers[MAX_BLOCKS][LARGE_BLOCK_LEN];
+static uint16_t num_blocks;
+static uint16_t num_blocks_requested;
+static uint16_t num_blocks_received;
+static uint16_t num_blocks_until_exit;
+static bool     auto_receive;
+static uint16_t block_received_depth;
+static uint16_t block_received_max_depth;
+
+static btstack_timer_source_t timeout_timer;
+
+static void receive_next_block(void){
+    CHECK(num_blocks_requested < num_blocks);
+    uart->receive_block(block_buffers[num_blocks_requested], block_lens[num_blocks_requested]);
+    num_blocks_requested++;
+}
+
+static void block_received(void){
+    block_received_depth++;
+    block_received_max_depth = (uint16_t) btstack_max(block_received_max_depth, block_received_depth);
+    num_blocks_received++;
+    if (auto_receive && (num_blocks_requested < num_blocks)){
+        receive_next_block();
+    }
+    if (num_blocks_received == num_blocks_until_exit){
+        btstack_run_loop_trigger_exit();
+    }
+    block_received_depth--;
+}
+
+static void timeout_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    btstack_run_loop_trigger_exit();
+}
+
+// run until num_blocks_received reaches given count or timeout
+static void run_until_blocks_received(uint16_t count, uint32_t timeout_ms){
+    num_blocks_until_exit = count;
+    if (num_blocks_received >= count) return;
+    btstack_run_loop_set_timer_handler(&timeout_timer, &timeout_handler);
+    btstack_run_loop_set_timer(&timeout_timer, timeout_ms);
+    btstack_run_loop_add_timer(&timeout_timer);
+    btstack_run_loop_execute();
+    btstack_run_loop_remove_timer(&timeout_timer);
+}
+
+// data for block i is i, i+1, i+2, ...
+static void controller_send_blocks(uint16_t first, uint16_t count){
+    uint8_t data[LARGE_BLOCK_LEN * MAX_BLOCKS];
+    uint16_t len = 0;
+    uint16_t i;
+    for (i = first; i < first + count; i++){
+        uint16_t j;
+        for (j = 0; j < block_lens[i]; j++){
+            data[len++] = (uint8_t) (i + j);
+        }
+    }
+    CHECK_EQUAL(len, write(pty_master_fd, data, len));
+}
+
+static void check_block(uint16_t index){
+    uint16_t j;
+    for (j = 0; j < block_lens[index]; j++){
+        CHECK_EQUAL((uint8_t) (index + j), block_buffers[index][j]);
+    }
+}
+
+TEST_GROUP(UART_POSIX){
+    void setup(void){
+        pty_master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+        CHECK(pty_master_fd >= 0);
+        CHECK_EQUAL(0, grantpt(pty_master_fd));
+        CHECK_EQUAL(0, unlockpt(pty_master_fd));
+        btstack_strcpy(pty_slave_name, sizeof(pty_slave_name), ptsname(pty_master_fd));
+
+        btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+        uart_config.baudrate = 115200;
+        uart_config.flowcontrol = 0;
+        uart_config.device_name = pty_slave_name;
+        uart_config.parity = 0;
+        uart = btstack_uart_posix_instance();
+        CHECK_EQUAL(0, uart->init(&uart_config));
+        uart->set_block_received(&block_received);
+        CHECK_EQUAL(0, uart->open());
+
+        memset(block_buffers, 0, sizeof(block_buffers));
+        num_blocks = 0;
+        num_blocks_requested = 0;
+        num_blocks_received = 0;
+        auto_receive = true;
+        block_received_depth = 0;
+        block_received_max_depth = 0;
+    }
+
+    void teardown(void){
+        uart->close();
+        close(pty_master_fd);
+        btstack_run_loop_deinit();
+    }
+
+    // H4 event: packet type, event header, event parameters
+    void add_h4_event(uint8_t param_len){
+        block_lens[num_blocks++] = 1;
+        block_lens[num_blocks++] = 2;
+        block_lens[num_blocks++] = param_len;
+    }
+};
+
+TEST(UART_POSIX, BlocksFromSingleReadWithoutRecursion){
+    add_h4_event(4);
+    add_h4_event(10);
+    controller_send_blocks(0, num_blocks);
+    receive_next_block();
+    run_until_blocks_received(num_blocks, 1000);
+    CHECK_EQUAL(num_blocks, num_blocks_received);
+    // receive_block from block_received is served by the buffer loop, not by a nested block_received call
+    CHECK_EQUAL(1, block_received_max_depth);
+    uint16_t i;
+    for (i = 0; i < num_blocks; i++){
+        check_block(i);
+    }
+}
+
+TEST(UART_POSIX, PartialBlock){
+    block_lens[num_blocks++] = 10;
+    block_lens[num_blocks++] = 3;
+    receive_next_block();
+
+    // first part of block
+    uint8_t data[13];
+    uint16_t i;
+    for (i = 0; i < 10; i++){
+        data[i] = (uint8_t) i;
+    }
+    for (i = 0; i < 3; i++){
+        data[10 + i] = (uint8_t) (1 + i);
+    }
+    CHECK_EQUAL(4, write(pty_master_fd, data, 4));
+    run_until_blocks_received(1, 50);
+    CHECK_EQUAL(0, num_blocks_received);
+
+    // rest of first block and start of second block
+    CHECK_EQUAL(7, write(pty_master_fd, &data[4], 7));
+    run_until_blocks_received(1, 1000);
+    CHECK_EQUAL(1, num_blocks_received);
+    check_block(0);
+
+    // rest of second block
+    CHECK_EQUAL(2, write(pty_master_fd, &data[11], 2));
+    run_until_blocks_received(2, 1000);
+    CHECK_EQUAL(2, num_blocks_received);
+    check_block(1);
+}
+
+TEST(UART_POSIX, BackToBackReceiveFromBufferedBytes){
+    auto_receive = false;
+    block_lens[num_blocks++] = 1;
+    block_lens[num_blocks++] = 2;
+    block_lens[num_blocks++] = 5;
+    controller_send_blocks(0, num_blocks);
+    receive_next_block();
+    run_until_blocks_received(1, 1000);
+    CHECK_EQUAL(1, num_blocks_received);
+
+    // remaining blocks are already buffered and delivered from receive_block without run loop
+    receive_next_block();
+    CHECK_EQUAL(2, num_blocks_received);
+    receive_next_block();
+    CHECK_EQUAL(3, num_blocks_received);
+    uint16_t i;
+    for (i = 0; i < num_blocks; i++){
+        check_block(i);
+    }
+}
+
+TEST(UART_POSIX, LargeBlockReadDirectly){
+    block_lens[num_blocks++] = 1;
+    block_lens[num_blocks++] = LARGE_BLOCK_LEN;
+    block_lens[num_blocks++] = 1;
+    controller_send_blocks(0, 1);
+    receive_next_block();
+    run_until_blocks_received(1, 1000);
+    controller_send_blocks(1, 2);
+    run_until_blocks_received(num_blocks, 1000);
+    CHECK_EQUAL(num_blocks, num_blocks_received);
+    uint16_t i;
+    for (i = 0; i < num_blocks; i++){
+        check_block(i);
+    }
+}
+
+TEST(UART_POSIX, CloseDropsBufferedBytes){
+    auto_receive = false;
+    block_lens[num_blocks++] = 1;
+    block_lens[num_blocks++] = 2;
+    controller_send_blocks(0, num_blocks);
+    receive_next_block();
+    run_until_blocks_received(1, 1000);
+    CHECK_EQUAL(1, num_blocks_received);
+
+    uart->close();
+    CHECK_EQUAL(0, uart->open());
+    receive_next_block();
+    run_until_blocks_received(2, 50);
+    CHECK_EQUAL(1, num_blocks_received);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}